@@ -7,6 +7,9 @@
 #include "sys.h"
 #include "fmt.h"
 #include "array.h"
+#include "vd_log.h"
+#include <stdlib.h>
+
 static struct {
     lua_State     *l;
     str            exec_path;
@@ -21,8 +24,63 @@ int l_c_parse(lua_State *l)
     return 1;
 }
 
+static VD_LOG_DECODE_PROC(write_decoded_line)
+{
+    fwrite(text, 1, len, (FILE*)c);
+}
+
+/**
+ * @brief vdcli decode-log <binary log> [output]
+ * Expands a log that was written with VD_LOG_BINARY into text, to output or stdout.
+ */
+static int decode_log(int argc, char const *argv[])
+{
+    if (argc < 3) {
+        vd_fmt_printf("USAGE\n");
+        vd_fmt_printf("vdcli decode-log <engine.vdlog> [output]\n");
+        return 1;
+    }
+
+    FILE *in = fopen(argv[2], "rb");
+    if (!in) {
+        vd_fmt_printf("Failed to open %{cstr}\n", argv[2]);
+        return 1;
+    }
+
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+
+    char *data = (char*)malloc(size);
+    size_t read = fread(data, 1, size, in);
+    fclose(in);
+
+    FILE *out = argc > 3 ? fopen(argv[3], "wb") : stdout;
+    if (!out) {
+        vd_fmt_printf("Failed to open %{cstr}\n", argv[3]);
+        free(data);
+        return 1;
+    }
+
+    int result = vd_log_decode(data, read, write_decoded_line, out);
+    if (result != 0) {
+        vd_fmt_fprintf(stderr, "%{cstr} is truncated or not a binary log\n", argv[2]);
+    }
+
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    free(data);
+    return result != 0;
+}
+
 int main(int argc, char const *argv[])
 {
+    if (argc >= 2 && strcmp(argv[1], "decode-log") == 0) {
+        return decode_log(argc, argv);
+    }
+
     G.a = arena_new(4096*2, vd_memory_get_system_allocator());
     G.l = luaL_newstate();
     luaL_openlibs(G.l);
@@ -1,5 +1,4 @@
 #define VD_INTERNAL_SOURCE_FILE 1
-#define VD_LOG_IMPLEMENTATION
 #include "instance.h"
 #include "mm.h"
 #include "array.h"
@@ -1,7 +1,283 @@
 #include "arena.h"
+
+#if VD_PLATFORM_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+/* ----VIRTUAL MEMORY---------------------------------------------------------------------------- */
+static void *vm_reserve(u64 size)
+{
+#if VD_PLATFORM_WINDOWS
+    return VirtualAlloc(0, (SIZE_T)size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif
+    void *result = mmap(0, (size_t)size, PROT_NONE, flags, -1, 0);
+    return result == MAP_FAILED ? 0 : result;
+#endif
+}
+
+static int vm_commit(umm ptr, u64 size)
+{
+#if VD_PLATFORM_WINDOWS
+    return VirtualAlloc((void*)ptr, (SIZE_T)size, MEM_COMMIT, PAGE_READWRITE) != 0;
+#else
+    return mprotect((void*)ptr, (size_t)size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+static void vm_decommit(umm ptr, u64 size)
+{
+#if VD_PLATFORM_WINDOWS
+    VirtualFree((void*)ptr, (SIZE_T)size, MEM_DECOMMIT);
+#else
+    madvise((void*)ptr, (size_t)size, MADV_DONTNEED);
+    mprotect((void*)ptr, (size_t)size, PROT_NONE);
+#endif
+}
+
+static void vm_release(umm ptr, u64 size)
+{
+#if VD_PLATFORM_WINDOWS
+    VirtualFree((void*)ptr, 0, MEM_RELEASE);
+#else
+    munmap((void*)ptr, (size_t)size);
+#endif
+}
+
+static u64 round_up_to_commit_granularity(u64 size)
+{
+    return (size + VD_ARENA_COMMIT_GRANULARITY - 1) & ~(u64)(VD_ARENA_COMMIT_GRANULARITY - 1);
+}
+
+VD_Arena vd_arena_new_virtual(u64 reserve_size, u64 retain_size)
+{
+    reserve_size = round_up_to_commit_granularity(reserve_size);
+    umm data = (umm)vm_reserve(reserve_size);
+
+    VD_Arena arena = {
+        .data = data,
+        .begin = data,
+        .end = data,
+        .flags = VD_ARENA_FLAG_VIRTUAL,
+        .reserved = data ? reserve_size : 0,
+        .retained = round_up_to_commit_granularity(retain_size),
+    };
+
+    return arena;
+}
+
+static int commit_more(VD_Arena *arena, ptrdiff_t size, ptrdiff_t align)
+{
+    u64 needed = (u64)(arena->begin - arena->data) + (u64)size + (u64)align;
+    if (needed > arena->reserved) {
+        return 0;
+    }
+
+    // Commit at least as much as is retained, so the first frames don't commit page by page
+    u64 new_committed = round_up_to_commit_granularity(needed);
+    if (new_committed < arena->retained) {
+        new_committed = arena->retained;
+    }
+
+    if (new_committed > arena->reserved) {
+        new_committed = arena->reserved;
+    }
+
+    if (!vm_commit(arena->end, new_committed - arena->committed)) {
+        return 0;
+    }
+
+    arena->committed = new_committed;
+    vd_atomic_fence();
+    *(volatile umm*)&arena->end = arena->data + new_committed;
+    return 1;
+}
+
+/* ----BLOCKS------------------------------------------------------------------------------------ */
+
+static void update_high_water(VD_Arena *arena)
+{
+    u64 used = vd_arena_get_used(arena);
+    if (used > arena->high_water) {
+        arena->high_water = used;
+    }
+}
+
+static void set_block(VD_Arena *arena, VD_ArenaBlock *block, umm begin)
+{
+    umm data = (umm)(block + 1);
+
+    // Concurrent vd_arena_alloc_t callers must never see the new begin with the old end.
+    *(volatile umm*)&arena->end = 0;
+    vd_atomic_fence();
+    arena->block = block;
+    arena->data  = data;
+    arena->begin = begin ? begin : data;
+    vd_atomic_fence();
+    *(volatile umm*)&arena->end = data + block->size;
+}
+
+static VD_ArenaBlock *allocate_block(VD_Arena *arena, size_t size)
+{
+    VD_ArenaBlock *block = (VD_ArenaBlock*)vd_malloc(arena->allocator, sizeof(VD_ArenaBlock) + size);
+    if (!block) {
+        return 0;
+    }
+
+    block->prev = 0;
+    block->size = size;
+    arena->committed += size;
+    return block;
+}
+
+static void free_block(VD_Arena *arena, VD_ArenaBlock *block)
+{
+    arena->committed -= block->size;
+    vd_free(arena->allocator, (umm)block, sizeof(VD_ArenaBlock) + block->size);
+}
+
+int vd_arena__grow(VD_Arena *arena, ptrdiff_t size, ptrdiff_t align)
+{
+    if (arena->flags & VD_ARENA_FLAG_VIRTUAL) {
+        return commit_more(arena, size, align);
+    }
+
+    size_t block_size = arena->min_block_size;
+    size_t needed = (size_t)(size + align);
+    if (block_size < needed) {
+        block_size = needed;
+    }
+
+    VD_ArenaBlock *block = allocate_block(arena, block_size);
+    if (!block) {
+        return 0;
+    }
+
+    if (arena->block) {
+        arena->prev_used += arena->begin - arena->data;
+    }
+
+    block->prev = arena->block;
+    set_block(arena, block, 0);
+    return 1;
+}
+
+void vd_arena_rewind(VD_Arena *arena, VD_ArenaMark mark)
+{
+    update_high_water(arena);
+
+    if (!(arena->flags & VD_ARENA_FLAG_CHAINED) || arena->block == mark.block) {
+        arena->begin = mark.begin;
+        arena->prev_used = mark.prev_used;
+        return;
+    }
+
+    VD_ArenaBlock *block = arena->block;
+    while (block && block != mark.block) {
+        VD_ArenaBlock *prev = block->prev;
+        free_block(arena, block);
+        block = prev;
+    }
+
+    arena->prev_used = mark.prev_used;
+    set_block(arena, block, mark.begin);
+}
+
+void vd_arena_reset(VD_Arena *arena)
+{
+    update_high_water(arena);
+    arena->prev_used = 0;
+
+    if ((arena->flags & VD_ARENA_FLAG_VIRTUAL) && (arena->committed > arena->retained)) {
+        arena->end = arena->data + arena->retained;
+        vm_decommit(arena->end, arena->committed - arena->retained);
+        arena->committed = arena->retained;
+    }
+
+    if (!(arena->flags & VD_ARENA_FLAG_CHAINED) || !arena->block || !arena->block->prev) {
+        arena->begin = arena->data;
+        return;
+    }
+
+    // More than one block was needed. Replace them with a single block that is big enough for all of
+    // them, so the next cycle does not need to chain.
+    size_t total = (size_t)arena->committed;
+
+    VD_ArenaBlock *block = arena->block;
+    while (block) {
+        VD_ArenaBlock *prev = block->prev;
+        free_block(arena, block);
+        block = prev;
+    }
+
+    arena->block = 0;
+    block = allocate_block(arena, total);
+    if (!block) {
+        block = allocate_block(arena, arena->min_block_size);
+    }
+
+    // Out of memory: leave the arena empty, the next allocation will try to grow it again.
+    if (!block) {
+        arena->data = arena->begin = arena->end = 0;
+        return;
+    }
+
+    set_block(arena, block, 0);
+}
+
+void vd_arena_free(VD_Arena *arena)
+{
+    if (arena->flags & VD_ARENA_FLAG_VIRTUAL) {
+        if (arena->data) {
+            vm_release(arena->data, arena->reserved);
+        }
+
+        arena->data = arena->begin = arena->end = 0;
+        arena->committed = 0;
+        return;
+    }
+
+    if (!(arena->flags & VD_ARENA_FLAG_CHAINED)) {
+        vd_free(arena->allocator, arena->data, arena->end - arena->data);
+        return;
+    }
+
+    VD_ArenaBlock *block = arena->block;
+    while (block) {
+        VD_ArenaBlock *prev = block->prev;
+        free_block(arena, block);
+        block = prev;
+    }
+
+    arena->block = 0;
+    arena->data = arena->begin = arena->end = 0;
+}
+
 VD_PROC_ALLOC(vd_arena_proc_alloc)
 {
     VD_Arena *arena = (VD_Arena*)c;
+
+    // The most recent allocation can grow or shrink where it is, which is what growing arrays do
+    if (ptr != 0 && ptr + prevsize == arena->begin) {
+        if (newsize <= prevsize) {
+            update_high_water(arena);
+            arena->begin = ptr + newsize;
+            return newsize == 0 ? 0 : ptr;
+        }
+
+        if ((ptrdiff_t)newsize <= (ptrdiff_t)(arena->end - ptr)) {
+            memset((void*)arena->begin, 0, newsize - prevsize);
+            arena->begin = ptr + newsize;
+            return ptr;
+        }
+    }
+
     if (newsize == 0) {
         return 0;
     }
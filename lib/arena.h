@@ -4,23 +4,138 @@
 #include <string.h>
 #include "vd_atomic.h"
 
+typedef struct VD_ArenaBlock VD_ArenaBlock;
+
+/** Header of every block of a chained arena. The block's memory follows right after it. */
+struct VD_ArenaBlock {
+    VD_ArenaBlock *prev;
+    size_t         size;
+};
+
+typedef enum {
+    /**
+     * When the current block is exhausted, a new block is reserved from the backing allocator
+     * instead of failing the allocation.
+     */
+    VD_ARENA_FLAG_CHAINED = 1 << 0,
+
+    /**
+     * The arena reserves a contiguous range of address space up front, and commits pages from it
+     * as it grows. Resetting gives back committed pages beyond the retained size.
+     */
+    VD_ARENA_FLAG_VIRTUAL = 1 << 1,
+} VD_ArenaFlags;
+
+/** Virtual arenas commit memory in steps of this many bytes. */
+#define VD_ARENA_COMMIT_GRANULARITY (64 * 1024)
+
 typedef struct {
-    umm           data;
-    umm           begin;
-    umm           end;
-    VD_Allocator *allocator;
+    umm            data;
+    umm            begin;
+    umm            end;
+    VD_Allocator  *allocator;
+    VD_ArenaFlags  flags;
+
+    /** The current block. Only used by chained arenas. */
+    VD_ArenaBlock *block;
+
+    /** Bytes used in the blocks before the current one. */
+    u64            prev_used;
+
+    /** Bytes reserved from the allocator in all blocks. */
+    u64            committed;
+
+    /** The most bytes that were in use at the same time. */
+    u64            high_water;
+    size_t         min_block_size;
+
+    /** Bytes of address space reserved. Only used by virtual arenas. */
+    u64            reserved;
+
+    /** Bytes that stay committed after a reset. Only used by virtual arenas. */
+    u64            retained;
+    volatile i32   lock;
 } VD_Arena;
 
+/**
+ * A position in an arena that can be rewound to, to free everything allocated after it.
+ */
+typedef struct {
+    VD_ArenaBlock *block;
+    umm            begin;
+    u64            prev_used;
+} VD_ArenaMark;
+
 #define VD_ARENA_ALLOC(arena, size) (vd_arena_alloc(arena, size, 8))
 #define VD_ARENA_ALLOC_T(arena, size) (vd_arena_alloc_t(arena, size, 8))
 #define VD_ARENA_ALLOC_ARRAY(arena, count, size) (vd_arena_alloc(arena, count * size, 8))
 #define VD_ARENA_ALLOC_ARRAY_T(arena, count, size) (vd_arena_alloc_t(arena, count * size, 8))
 #define VD_ARENA_ALLOC_STRUCT_T(arena, type) ((type*)vd_arena_alloc_t(arena, sizeof(type), 8))
 
+/**
+ * @brief Run the following statement/block and then rewind the arena to where it was before it.
+ * @note Leaving the block through return, break or goto skips the rewind.
+ */
+#define VD_ARENA_SCOPE(arena)                                                         \
+    for (VD_ArenaMark _vd_arena_mark_ = vd_arena_mark(arena), *_vd_arena_once_ = 0;   \
+         _vd_arena_once_ == 0;                                                        \
+         _vd_arena_once_ = &_vd_arena_mark_, vd_arena_rewind(arena, _vd_arena_mark_))
+
+/**
+ * @brief Make room for at least size bytes with align. Chained arenas reserve a new block, and
+ * virtual arenas commit more pages.
+ * @return 1 on success, 0 if the backing allocator failed or the reserved range is exhausted.
+ */
+int vd_arena__grow(VD_Arena *arena, ptrdiff_t size, ptrdiff_t align);
+
+/**
+ * @brief Free everything allocated after mark.
+ */
+void vd_arena_rewind(VD_Arena *arena, VD_ArenaMark mark);
+
+/**
+ * @brief Free every allocation. Chained arenas keep a single block, large enough to fit everything
+ * that was allocated since the last reset, so that repeating the same work does not need to reserve
+ * new blocks.
+ */
+void vd_arena_reset(VD_Arena *arena);
+
+/**
+ * @brief Create an arena backed by a reserved range of address space.
+ * @param reserve_size The size of the range. Allocations fail past this point.
+ * @param retain_size The number of bytes that stay committed when the arena is reset.
+ * @return The arena. Its data is 0 if the address space could not be reserved.
+ */
+VD_Arena vd_arena_new_virtual(u64 reserve_size, u64 retain_size);
+
+void vd_arena_free(VD_Arena *arena);
+
 VD_INLINE VD_Arena vd_arena_new(ptrdiff_t size, VD_Allocator *allocator)
 {
     umm data = vd_realloc(allocator, 0, 0, (size_t)size);
-    VD_Arena arena = {data, data, ((uintptr_t)data + size), allocator};
+    VD_Arena arena = {
+        .data = data,
+        .begin = data,
+        .end = ((uintptr_t)data + size),
+        .allocator = allocator,
+        .committed = (u64)size,
+    };
+    return arena;
+}
+
+/**
+ * @brief Create an arena that chains a new block from allocator whenever it runs out of space.
+ * @param block_size The size of the first block, and the minimum size of every block after it.
+ */
+VD_INLINE VD_Arena vd_arena_new_chained(ptrdiff_t block_size, VD_Allocator *allocator)
+{
+    VD_Arena arena = {
+        .allocator = allocator,
+        .flags = VD_ARENA_FLAG_CHAINED,
+        .min_block_size = (size_t)block_size,
+    };
+
+    vd_arena__grow(&arena, 0, 1);
     return arena;
 }
 
@@ -29,8 +144,14 @@ VD_INLINE void *vd_arena_alloc(VD_Arena *arena, ptrdiff_t size, ptrdiff_t align)
     ptrdiff_t padding = -(uintptr_t)arena->begin & (align - 1);
     ptrdiff_t available = arena->end - arena->begin - padding;
 
-    if (available < 0) {
-        return 0;
+    if (available < size) {
+        if (!(arena->flags & (VD_ARENA_FLAG_CHAINED | VD_ARENA_FLAG_VIRTUAL)) ||
+            !vd_arena__grow(arena, size, align))
+        {
+            return 0;
+        }
+
+        padding = -(uintptr_t)arena->begin & (align - 1);
     }
 
     void *p = (void*)(arena->begin + padding);
@@ -38,54 +159,103 @@ VD_INLINE void *vd_arena_alloc(VD_Arena *arena, ptrdiff_t size, ptrdiff_t align)
     return memset(p, 0, size);
 }
 
+/**
+ * @brief Thread safe version of vd_arena_alloc. Failed allocations do not consume space.
+ */
 VD_INLINE void *vd_arena_alloc_t(VD_Arena *arena, ptrdiff_t size, ptrdiff_t align)
 {
-    ptrdiff_t padding = -(uintptr_t)arena->begin & (align - 1);
-    ptrdiff_t available = arena->end - arena->begin - padding;
+    for (;;) {
+        umm begin = *(volatile umm*)&arena->begin;
+        umm end = *(volatile umm*)&arena->end;
+        ptrdiff_t padding = -(uintptr_t)begin & (align - 1);
 
-    if (available < 0) {
-        return 0;
-    }
+        if ((ptrdiff_t)(end - begin) - padding < size) {
+            if (!(arena->flags & (VD_ARENA_FLAG_CHAINED | VD_ARENA_FLAG_VIRTUAL))) {
+                return 0;
+            }
 
-    umm p = (umm)vd_atomic_fetch_and_adduptr(&arena->begin, padding + size);
+            // Chaining a block publishes end = 0 first, so that nobody can bump the new begin
+            // against the old end.
+            while (vd_atomic_compare_and_swap32(&arena->lock, 1, 0) != 0);
 
+            int ok = 1;
+            begin = arena->begin;
+            padding = -(uintptr_t)begin & (align - 1);
+            if ((ptrdiff_t)(arena->end - begin) - padding < size) {
+                ok = vd_arena__grow(arena, size, align);
+            }
 
-    p += padding;
+            vd_atomic_fence();
+            arena->lock = 0;
 
-    if (p + size > arena->end) {
-        return 0;
-    }
+            if (!ok) {
+                return 0;
+            }
+
+            continue;
+        }
 
-    return memset((void*)p, 0, size);
+        umm p = begin + padding;
+        if ((umm)vd_atomic_compare_and_swap_ptr(
+            (void *volatile*)&arena->begin,
+            (void*)(p + size),
+            (void*)begin) == begin)
+        {
+            return memset((void*)p, 0, size);
+        }
+    }
 }
 
-VD_INLINE void vd_arena_reset(VD_Arena *arena)
+/**
+ * @brief Remember the current position of the arena.
+ */
+VD_INLINE VD_ArenaMark vd_arena_mark(VD_Arena *arena)
 {
-    arena->begin = arena->data;
+    VD_ArenaMark mark = {
+        .block = arena->block,
+        .begin = arena->begin,
+        .prev_used = arena->prev_used,
+    };
+    return mark;
 }
 
-VD_INLINE void vd_arena_free(VD_Arena *arena)
+VD_INLINE u64 vd_arena_get_used(VD_Arena *arena)
 {
-    vd_free(arena->allocator, arena->data, arena->end - arena->data);
+    return arena->prev_used + (arena->begin - arena->data);
 }
 
 VD_INLINE void vd_arena_get_stats(VD_Arena *arena, u64 *used, u64 *total)
 {
-    *used = arena->begin - arena->data;
-    *total = arena->end - arena->data;
+    *used = vd_arena_get_used(arena);
+    *total = arena->committed;
+}
+
+/**
+ * @brief The most bytes that were in use at the same time since the arena was created.
+ */
+VD_INLINE u64 vd_arena_get_high_water(VD_Arena *arena)
+{
+    u64 used = vd_arena_get_used(arena);
+    return used > arena->high_water ? used : arena->high_water;
 }
 
 VD_PROC_ALLOC(vd_arena_proc_alloc);
 
 #if VD_ABBREVIATIONS
 #define Arena VD_Arena
+#define ArenaMark VD_ArenaMark
 #define arena_new vd_arena_new
+#define arena_new_chained vd_arena_new_chained
+#define arena_new_virtual vd_arena_new_virtual
 #define arena_alloc VD_ARENA_ALLOC
 #define arena_alloc_array VD_ARENA_ALLOC_ARRAY
 #define arena_alloc_struct VD_ARENA_ALLOC_STRUCT
 #define arena_alloc_t VD_ARENA_ALLOC_T
 #define arena_alloc_array_t VD_ARENA_ALLOC_ARRAY_T
 #define arena_alloc_struct_t VD_ARENA_ALLOC_STRUCT_T
+#define arena_mark vd_arena_mark
+#define arena_rewind vd_arena_rewind
+#define arena_scope VD_ARENA_SCOPE
 #define arena_reset vd_arena_reset
 #define arena_free vd_arena_free
 #endif
@@ -0,0 +1,98 @@
+#define VD_INTERNAL_SOURCE_FILE 1
+#include "array.h"
+#include "vd_atomic.h"
+
+#include <string.h>
+
+/**
+ * Call site records never move once created, since arrays point at them. Arrays from different
+ * threads share them, so they are only touched under the lock.
+ */
+static VD_ArraySite Sites[VD_ARRAY_DEBUG_MAX_SITES];
+static size_t       Sites_Len;
+static volatile i32 Sites_Lock;
+
+static void lock_sites(void)
+{
+    while (vd_atomic_compare_and_swap32(&Sites_Lock, 1, 0) != 0);
+}
+
+static void unlock_sites(void)
+{
+    vd_atomic_fence();
+    Sites_Lock = 0;
+}
+
+VD_ArraySite *vd_array__debug_site(const char *file, int line, size_t tsize)
+{
+    VD_ArraySite *result = 0;
+    lock_sites();
+
+    for (size_t i = 0; i < Sites_Len; ++i) {
+        if (Sites[i].line == line && strcmp(Sites[i].file, file) == 0) {
+            result = &Sites[i];
+            break;
+        }
+    }
+
+    if (result == 0 && Sites_Len < VD_ARRAY_DEBUG_MAX_SITES) {
+        result = &Sites[Sites_Len++];
+        memset(result, 0, sizeof(*result));
+        result->file = file;
+        result->line = line;
+        result->tsize = tsize;
+    }
+
+    if (result) {
+        result->arrays++;
+    }
+
+    unlock_sites();
+    return result;
+}
+
+void vd_array__debug_note(VD_ArrayHeader *header, int grew)
+{
+    VD_ArraySite *site = header->site;
+    lock_sites();
+
+    if (grew) {
+        site->grows++;
+    }
+
+    if (header->len > site->peak_len) {
+        site->peak_len = header->len;
+    }
+
+    if (header->cap > site->peak_cap) {
+        site->peak_cap = header->cap;
+    }
+
+    unlock_sites();
+}
+
+size_t vd_array_debug_get_sites(VD_ArraySite *sites, size_t cap)
+{
+    lock_sites();
+
+    size_t len = Sites_Len;
+    if (sites) {
+        memcpy(sites, Sites, (len < cap ? len : cap) * sizeof(VD_ArraySite));
+    }
+
+    unlock_sites();
+    return len;
+}
+
+void vd_array_debug_reset_sites(void)
+{
+    // Live arrays still point into the records, so only their counters are cleared
+    lock_sites();
+    for (size_t i = 0; i < Sites_Len; ++i) {
+        Sites[i].arrays = 0;
+        Sites[i].grows = 0;
+        Sites[i].peak_len = 0;
+        Sites[i].peak_cap = 0;
+    }
+    unlock_sites();
+}
@@ -1,42 +1,152 @@
 #ifndef VD_ARRAY_H
 #define VD_ARRAY_H
 #include "vd_common.h"
+#include <assert.h>
 #include <string.h>
 
+/**
+ * When 1, every array remembers the VD_ARRAY_INIT that created it, and the peak length and capacity
+ * of the arrays of every such call site are recorded. Read them with vd_array_debug_get_sites, to
+ * find out what to VD_ARRAY_RESERVE up front.
+ */
+#ifndef VD_ARRAY_DEBUG
+#define VD_ARRAY_DEBUG 0
+#endif
+
+/** The most call sites that VD_ARRAY_DEBUG keeps track of. Arrays from sites past that aren't. */
+#define VD_ARRAY_DEBUG_MAX_SITES 256
+
+typedef struct {
+    const char *file;
+    int         line;
+    size_t      tsize;
+
+    /** The number of arrays created here. */
+    u64         arrays;
+
+    /** The number of times these arrays had to be reallocated. */
+    u64         grows;
+    size_t      peak_len;
+    size_t      peak_cap;
+} VD_ArraySite;
+
 typedef struct {
     size_t        len;
     size_t        cap;
     VD_Allocator *allocator;
+
+    /** Where the array was created. Only set with VD_ARRAY_DEBUG. */
+    VD_ArraySite *site;
 } VD_ArrayHeader;
 
+/** qsort style comparison, used by the sorted array operations. */
+typedef int VD_ArrayCompare(const void *a, const void *b);
+
 #define VD_ARRAY_HEADER(a)          ((VD_ArrayHeader*)((u8*)(a) - sizeof(VD_ArrayHeader)))
+#define VD_ARRAY__DEBUG_NOTE(a)     (VD_ARRAY_HEADER(a)->site ? vd_array__debug_note(VD_ARRAY_HEADER(a), 0) : (void)0)
+#if VD_ARRAY_DEBUG
+#define VD_ARRAY_INIT(a, allocator) \
+    ((a) = vd_array__debug_track(vd_array_grow(a, sizeof(*(a)), 1, 0, allocator), sizeof(*(a)), __FILE__, __LINE__))
+#define VD_ARRAY_CLEAR(a)           (VD_ARRAY__DEBUG_NOTE(a), VD_ARRAY_HEADER(a)->len = 0)
+#else
 #define VD_ARRAY_INIT(a, allocator) ((a) = vd_array_grow(a, sizeof(*(a)), 1, 0, allocator))
-#define VD_ARRAY_DEINIT(a)          (vd_free(VD_ARRAY_ALC(a), (umm)VD_ARRAY_HEADER(a), VD_ARRAY_CAP(a) * sizeof(*a)))
+#define VD_ARRAY_CLEAR(a)           (VD_ARRAY_HEADER(a)->len = 0)
+#endif
+#define VD_ARRAY_DEINIT(a)          \
+    (VD_ARRAY__DEBUG_NOTE(a), \
+    vd_free(VD_ARRAY_ALC(a), (umm)VD_ARRAY_HEADER(a), VD_ARRAY_CAP(a) * sizeof(*a) + sizeof(VD_ArrayHeader)))
 #define VD_ARRAY_ADD(a, v)          (VD_ARRAY_CHECK_GROW(a,1), (a)[VD_ARRAY_HEADER(a)->len++] = (v))
 #define VD_ARRAY_ADDP(a)            (VD_ARRAY_CHECK_GROW(a,1), &((a)[VD_ARRAY_HEADER(a)->len++]))
 #define VD_ARRAY_PUSH(a)            (VD_ARRAY_CHECK_GROW(a,1), VD_ARRAY_HEADER(a)->len++)
 #define VD_ARRAY_ADDN(a, n)         (VD_ARRAY_CHECK_GROW(a,n), VD_ARRAY_HEADER(a)->len += n)
 #define VD_ARRAY_LEN(a)             ((a) ? VD_ARRAY_HEADER(a)->len : 0)
 #define VD_ARRAY_CAP(a)             ((a) ? VD_ARRAY_HEADER(a)->cap : 0)
-#define VD_ARRAY_CLEAR(a)           (VD_ARRAY_HEADER(a)->len = 0)
 #define VD_ARRAY_ALC(a)             ((a) ? VD_ARRAY_HEADER(a)->allocator : 0)
 #define VD_ARRAY_GROW(a, b, c)      ((a) = vd_array_grow((a), sizeof(*(a)), (b), (c), VD_ARRAY_ALC(a)))
 #define VD_ARRAY_POP(a)             (VD_ARRAY_HEADER(a)->len--, (a)[VD_ARRAY_HEADER(a)->len])
 #define VD_ARRAY_LAST(a)            ((a)[VD_ARRAY_HEADER(a)->len - 1])
 #define VD_ARRAY_DEL(a, i)          VD_ARRAY_DELN(a, i, 1)
 #define VD_ARRAY_DELSWAP(a, i)      ((a)[i] = VD_ARRAY_LAST(a), VD_ARRAY_HEADER(a)->len -= 1)
-#define VD_ARRAY_DELN(a, i, n)      \
-    (memmove(&(a)[i], &(a)[i + n], sizeof(*(a)) * (VD_ARRAY_HEADER(a)->len - (n) - (i))), \
-    VD_ARRAY_HEADER(a)->len -= (n))
+#define VD_ARRAY_DELN(a, i, n)      vd_array__deln((a), sizeof(*(a)), (i), (n))
 #define VD_ARRAY_CHECK_GROW(a, n)   \
     ((!(a) || VD_ARRAY_HEADER(a)->len + (n) > VD_ARRAY_HEADER(a)->cap) \
     ? (VD_ARRAY_GROW(a, n, 0), 0) : 0)
 
-VD_INLINE void *vd_array_grow(
-    void *a, 
-    size_t tsize, 
-    size_t addlen, 
-    size_t mincap, 
+/** Make the capacity at least n, exactly, instead of rounding it up like growing does. */
+#define VD_ARRAY_RESERVE(a, n)      ((a) = vd_array_reserve((a), sizeof(*(a)), (n)))
+
+/** Give back the capacity past the length. Arrays at the top of an arena give it back to the arena. */
+#define VD_ARRAY_SHRINK(a)          ((a) = vd_array_shrink((a), sizeof(*(a))))
+
+/** Set the length to n. Elements past the old length are left uninitialized. */
+#define VD_ARRAY_RESIZE_UNINIT(a, n) (VD_ARRAY_GROW(a, 0, n), VD_ARRAY_HEADER(a)->len = (n))
+
+/** Append n elements from p with a single copy. */
+#define VD_ARRAY_APPEND_N(a, p, n)  ((a) = vd_array__insertn((a), sizeof(*(a)), VD_ARRAY_LEN(a), (p), (n)))
+
+/** Insert n elements from p before index i. Without p, the new elements are left uninitialized. */
+#define VD_ARRAY_INSERTN(a, i, p, n) ((a) = vd_array__insertn((a), sizeof(*(a)), (i), (p), (n)))
+#define VD_ARRAY_INSERT(a, i, v)    (VD_ARRAY_INSERTN(a, i, 0, 1), (a)[i] = (v))
+
+/** The index of the first element that is not less than *key, in an array sorted by cmp. */
+#define VD_ARRAY_LOWER_BOUND(a, key, cmp) vd_array__bound((a), sizeof(*(a)), VD_ARRAY_LEN(a), (key), (cmp), 0)
+
+/** The index of the first element that is greater than *key, in an array sorted by cmp. */
+#define VD_ARRAY_UPPER_BOUND(a, key, cmp) vd_array__bound((a), sizeof(*(a)), VD_ARRAY_LEN(a), (key), (cmp), 1)
+
+/**
+ * Insert v into an array sorted by cmp, after the elements equal to it, so that equal elements
+ * keep the order they were inserted in. Evaluates to the index of v.
+ */
+#define VD_ARRAY_INSERT_SORTED(a, v, cmp) \
+    (VD_ARRAY_CHECK_GROW(a, 2), (a)[VD_ARRAY_HEADER(a)->len + 1] = (v), vd_array__insert_sorted((a), sizeof(*(a)), (cmp)))
+
+/** Find or create the record of a call site and count one more array for it, or 0 if there are too many. */
+VD_ArraySite *vd_array__debug_site(const char *file, int line, size_t tsize);
+
+/** Record the length and capacity of an array in the record of its call site, if it has one. */
+void vd_array__debug_note(VD_ArrayHeader *header, int grew);
+
+/**
+ * @brief Copy the records of the call sites that created arrays with VD_ARRAY_DEBUG.
+ * @param sites Where to copy them to. Can be 0 to only count them.
+ * @param cap   The number of records that fit in sites.
+ * @return The number of call sites.
+ */
+size_t vd_array_debug_get_sites(VD_ArraySite *sites, size_t cap);
+
+/** Zero the counters of every call site record, e.g. to measure a single frame. */
+void vd_array_debug_reset_sites(void);
+
+/** Reallocate the array to exactly cap elements. */
+static VD_INLINE void *vd_array__set_cap(void *a, size_t tsize, size_t cap, VD_Allocator *allocator)
+{
+    void *b = (void*)vd_realloc(
+        allocator,
+        (umm)(a ? VD_ARRAY_HEADER(a) : 0),
+        VD_ARRAY_CAP(a) == 0 ? 0 : tsize * VD_ARRAY_CAP(a) + sizeof(VD_ArrayHeader),
+        tsize * cap + sizeof(VD_ArrayHeader));
+
+    b = (char*)b + sizeof(VD_ArrayHeader);
+    if (a == 0) {
+        VD_ARRAY_HEADER(b)->len = 0;
+        VD_ARRAY_HEADER(b)->allocator = allocator;
+        VD_ARRAY_HEADER(b)->site = 0;
+    }
+
+    VD_ARRAY_HEADER(b)->cap = cap;
+    if (VD_ARRAY_HEADER(b)->site) {
+        vd_array__debug_note(VD_ARRAY_HEADER(b), 1);
+    }
+
+    return b;
+}
+
+static VD_INLINE void *vd_array_grow(
+    void *a,
+    size_t tsize,
+    size_t addlen,
+    size_t mincap,
     VD_Allocator* allocator)
 {
     size_t min_len = VD_ARRAY_LEN(a) + addlen;
@@ -55,39 +165,139 @@ VD_INLINE void *vd_array_grow(
         mincap = 4;
     }
 
-    void *b = (void*)vd_realloc(
-        allocator, 
-        (umm)(a ? VD_ARRAY_HEADER(a) : 0),
-        VD_ARRAY_CAP(a) == 0 ? 0 : tsize * VD_ARRAY_CAP(a) + sizeof(VD_ArrayHeader),
-        tsize * mincap + sizeof(VD_ArrayHeader));
-    
-    b = (char*)b + sizeof(VD_ArrayHeader);
-    if (a == 0) {
-        VD_ARRAY_HEADER(b)->len = 0;
-        VD_ARRAY_HEADER(b)->allocator = allocator;
+    return vd_array__set_cap(a, tsize, mincap, allocator);
+}
+
+static VD_INLINE void *vd_array_reserve(void *a, size_t tsize, size_t cap)
+{
+    if (cap <= VD_ARRAY_CAP(a)) {
+        return a;
     }
 
-    VD_ARRAY_HEADER(b)->cap = mincap;
-    return b;
+    return vd_array__set_cap(a, tsize, cap, VD_ARRAY_ALC(a));
+}
+
+static VD_INLINE void *vd_array_shrink(void *a, size_t tsize)
+{
+    // Kept at one element at least, since a capacity of 0 reads as "not allocated"
+    size_t cap = VD_ARRAY_LEN(a) > 0 ? VD_ARRAY_LEN(a) : 1;
+    if (cap >= VD_ARRAY_CAP(a)) {
+        return a;
+    }
+
+    return vd_array__set_cap(a, tsize, cap, VD_ARRAY_ALC(a));
+}
+
+static VD_INLINE void *vd_array__insertn(void *a, size_t tsize, size_t i, const void *p, size_t n)
+{
+    size_t len = VD_ARRAY_LEN(a);
+    assert(i <= len);
+
+    if (len + n > VD_ARRAY_CAP(a)) {
+        a = vd_array_grow(a, tsize, n, 0, VD_ARRAY_ALC(a));
+    }
+
+    u8 *at = (u8*)a + i * tsize;
+    if (i < len) {
+        memmove(at + n * tsize, at, (len - i) * tsize);
+    }
+
+    if (p) {
+        memcpy(at, p, n * tsize);
+    }
+
+    VD_ARRAY_HEADER(a)->len = len + n;
+    return a;
+}
+
+static VD_INLINE void vd_array__deln(void *a, size_t tsize, size_t i, size_t n)
+{
+    size_t len = VD_ARRAY_HEADER(a)->len;
+    assert(i + n <= len);
+
+    // Deleting from the end doesn't move anything
+    if (i + n < len) {
+        u8 *at = (u8*)a + i * tsize;
+        memmove(at, at + n * tsize, (len - n - i) * tsize);
+    }
+
+    VD_ARRAY_HEADER(a)->len = len - n;
+}
+
+static VD_INLINE size_t vd_array__bound(
+    const void *a,
+    size_t tsize,
+    size_t len,
+    const void *key,
+    VD_ArrayCompare *cmp,
+    int upper)
+{
+    size_t lo = 0;
+    while (len > 0) {
+        size_t half = len / 2;
+        int c = cmp((const u8*)a + (lo + half) * tsize, key);
+        if (c < 0 || (upper && c == 0)) {
+            lo += half + 1;
+            len -= half + 1;
+        } else {
+            len = half;
+        }
+    }
+
+    return lo;
+}
+
+/** Move the element that VD_ARRAY_INSERT_SORTED left past the end into its place. */
+static VD_INLINE size_t vd_array__insert_sorted(void *a, size_t tsize, VD_ArrayCompare *cmp)
+{
+    size_t len = VD_ARRAY_HEADER(a)->len;
+    u8 *v = (u8*)a + (len + 1) * tsize;
+    size_t i = vd_array__bound(a, tsize, len, v, cmp, 1);
+
+    u8 *at = (u8*)a + i * tsize;
+    memmove(at + tsize, at, (len - i) * tsize);
+    memcpy(at, v, tsize);
+    VD_ARRAY_HEADER(a)->len = len + 1;
+    return i;
+}
+
+static VD_INLINE void *vd_array__debug_track(void *a, size_t tsize, const char *file, int line)
+{
+    VD_ArraySite *site = vd_array__debug_site(file, line, tsize);
+    VD_ARRAY_HEADER(a)->site = site;
+    if (site) {
+        vd_array__debug_note(VD_ARRAY_HEADER(a), 0);
+    }
+
+    return a;
 }
 
 #define VD_ARRAY
 
 #if VD_ABBREVIATIONS
-#define array_init      VD_ARRAY_INIT
-#define array_deinit    VD_ARRAY_DEINIT
-#define array_add       VD_ARRAY_ADD
-#define array_addp      VD_ARRAY_ADDP
-#define array_addn      VD_ARRAY_ADDN
-#define array_len       VD_ARRAY_LEN
-#define array_cap       VD_ARRAY_CAP
-#define array_pop       VD_ARRAY_POP
-#define array_last      VD_ARRAY_LAST
-#define array_delswap   VD_ARRAY_DELSWAP
-#define array_clear     VD_ARRAY_CLEAR
-#define array_del       VD_ARRAY_DEL
-#define array_deln      VD_ARRAY_DELN
-#define dynarray        VD_ARRAY
+#define array_init          VD_ARRAY_INIT
+#define array_deinit        VD_ARRAY_DEINIT
+#define array_add           VD_ARRAY_ADD
+#define array_addp          VD_ARRAY_ADDP
+#define array_addn          VD_ARRAY_ADDN
+#define array_len           VD_ARRAY_LEN
+#define array_cap           VD_ARRAY_CAP
+#define array_pop           VD_ARRAY_POP
+#define array_last          VD_ARRAY_LAST
+#define array_delswap       VD_ARRAY_DELSWAP
+#define array_clear         VD_ARRAY_CLEAR
+#define array_del           VD_ARRAY_DEL
+#define array_deln          VD_ARRAY_DELN
+#define array_reserve       VD_ARRAY_RESERVE
+#define array_shrink        VD_ARRAY_SHRINK
+#define array_resize_uninit VD_ARRAY_RESIZE_UNINIT
+#define array_append_n      VD_ARRAY_APPEND_N
+#define array_insert        VD_ARRAY_INSERT
+#define array_insertn       VD_ARRAY_INSERTN
+#define array_lower_bound   VD_ARRAY_LOWER_BOUND
+#define array_upper_bound   VD_ARRAY_UPPER_BOUND
+#define array_insert_sorted VD_ARRAY_INSERT_SORTED
+#define dynarray            VD_ARRAY
 #endif
 
 #endif
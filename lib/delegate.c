@@ -0,0 +1,305 @@
+#define VD_INTERNAL_SOURCE_FILE 1
+#include "delegate.h"
+
+#include <string.h>
+
+/* ----EPOCHS------------------------------------------------------------------------------------ */
+
+/** Advanced every time a snapshot is retired. Starts at 1 since 0 marks offline threads. */
+static volatile i64 Epoch = 1;
+
+/** The epoch every online thread saw when it was last quiescent, or 0 for free slots. */
+static volatile i64 Thread_Epochs[VD_HOOK_MAX_THREADS];
+
+static _Thread_local int Thread_Slot = -1;
+
+/** Retired snapshots of every hook, newest first. */
+static VD_HookSnapshot *volatile Retired;
+
+static i64 current_epoch(void)
+{
+    return vd_atomic_fetch_and_add64(&Epoch, 0);
+}
+
+void vd_hook_thread_online(void)
+{
+    if (Thread_Slot >= 0) {
+        return;
+    }
+
+    for (;;) {
+        for (int i = 0; i < VD_HOOK_MAX_THREADS; ++i) {
+            if (Thread_Epochs[i] == 0 &&
+                vd_atomic_compare_and_swap64(&Thread_Epochs[i], current_epoch(), 0) == 0)
+            {
+                Thread_Slot = i;
+                return;
+            }
+        }
+    }
+}
+
+void vd_hook_thread_offline(void)
+{
+    if (Thread_Slot < 0) {
+        return;
+    }
+
+    vd_atomic_fence();
+    Thread_Epochs[Thread_Slot] = 0;
+    Thread_Slot = -1;
+}
+
+static void push_retired(VD_HookSnapshot *first, VD_HookSnapshot *last)
+{
+    for (;;) {
+        VD_HookSnapshot *head = Retired;
+        last->retired_next = head;
+        if (vd_atomic_compare_and_swap_ptr((void *volatile*)&Retired, first, head) == head) {
+            return;
+        }
+    }
+}
+
+static void free_snapshot(VD_HookSnapshot *snapshot)
+{
+    vd_free(
+        snapshot->allocator,
+        (umm)snapshot,
+        sizeof(VD_HookSnapshot) + snapshot->len * sizeof(VD_HookEntry));
+}
+
+void vd_hook_quiescent(void)
+{
+    if (Thread_Slot >= 0) {
+        vd_atomic_fence();
+        Thread_Epochs[Thread_Slot] = current_epoch();
+    }
+
+    // Take the whole list, so that nobody else frees the same snapshots
+    VD_HookSnapshot *list;
+    do {
+        list = Retired;
+        if (list == 0) {
+            return;
+        }
+    } while (vd_atomic_compare_and_swap_ptr((void *volatile*)&Retired, 0, list) != list);
+
+    i64 min = INT64_MAX;
+    for (int i = 0; i < VD_HOOK_MAX_THREADS; ++i) {
+        i64 e = Thread_Epochs[i];
+        if (e != 0 && e < min) {
+            min = e;
+        }
+    }
+
+    VD_HookSnapshot *keep_first = 0;
+    VD_HookSnapshot *keep_last = 0;
+    while (list) {
+        VD_HookSnapshot *next = list->retired_next;
+        if ((i64)list->retired_epoch <= min) {
+            free_snapshot(list);
+        } else {
+            list->retired_next = keep_first;
+            keep_first = list;
+            if (keep_last == 0) {
+                keep_last = list;
+            }
+        }
+
+        list = next;
+    }
+
+    if (keep_first) {
+        push_retired(keep_first, keep_last);
+    }
+}
+
+/* ----SNAPSHOTS--------------------------------------------------------------------------------- */
+
+static VD_HookEntry *new_snapshot(VD_Allocator *allocator, size_t len)
+{
+    VD_HookSnapshot *snapshot = (VD_HookSnapshot*)vd_malloc(
+        allocator,
+        sizeof(VD_HookSnapshot) + len * sizeof(VD_HookEntry));
+
+    snapshot->len = len;
+    snapshot->allocator = allocator;
+    snapshot->retired_next = 0;
+    snapshot->retired_epoch = 0;
+    return (VD_HookEntry*)(snapshot + 1);
+}
+
+/** Swap list for next. On success, list is retired, and on failure next is freed. */
+static int publish(VD_HookBase *hook, VD_HookEntry *list, VD_HookEntry *next)
+{
+    if (vd_atomic_compare_and_swap_ptr((void *volatile*)&hook->list, next, list) != list) {
+        if (next) {
+            free_snapshot((VD_HookSnapshot*)next - 1);
+        }
+
+        return 0;
+    }
+
+    if (list) {
+        // Threads that are quiescent at this epoch or later can't have seen list anymore
+        VD_HookSnapshot *old = (VD_HookSnapshot*)list - 1;
+        old->retired_epoch = (u64)(vd_atomic_fetch_and_add64(&Epoch, 1) + 1);
+        push_retired(old, old);
+    }
+
+    return 1;
+}
+
+void vd_hook__subscribe(VD_HookBase *hook, void (*func)(void), void *usrdata)
+{
+    for (;;) {
+        VD_HookEntry *list = hook->list;
+        size_t len = VD_HOOK__LEN(list);
+
+        VD_HookEntry *next = new_snapshot(hook->allocator, len + 1);
+        if (len > 0) {
+            memcpy(next, list, len * sizeof(VD_HookEntry));
+        }
+
+        next[len].func = func;
+        next[len].usrdata = usrdata;
+
+        if (publish(hook, list, next)) {
+            return;
+        }
+    }
+}
+
+void vd_hook__unsubscribe(VD_HookBase *hook, void (*func)(void))
+{
+    for (;;) {
+        VD_HookEntry *list = hook->list;
+        size_t len = VD_HOOK__LEN(list);
+
+        size_t found = len;
+        for (size_t i = 0; i < len; ++i) {
+            if (list[i].func == func) {
+                found = i;
+                break;
+            }
+        }
+
+        if (found == len) {
+            return;
+        }
+
+        VD_HookEntry *next = 0;
+        if (len > 1) {
+            next = new_snapshot(hook->allocator, len - 1);
+            memcpy(next, list, found * sizeof(VD_HookEntry));
+            memcpy(next + found, list + found + 1, (len - found - 1) * sizeof(VD_HookEntry));
+        }
+
+        if (publish(hook, list, next)) {
+            return;
+        }
+    }
+}
+
+void vd_hook__deinit(VD_HookBase *hook)
+{
+    if (hook->list) {
+        free_snapshot((VD_HookSnapshot*)hook->list - 1);
+        hook->list = 0;
+    }
+}
+
+/* ----DEFERRED---------------------------------------------------------------------------------- */
+
+struct VD_HookEvent {
+    VD_HookEvent    *next;
+    VD_HookBase     *hook;
+    VD_HookCallArgs *call;
+    size_t          size;
+};
+
+/** Arguments follow the event, aligned like anything a delegate could take. */
+#define EVENT_HEADER_SIZE ((sizeof(VD_HookEvent) + 15) & ~(size_t)15)
+
+void vd_hook_queue_init(VD_HookQueue *queue, VD_Allocator *allocator)
+{
+    queue->head = 0;
+    queue->allocator = allocator;
+}
+
+static void free_event(VD_HookQueue *queue, VD_HookEvent *event)
+{
+    vd_free(queue->allocator, (umm)event, EVENT_HEADER_SIZE + event->size);
+}
+
+void vd_hook__defer(VD_HookQueue *queue, VD_HookBase *hook, VD_HookCallArgs *call, const void *args, size_t size)
+{
+    VD_HookEvent *event = (VD_HookEvent*)vd_malloc(queue->allocator, EVENT_HEADER_SIZE + size);
+    event->hook = hook;
+    event->call = call;
+    event->size = size;
+    memcpy((u8*)event + EVENT_HEADER_SIZE, args, size);
+
+    for (;;) {
+        VD_HookEvent *head = queue->head;
+        event->next = head;
+        if (vd_atomic_compare_and_swap_ptr((void *volatile*)&queue->head, event, head) == head) {
+            return;
+        }
+    }
+}
+
+/** Take every event, oldest first. */
+static VD_HookEvent *take_events(VD_HookQueue *queue)
+{
+    VD_HookEvent *list;
+    do {
+        list = queue->head;
+        if (list == 0) {
+            return 0;
+        }
+    } while (vd_atomic_compare_and_swap_ptr((void *volatile*)&queue->head, 0, list) != list);
+
+    // Events are pushed newest first
+    VD_HookEvent *reversed = 0;
+    while (list) {
+        VD_HookEvent *next = list->next;
+        list->next = reversed;
+        reversed = list;
+        list = next;
+    }
+
+    return reversed;
+}
+
+size_t vd_hook_queue_flush(VD_HookQueue *queue)
+{
+    size_t count = 0;
+    VD_HookEvent *event = take_events(queue);
+    while (event) {
+        VD_HookEvent *next = event->next;
+        const void *args = (u8*)event + EVENT_HEADER_SIZE;
+
+        VD_HookEntry *list = *(VD_HookEntry *volatile*)&event->hook->list;
+        for (size_t i = 0, n = VD_HOOK__LEN(list); i < n; ++i) {
+            event->call(list[i].func, list[i].usrdata, args);
+        }
+
+        free_event(queue, event);
+        event = next;
+        count++;
+    }
+
+    return count;
+}
+
+void vd_hook_queue_deinit(VD_HookQueue *queue)
+{
+    VD_HookEvent *event = take_events(queue);
+    while (event) {
+        VD_HookEvent *next = event->next;
+        free_event(queue, event);
+        event = next;
+    }
+}
@@ -2,53 +2,101 @@
 #define VD_DELEGATE_H
 #include "vd_common.h"
 #include "array.h"
+#include "vd_atomic.h"
+
+/*
+ * Hooks can be subscribed to, unsubscribed from and invoked from any number of threads at the same
+ * time. The subscribers live in an immutable snapshot: invoking loads the snapshot pointer once and
+ * loops over it, and changing the subscribers builds a new snapshot and swaps it in with a CAS.
+ *
+ * Replaced snapshots are retired, and freed once every thread that could still be looping over them
+ * has passed through vd_hook_quiescent. Threads that touch hooks while other threads change them
+ * call vd_hook_thread_online first, and vd_hook_quiescent regularly, at points where they aren't
+ * inside an invocation (e.g. at the end of every frame). A thread that isn't online can still call
+ * vd_hook_quiescent, to free snapshots that every online thread is done with.
+ */
+
+/** The most threads that can be online at the same time. */
+#define VD_HOOK_MAX_THREADS 64
+
+/** A subscriber of any hook. Entries of every hook have this layout. */
+typedef struct {
+    void (*func)(void);
+    void *usrdata;
+} VD_HookEntry;
+
+typedef struct VD_HookSnapshot VD_HookSnapshot;
+
+/** Header in front of the entries of every snapshot. */
+struct VD_HookSnapshot {
+    size_t           len;
+    VD_Allocator    *allocator;
+    VD_HookSnapshot *retired_next;
+    u64              retired_epoch;
+};
+
+/** The part of every hook that the implementation works on. */
+typedef struct {
+    VD_HookEntry *volatile list;
+    VD_Allocator          *allocator;
+} VD_HookBase;
+
+typedef struct VD_HookEvent VD_HookEvent;
+
+/** Invocations deferred to a later vd_hook_queue_flush. Any thread can add to it. */
+typedef struct {
+    VD_HookEvent *volatile head;
+    VD_Allocator          *allocator;
+} VD_HookQueue;
+
+/** Calls func with the arguments of a deferred invocation. Generated for every void delegate. */
+typedef void VD_HookCallArgs(void (*func)(void), void *usrdata, const void *args);
+
+#define VD_HOOK__LEN(list) ((list) ? ((VD_HookSnapshot*)(list) - 1)->len : 0)
+#define VD_HOOK__LOAD(hook) (*(__typeof__((hook).list) volatile*)&(hook).list)
 
 #define VD_HOOK(name) name##Hook
-#define VD_HOOK_INIT(hook, allocator) VD_ARRAY_INIT(hook.list, allocator)
-#define VD_HOOK_DEINIT(hook) VD_ARRAY_DEINIT(hook.list)
-
-#define VD_HOOK_SUBSCRIBE(hook, fptr, usrdatavalue)      \
-    {                                                    \
-        unsigned int _lastidx = VD_ARRAY_LEN(hook.list); \
-        VD_ARRAY_PUSH(hook.list);                        \
-        hook.list[_lastidx].func = fptr;                 \
-        hook.list[_lastidx].usrdata = usrdatavalue;      \
-    }                                                    \
-
-#define VD_HOOK_UNSUBSCRIBE(hook, fptr)                     \
-    {                                                       \
-        int _f = -1;                                        \
-        for (int i = 0; i < VD_ARRAY_LEN(hook.list); ++i) { \
-            if (hook.list[i].func == fptr) {                \
-                _f = i;                                     \
-                break;                                      \
-            }                                               \
-        }                                                   \
-        if (_f) {                                           \
-            VD_ARRAY_DELSWAP(hook.list, _f);                \
-        }                                                   \
-    }                                                       \
+#define VD_HOOK_INIT(hook, alc) ((hook).base.list = 0, (hook).base.allocator = (alc))
+#define VD_HOOK_DEINIT(hook) vd_hook__deinit(&(hook).base)
+#define VD_HOOK_LEN(hook) VD_HOOK__LEN(VD_HOOK__LOAD(hook))
+
+#define VD_HOOK_SUBSCRIBE(hook, fptr, usrdatavalue) \
+    vd_hook__subscribe(&(hook).base, (void(*)(void))(fptr), (usrdatavalue))
+
+/** Remove the first subscriber with fptr, keeping the order of the rest. */
+#define VD_HOOK_UNSUBSCRIBE(hook, fptr) \
+    vd_hook__unsubscribe(&(hook).base, (void(*)(void))(fptr))
 
 #define VD_HOOK_INVOKE(hook, ...)                                   \
     {                                                               \
-        for (int _i = 0; _i < VD_ARRAY_LEN(hook.list); ++_i) {      \
-            hook.list[_i].func(__VA_ARGS__, hook.list[_i].usrdata); \
+        __typeof__((hook).list) _l = VD_HOOK__LOAD(hook);           \
+        for (size_t _i = 0, _n = VD_HOOK__LEN(_l); _i < _n; ++_i) { \
+            _l[_i].func(__VA_ARGS__, _l[_i].usrdata);               \
         }                                                           \
     }                                                               \
 
-#define VD_HOOK_INVOKE_RET(hook, ret, ...)                                 \
-    {                                                                      \
-        for (int _i = 0; _i < VD_ARRAY_LEN(hook.list); ++_i) {             \
-            ret = hook.list[_i].func(__VA_ARGS__, hook.list[_i].usrdata);  \
-        }                                                                  \
-    }                                                                      \
+#define VD_HOOK_INVOKE_RET(hook, ret, ...)                          \
+    {                                                               \
+        __typeof__((hook).list) _l = VD_HOOK__LOAD(hook);           \
+        for (size_t _i = 0, _n = VD_HOOK__LEN(_l); _i < _n; ++_i) { \
+            ret = _l[_i].func(__VA_ARGS__, _l[_i].usrdata);         \
+        }                                                           \
+    }                                                               \
+
+#define VD_HOOK_INVOKE_RET_CALLBACK(hook, retcallback, retcallbackusrdata, ...)       \
+    {                                                                                 \
+        __typeof__((hook).list) _l = VD_HOOK__LOAD(hook);                             \
+        for (size_t _i = 0, _n = VD_HOOK__LEN(_l); _i < _n; ++_i) {                   \
+            retcallback(_l[_i].func(__VA_ARGS__, _l[_i].usrdata), retcallbackusrdata); \
+        }                                                                             \
+    }                                                                                 \
 
-#define VD_HOOK_INVOKE_RET_CALLBACK(hook, retcallback, retcallbackusrdata, ...)                       \
-    {                                                                                                 \
-        for (int _i = 0; _i < VD_ARRAY_LEN(hook.list); ++_i) {                                        \
-            retcallback(hook.list[_i].func(__VA_ARGS__, hook.list[_i].usrdata), retcallbackusrdata);  \
-        }                                                                                             \
-    }                                                                                                 \
+/**
+ * Invoke hook with the arguments when queue is flushed, with the subscribers it has then. The
+ * arguments are copied, but what they point to must stay alive until the flush. Only for delegates
+ * that return void.
+ */
+#define VD_HOOK_DEFER(name, queue, hook, ...) name##__defer((queue), &(hook), __VA_ARGS__)
 
 #define VD_CALLBACK(name) name##Callback
 
@@ -73,19 +121,82 @@
         name *func;                                     \
         void *usrdata;                                  \
     } name##Entry;										\
-    typedef struct {                                    \
-        name##Entry *list;								\
+    typedef union {                                     \
+        name##Entry *list;                              \
+        VD_HookBase base;                               \
     } VD_HOOK(name);                                    \
     typedef struct {                                    \
         name##Entry entry;								\
     } VD_CALLBACK(name);                                \
 
+/* Parameters start with underscores, so that they can't clash with the delegate's own. */
+#define VD_DELEGATE__DECLARE_DEFER_1(name, param1_type, param1_name)                          \
+    typedef struct { param1_type param1_name; } name##__Args;                                \
+    static VD_INLINE void name##__call(void (*_func)(void), void *_usrdata, const void *_argp) \
+    {                                                                                         \
+        const name##__Args *_args = (const name##__Args*)_argp;                               \
+        ((name*)_func)(_args->param1_name, _usrdata);                                         \
+    }                                                                                         \
+    static VD_INLINE void name##__defer(                                                      \
+        VD_HookQueue *_queue, VD_HOOK(name) *_hook, param1_type param1_name)                  \
+    {                                                                                         \
+        name##__Args _args = { param1_name };                                                 \
+        vd_hook__defer(_queue, &_hook->base, name##__call, &_args, sizeof(_args));            \
+    }
+
+#define VD_DELEGATE__DECLARE_DEFER_2(name, param1_type, param1_name, param2_type, param2_name)  \
+    typedef struct { param1_type param1_name; param2_type param2_name; } name##__Args;         \
+    static VD_INLINE void name##__call(void (*_func)(void), void *_usrdata, const void *_argp)   \
+    {                                                                                           \
+        const name##__Args *_args = (const name##__Args*)_argp;                                 \
+        ((name*)_func)(_args->param1_name, _args->param2_name, _usrdata);                       \
+    }                                                                                           \
+    static VD_INLINE void name##__defer(                                                        \
+        VD_HookQueue *_queue, VD_HOOK(name) *_hook, param1_type param1_name, param2_type param2_name) \
+    {                                                                                           \
+        name##__Args _args = { param1_name, param2_name };                                      \
+        vd_hook__defer(_queue, &_hook->base, name##__call, &_args, sizeof(_args));              \
+    }
 
 #define VD_DELEGATE_DECLARE_PARAMS1_VOID(name, param1_type, param1_name) \
-    VD_DELEGATE_DECLARE_1(name, void, param1_type param1_name);
+    VD_DELEGATE_DECLARE_1(name, void, param1_type param1_name); \
+    VD_DELEGATE__DECLARE_DEFER_1(name, param1_type, param1_name)
 #define VD_DELEGATE_DECLARE_PARAMS2_VOID(name, param1_type, param1_name, param2_type, param2_name) \
-    VD_DELEGATE_DECLARE_1(name, void, param1_type param1_name, param2_type param2_name);
+    VD_DELEGATE_DECLARE_1(name, void, param1_type param1_name, param2_type param2_name); \
+    VD_DELEGATE__DECLARE_DEFER_2(name, param1_type, param1_name, param2_type, param2_name)
 #define VD_DELEGATE_DECLARE_PARAMS1_RET(name, rettype, param1_type, param1_name) \
     VD_DELEGATE_DECLARE_1(name, rettype, param1_type param1_name);
 
+void vd_hook__subscribe(VD_HookBase *hook, void (*func)(void), void *usrdata);
+void vd_hook__unsubscribe(VD_HookBase *hook, void (*func)(void));
+
+/** Free the current snapshot. Nothing else may use the hook anymore. */
+void vd_hook__deinit(VD_HookBase *hook);
+
+/** Make the calling thread one that vd_hook_quiescent waits for before freeing snapshots. */
+void vd_hook_thread_online(void);
+
+/** Stop waiting for the calling thread. It must not be inside an invocation. */
+void vd_hook_thread_offline(void);
+
+/**
+ * @brief Declare that the calling thread isn't inside any invocation, and free the retired
+ * snapshots that no online thread can be looping over anymore.
+ */
+void vd_hook_quiescent(void);
+
+void vd_hook_queue_init(VD_HookQueue *queue, VD_Allocator *allocator);
+
+/** Drop the invocations that were never flushed. */
+void vd_hook_queue_deinit(VD_HookQueue *queue);
+
+void vd_hook__defer(VD_HookQueue *queue, VD_HookBase *hook, VD_HookCallArgs *call, const void *args, size_t size);
+
+/**
+ * @brief Run the deferred invocations in the order they were added. Invocations that are added
+ * while flushing wait for the next flush.
+ * @return The number of invocations that ran.
+ */
+size_t vd_hook_queue_flush(VD_HookQueue *queue);
+
 #endif // !VD_DELEGATE_H
@@ -1,40 +1,73 @@
 #include "handlemap.h"
-
-#include "hash.h"
-#include "intmap.h"
+#include "vd_atomic.h"
 
 #include <assert.h>
 #include <string.h>
 
+/** Marks the end of the free slot list. */
+#define NO_SLOT VD_U32_MAX
+
+/**
+ * Slots live in pages that are never moved, so object pointers stay valid while the map grows.
+ * Page 0 holds (1 << page_shift) slots, and every page after that holds twice as many as the one
+ * before it, so 32 pages are enough to address every u32 slot.
+ */
+#define MAX_PAGES 32
+
 typedef struct VD_HandleMap {
-    umm             arr;
-    size_t          arr_len;
-    size_t          arr_cap;
-    VD_IntMap       idmap;
-    size_t          elsize;
-    u64             next_id;
-    VD_Allocator    allocator;
-    void            (*on_free_object)(void *object, void *c);
-    void            *c;
+    volatile umm        pages[MAX_PAGES];
+    u32                 page_shift;
+    volatile u32        arr_len;
+
+    /** The head slot of the free list in the low 32 bits, and an ABA tag in the high 32 bits. */
+    volatile i64        free_head;
+    size_t              slot_size;
+    size_t              elsize;
+    VD_HandleMapFlags   flags;
+    VD_Allocator        allocator;
+    void                (*on_free_object)(void *object, void *c);
+    void                *c;
 } VD_HandleMap;
 
 typedef struct {
-    int refcount;
-    int refmode;
-    u64 id;
+    /** Incremented every time the slot is freed, so that stale handles stop resolving. */
+    volatile u32    generation;
+    volatile i32    refcount;
+
+    /** The next free slot, while this slot is in the free list. */
+    u32             next_free;
+    u16             refmode;
+    u16             alive;
 } EntryMetadata;
 
-static void *get_slot_value_ptr(VD_HandleMap *map, u64 slot)
+static void free_object_null(void *object, void *c) {}
+
+static VD_INLINE u32 get_slot_page(VD_HandleMap *map, u32 slot)
 {
-    return (void*)(map->arr + (sizeof(EntryMetadata) + map->elsize) * slot + sizeof(EntryMetadata));
+    return 63 - vd_clz64(((u64)slot >> map->page_shift) + 1);
 }
 
-static EntryMetadata *get_slot_metadata_ptr(VD_HandleMap *map, u64 slot)
+static size_t get_page_slot_count(VD_HandleMap *map, u32 page)
 {
-    return (EntryMetadata*)(map->arr + (sizeof(EntryMetadata) + map->elsize) * slot);
+    return (size_t)1 << (map->page_shift + page);
 }
 
-static void free_object_null(void *object, void *c) {}
+static VD_INLINE umm get_slot_ptr(VD_HandleMap *map, umm page_ptr, u32 page, u32 slot)
+{
+    u64 first_slot_in_page = ((u64)1 << (map->page_shift + page)) - ((u64)1 << map->page_shift);
+    return page_ptr + ((u64)slot - first_slot_in_page) * map->slot_size;
+}
+
+static EntryMetadata *get_slot_metadata_ptr(VD_HandleMap *map, u32 slot)
+{
+    u32 page = get_slot_page(map, slot);
+    return (EntryMetadata*)get_slot_ptr(map, map->pages[page], page, slot);
+}
+
+static void *get_slot_value_ptr(VD_HandleMap *map, u32 slot)
+{
+    return (void*)((umm)get_slot_metadata_ptr(map, slot) + sizeof(EntryMetadata));
+}
 
 void *vd_handlemap__init(size_t elsize, VD_HandleMapInitInfo *info)
 {
@@ -43,84 +76,197 @@ void *vd_handlemap__init(size_t elsize, VD_HandleMapInitInfo *info)
         0,
         sizeof(VD_HandleMap),
         info->allocator->c);
+    memset(hdr, 0, sizeof(VD_HandleMap));
 
     hdr->on_free_object = info->on_free_object;
     if (hdr->on_free_object == 0) {
         hdr->on_free_object = free_object_null;
     }
 
+    hdr->page_shift = 4;
+    while (((size_t)1 << hdr->page_shift) < info->initial_capacity) {
+        hdr->page_shift++;
+    }
+
     hdr->elsize     = elsize;
+    hdr->slot_size  = sizeof(EntryMetadata) + ((elsize + 7) & ~(size_t)7);
     hdr->allocator  = *info->allocator;
-    hdr->arr_cap    = info->initial_capacity;
     hdr->arr_len    = 0;
-    hdr->next_id    = 1;
+    hdr->free_head  = (i64)NO_SLOT;
+    hdr->flags      = info->flags;
     hdr->c          = info->c;
 
-    vd_intmap_init(&hdr->idmap, &hdr->allocator, info->initial_capacity, 0);
+    return (void*)hdr;
+}
 
-    size_t array_element_size = sizeof(EntryMetadata) + hdr->elsize;
+/**
+ * @brief Make sure the page that holds a slot exists. When two threads race to create the same
+ * page, the loser frees its page and uses the winner's.
+ */
+static void ensure_page(VD_HandleMap *hdr, u32 page)
+{
+    if (hdr->pages[page] != 0) {
+        return;
+    }
 
-    hdr->arr = hdr->allocator.proc_alloc(0, 0, array_element_size * hdr->arr_cap, hdr->allocator.c);
-    memset((void*)hdr->arr, 0, array_element_size * hdr->arr_cap);
+    size_t byte_size = get_page_slot_count(hdr, page) * hdr->slot_size;
+    umm new_page = hdr->allocator.proc_alloc(0, 0, byte_size, hdr->allocator.c);
+    memset((void*)new_page, 0, byte_size);
 
-    return (void*)hdr;
+    if (!(hdr->flags & VD_HANDLEMAP_FLAG_CONCURRENT)) {
+        hdr->pages[page] = new_page;
+        return;
+    }
+
+    void *prev = vd_atomic_compare_and_swap_ptr(
+        (void *volatile*)&hdr->pages[page],
+        (void*)new_page,
+        0);
+
+    if (prev != 0) {
+        hdr->allocator.proc_alloc(new_page, byte_size, 0, hdr->allocator.c);
+    }
 }
 
-static u64 allocate_slot(VD_HandleMap *hdr)
+static u32 pop_free_slot(VD_HandleMap *hdr)
 {
-    size_t array_element_size = sizeof(EntryMetadata) + hdr->elsize;
-    if (hdr->arr_len == hdr->arr_cap) {
-        hdr->arr = hdr->allocator.proc_alloc(
-            hdr->arr,
-            array_element_size * hdr->arr_cap,
-            array_element_size * hdr->arr_cap * 2,
-            hdr->allocator.c);
-        hdr->arr_cap *= 2;
+    if (!(hdr->flags & VD_HANDLEMAP_FLAG_CONCURRENT)) {
+        u32 slot = (u32)hdr->free_head;
+        if (slot != NO_SLOT) {
+            hdr->free_head = (i64)get_slot_metadata_ptr(hdr, slot)->next_free;
+        }
+        return slot;
     }
 
-    return hdr->arr_len++;
+    for (;;) {
+        u64 head = (u64)hdr->free_head;
+        u32 slot = (u32)head;
+        if (slot == NO_SLOT) {
+            return NO_SLOT;
+        }
+
+        // next_free may be stale if another thread popped this slot in the meantime, but then the
+        // tag will have changed and the swap fails.
+        u32 next = get_slot_metadata_ptr(hdr, slot)->next_free;
+        u64 new_head = (((head >> 32) + 1) << 32) | next;
+
+        if (vd_atomic_compare_and_swap64(&hdr->free_head, (i64)new_head, (i64)head) == (i64)head) {
+            return slot;
+        }
+    }
 }
 
-VD_Handle vd_handlemap__register(VD_HandleMap *hdr, void *valueptr, VD_HandleMapRegisterInfo *info)
+static void push_free_slot(VD_HandleMap *hdr, u32 slot)
+{
+    EntryMetadata *metadata_ptr = get_slot_metadata_ptr(hdr, slot);
+
+    if (!(hdr->flags & VD_HANDLEMAP_FLAG_CONCURRENT)) {
+        metadata_ptr->next_free = (u32)hdr->free_head;
+        hdr->free_head = (i64)slot;
+        return;
+    }
+
+    for (;;) {
+        u64 head = (u64)hdr->free_head;
+        metadata_ptr->next_free = (u32)head;
+        u64 new_head = (((head >> 32) + 1) << 32) | slot;
+
+        if (vd_atomic_compare_and_swap64(&hdr->free_head, (i64)new_head, (i64)head) == (i64)head) {
+            return;
+        }
+    }
+}
+
+static u32 allocate_slot(VD_HandleMap *hdr)
 {
-    u64 id = hdr->next_id++;
+    u32 slot = pop_free_slot(hdr);
+    if (slot != NO_SLOT) {
+        return slot;
+    }
 
-    u64 slot = allocate_slot(hdr);
+    if (hdr->flags & VD_HANDLEMAP_FLAG_CONCURRENT) {
+        slot = vd_atomic_inc_and_fetchu32(&hdr->arr_len) - 1;
+    } else {
+        slot = hdr->arr_len++;
+    }
 
-    vd_intmap_set(&hdr->idmap, id, slot);
+    assert(slot < NO_SLOT);
+    ensure_page(hdr, get_slot_page(hdr, slot));
+    return slot;
+}
 
+static void free_slot(VD_HandleMap *hdr, u32 slot)
+{
     EntryMetadata *metadata_ptr = get_slot_metadata_ptr(hdr, slot);
-    void *slot_value_ptr = get_slot_value_ptr(hdr, slot);
 
-    metadata_ptr->id = id;
-    metadata_ptr->refcount = 1;
-    metadata_ptr->refmode = info->ref_mode;
+    metadata_ptr->alive = 0;
+    u32 generation = metadata_ptr->generation + 1;
+    metadata_ptr->generation = generation == 0 ? 1 : generation;
+
+    push_free_slot(hdr, slot);
+}
+
+/**
+ * @brief Find the metadata of the slot a handle refers to. Never blocks or retries.
+ * @return The metadata, or 0 if the handle is stale or invalid.
+ */
+static VD_INLINE EntryMetadata *resolve_handle(VD_HandleMap *map, VD_Handle *handle)
+{
+    u32 slot = VD_HANDLE_SLOT(*handle);
+    u32 page = get_slot_page(map, slot);
+
+    umm page_ptr = map->pages[page];
+    if (page_ptr == 0) {
+        return 0;
+    }
+
+    EntryMetadata *metadata_ptr = (EntryMetadata*)get_slot_ptr(map, page_ptr, page, slot);
+    if (metadata_ptr->generation != VD_HANDLE_GENERATION(*handle)) {
+        return 0;
+    }
+
+    return metadata_ptr;
+}
+
+VD_Handle vd_handlemap__register(VD_HandleMap *hdr, void *valueptr, VD_HandleMapRegisterInfo *info)
+{
+    u32 slot = allocate_slot(hdr);
+
+    EntryMetadata *metadata_ptr = get_slot_metadata_ptr(hdr, slot);
+    void *slot_value_ptr = (void*)((umm)metadata_ptr + sizeof(EntryMetadata));
 
     memcpy((char*)slot_value_ptr, valueptr, hdr->elsize);
 
+    metadata_ptr->refcount = 1;
+    metadata_ptr->refmode = (u16)info->ref_mode;
+    metadata_ptr->next_free = NO_SLOT;
+    metadata_ptr->alive = 1;
+
+    if (metadata_ptr->generation == 0) {
+        metadata_ptr->generation = 1;
+    }
+
     return (VD_Handle) {
-        .id = id,
+        .id = VD_HANDLE_ID(slot, metadata_ptr->generation),
         .map = (void*)hdr,
     };
 }
 
 void *vd_handle_use(VD_Handle *handle, VD_HandleMapUseMode mode)
 {
-    VD_HandleMap *map = handle->map;
-
-    u64 slot;
-    if (!vd_intmap_tryget(&map->idmap, handle->id, &slot)) {
+    EntryMetadata *metadata_ptr = resolve_handle(handle->map, handle);
+    if (!metadata_ptr) {
         return 0;
     }
 
-    return get_slot_value_ptr(map, slot);
+    return (void*)((umm)metadata_ptr + sizeof(EntryMetadata));
 }
 
 VD_Handle vd_handlemap_copy(VD_Handle *handle)
 {
     VD_HandleMap *map = handle->map;
-    u64 slot;
-    if (!vd_intmap_tryget(&map->idmap, handle->id, &slot)) {
+    EntryMetadata *metadata_ptr = resolve_handle(map, handle);
+    if (!metadata_ptr) {
         VD_Handle null = (VD_Handle) {
             .id = 0,
             .map = 0,
@@ -128,9 +274,12 @@ VD_Handle vd_handlemap_copy(VD_Handle *handle)
         return null;
     }
 
-    EntryMetadata *metadata_ptr = get_slot_metadata_ptr(map, slot);
     if (metadata_ptr->refmode == VD_HANDLEMAP_REF_MODE_COUNT) {
-        metadata_ptr->refcount++;
+        if (map->flags & VD_HANDLEMAP_FLAG_CONCURRENT) {
+            vd_atomic_inc_and_fetch32(&metadata_ptr->refcount);
+        } else {
+            metadata_ptr->refcount++;
+        }
     }
 
     return *handle;
@@ -139,20 +288,24 @@ VD_Handle vd_handlemap_copy(VD_Handle *handle)
 void vd_handle_drop(VD_Handle *handle)
 {
     VD_HandleMap *map = handle->map;
-    u64 slot;
-    if (!vd_intmap_tryget(&map->idmap, handle->id, &slot)) {
+    EntryMetadata *metadata_ptr = resolve_handle(map, handle);
+    if (!metadata_ptr) {
         return;
     }
 
-    EntryMetadata *metadata_ptr = get_slot_metadata_ptr(map, slot);
     if (metadata_ptr->refmode == VD_HANDLEMAP_REF_MODE_COUNT) {
-        metadata_ptr->refcount--;
+        i32 refcount;
+        if (map->flags & VD_HANDLEMAP_FLAG_CONCURRENT) {
+            refcount = vd_atomic_add_and_fetch32(&metadata_ptr->refcount, -1);
+        } else {
+            refcount = --metadata_ptr->refcount;
+        }
 
-        assert(!(metadata_ptr->refcount < 0));
-        if (metadata_ptr->refcount == 0) {
-            void *value_ptr = get_slot_value_ptr(map, slot);
-            map->on_free_object(value_ptr, map->c);
-            metadata_ptr->id = 0;
+        assert(!(refcount < 0));
+        if (refcount == 0) {
+            u32 slot = VD_HANDLE_SLOT(*handle);
+            map->on_free_object((void*)((umm)metadata_ptr + sizeof(EntryMetadata)), map->c);
+            free_slot(map, slot);
         }
     }
     handle->id = 0;
@@ -160,15 +313,28 @@ void vd_handle_drop(VD_Handle *handle)
 
 void vd_handlemap__deinit(VD_HandleMap *map)
 {
-    vd_intmap_deinit(&map->idmap);
-
-    for (u64 i = 0; i < map->arr_len; ++i) {
+    for (u32 i = 0; i < map->arr_len; ++i) {
         EntryMetadata *metadata = get_slot_metadata_ptr(map, i);
 
-        if (metadata->id == 0) {
+        if (!metadata->alive) {
             continue;
         }
 
         map->on_free_object(get_slot_value_ptr(map, i), map->c);
     }
+
+    VD_Allocator allocator = map->allocator;
+    for (u32 page = 0; page < MAX_PAGES; ++page) {
+        if (map->pages[page] == 0) {
+            continue;
+        }
+
+        allocator.proc_alloc(
+            map->pages[page],
+            get_page_slot_count(map, page) * map->slot_size,
+            0,
+            allocator.c);
+    }
+
+    allocator.proc_alloc((umm)map, sizeof(VD_HandleMap), 0, allocator.c);
 }
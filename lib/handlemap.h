@@ -5,20 +5,39 @@
 
 #define VD_HANDLEMAP
 
+typedef enum {
+    /**
+     * Register, copy and drop may be called from multiple threads. Refcounts and the free slot list
+     * are updated atomically, and the allocator must be thread safe.
+     */
+    VD_HANDLEMAP_FLAG_CONCURRENT = 1 << 0,
+} VD_HandleMapFlags;
+
 typedef struct {
-    size_t          initial_capacity;
-    VD_Allocator    *allocator;
-    void            (*on_free_object)(void *object, void *c);
-    void            *c;
+    /** The number of slots in the first page. Later pages double in size. */
+    size_t              initial_capacity;
+    VD_Allocator        *allocator;
+    void                (*on_free_object)(void *object, void *c);
+    void                *c;
+    VD_HandleMapFlags   flags;
 } VD_HandleMapInitInfo;
 
 typedef struct VD_HandleMap VD_HandleMap;
 
+/**
+ * A reference to an object in a handlemap. The id packs the slot index of the object in the low 32
+ * bits and the generation of the slot in the high 32 bits. Generations start at 1, so an id of 0
+ * is never valid.
+ */
 typedef struct {
     u64             id;
     VD_HandleMap    *map;
 } VD_Handle;
 
+#define VD_HANDLE_ID(slot, generation) (((u64)(generation) << 32) | (u64)(u32)(slot))
+#define VD_HANDLE_SLOT(h)              ((u32)((h).id & 0xFFFFFFFF))
+#define VD_HANDLE_GENERATION(h)        ((u32)((h).id >> 32))
+
 typedef enum {
     /** The object will never be freed. */
     VD_HANDLEMAP_REF_MODE_ALWAYS  = 0,
@@ -60,6 +79,10 @@ void *vd_handlemap__init(size_t elsize, VD_HandleMapInitInfo *info);
 
 VD_Handle vd_handlemap__register(VD_HandleMap *hdr, void *valueptr, VD_HandleMapRegisterInfo *info);
 
+/**
+ * @brief Get the object a handle refers to.
+ * @return The object pointer, or 0 if the object has been freed.
+ */
 void *vd_handle_use(VD_Handle *handle, VD_HandleMapUseMode mode);
 
 VD_Handle vd_handlemap_copy(VD_Handle *handle);
@@ -0,0 +1,114 @@
+#include "hash.h"
+
+#include <string.h>
+
+#define BLOCK_SIZE 48
+
+/** Mix a block into the three lanes, which don't depend on each other so their multiplies overlap. */
+#define MIX_BLOCK(p, seed, see1, see2) do { \
+        seed = vd_hash__mix(vd_hash__r8(p) ^ VD_HASH_P1, vd_hash__r8((p) + 8) ^ seed); \
+        see1 = vd_hash__mix(vd_hash__r8((p) + 16) ^ VD_HASH_P2, vd_hash__r8((p) + 24) ^ see1); \
+        see2 = vd_hash__mix(vd_hash__r8((p) + 32) ^ VD_HASH_P3, vd_hash__r8((p) + 40) ^ see2); \
+    } while (0)
+
+/**
+ * Hash the last bytes, fewer than a block, which end at p + i. The last 16 bytes of the data are
+ * always read, so when i < 16 the bytes before p (the end of the last block) are read again.
+ */
+static u64 finish_tail(const u8 *p, u64 i, u64 seed, u64 len)
+{
+    while (i > 16) {
+        seed = vd_hash__mix(vd_hash__r8(p) ^ VD_HASH_P1, vd_hash__r8(p + 8) ^ seed);
+        p += 16;
+        i -= 16;
+    }
+
+    return vd_hash__finish(vd_hash__r8(p + i - 16), vd_hash__r8(p + i - 8), seed, len);
+}
+
+u64 vd_hash__long(const u8 *p, u64 len, u64 seed)
+{
+    u64 i = len;
+    if (i >= BLOCK_SIZE) {
+        u64 see1 = seed;
+        u64 see2 = seed;
+        do {
+            MIX_BLOCK(p, seed, see1, see2);
+            p += BLOCK_SIZE;
+            i -= BLOCK_SIZE;
+        } while (i >= BLOCK_SIZE);
+
+        seed ^= see1 ^ see2;
+    }
+
+    return finish_tail(p, i, seed, len);
+}
+
+void vd_hash_begin(VD_HashState *state, u64 seed)
+{
+    state->seed = vd_hash__seed(seed);
+    state->see1 = state->seed;
+    state->see2 = state->seed;
+    state->len = 0;
+    memset(state->last, 0, sizeof(state->last));
+}
+
+void vd_hash_update(VD_HashState *state, const void *data, u64 len)
+{
+    const u8 *p = (const u8*)data;
+    u64 buflen = state->len % BLOCK_SIZE;
+    state->len += len;
+
+    if (buflen + len < BLOCK_SIZE) {
+        memcpy(state->buf + buflen, p, len);
+        return;
+    }
+
+    // vd_hash mixes a block as soon as it has one, even the last, so the same is done here
+    u64 seed = state->seed;
+    u64 see1 = state->see1;
+    u64 see2 = state->see2;
+    const u8 *block_end;
+
+    if (buflen > 0) {
+        u64 fill = BLOCK_SIZE - buflen;
+        memcpy(state->buf + buflen, p, fill);
+        MIX_BLOCK(state->buf, seed, see1, see2);
+        block_end = state->buf + BLOCK_SIZE;
+        p += fill;
+        len -= fill;
+    }
+
+    while (len >= BLOCK_SIZE) {
+        MIX_BLOCK(p, seed, see1, see2);
+        p += BLOCK_SIZE;
+        len -= BLOCK_SIZE;
+        block_end = p;
+    }
+
+    memcpy(state->last, block_end - 16, 16);
+    memcpy(state->buf, p, len);
+
+    state->seed = seed;
+    state->see1 = see1;
+    state->see2 = see2;
+}
+
+u64 vd_hash_end(VD_HashState *state)
+{
+    u64 len = state->len;
+    if (len <= 16) {
+        return vd_hash__short(state->buf, len, state->seed);
+    }
+
+    u64 seed = state->seed;
+    if (len >= BLOCK_SIZE) {
+        seed ^= state->see1 ^ state->see2;
+    }
+
+    u8 tail[16 + BLOCK_SIZE];
+    u64 buflen = len % BLOCK_SIZE;
+    memcpy(tail, state->last, 16);
+    memcpy(tail + 16, state->buf, buflen);
+    return finish_tail(tail + 16, buflen, seed, len);
+}
@@ -1,48 +1,164 @@
+// hash.h
+//
+// 64-bit non-cryptographic hashing, in the style of wyhash: 128-bit multiply-xor mixing, keys of up
+// to 16 bytes in two reads without loops, and three independent lanes over 48 byte blocks for long
+// keys. vd_hash_u64 is the same function specialized for a single u64 (the intmap case), and
+// VD_HashState computes the same hash over data that arrives in pieces.
 #ifndef VD_HASH_H
 #define VD_HASH_H
 
 #include "vd_common.h"
+#include <string.h>
 
-VD_INLINE u64 vd_hash(const void *data, u64 len, u32 seed)
+#if VD_HOST_COMPILER_MSVC && defined(_M_X64)
+#include <intrin.h>
+#pragma intrinsic(_umul128)
+#endif
+
+#define VD_HASH_P0 0x2d358dccaa6c78a5ull
+#define VD_HASH_P1 0x8bb84b93962eacc9ull
+#define VD_HASH_P2 0x4b33a62ed433d4a3ull
+#define VD_HASH_P3 0x4d5a2da51de1aa47ull
+
+/** Multiply a and b into 128 bits, low half in a and high half in b. */
+static VD_INLINE void vd_hash__mum(u64 *a, u64 *b)
 {
-    const u64 m = 0x5bd1e995;
-    const u64 r = 24;
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (u64)r;
+    *b = (u64)(r >> 64);
+#elif VD_HOST_COMPILER_MSVC && defined(_M_X64)
+    *a = _umul128(*a, *b, b);
+#else
+    u64 ha = *a >> 32, hb = *b >> 32, la = (u32)*a, lb = (u32)*b;
+    u64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    u64 t = rl + (rm0 << 32);
+    u64 c = t < rl;
+    u64 lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
 
-    u64 h = seed ^ len;
+static VD_INLINE u64 vd_hash__mix(u64 a, u64 b)
+{
+    vd_hash__mum(&a, &b);
+    return a ^ b;
+}
 
-    const u8 *bytes = (const u8*)data;
+static VD_INLINE u64 vd_hash__r8(const u8 *p)
+{
+    u64 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
 
-    while (len >= 4)
-    {
-        u32 k = *(u32*)bytes;
+static VD_INLINE u64 vd_hash__r4(const u8 *p)
+{
+    u32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
 
-        k *= m;
-        k ^= k >> r;
-        k *= m;
+static VD_INLINE u64 vd_hash__seed(u64 seed)
+{
+    return seed ^ vd_hash__mix(seed ^ VD_HASH_P0, VD_HASH_P1);
+}
 
-        h *= m;
-        h ^= k;
+static VD_INLINE u64 vd_hash__finish(u64 a, u64 b, u64 seed, u64 len)
+{
+    a ^= VD_HASH_P1;
+    b ^= seed;
+    vd_hash__mum(&a, &b);
+    return vd_hash__mix(a ^ VD_HASH_P0 ^ len, b ^ VD_HASH_P1);
+}
 
-        bytes += 4;
-        len -= 4;   
+/** Keys of up to 16 bytes, without loops. seed has already gone through vd_hash__seed. */
+static VD_INLINE u64 vd_hash__short(const u8 *p, u64 len, u64 seed)
+{
+    u64 a, b;
+    if (len >= 4) {
+        // Two overlapping reads of 4 or 8 bytes from either end cover every byte
+        u64 mid = (len >> 3) << 2;
+        a = (vd_hash__r4(p) << 32) | vd_hash__r4(p + mid);
+        b = (vd_hash__r4(p + len - 4) << 32) | vd_hash__r4(p + len - 4 - mid);
+    } else if (len > 0) {
+        a = ((u64)p[0] << 16) | ((u64)p[len >> 1] << 8) | p[len - 1];
+        b = 0;
+    } else {
+        a = b = 0;
     }
 
-    switch (len) {
-        case 3: h ^= bytes[2] << 16;
-        case 2: h ^= bytes[1] << 8;
-        case 1: h ^= bytes[0];
-                h *= m;
+    return vd_hash__finish(a, b, seed, len);
+}
+
+/** Keys longer than 16 bytes. seed has already gone through vd_hash__seed. */
+u64 vd_hash__long(const u8 *p, u64 len, u64 seed);
+
+/**
+ * @brief Hash len bytes of data.
+ * @param data  The data. Has no alignment requirements.
+ * @param len   The length of the data in bytes.
+ * @param seed  The seed; different seeds give unrelated hashes.
+ * @return The hash.
+ */
+static VD_INLINE u64 vd_hash(const void *data, u64 len, u64 seed)
+{
+    seed = vd_hash__seed(seed);
+    if (len <= 16) {
+        return vd_hash__short((const u8*)data, len, seed);
     }
 
-    h ^= h >> 13;
-    h *= m;
-    h ^= h >> 15;
+    return vd_hash__long((const u8*)data, len, seed);
+}
 
-    return h;
+/**
+ * @brief Hash a u64 key. The result is the same as vd_hash(&key, 8, seed) on little endian hosts,
+ * and the seed is folded away when it is a constant.
+ */
+static VD_INLINE u64 vd_hash_u64(u64 key, u64 seed)
+{
+    seed = vd_hash__seed(seed);
+    return vd_hash__finish((key << 32) | (key >> 32), key, seed, 8);
 }
 
+/** Hashes data that arrives in pieces, giving the same result as vd_hash over all of it. */
+typedef struct {
+    u64 seed;
+    u64 see1;
+    u64 see2;
+    u64 len;
+    /** Bytes that haven't formed a full block yet. */
+    u8  buf[48];
+    /** The end of the last block, since the hash always reads the last 16 bytes. */
+    u8  last[16];
+} VD_HashState;
+
+/**
+ * @brief Begin hashing data in pieces.
+ * @param state The state.
+ * @param seed  The seed, as for vd_hash.
+ */
+void vd_hash_begin(VD_HashState *state, u64 seed);
+
+/**
+ * @brief Add the next piece of data.
+ * @param state The state.
+ * @param data  The data.
+ * @param len   The length of the data in bytes.
+ */
+void vd_hash_update(VD_HashState *state, const void *data, u64 len);
+
+/**
+ * @brief Get the hash of all the data so far. More data can be added afterwards.
+ * @param state The state.
+ * @return The hash.
+ */
+u64 vd_hash_end(VD_HashState *state);
+
 #define VD_HASH_STR(in, seed) vd_hash(in.data, in.len, seed)
 
 #define VD_HASH_DEFAULT_SEED (0x9747b28c)
 
-#endif
\ No newline at end of file
+#endif
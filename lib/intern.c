@@ -0,0 +1,252 @@
+#define VD_INTERNAL_SOURCE_FILE 1
+#include "intern.h"
+#include "arena.h"
+#include "hash.h"
+#include "vd_atomic.h"
+
+#include <string.h>
+
+/** Size of the blocks that strings are copied into. Longer strings get a block of their own. */
+#define STRING_BLOCK_SIZE (64 * 1024)
+
+/**
+ * Entries live in pages that never move, so vd_interner_get_str can read them without locking.
+ * Page 0 holds FIRST_PAGE_SIZE entries and every page after it twice as many as the one before.
+ */
+#define FIRST_PAGE_SHIFT 10
+#define MAX_PAGES 22
+
+typedef struct {
+    u64         hash;
+    char        *data;
+    u32         len;
+} Entry;
+
+typedef struct {
+    /** The symbol in this slot, or 0 if empty. */
+    u32         symbol;
+
+    /** The high bits of the hash, compared before looking at the entry. */
+    u32         hash_hi;
+} Slot;
+
+struct VD_Interner {
+    VD_Allocator    *allocator;
+    volatile i32    lock;
+
+    Entry *volatile pages[MAX_PAGES];
+    volatile u32    count;
+
+    /** Symbols by hash, with linear probing. */
+    Slot            *slots;
+    u32             cap_total;
+
+    VD_Arena        strings;
+};
+
+static u32 get_entry_page(u32 index)
+{
+    return 63 - vd_clz64(((u64)index >> FIRST_PAGE_SHIFT) + 1);
+}
+
+static size_t get_page_entry_count(u32 page)
+{
+    return (size_t)1 << (FIRST_PAGE_SHIFT + page);
+}
+
+static Entry *get_entry(VD_Interner *interner, u32 index)
+{
+    u32 page = get_entry_page(index);
+    u64 first_index_in_page = ((u64)1 << (FIRST_PAGE_SHIFT + page)) - ((u64)1 << FIRST_PAGE_SHIFT);
+    return &interner->pages[page][index - first_index_in_page];
+}
+
+static void lock_interner(VD_Interner *interner)
+{
+    while (vd_atomic_compare_and_swap32(&interner->lock, 1, 0) != 0);
+}
+
+static void unlock_interner(VD_Interner *interner)
+{
+    vd_atomic_fence();
+    interner->lock = 0;
+}
+
+static void allocate_slots(VD_Interner *interner, u32 cap_total)
+{
+    size_t byte_size = sizeof(Slot) * cap_total;
+    interner->slots = (Slot*)vd_malloc(interner->allocator, byte_size);
+    interner->cap_total = cap_total;
+    memset(interner->slots, 0, byte_size);
+}
+
+static Slot *find_slot(VD_Interner *interner, VD_str s, u64 hash)
+{
+    u32 mask = interner->cap_total - 1;
+    u32 i = (u32)hash & mask;
+    u32 hash_hi = (u32)(hash >> 32);
+
+    for (;;) {
+        Slot *slot = &interner->slots[i];
+        if (slot->symbol == 0) {
+            return slot;
+        }
+
+        if (slot->hash_hi == hash_hi) {
+            Entry *entry = get_entry(interner, slot->symbol - 1);
+            if (entry->hash == hash && entry->len == s.len && memcmp(entry->data, s.data, s.len) == 0) {
+                return slot;
+            }
+        }
+
+        i = (i + 1) & mask;
+    }
+}
+
+static void grow(VD_Interner *interner)
+{
+    Slot *old_slots = interner->slots;
+    u32 old_cap_total = interner->cap_total;
+    allocate_slots(interner, old_cap_total * 2);
+
+    u32 mask = interner->cap_total - 1;
+    for (u32 i = 0; i < old_cap_total; ++i) {
+        if (old_slots[i].symbol == 0) {
+            continue;
+        }
+
+        u32 j = (u32)get_entry(interner, old_slots[i].symbol - 1)->hash & mask;
+        while (interner->slots[j].symbol != 0) {
+            j = (j + 1) & mask;
+        }
+
+        interner->slots[j] = old_slots[i];
+    }
+
+    vd_free(interner->allocator, (umm)old_slots, sizeof(Slot) * old_cap_total);
+}
+
+VD_Interner *vd_interner_create(VD_Allocator *allocator)
+{
+    VD_Interner *interner = (VD_Interner*)vd_malloc(allocator, sizeof(VD_Interner));
+    memset(interner, 0, sizeof(VD_Interner));
+
+    interner->allocator = allocator;
+    interner->strings = vd_arena_new_chained(STRING_BLOCK_SIZE, allocator);
+    allocate_slots(interner, 1024);
+    return interner;
+}
+
+void vd_interner_destroy(VD_Interner *interner)
+{
+    VD_Allocator *allocator = interner->allocator;
+
+    for (u32 page = 0; page < MAX_PAGES; ++page) {
+        if (interner->pages[page]) {
+            vd_free(allocator, (umm)interner->pages[page], sizeof(Entry) * get_page_entry_count(page));
+        }
+    }
+
+    vd_free(allocator, (umm)interner->slots, sizeof(Slot) * interner->cap_total);
+    vd_arena_free(&interner->strings);
+    vd_free(allocator, (umm)interner, sizeof(VD_Interner));
+}
+
+u64 vd_interner_hash(VD_str s)
+{
+    return VD_HASH_STR(s, VD_HASH_DEFAULT_SEED);
+}
+
+VD_Symbol vd_interner_intern_hashed(VD_Interner *interner, VD_str s, u64 hash)
+{
+    lock_interner(interner);
+
+    Slot *slot = find_slot(interner, s, hash);
+    if (slot->symbol != 0) {
+        VD_Symbol symbol = slot->symbol;
+        unlock_interner(interner);
+        return symbol;
+    }
+
+    u32 index = interner->count;
+    u32 page = get_entry_page(index);
+    if (page >= MAX_PAGES) {
+        unlock_interner(interner);
+        return 0;
+    }
+
+    if (interner->pages[page] == 0) {
+        interner->pages[page] = (Entry*)vd_malloc(interner->allocator, sizeof(Entry) * get_page_entry_count(page));
+    }
+
+    char *data = (char*)vd_arena_alloc(&interner->strings, s.len + 1, 1);
+    memcpy(data, s.data, s.len);
+    data[s.len] = 0;
+
+    Entry *entry = get_entry(interner, index);
+    entry->hash = hash;
+    entry->data = data;
+    entry->len = s.len;
+
+    // Publish the entry before the symbol can be seen by anyone
+    vd_atomic_fence();
+    interner->count = index + 1;
+
+    slot->symbol = index + 1;
+    slot->hash_hi = (u32)(hash >> 32);
+
+    // Keep the load factor under 1/2
+    if (interner->count * 2 > interner->cap_total) {
+        grow(interner);
+    }
+
+    unlock_interner(interner);
+    return index + 1;
+}
+
+VD_Symbol vd_interner_find_hashed(VD_Interner *interner, VD_str s, u64 hash)
+{
+    lock_interner(interner);
+    VD_Symbol symbol = find_slot(interner, s, hash)->symbol;
+    unlock_interner(interner);
+    return symbol;
+}
+
+VD_str vd_interner_get_str(VD_Interner *interner, VD_Symbol symbol)
+{
+    if (symbol == 0 || symbol > interner->count) {
+        return (VD_str) { 0 };
+    }
+
+    Entry *entry = get_entry(interner, symbol - 1);
+    return (VD_str) { .data = entry->data, .len = entry->len };
+}
+
+u32 vd_interner_get_count(VD_Interner *interner)
+{
+    return interner->count;
+}
+
+static VD_Interner *volatile Global_Interner;
+
+VD_Interner *vd_symbols(void)
+{
+    VD_Interner *interner = (VD_Interner*)vd_atomic_load_ptr((void*)&Global_Interner);
+    if (interner) {
+        return interner;
+    }
+
+    // Whoever loses the race destroys its interner and uses the winner's
+    interner = vd_interner_create(vd_memory_get_system_allocator());
+    VD_Interner *prev = (VD_Interner*)vd_atomic_compare_and_swap_ptr(
+        (void *volatile*)&Global_Interner,
+        interner,
+        0);
+
+    if (prev) {
+        vd_interner_destroy(interner);
+        return prev;
+    }
+
+    return interner;
+}
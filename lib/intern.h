@@ -0,0 +1,99 @@
+// intern.h
+//
+// A string interner. Every distinct string gets a 32-bit symbol, so that strings can be compared
+// and used as keys by their symbol instead of by their bytes. The bytes of every interned string
+// are kept in an arena, null terminated, and never move.
+#ifndef VD_INTERN_H
+#define VD_INTERN_H
+#include "vd_common.h"
+#include "str.h"
+
+/** A symbol. Symbols start at 1 and are handed out in order, so 0 is never a valid symbol. */
+typedef u32 VD_Symbol;
+
+typedef struct VD_Interner VD_Interner;
+
+/**
+ * @brief Create an interner. Every function of an interner can be called from multiple threads.
+ * @param allocator Must be thread safe, since any thread that interns a new string may allocate.
+ */
+VD_Interner *vd_interner_create(VD_Allocator *allocator);
+void vd_interner_destroy(VD_Interner *interner);
+
+/**
+ * @brief The hash that the interner uses. Compute it once to skip hashing on later lookups.
+ */
+u64 vd_interner_hash(VD_str s);
+
+/**
+ * @brief Get the symbol of s, interning it if it is new.
+ * @param hash The result of vd_interner_hash(s).
+ */
+VD_Symbol vd_interner_intern_hashed(VD_Interner *interner, VD_str s, u64 hash);
+
+/**
+ * @brief Get the symbol of s if it was interned before.
+ * @param hash The result of vd_interner_hash(s).
+ * @return The symbol, or 0.
+ */
+VD_Symbol vd_interner_find_hashed(VD_Interner *interner, VD_str s, u64 hash);
+
+/**
+ * @brief Get the string of a symbol. Never locks.
+ * @return The string. Its data is null terminated, must not be written to, and is valid until the
+ * interner is destroyed.
+ */
+VD_str vd_interner_get_str(VD_Interner *interner, VD_Symbol symbol);
+
+/** The number of symbols. */
+u32 vd_interner_get_count(VD_Interner *interner);
+
+VD_INLINE VD_Symbol vd_interner_intern(VD_Interner *interner, VD_str s)
+{
+    return vd_interner_intern_hashed(interner, s, vd_interner_hash(s));
+}
+
+VD_INLINE VD_Symbol vd_interner_find(VD_Interner *interner, VD_str s)
+{
+    return vd_interner_find_hashed(interner, s, vd_interner_hash(s));
+}
+
+/**
+ * @brief The interner that the VD_SYMBOL_* functions and macros use. Created at first use, and
+ * lives until the process exits.
+ */
+VD_Interner *vd_symbols(void);
+
+VD_INLINE VD_Symbol vd_symbol_intern(VD_str s)
+{
+    return vd_interner_intern(vd_symbols(), s);
+}
+
+VD_INLINE VD_str vd_symbol_str(VD_Symbol symbol)
+{
+    return vd_interner_get_str(vd_symbols(), symbol);
+}
+
+/**
+ * @brief Declare a local VD_Symbol named var for the string literal s. The literal is interned the
+ * first time the declaration runs, and the symbol is cached in a static after that, so later runs
+ * do not hash the string.
+ * @code
+ * VD_SYMBOL_LIT(sym, "r.inflight-frame-count");
+ * vd_cvs_get_symbol(cvs, sym, &value);
+ * @endcode
+ */
+#define VD_SYMBOL_LIT(var, s)                                                                       \
+    static volatile VD_Symbol var##_vd_symbol_cache_;                                               \
+    const VD_Symbol var = var##_vd_symbol_cache_                                                    \
+        ? var##_vd_symbol_cache_                                                                    \
+        : (var##_vd_symbol_cache_ = vd_symbol_intern(VD_STR_LIT(s)))
+
+#if VD_ABBREVIATIONS
+#define Symbol          VD_Symbol
+#define symbol_intern   vd_symbol_intern
+#define symbol_str      vd_symbol_str
+#define symbol_lit      VD_SYMBOL_LIT
+#endif
+
+#endif // !VD_INTERN_H
@@ -3,135 +3,283 @@
 
 #include <string.h>
 
-void vd_intmap_init(VD_IntMap *map, VD_Allocator *allocator, u64 cap, VD_IntMapFlags flags)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define VD_INTMAP_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define VD_INTMAP_NEON 1
+#include <arm_neon.h>
+#endif
+
+#ifndef VD_INTMAP_SSE2
+#define VD_INTMAP_SSE2 0
+#endif
+
+#ifndef VD_INTMAP_NEON
+#define VD_INTMAP_NEON 0
+#endif
+
+/** Control byte of a free slot. Used slots store the low 7 bits of the hash (h2). */
+#define CTRL_EMPTY 0x80
+
+/**
+ * A mask with one set bit per matching lane in a group. NEON has no movemask, so each lane there
+ * occupies 4 bits instead of 1.
+ */
+typedef u64 GroupMask;
+
+#if VD_INTMAP_NEON
+#define GROUP_MASK_SHIFT 2
+#else
+#define GROUP_MASK_SHIFT 0
+#endif
+
+static VD_INLINE GroupMask group_match(const u8 *ctrl, u8 b)
 {
-    map->allocator = *allocator;
-    map->flags = flags;
-    map->cap_total = cap;
-    map->usecount = 0;
-    map->cap = map->cap_total - (u64)((float)map->cap_total * 0.20f);
-    size_t byte_size = map->cap_total * sizeof(VD_IntMapEntry);
-    map->table = (VD_IntMapEntry*)map->allocator.proc_alloc(
-        0,
-        0,
-        byte_size,
-        map->allocator.c);
-    memset(map->table, 0, byte_size);
+#if VD_INTMAP_SSE2
+    __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+    __m128i eq    = _mm_cmpeq_epi8(group, _mm_set1_epi8((char)b));
+    return (GroupMask)(u32)_mm_movemask_epi8(eq);
+#elif VD_INTMAP_NEON
+    uint8x16_t eq     = vceqq_u8(vld1q_u8(ctrl), vdupq_n_u8(b));
+    uint8x8_t  nibble = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(nibble), 0) & 0x8888888888888888ull;
+#else
+    GroupMask result = 0;
+    for (u64 i = 0; i < VD_INTMAP_GROUP_WIDTH; ++i) {
+        result |= (GroupMask)(ctrl[i] == b) << i;
+    }
+    return result;
+#endif
 }
 
-int vd_intmap_tryget(VD_IntMap *map, u64 k, u64 *v)
+static VD_INLINE u64 group_mask_lane(GroupMask m)
+{
+    return vd_ctz64(m) >> GROUP_MASK_SHIFT;
+}
+
+static VD_INLINE u64 hash_key(u64 k)
 {
-    u64 hash = vd_hash(&k, sizeof(k), 0xFACE0FF);
-    u64 index = hash % map->cap;
+    return vd_hash_u64(k, 0);
+}
 
-    VD_IntMapEntry *entry = &map->table[index];
+#define HASH_H1(h) ((h) >> 7)
+#define HASH_H2(h) ((u8)((h) & 0x7F))
 
-    while (entry->used && entry->k != k) {
-        if (entry->next) {
-            entry = entry->next;
-        } else {
-            return 0;
-        }
+static size_t table_byte_size(u64 cap_total)
+{
+    return cap_total * sizeof(VD_IntMapEntry) + cap_total + VD_INTMAP_GROUP_WIDTH;
+}
+
+static void allocate_table(VD_IntMap *map, u64 cap_total)
+{
+    size_t byte_size = table_byte_size(cap_total);
+    u8 *memory = (u8*)map->allocator.proc_alloc(0, 0, byte_size, map->allocator.c);
+
+    map->cap_total = cap_total;
+    map->cap       = cap_total - cap_total / 8;
+    map->usecount  = 0;
+    map->table     = (VD_IntMapEntry*)memory;
+    map->ctrl      = memory + cap_total * sizeof(VD_IntMapEntry);
+
+    memset(map->ctrl, CTRL_EMPTY, cap_total + VD_INTMAP_GROUP_WIDTH);
+}
+
+static void free_table(VD_IntMap *map)
+{
+    if (map->table == 0) {
+        return;
     }
 
-    *v = entry->v;
-    return 1;
+    map->allocator.proc_alloc(
+        (umm)map->table,
+        table_byte_size(map->cap_total),
+        0,
+        map->allocator.c);
+
+    map->table = 0;
+    map->ctrl = 0;
 }
 
-int vd_intmap_set(VD_IntMap *map, u64 k, u64 v)
+static VD_INLINE void set_ctrl(VD_IntMap *map, u64 slot, u8 c)
 {
-    if (!(map->flags & VD_INTMAP_FLAG_NO_AUTOGROW)) vd_intmap_check_grow(map);
+    map->ctrl[slot] = c;
+    if (slot < VD_INTMAP_GROUP_WIDTH) {
+        map->ctrl[map->cap_total + slot] = c;
+    }
+}
 
-    u64 hash = vd_hash(&k, sizeof(k), 0xFACE0FF);
-    u64 index = hash % map->cap;
+/**
+ * Probe sequence is linear from the home slot, one group at a time. Entries are always placed in
+ * the first free slot after their home slot, so an empty control byte ends the search.
+ */
+static VD_INLINE VD_IntMapEntry *find_entry(VD_IntMap *map, u64 k, u64 hash)
+{
+    u64 mask = map->cap_total - 1;
+    u64 pos  = HASH_H1(hash) & mask;
+    u8  h2   = HASH_H2(hash);
 
-    VD_IntMapEntry *existing = &map->table[index];
-    VD_IntMapEntry *curr = existing;
+    for (;;) {
+        const u8 *group = map->ctrl + pos;
+        GroupMask m = group_match(group, h2);
 
-    if (existing->used) {
-        u64 cursor = map->cap_total;
+        while (m) {
+            VD_IntMapEntry *entry = &map->table[(pos + group_mask_lane(m)) & mask];
+            if (entry->k == k) {
+                return entry;
+            }
 
-        while (curr->used && cursor > 0) {
-            cursor--;
-            curr = &map->table[cursor];
+            m &= m - 1;
         }
 
-        if (curr->used) {
+        if (group_match(group, CTRL_EMPTY)) {
             return 0;
         }
 
-        VD_IntMapEntry *chain = existing;
+        pos = (pos + VD_INTMAP_GROUP_WIDTH) & mask;
+    }
+}
+
+static u64 find_empty_slot(VD_IntMap *map, u64 hash)
+{
+    u64 mask = map->cap_total - 1;
+    u64 pos  = HASH_H1(hash) & mask;
 
-        while (chain->next) {
-            chain = chain->next;
+    for (;;) {
+        GroupMask m = group_match(map->ctrl + pos, CTRL_EMPTY);
+        if (m) {
+            return (pos + group_mask_lane(m)) & mask;
         }
 
-        chain->next = curr;
+        pos = (pos + VD_INTMAP_GROUP_WIDTH) & mask;
     }
+}
 
-    curr->used = 1;
-    curr->k = k;
-    curr->v = v;
-    curr->next = 0;
+static void insert_new(VD_IntMap *map, u64 k, u64 v, u64 hash)
+{
+    u64 slot = find_empty_slot(map, hash);
+    set_ctrl(map, slot, HASH_H2(hash));
+    map->table[slot].k = k;
+    map->table[slot].v = v;
     map->usecount++;
+}
 
-    return 1;
+static void rehash(VD_IntMap *map, u64 new_cap_total)
+{
+    VD_IntMap old = *map;
+    allocate_table(map, new_cap_total);
+
+    for (u64 i = 0; i < old.cap_total; ++i) {
+        if (old.ctrl[i] == CTRL_EMPTY) {
+            continue;
+        }
+
+        VD_IntMapEntry *entry = &old.table[i];
+        insert_new(map, entry->k, entry->v, hash_key(entry->k));
+    }
+
+    free_table(&old);
 }
 
-int vd_intmap_check_grow(VD_IntMap *map)
+void vd_intmap_init(VD_IntMap *map, VD_Allocator *allocator, u64 cap, VD_IntMapFlags flags)
+{
+    map->allocator = *allocator;
+    map->flags = flags;
+
+    // Round up so that cap entries fit under the 7/8 load factor
+    u64 wanted = (cap * 8 + 6) / 7;
+    u64 cap_total = VD_INTMAP_GROUP_WIDTH;
+    while (cap_total < wanted) {
+        cap_total *= 2;
+    }
+
+    allocate_table(map, cap_total);
+}
+
+int vd_intmap_tryget(VD_IntMap *map, u64 k, u64 *v)
 {
-    if (map->usecount != map->cap_total)
-    {
+    VD_IntMapEntry *entry = find_entry(map, k, hash_key(k));
+    if (!entry) {
         return 0;
     }
 
-    VD_IntMap new_map;
-    vd_intmap_init(&new_map, &map->allocator, map->cap_total * 2, map->flags);
+    *v = entry->v;
+    return 1;
+}
 
-    for (u64 i = 0; i < map->cap_total; ++i) {
-        VD_IntMapEntry *entry = &map->table[i];
+int vd_intmap_set(VD_IntMap *map, u64 k, u64 v)
+{
+    u64 hash = hash_key(k);
 
-        if (!entry->used) {
-            continue;
+    VD_IntMapEntry *existing = find_entry(map, k, hash);
+    if (existing) {
+        existing->v = v;
+        return 1;
+    }
+
+    if (map->usecount >= map->cap) {
+        if (map->flags & VD_INTMAP_FLAG_NO_AUTOGROW) {
+            return 0;
         }
 
-        vd_intmap_set(&new_map, entry->k, entry->v);
+        rehash(map, map->cap_total * 2);
     }
 
-    vd_intmap_deinit(map);
+    insert_new(map, k, v, hash);
+    return 1;
+}
+
+int vd_intmap_check_grow(VD_IntMap *map)
+{
+    if (map->usecount < map->cap) {
+        return 0;
+    }
 
-    *map = new_map;
+    if (map->flags & VD_INTMAP_FLAG_NO_AUTOGROW) {
+        return 0;
+    }
+
+    rehash(map, map->cap_total * 2);
     return 1;
 }
 
 void vd_intmap_del(VD_IntMap *map, u64 k)
 {
-    u64 hash = vd_hash(&k, sizeof(k), 0xFACE0FF);
-    u64 index = hash % map->cap;
+    VD_IntMapEntry *entry = find_entry(map, k, hash_key(k));
+    if (!entry) {
+        return;
+    }
 
-    VD_IntMapEntry *entry = &map->table[index];
+    u64 mask = map->cap_total - 1;
+    u64 hole = (u64)(entry - map->table);
+    u64 i = hole;
 
-    while (entry->used && entry->k != k) {
-        if (entry->next) {
-            entry = entry->next;
-        } else {
-            return;
+    // Backward shift: pull every following entry of the cluster that may legally live in the hole
+    // into it, so that lookups never need tombstones.
+    for (;;) {
+        i = (i + 1) & mask;
+        if (map->ctrl[i] == CTRL_EMPTY) {
+            break;
         }
-    }
 
-    entry->used = 0;
-    entry->k = 0;
-    entry->v = 0;
-    if (map->usecount > 0) {
-        map->usecount--;
+        u64 home = HASH_H1(hash_key(map->table[i].k)) & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            map->table[hole] = map->table[i];
+            set_ctrl(map, hole, map->ctrl[i]);
+            hole = i;
+        }
     }
+
+    set_ctrl(map, hole, CTRL_EMPTY);
+    map->table[hole].k = 0;
+    map->table[hole].v = 0;
+    map->usecount--;
 }
 
 void vd_intmap_deinit(VD_IntMap *map)
 {
-    map->allocator.proc_alloc(
-        (umm)map->table,
-        map->cap_total * sizeof(*map->table),
-        0,
-        map->allocator.c);
+    free_table(map);
+    map->cap = 0;
+    map->cap_total = 0;
+    map->usecount = 0;
 }
@@ -1,34 +1,76 @@
+// intmap.h
+//
+// A map of u64 keys to u64 values. The map is an open addressing hash table with a separate array
+// of control bytes that are probed 16 at a time (SSE2/NEON when available). Deletion shifts
+// entries backwards so there are no tombstones.
 #ifndef VD_INTMAP_H
 #define VD_INTMAP_H
 #include "vd_common.h"
 
-typedef struct VD_IntMapEntry VD_IntMapEntry;
+/** Number of control bytes that are probed at a time. */
+#define VD_INTMAP_GROUP_WIDTH 16
 
-struct VD_IntMapEntry {
-    VD_IntMapEntry      *next;
-    int                 used;
+typedef struct {
     u64                 k;
     u64                 v;
-};
+} VD_IntMapEntry;
 
 typedef enum {
     VD_INTMAP_FLAG_NO_AUTOGROW = 1 << 0,
 } VD_IntMapFlags;
 
 typedef struct {
+    /** The entries. cap_total in length. */
     VD_IntMapEntry  *table;
+
+    /**
+     * The control bytes. cap_total + VD_INTMAP_GROUP_WIDTH in length, the last group mirrors the
+     * first so that probing never has to wrap around in the middle of a group.
+     */
+    u8              *ctrl;
+
+    /** The number of entries that can be stored before the map needs to grow. */
     u64             cap;
+
+    /** The number of slots in the table. Always a power of two. */
     u64             cap_total;
     u64             usecount;
     VD_Allocator    allocator;
     VD_IntMapFlags  flags;
 } VD_IntMap;
 
+/**
+ * @brief Initialize an intmap.
+ * @param map The map.
+ * @param allocator The allocator used for the table.
+ * @param cap The number of entries the map should be able to hold without growing.
+ * @param flags The map flags.
+ */
 void vd_intmap_init(VD_IntMap *map, VD_Allocator *allocator, u64 cap, VD_IntMapFlags flags);
+
+/**
+ * @brief Get the value of a key.
+ * @return 1 if the key was found, 0 otherwise.
+ */
 int vd_intmap_tryget(VD_IntMap *map, u64 k, u64 *v);
+
+/**
+ * @brief Insert or update a key.
+ * @return 1 on success, 0 if the map is full and VD_INTMAP_FLAG_NO_AUTOGROW is set.
+ */
 int vd_intmap_set(VD_IntMap *map, u64 k, u64 v);
+
+/**
+ * @brief Grow the map if it cannot fit another entry.
+ * @return 1 if the map grew, 0 otherwise.
+ */
 int vd_intmap_check_grow(VD_IntMap *map);
+
+/**
+ * @brief Remove a key from the map, if it exists.
+ */
 void vd_intmap_del(VD_IntMap *map, u64 k);
+
 void vd_intmap_deinit(VD_IntMap *map);
 
 
@@ -0,0 +1,2 @@
+#define VD_LOG_IMPLEMENTATION
+#include "vd_log.h"
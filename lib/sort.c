@@ -0,0 +1,53 @@
+#define VD_INTERNAL_SOURCE_FILE 1
+#include "sort.h"
+
+#include <string.h>
+
+#define DIGITS 8
+
+void vd_radix_sort_u64(VD_SortItem *items, VD_SortItem *scratch, size_t len)
+{
+    if (len < 2) {
+        return;
+    }
+
+    size_t counts[DIGITS][256];
+    memset(counts, 0, sizeof(counts));
+
+    for (size_t i = 0; i < len; ++i) {
+        u64 key = items[i].key;
+        for (int d = 0; d < DIGITS; ++d) {
+            counts[d][(key >> (d * 8)) & 0xFF]++;
+        }
+    }
+
+    VD_SortItem *src = items;
+    VD_SortItem *dst = scratch;
+    for (int d = 0; d < DIGITS; ++d) {
+        size_t *count = counts[d];
+
+        // Every key has the same digit, so this pass would not move anything
+        if (count[(src[0].key >> (d * 8)) & 0xFF] == len) {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (int b = 0; b < 256; ++b) {
+            size_t c = count[b];
+            count[b] = offset;
+            offset += c;
+        }
+
+        for (size_t i = 0; i < len; ++i) {
+            dst[count[(src[i].key >> (d * 8)) & 0xFF]++] = src[i];
+        }
+
+        VD_SortItem *t = src;
+        src = dst;
+        dst = t;
+    }
+
+    if (src != items) {
+        memcpy(items, src, len * sizeof(VD_SortItem));
+    }
+}
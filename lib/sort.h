@@ -0,0 +1,30 @@
+// sort.h
+//
+// Sorting by integer keys. vd_radix_sort_u64 is a stable LSD radix sort over 8 bit digits: one pass
+// counts every digit of every key, and a scatter pass runs for each digit that not all keys share,
+// so keys that only differ in a few bytes take only a few passes.
+#ifndef VD_SORT_H
+#define VD_SORT_H
+#include "vd_common.h"
+
+/** A key to sort by, and the index of what it belongs to. */
+typedef struct {
+    u64 key;
+    u32 index;
+    u32 pad;
+} VD_SortItem;
+
+/**
+ * @brief Sort items by key, keeping the order of equal keys.
+ * @param items     The items.
+ * @param scratch   At least len items, overwritten.
+ * @param len       The number of items.
+ */
+void vd_radix_sort_u64(VD_SortItem *items, VD_SortItem *scratch, size_t len);
+
+#ifdef VD_ABBREVIATIONS
+#define SortItem        VD_SortItem
+#define radix_sort_u64  vd_radix_sort_u64
+#endif
+
+#endif // !VD_SORT_H
@@ -3,130 +3,190 @@
 #include "hash.h"
 #include <string.h>
 
-#define GET_BIN_AT(m, i) \
-    ((VD_BinPrefix*)(((u8*)m) + (VD_STRMAP_HEADER(m)->tsize + sizeof(VD_BinPrefix)) * i))
+/** Size of the blocks that keys are copied into. Longer keys get a block of their own. */
+#define KEY_BLOCK_SIZE 4096
 
-static bool check_key(VD_str check, VD_BinPrefix* against)
+#define GET_SLOT_AT(h, slots, i) ((VD_StrMapSlot*)((slots) + (size_t)(h)->slot_size * (i)))
+#define GET_SLOT_VALUE(slot)     ((void*)((u8*)(slot) + sizeof(VD_StrMapSlot)))
+
+static u64 hash_key(VD_str key)
 {
-    u32 prefix_len = sizeof(against->key_prefix);
-    u32 first_check_len = prefix_len < check.len ? prefix_len : check.len;
-    u32 second_check_len = check.len - prefix_len;
+    u64 hash = VD_HASH_STR(key, VD_HASH_DEFAULT_SEED);
 
-    if (against->key_len != check.len) {
-        return false;
-    }
+    // 0 marks empty slots
+    return hash == 0 ? 1 : hash;
+}
 
-    if (memcmp(against->key_prefix, check.data, first_check_len)) {
-        return false;
-    }
+static VD_bool check_key(VD_StrMapSlot *slot, VD_str key, u64 hash)
+{
+    return slot->hash == hash &&
+           slot->key_len == key.len &&
+           memcmp(slot->key, key.data, key.len) == 0;
+}
+
+static void allocate_slots(VD_StrMapHeader *h, u32 cap_total)
+{
+    size_t byte_size = (size_t)h->slot_size * cap_total;
+    h->slots = (u8*)vd_realloc(h->allocator, 0, 0, byte_size);
+    memset(h->slots, 0, byte_size);
 
-    return check.len < prefix_len 
-        ? true
-        : (memcmp(against->key_rest, check.data + prefix_len, second_check_len) == 0);
+    h->cap_total = cap_total;
+    h->cap = cap_total - cap_total / 4;
+    h->count = 0;
 }
 
-static void copy_key(str key, VD_BinPrefix *bin)
+static const char *copy_key(VD_StrMapHeader *h, VD_str key)
 {
-    u32 prefix_len = sizeof(bin->key_prefix);
-    u32 key_len = key.len;
-    bin->key_len = key_len;
+    char *copy = (char*)vd_arena_alloc(&h->keys, key.len, 1);
+    memcpy(copy, key.data, key.len);
+    h->key_bytes += key.len;
+    return copy;
+}
 
-    u32 first_copy_len = prefix_len < key_len ? prefix_len : key_len;
+/**
+ * @brief Find the slot of key, or the empty slot where it would go.
+ */
+static VD_StrMapSlot *find_slot(VD_StrMapHeader *h, VD_str key, u64 hash)
+{
+    u32 mask = h->cap_total - 1;
+    u32 i = (u32)hash & mask;
 
-    memcpy(bin->key_prefix, key.data, first_copy_len);
+    for (;;) {
+        VD_StrMapSlot *slot = GET_SLOT_AT(h, h->slots, i);
+        if (slot->hash == 0 || check_key(slot, key, hash)) {
+            return slot;
+        }
 
-    if (key_len > prefix_len) {
-        bin->key_rest = (char*)vd_realloc(
-            VD_STRMAP_HEADER(bin)->allocator, 
-            0, 
-            0, 
-            key_len - prefix_len);
-        memcpy(bin->key_rest, key.data + prefix_len, key_len - prefix_len);
+        i = (i + 1) & mask;
     }
-    
 }
 
-void *vd__strmap_init(VD_Allocator *allocator, u32 tsize, u32 cap)
+/**
+ * @brief Double the table, and copy the keys that are still in use into a new arena, so that deleted
+ * keys do not pile up.
+ */
+static void grow(VD_StrMapHeader *h)
 {
-    VD_StrMapHeader *map;
-    const u32 bin_size = sizeof(VD_BinPrefix) + tsize;
-    map = (VD_StrMapHeader*)vd_realloc(
-        allocator, 
-        0, 
-        0, 
-        sizeof(VD_StrMapHeader) + bin_size * cap);
-
-    memset(map, 0, sizeof(VD_StrMapHeader) + bin_size * cap);
-
-    map->cap_total = cap;
-    map->cap = (u32)(((float)(cap)) * 0.86f);
-    map->tsize = tsize;
-    map->allocator = allocator;
-    return (void*)((u8*)map + sizeof(VD_StrMapHeader));
+    u8 *old_slots = h->slots;
+    u32 old_cap_total = h->cap_total;
+    VD_Arena old_keys = h->keys;
+
+    u64 block_size = h->key_bytes < KEY_BLOCK_SIZE ? KEY_BLOCK_SIZE : h->key_bytes;
+    h->keys = vd_arena_new_chained((ptrdiff_t)block_size, h->allocator);
+    h->key_bytes = 0;
+    allocate_slots(h, old_cap_total * 2);
+
+    u32 mask = h->cap_total - 1;
+    for (u32 i = 0; i < old_cap_total; ++i) {
+        VD_StrMapSlot *old_slot = GET_SLOT_AT(h, old_slots, i);
+        if (old_slot->hash == 0) {
+            continue;
+        }
+
+        u32 j = (u32)old_slot->hash & mask;
+        while (GET_SLOT_AT(h, h->slots, j)->hash != 0) {
+            j = (j + 1) & mask;
+        }
+
+        VD_StrMapSlot *slot = GET_SLOT_AT(h, h->slots, j);
+        memcpy(slot, old_slot, h->slot_size);
+        slot->key = copy_key(h, (VD_str) { .data = (cstr)old_slot->key, .len = old_slot->key_len });
+        h->count++;
+    }
+
+    vd_free(h->allocator, (umm)old_slots, (size_t)h->slot_size * old_cap_total);
+    vd_arena_free(&old_keys);
 }
 
-VD_BinPrefix *vd__strmap_get_bin(void *map, VD_str key, VD__GetBinFlags op)
+/**
+ * @brief Remove a slot by moving later slots of its cluster back into the hole, so that lookups never
+ * need tombstones.
+ */
+static void remove_slot(VD_StrMapHeader *h, VD_StrMapSlot *removed)
 {
-    size_t hash = VD_HASH_STR(key, VD_HASH_DEFAULT_SEED);
-    size_t bin_index = hash % VD_STRMAP_HEADER(map)->cap;
+    u32 mask = h->cap_total - 1;
+    u32 hole = (u32)(((u8*)removed - h->slots) / h->slot_size);
+    u32 i = hole;
 
-    VD_BinPrefix* existing_bin = GET_BIN_AT(map, bin_index);
+    h->key_bytes -= removed->key_len;
 
-    if (existing_bin->used) {
-        bool found = false;
+    for (;;) {
+        i = (i + 1) & mask;
+        VD_StrMapSlot *slot = GET_SLOT_AT(h, h->slots, i);
+        if (slot->hash == 0) {
+            break;
+        }
 
-        if (check_key(key, existing_bin)) {
-            found = true;
+        u32 home = (u32)slot->hash & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            memcpy(GET_SLOT_AT(h, h->slots, hole), slot, h->slot_size);
+            hole = i;
         }
+    }
 
-        while (!found && (existing_bin->next != 0)) {
-            existing_bin = existing_bin->next;
+    memset(GET_SLOT_AT(h, h->slots, hole), 0, h->slot_size);
+    h->count--;
+}
 
-            if (check_key(key, existing_bin)) {
-                found = true;
-            }
-        }
-        
-        if (found) {
-            if (op & VD__GET_BIN_FLAGS_SET_UNUSED) {
-                existing_bin->used = false;
-
-                if (existing_bin->key_rest) {
-                    vd_free(
-                        VD_STRMAP_HEADER(map)->allocator, 
-                        (umm)existing_bin->key_rest, 
-                        sizeof(existing_bin->key_prefix) - existing_bin->key_len);
-                }
-            }
-
-            return existing_bin;
+void *vd__strmap_init(VD_Allocator *allocator, u32 tsize, u32 cap)
+{
+    VD_StrMapHeader *h = (VD_StrMapHeader*)vd_realloc(allocator, 0, 0, sizeof(VD_StrMapHeader));
+    memset(h, 0, sizeof(VD_StrMapHeader));
+
+    h->tsize = tsize;
+    h->slot_size = (u32)(sizeof(VD_StrMapSlot) + ((tsize + 7) & ~7u));
+    h->allocator = allocator;
+    h->keys = vd_arena_new_chained(KEY_BLOCK_SIZE, allocator);
+
+    // Round up so that cap keys fit under the 3/4 load factor
+    u64 wanted = ((u64)cap * 4 + 2) / 3;
+    u32 cap_total = 16;
+    while (cap_total < wanted) {
+        cap_total *= 2;
+    }
+
+    allocate_slots(h, cap_total);
+    return (void*)((u8*)h + sizeof(VD_StrMapHeader));
+}
+
+void *vd__strmap_get_bin(void *map, VD_str key, VD__GetBinFlags op)
+{
+    VD_StrMapHeader *h = VD_STRMAP_HEADER(map);
+    u64 hash = hash_key(key);
+
+    VD_StrMapSlot *slot = find_slot(h, key, hash);
+
+    if (slot->hash != 0) {
+        if (op & VD__GET_BIN_FLAGS_SET_UNUSED) {
+            remove_slot(h, slot);
         }
+
+        return GET_SLOT_VALUE(slot);
     }
 
     if (!(op & VD__GET_BIN_FLAGS_CREATE)) {
         return 0;
     }
 
-    if (!existing_bin->used) {
-        copy_key(key, existing_bin);
-        existing_bin->used = true;
-        existing_bin->next = 0;
-        return existing_bin;
+    if (h->count >= h->cap) {
+        grow(h);
+        slot = find_slot(h, key, hash);
     }
 
-    u32 cursor = VD_STRMAP_HEADER(map)->cap_total;
-    while ((cursor > 0) && (GET_BIN_AT(map, cursor)->used)) {
-        cursor--;
-    }
+    slot->hash = hash;
+    slot->key = copy_key(h, key);
+    slot->key_len = key.len;
+    h->count++;
 
-    if (cursor == 0) {
-        return 0;
-    }
+    return GET_SLOT_VALUE(slot);
+}
 
-    VD_BinPrefix* new_bin = GET_BIN_AT(map, cursor);
-    new_bin->used = true;
-    new_bin->next = 0;
-    copy_key(key, new_bin);
+void vd__strmap_deinit(void *map)
+{
+    VD_StrMapHeader *h = VD_STRMAP_HEADER(map);
+    VD_Allocator *allocator = h->allocator;
 
-    return new_bin;
-}
\ No newline at end of file
+    vd_free(allocator, (umm)h->slots, (size_t)h->slot_size * h->cap_total);
+    vd_arena_free(&h->keys);
+    vd_free(allocator, (umm)h, sizeof(VD_StrMapHeader));
+}
@@ -1,28 +1,41 @@
 // strmap.h
 // Author: Michael Dodis
 // 
-// A map of string slices to values. The map is implemented as a hash table.
+// A map of string slices to values. The map is an open addressing hash table with linear probing,
+// that keeps the full hash of every key next to it and copies the keys into an arena it owns.
 #ifndef VD_STRMAP_H
 #define VD_STRMAP_H
 #include "vd_common.h"
 #include "str.h"
+#include "arena.h"
 #include <string.h>
 
 typedef struct {
+    /** The most keys the table holds before it grows. */
     u32           cap;
+
+    /** The number of slots. Always a power of two. */
     u32           cap_total;
+    u32           count;
     u32           tsize;
+    u32           slot_size;
     VD_Allocator *allocator;
+
+    /** The slots. Each one is a VD_StrMapSlot followed by the value. */
+    u8           *slots;
+
+    /** Owns the bytes of every key. Compacted when the table grows. */
+    VD_Arena      keys;
+    u64           key_bytes;
 } VD_StrMapHeader;
 
-typedef struct VD_BinPrefix VD_BinPrefix;
-struct VD_BinPrefix {
-    VD_BinPrefix *next;
-    u32        key_len;
-    bool       used;
-    char      *key_rest;
-    char       key_prefix[43];
-};
+typedef struct {
+    /** The full hash of the key, or 0 if the slot is empty. */
+    u64           hash;
+    const char   *key;
+    u32           key_len;
+    u32           pad;
+} VD_StrMapSlot;
 
 typedef enum {
     /** 
@@ -40,34 +53,42 @@ typedef enum {
 #define VD_STRMAP_SET(m,k,v)         vd__strmap_set(m, k, (void*)v)
 #define VD_STRMAP_GET(m,k,v)         vd__strmap_get(m, k, (void*)v)
 #define VD_STRMAP_DEL(m,k)           (vd__strmap_get_bin(m, k, VD__GET_BIN_FLAGS_SET_UNUSED) != 0)
-#define VD_STRMAP_DEINIT(m)          vd_realloc(VD_STRMAP_HEADER(m)->allocator, (umm)VD_STRMAP_HEADER(m), VD_STRMAP_HEADER(m)->cap_total, 0)
+#define VD_STRMAP_DEINIT(m)          vd__strmap_deinit(m)
 
 
+/**
+ * @brief Create a map. The returned pointer stays the same when the map grows.
+ * @param cap The number of keys the map holds before it first grows.
+ */
 void *vd__strmap_init(VD_Allocator *allocator, u32 tsize, u32 cap);
-VD_BinPrefix *vd__strmap_get_bin(void *map, VD_str key, VD__GetBinFlags op);
+
+/**
+ * @brief Find the value of key.
+ * @return The value, or 0 if the key does not exist and was not created. When deleting, the result
+ * is only meaningful as a boolean.
+ */
+void *vd__strmap_get_bin(void *map, VD_str key, VD__GetBinFlags op);
+void vd__strmap_deinit(void *map);
 
 VD_INLINE VD_bool vd__strmap_set(void *map, VD_str key, void *value)
 {
-    VD_BinPrefix *bin = vd__strmap_get_bin(map, key, VD__GET_BIN_FLAGS_CREATE);
-    if (!bin) {
+    void *bin_data = vd__strmap_get_bin(map, key, VD__GET_BIN_FLAGS_CREATE);
+    if (!bin_data) {
         return false;
     }
 
-    u8 *bin_data = (((u8*)bin) + sizeof(VD_BinPrefix));
-    u32 tsize = VD_STRMAP_HEADER(map)->tsize;
-    memcpy(bin_data, value, tsize);
+    memcpy(bin_data, value, VD_STRMAP_HEADER(map)->tsize);
 
     return true;
 }
 
 VD_INLINE VD_bool vd__strmap_get(void *map, VD_str key, void *value)
 {
-    VD_BinPrefix *bin = vd__strmap_get_bin(map, key, 0);
-    if (!bin) {
+    void *bin_data = vd__strmap_get_bin(map, key, 0);
+    if (!bin_data) {
         return false;
     }
 
-    u8 *bin_data = (((u8*)bin) + sizeof(VD_BinPrefix));
     memcpy(value, bin_data, VD_STRMAP_HEADER(map)->tsize);
 
     return true;
@@ -74,6 +74,18 @@
 #define MEMORY_BARRIER() do {__sync_synchronize(); asm volatile("mfence": : :"memory"); } while(0)
 #endif
 
+/**
+ * Full memory fence. Unlike MEMORY_BARRIER, this works on every architecture.
+ */
+static inline void vd_atomic_fence(void) {
+#if VD_ATOMIC_PLATFORM_WINDOWS
+    volatile long v = 0;
+    _InterlockedExchange(&v, 1);
+#else
+    __sync_synchronize();
+#endif
+}
+
 static inline int32_t vd_atomic_compare_and_swap32(volatile int32_t *ptr, int32_t new_value, int32_t expected) {
 #if VD_ATOMIC_PLATFORM_WINDOWS
     return _InterlockedCompareExchange(ptr, new_value, expected);
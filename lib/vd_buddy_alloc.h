@@ -9,22 +9,78 @@
 #define VD_BUDDY_ALLOCATION_PROC(name) void *name(void *ptr, size_t prevsize, size_t newsize, void *usrdata)
 typedef VD_BUDDY_ALLOCATION_PROC(VD_BuddyAllocationProc);
 
+/** The most orders (block sizes) a buddy allocator can have, from the smallest block up. */
+#define VD_BUDDY_ALLOC_MAX_ORDERS 48
+
+/**
+ * Region bases are aligned to this many bytes, or to the region size if that is smaller. Blocks up to
+ * this size are then aligned to their own size, so that a page carved out of the allocator can be
+ * found from any address inside it.
+ */
+#ifndef VD_BUDDY_ALLOC_REGION_ALIGNMENT
+#define VD_BUDDY_ALLOC_REGION_ALIGNMENT (64 * 1024)
+#endif
+
+/** Header at the start of every block. The block's memory follows it, at the allocator's alignment. */
 typedef struct {
-	size_t	size;
-	int		is_free;
-    int     reserved;
+    unsigned int    order;
+    unsigned int    region;
+    int             is_free;
+    int             reserved;
 } VD_BuddyBlock;
 
+/** A free block, linked into the free list of its order. */
+typedef struct VD_BuddyFreeBlock VD_BuddyFreeBlock;
+struct VD_BuddyFreeBlock {
+    VD_BuddyBlock       block;
+    VD_BuddyFreeBlock   *prev;
+    VD_BuddyFreeBlock   *next;
+};
+
+/**
+ * A power of two sized range of memory, split into buddies. Each pair of buddies has one bit in
+ * bitmap, which is set when exactly one of the two is free.
+ */
+typedef struct {
+    void            *memory;
+    size_t          memory_size;
+    char            *base;
+    size_t          size;
+    unsigned int    max_order;
+    unsigned char   *bitmap;
+} VD_BuddyRegion;
+
 typedef struct {
-	VD_BuddyAllocationProc	*proc;
-	void					*usrdata;
-	VD_BuddyBlock			*head;
-	VD_BuddyBlock			*tail;
-    size_t                   alignment;
+    VD_BuddyAllocationProc  *proc;
+    void                    *usrdata;
+
+    VD_BuddyRegion          *regions;
+    unsigned int            num_regions;
+    unsigned int            cap_regions;
+
+    /** Free blocks of each order, across all regions. */
+    VD_BuddyFreeBlock       *free_lists[VD_BUDDY_ALLOC_MAX_ORDERS];
+
+    /** The size of new regions. Larger allocations get a region that fits them. */
+    size_t                  region_size;
+    size_t                  min_block_size;
+    unsigned int            min_block_shift;
+    size_t                  alignment;
+
+    size_t                  used_bytes;
+    size_t                  total_bytes;
+    size_t                  num_used_blocks;
+    size_t                  num_free_blocks;
 } VD_BuddyAlloc;
 
 VD_BUDDY_ALLOCATION_PROC(vd_buddy_alloc_default_palloc);
 void vd_buddy_alloc_init(VD_BuddyAlloc *alloc, VD_BuddyAllocationProc *palloc, void *usrdata, size_t initial_size, size_t alignment);
+
+/**
+ * @brief Allocate (ptr == 0), free (size == 0), or resize an allocation. Resizing happens in place when
+ * the block is big enough, or when the buddies that follow it are free.
+ * @return The allocation, or 0 if the backing allocation proc failed.
+ */
 void *vd_buddy_alloc_realloc(VD_BuddyAlloc *alloc, void *ptr, size_t size);
 void vd_buddy_alloc_deinit(VD_BuddyAlloc *alloc);
 void vd_buddy_alloc_get_stats(
@@ -39,6 +95,7 @@ void vd_buddy_alloc_get_stats(
 #ifdef VD_BUDDY_ALLOC_IMPLEMENTATION
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 VD_BUDDY_ALLOCATION_PROC(vd_buddy_alloc_default_palloc) {
     if (newsize == 0) {
@@ -100,182 +157,345 @@ static size_t vd_buddy_alloc__align_forward(size_t ptr, size_t align)
     return p;
 }
 
-static VD_BuddyBlock *vd_buddy_alloc__next_block(VD_BuddyBlock *block)
+static unsigned int vd_buddy_alloc__log2(size_t x)
+{
+    unsigned int result = 0;
+    while (x > 1) {
+        x >>= 1;
+        result++;
+    }
+
+    return result;
+}
+
+static size_t vd_buddy_alloc__order_size(VD_BuddyAlloc *alloc, unsigned int order)
 {
-    return (VD_BuddyBlock *)((char *)block + block->size);
+    return alloc->min_block_size << order;
 }
 
-static VD_BuddyBlock *vd_buddy_alloc__split(VD_BuddyBlock *block, size_t size)
+/**
+ * @brief The smallest order that fits size bytes after the block header.
+ */
+static unsigned int vd_buddy_alloc__order_req(VD_BuddyAlloc *alloc, size_t size)
 {
-    if (block == 0 || size == 0) {
-        return 0;
-    }
+    size_t needed = size + alloc->alignment;
+    unsigned int order = 0;
 
-    while (size < block->size) {
-        size_t sz = block->size >> 1;
-        block->size = sz;
-        block = vd_buddy_alloc__next_block(block);
-        block->size = sz;
-        block->is_free = 1;
+    while (vd_buddy_alloc__order_size(alloc, order) < needed) {
+        order++;
     }
 
-    if (size <= block->size) {
-        return block;
+    return order;
+}
+
+/**
+ * @brief Flip the bit of the pair that the block at offset belongs to.
+ * @return The new value of the bit. 0 means both buddies are now in the same state.
+ */
+static int vd_buddy_alloc__toggle_pair(VD_BuddyAlloc *alloc, VD_BuddyRegion *region, size_t offset, unsigned int order)
+{
+    size_t num_min_blocks = region->size >> alloc->min_block_shift;
+    size_t bit = (num_min_blocks - (num_min_blocks >> order)) + (offset >> (alloc->min_block_shift + order + 1));
+
+    region->bitmap[bit >> 3] ^= (unsigned char)(1u << (bit & 7));
+    return (region->bitmap[bit >> 3] >> (bit & 7)) & 1;
+}
+
+static int vd_buddy_alloc__pair_bit(VD_BuddyAlloc *alloc, VD_BuddyRegion *region, size_t offset, unsigned int order)
+{
+    size_t num_min_blocks = region->size >> alloc->min_block_shift;
+    size_t bit = (num_min_blocks - (num_min_blocks >> order)) + (offset >> (alloc->min_block_shift + order + 1));
+
+    return (region->bitmap[bit >> 3] >> (bit & 7)) & 1;
+}
+
+static void vd_buddy_alloc__push_free(VD_BuddyAlloc *alloc, VD_BuddyFreeBlock *block, unsigned int region, unsigned int order)
+{
+    block->block.order = order;
+    block->block.region = region;
+    block->block.is_free = 1;
+
+    block->prev = 0;
+    block->next = alloc->free_lists[order];
+    if (block->next) {
+        block->next->prev = block;
     }
 
-    return 0;
+    alloc->free_lists[order] = block;
+    alloc->num_free_blocks++;
 }
 
-static VD_BuddyBlock *vd_buddy_alloc__find(VD_BuddyBlock *head, VD_BuddyBlock *tail, size_t size)
+static void vd_buddy_alloc__remove_free(VD_BuddyAlloc *alloc, VD_BuddyFreeBlock *block)
 {
-    VD_BuddyBlock *best = 0;
-    VD_BuddyBlock *block = head;
-    VD_BuddyBlock *buddy = vd_buddy_alloc__next_block(block);
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        alloc->free_lists[block->block.order] = block->next;
+    }
 
-    if (buddy == tail && block->is_free) {
-        return vd_buddy_alloc__split(block, size);
+    if (block->next) {
+        block->next->prev = block->prev;
     }
 
-    while (block < tail && buddy < tail) {
-        if (block->is_free && buddy->is_free && block->size == buddy->size) {
-            block->size <<= 1;
+    block->block.is_free = 0;
+    alloc->num_free_blocks--;
+}
 
-            if (size <= block->size && (best == 0 || block->size <= best->size)) {
-                best = block;
-            }
+/**
+ * @brief Add a region of at least size bytes, as a single free block.
+ * @return 1 on success, 0 if the allocation proc failed.
+ */
+static int vd_buddy_alloc__add_region(VD_BuddyAlloc *alloc, size_t size)
+{
+    if (size < alloc->region_size) {
+        size = alloc->region_size;
+    }
 
-            block = vd_buddy_alloc__next_block(buddy);
-            if (block < tail) {
-                buddy = vd_buddy_alloc__next_block(block);
-            }
+    size = vd_buddy_alloc__round_up_to_next_power_of_2(size);
+    unsigned int max_order = vd_buddy_alloc__log2(size >> alloc->min_block_shift);
+    if (max_order >= VD_BUDDY_ALLOC_MAX_ORDERS) {
+        return 0;
+    }
 
-            continue;
-        }
+    if (alloc->num_regions == alloc->cap_regions) {
+        unsigned int new_cap = alloc->cap_regions == 0 ? 4 : alloc->cap_regions * 2;
+        VD_BuddyRegion *regions = (VD_BuddyRegion *)alloc->proc(
+            alloc->regions,
+            sizeof(VD_BuddyRegion) * alloc->cap_regions,
+            sizeof(VD_BuddyRegion) * new_cap,
+            alloc->usrdata);
 
-        if (block->is_free && size <= block->size &&
-            (best == 0 || block->size <= best->size)) 
-        {
-            best = block;
+        if (regions == 0) {
+            return 0;
         }
 
-        if (buddy->is_free && size <= buddy->size &&
-            (best == 0 || buddy->size < best->size))
-        {
-            best = buddy;
-        }
+        alloc->regions = regions;
+        alloc->cap_regions = new_cap;
+    }
 
-        if (block->size <= buddy->size) {
-            block = vd_buddy_alloc__next_block(buddy);
+    size_t region_alignment = size < VD_BUDDY_ALLOC_REGION_ALIGNMENT ? size : VD_BUDDY_ALLOC_REGION_ALIGNMENT;
+    if (region_alignment < alloc->alignment) {
+        region_alignment = alloc->alignment;
+    }
 
-            if (block < tail) {
-                buddy = vd_buddy_alloc__next_block(block);
-            }
-        } else {
-            block = buddy;
-            buddy = vd_buddy_alloc__next_block(buddy);
-        }
+    // The region, padding to align its base, and the pair bitmap, which has fewer bits than the
+    // region has minimum sized blocks.
+    size_t bitmap_size = ((size >> alloc->min_block_shift) + 7) / 8;
+    size_t memory_size = size + region_alignment + bitmap_size;
+    void *memory = alloc->proc(0, 0, memory_size, alloc->usrdata);
+    if (memory == 0) {
+        return 0;
     }
 
-    if (best != 0) {
-        return vd_buddy_alloc__split(best, size);
+    VD_BuddyRegion *region = &alloc->regions[alloc->num_regions];
+    region->memory = memory;
+    region->memory_size = memory_size;
+    region->base = (char *)vd_buddy_alloc__align_forward((size_t)memory, region_alignment);
+    region->size = size;
+    region->max_order = max_order;
+    region->bitmap = (unsigned char *)memory + size + region_alignment;
+    memset(region->bitmap, 0, bitmap_size);
+
+    vd_buddy_alloc__push_free(alloc, (VD_BuddyFreeBlock *)region->base, alloc->num_regions, max_order);
+    alloc->num_regions++;
+    alloc->total_bytes += size;
+    return 1;
+}
+
+/**
+ * @brief Take the smallest free block of at least order, splitting it down to order.
+ */
+static VD_BuddyBlock *vd_buddy_alloc__take(VD_BuddyAlloc *alloc, unsigned int order)
+{
+    unsigned int k = order;
+    while (k < VD_BUDDY_ALLOC_MAX_ORDERS && alloc->free_lists[k] == 0) {
+        k++;
     }
 
-    return 0;
+    if (k == VD_BUDDY_ALLOC_MAX_ORDERS) {
+        return 0;
+    }
+
+    VD_BuddyFreeBlock *block = alloc->free_lists[k];
+    VD_BuddyRegion *region = &alloc->regions[block->block.region];
+    size_t offset = (size_t)((char *)block - region->base);
+
+    vd_buddy_alloc__remove_free(alloc, block);
+    if (k < region->max_order) {
+        vd_buddy_alloc__toggle_pair(alloc, region, offset, k);
+    }
+
+    // Split, keeping the lower half and freeing the upper one
+    while (k > order) {
+        k--;
+        VD_BuddyFreeBlock *upper = (VD_BuddyFreeBlock *)((char *)block + vd_buddy_alloc__order_size(alloc, k));
+        vd_buddy_alloc__push_free(alloc, upper, block->block.region, k);
+        vd_buddy_alloc__toggle_pair(alloc, region, offset, k);
+    }
+
+    block->block.order = order;
+    block->block.is_free = 0;
+    return &block->block;
 }
 
-static size_t vd_buddy_alloc__size_req(VD_BuddyAlloc *alloc, size_t size) {
-    size_t actual_size = alloc->alignment;
-    size += sizeof(VD_BuddyBlock);
-    size = vd_buddy_alloc__align_forward(size, alloc->alignment);
+/**
+ * @brief Free a block, merging it with its buddy for as long as the buddy is free too.
+ */
+static void vd_buddy_alloc__give_back(VD_BuddyAlloc *alloc, VD_BuddyBlock *block)
+{
+    VD_BuddyRegion *region = &alloc->regions[block->region];
+    size_t offset = (size_t)((char *)block - region->base);
+    unsigned int order = block->order;
+
+    while (order < region->max_order) {
+        if (vd_buddy_alloc__toggle_pair(alloc, region, offset, order)) {
+            break;
+        }
+
+        size_t buddy_offset = offset ^ vd_buddy_alloc__order_size(alloc, order);
+        vd_buddy_alloc__remove_free(alloc, (VD_BuddyFreeBlock *)(region->base + buddy_offset));
 
-    while (size > actual_size) {
-        actual_size <<= 1;
+        offset &= ~vd_buddy_alloc__order_size(alloc, order);
+        order++;
     }
 
-    return actual_size;
+    vd_buddy_alloc__push_free(alloc, (VD_BuddyFreeBlock *)(region->base + offset), block->region, order);
 }
 
-static void vd_buddy_alloc__coalescence(VD_BuddyBlock *head, VD_BuddyBlock *tail) {
-    for (;;) {
-        VD_BuddyBlock *block = head;
-        VD_BuddyBlock *buddy = vd_buddy_alloc__next_block(block);
-
-        int no_coalescence = 1;
-
-        while (block < tail && buddy < tail) {
-            if (block->is_free && buddy->is_free && block->size == buddy->size) {
-                block->size <<= 1;
-                block = vd_buddy_alloc__next_block(block);
-                if (block < tail) {
-                    buddy = vd_buddy_alloc__next_block(block);
-                    no_coalescence = 0;
-                }
-            } else if (block->size < buddy->size) {
-                block = buddy;
-                buddy = vd_buddy_alloc__next_block(buddy);
-            } else {
-                block = vd_buddy_alloc__next_block(buddy);
-                if (block < tail) {
-                    buddy = vd_buddy_alloc__next_block(block);
-                }
-            }
+/**
+ * @brief Try to resize a block to order without moving it.
+ * @return 1 if the block now has order, 0 if it would have to move.
+ */
+static int vd_buddy_alloc__resize_in_place(VD_BuddyAlloc *alloc, VD_BuddyBlock *block, unsigned int order)
+{
+    VD_BuddyRegion *region = &alloc->regions[block->region];
+    size_t offset = (size_t)((char *)block - region->base);
+    unsigned int region_index = block->region;
+
+    if (order > region->max_order) {
+        return 0;
+    }
+
+    if (order <= block->order) {
+        // Give back the upper halves. Their buddies are the lower halves that we keep, so they
+        // cannot merge.
+        for (unsigned int k = block->order; k > order;) {
+            k--;
+            VD_BuddyFreeBlock *upper = (VD_BuddyFreeBlock *)((char *)block + vd_buddy_alloc__order_size(alloc, k));
+            vd_buddy_alloc__push_free(alloc, upper, region_index, k);
+            vd_buddy_alloc__toggle_pair(alloc, region, offset, k);
         }
 
-        if (no_coalescence) {
-            return;
+        block->order = order;
+        return 1;
+    }
+
+    // Every buddy from the block's order up must be the upper half, and free as a whole. Since the
+    // block itself is not free at any of these orders, the pair bit tells whether the buddy is.
+    if ((offset & (vd_buddy_alloc__order_size(alloc, order) - 1)) != 0) {
+        return 0;
+    }
+
+    for (unsigned int k = block->order; k < order; ++k) {
+        if (!vd_buddy_alloc__pair_bit(alloc, region, offset, k)) {
+            return 0;
         }
     }
+
+    for (unsigned int k = block->order; k < order; ++k) {
+        size_t buddy_offset = offset + vd_buddy_alloc__order_size(alloc, k);
+        vd_buddy_alloc__remove_free(alloc, (VD_BuddyFreeBlock *)(region->base + buddy_offset));
+        vd_buddy_alloc__toggle_pair(alloc, region, offset, k);
+    }
+
+    block->order = order;
+    return 1;
 }
 
 void vd_buddy_alloc_init(VD_BuddyAlloc *alloc, VD_BuddyAllocationProc *palloc, void *usrdata, size_t initial_size, size_t alignment)
 {
     assert(vd_buddy_alloc__is_power_of_two(sizeof(VD_BuddyBlock)));
-    alignment           = vd_buddy_alloc__round_up_to_next_power_of_2(alignment);
-    initial_size        = vd_buddy_alloc__round_up_to_next_power_of_2(initial_size);
-	
-	void *memory = palloc(0, 0, initial_size, usrdata);
+    alignment = vd_buddy_alloc__round_up_to_next_power_of_2(alignment);
+
+    memset(alloc, 0, sizeof(*alloc));
     alloc->proc             = palloc;
     alloc->usrdata          = usrdata;
-    alloc->head             = (VD_BuddyBlock *)memory;
-    alloc->head->size       = initial_size;
-    alloc->head->is_free    = 1;
-    alloc->tail             = vd_buddy_alloc__next_block(alloc->head);
     alloc->alignment        = alignment < sizeof(VD_BuddyBlock) ? sizeof(VD_BuddyBlock) : alignment;
+    alloc->min_block_size   = vd_buddy_alloc__round_up_to_next_power_of_2(
+        alloc->alignment < sizeof(VD_BuddyFreeBlock) ? sizeof(VD_BuddyFreeBlock) : alloc->alignment);
+    alloc->min_block_shift  = vd_buddy_alloc__log2(alloc->min_block_size);
+    alloc->region_size      = vd_buddy_alloc__round_up_to_next_power_of_2(initial_size);
+
+    if (alloc->region_size < alloc->min_block_size) {
+        alloc->region_size = alloc->min_block_size;
+    }
+
+    vd_buddy_alloc__add_region(alloc, alloc->region_size);
 }
 
 void *vd_buddy_alloc_realloc(VD_BuddyAlloc *alloc, void *ptr, size_t size)
 {
     if (ptr == 0) {
-        size_t actual_size = vd_buddy_alloc__size_req(alloc, size);
+        if (size == 0) {
+            return 0;
+        }
 
-        VD_BuddyBlock *found = vd_buddy_alloc__find(alloc->head, alloc->tail, actual_size);
+        unsigned int order = vd_buddy_alloc__order_req(alloc, size);
+        VD_BuddyBlock *found = vd_buddy_alloc__take(alloc, order);
         if (found == 0) {
-            vd_buddy_alloc__coalescence(alloc->head, alloc->tail);
-            found = vd_buddy_alloc__find(alloc->head, alloc->tail, actual_size);
-        }
+            if (!vd_buddy_alloc__add_region(alloc, vd_buddy_alloc__order_size(alloc, order))) {
+                return 0;
+            }
 
-        if (found != 0) {
-            found->is_free = 0;
-            return (void *)((char *)found + alloc->alignment);
+            found = vd_buddy_alloc__take(alloc, order);
         }
 
-        return 0;
-    } else if (ptr != 0 && size == 0) {
-        assert(alloc->head <= ptr);
-        assert(ptr <= alloc->tail);
+        alloc->used_bytes += vd_buddy_alloc__order_size(alloc, found->order);
+        alloc->num_used_blocks++;
+        return (void *)((char *)found + alloc->alignment);
+    }
 
-        VD_BuddyBlock *block = (VD_BuddyBlock *)((char *)ptr - alloc->alignment);
-        block->is_free = 1;
+    VD_BuddyBlock *block = (VD_BuddyBlock *)((char *)ptr - alloc->alignment);
+    assert(block->region < alloc->num_regions);
+    assert(!block->is_free);
 
+    if (size == 0) {
+        alloc->used_bytes -= vd_buddy_alloc__order_size(alloc, block->order);
+        alloc->num_used_blocks--;
+        vd_buddy_alloc__give_back(alloc, block);
         return 0;
-    } else {
+    }
+
+    size_t prev_block_size = vd_buddy_alloc__order_size(alloc, block->order);
+    if (vd_buddy_alloc__resize_in_place(alloc, block, vd_buddy_alloc__order_req(alloc, size))) {
+        alloc->used_bytes -= prev_block_size;
+        alloc->used_bytes += vd_buddy_alloc__order_size(alloc, block->order);
+        return ptr;
+    }
+
+    void *result = vd_buddy_alloc_realloc(alloc, 0, size);
+    if (result == 0) {
         return 0;
     }
+
+    memcpy(result, ptr, prev_block_size - alloc->alignment);
+    vd_buddy_alloc_realloc(alloc, ptr, 0);
+    return result;
 }
 
 void vd_buddy_alloc_deinit(VD_BuddyAlloc *alloc)
 {
-    alloc->proc(alloc->head, alloc->head->size, 0, alloc->usrdata);
+    for (unsigned int i = 0; i < alloc->num_regions; ++i) {
+        alloc->proc(alloc->regions[i].memory, alloc->regions[i].memory_size, 0, alloc->usrdata);
+    }
+
+    if (alloc->regions) {
+        alloc->proc(alloc->regions, sizeof(VD_BuddyRegion) * alloc->cap_regions, 0, alloc->usrdata);
+    }
+
+    alloc->regions = 0;
+    alloc->num_regions = 0;
+    alloc->cap_regions = 0;
 }
 
 void vd_buddy_alloc_get_stats(
@@ -285,42 +505,21 @@ void vd_buddy_alloc_get_stats(
     size_t *num_blocks,
     size_t *num_free_blocks)
 {
-    size_t used_bytes = 0;
-    size_t total_bytes = 0;
-    size_t num_blocks_ = 0;
-    size_t num_free_blocks_ = 0;
-
-    VD_BuddyBlock *block = alloc->head;
-    VD_BuddyBlock *tail = alloc->tail;
-
-    while (block < tail) {
-        total_bytes += block->size;
-        num_blocks_++;
-
-        if (block->is_free) {
-            num_free_blocks_++;
-        } else {
-            used_bytes += block->size;
-        }
-
-        block = vd_buddy_alloc__next_block(block);
-    }
-
     if (used != 0) {
-        *used = used_bytes;
+        *used = alloc->used_bytes;
     }
 
     if (total != 0) {
-        *total = total_bytes;
+        *total = alloc->total_bytes;
     }
 
     if (num_blocks != 0) {
-        *num_blocks = num_blocks_;
+        *num_blocks = alloc->num_used_blocks + alloc->num_free_blocks;
     }
 
     if (num_free_blocks != 0) {
-        *num_free_blocks = num_free_blocks_;
+        *num_free_blocks = alloc->num_free_blocks;
     }
 }
 
-#endif
\ No newline at end of file
+#endif
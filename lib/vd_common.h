@@ -221,6 +221,41 @@ VD_INLINE umm vd_free(VD_Allocator *allocator, umm ptr, size_t size)
 
 #define VD_ALLOC_ARRAY(alc, s, n) ((s*)vd_malloc(alc, sizeof(s) * n))
 
+/* ----BITS-------------------------------------------------------------------------------------- */
+#if VD_HOST_COMPILER_MSVC
+#include <intrin.h>
+#endif
+
+/**
+ * @brief Count trailing zero bits.
+ * @param x The value. Must not be 0.
+ */
+VD_INLINE u32 vd_ctz64(u64 x)
+{
+#if VD_HOST_COMPILER_MSVC
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (u32)index;
+#else
+    return (u32)__builtin_ctzll(x);
+#endif
+}
+
+/**
+ * @brief Count leading zero bits.
+ * @param x The value. Must not be 0.
+ */
+VD_INLINE u32 vd_clz64(u64 x)
+{
+#if VD_HOST_COMPILER_MSVC
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return 63 - (u32)index;
+#else
+    return (u32)__builtin_clzll(x);
+#endif
+}
+
 /* ----COLORS------------------------------------------------------------------------------------ */
 
 VD_INLINE u32 vd_pack_unorm_r8g8b8a8(float v[4])
@@ -124,14 +124,14 @@ static inline void vd_fmt_printf(const char *fmt, ...)
     )
 
 #define VD_FMT__INT_CONVERSION_PROCS      \
-    VD_FMT__X(uint64_t, 0, 20, uint64_t)  \
-    VD_FMT__X(int64_t,  1, 21, int64_t)   \
-    VD_FMT__X(uint32_t, 0, 10, uint32_t)  \
-    VD_FMT__X(int32_t,  1, 11, int32_t)   \
-    VD_FMT__X(uint16_t, 0, 5,  uint32_t)  \
-    VD_FMT__X(int16_t,  1, 6,  int32_t)   \
-    VD_FMT__X(uint8_t,  0, 3,  uint32_t)  \
-    VD_FMT__X(int8_t,   1, 4,  int32_t)
+    VD_FMT__X(uint64_t, 0, 20, uint64_t, uint64_t)  \
+    VD_FMT__X(int64_t,  1, 20, int64_t,  uint64_t)  \
+    VD_FMT__X(uint32_t, 0, 10, uint32_t, uint32_t)  \
+    VD_FMT__X(int32_t,  1, 11, int32_t,  uint32_t)  \
+    VD_FMT__X(uint16_t, 0, 5,  uint32_t, uint32_t)  \
+    VD_FMT__X(int16_t,  1, 6,  int32_t,  uint32_t)  \
+    VD_FMT__X(uint8_t,  0, 3,  uint32_t, uint32_t)  \
+    VD_FMT__X(int8_t,   1, 4,  int32_t,  uint32_t)
 
 #define VD_FMT__INT_CONVERSION_PROC_NAME2(x, y, z) x##y##z
 #define VD_FMT__INT_CONVERSION_PROC_NAME(x) VD_FMT__INT_CONVERSION_PROC_NAME2(vd_fmt__,x,_to_str)
@@ -145,32 +145,35 @@ static const char VD_FMT__Digits_Lut[201] =
     "6061626364656667686970717273747576777879"
     "8081828384858687888990919293949596979899";
 
-#define VD_FMT__X(intname, issigned, maxdigits, argcast)                      \
+// Works on the unsigned magnitude (utype) so that the most negative value does not overflow, and
+// always consumes the argument, even when it does not fit, so the arguments that follow stay in sync.
+// Signed values are sign extended into utype, so the top bit of u is the sign; v < 0 would always be
+// false for the unsigned types.
+#define VD_FMT__X(intname, issigned, maxdigits, argcast, utype)              \
     static VD_FMT__INT_CONVERSION_PROC_SIG(intname)                           \
     {                                                                         \
-        char wr[21];                                                          \
+        char wr[maxdigits];                                                   \
         const size_t length = maxdigits;                                      \
-        size_t next = length - 1;                                             \
-        if (n < next) return length;                                          \
+        size_t next = length;                                                 \
         intname v = (intname)va_arg(*a, argcast);                             \
+        utype u = (utype)v;                                                   \
         int sgn = 0;                                                          \
-        if (issigned && (v < 0)) {                                            \
+        if (issigned && (u >> (sizeof(utype) * 8 - 1))) {                     \
             sgn = 1;                                                          \
-            v = -v;                                                           \
+            u = (utype)0 - u;                                                 \
         }                                                                     \
-        while (v >= 100) {                                                    \
-            intname i = (v % 100) * 2;                                        \
-            v /= 100;                                                         \
-            wr[next] = VD_FMT__Digits_Lut[i + 1];                             \
-            wr[next - 1] = VD_FMT__Digits_Lut[i];                             \
-            next -= 2;                                                        \
+        while (u >= 100) {                                                    \
+            size_t i = (size_t)(u % 100) * 2;                                 \
+            u /= 100;                                                         \
+            wr[--next] = VD_FMT__Digits_Lut[i + 1];                           \
+            wr[--next] = VD_FMT__Digits_Lut[i];                               \
         }                                                                     \
-        if (v < 10) {                                                         \
-            wr[next] = '0' + v;                                               \
+        if (u < 10) {                                                         \
+            wr[--next] = (char)('0' + u);                                     \
         } else {                                                              \
-            intname i = v * 2;                                                \
-            wr[next--] = VD_FMT__Digits_Lut[i + 1];                           \
-            wr[next] = VD_FMT__Digits_Lut[i];                                 \
+            size_t i = (size_t)u * 2;                                         \
+            wr[--next] = VD_FMT__Digits_Lut[i + 1];                           \
+            wr[--next] = VD_FMT__Digits_Lut[i];                               \
         }                                                                     \
         if (sgn) {                                                            \
             wr[--next] = '-';                                                 \
@@ -208,16 +211,120 @@ VD_FMT__STRING_SLICE_PROCS
 #undef VD_FMT__X
 
 /* ----FLOATING POINT---------------------------------------------------------------------------- */
+// Prints like printf's "%f", without going through libc. Values under 2^64 split into an integer and
+// a fraction part, larger ones have no fraction and are expanded exactly with a small bignum.
+static size_t vd_fmt__double_to_str(char *out, size_t n, double f)
+{
+    uint64_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    int neg = (int)(bits >> 63);
+    int exponent = (int)((bits >> 52) & 0x7FF);
+    uint64_t mantissa = bits & ((1ull << 52) - 1);
+
+    char wr[320];
+    const size_t length = sizeof(wr);
+    size_t next = length;
+
+    if (exponent == 0x7FF) {
+        const char *s = mantissa ? "nan" : "inf";
+        next -= 3;
+        memcpy(wr + next, s, 3);
+    } else {
+        double af = neg ? -f : f;
+        uint64_t fp = 0;
+
+        if (af < 18446744073709551616.0) {
+            // Subtracting the integer part is exact. The scaled fraction is split into its rounded
+            // product and the exact error (Dekker), so it rounds to nearest even on the exact value.
+            uint64_t ip = (uint64_t)af;
+            double frac = af - (double)ip;
+            double prod = frac * 1000000.0;
+            double split = frac * 134217729.0;
+            double hi = split - (split - frac);
+            double lo = frac - hi;
+            double err = (hi * 1000000.0 - prod) + lo * 1000000.0;
+
+            fp = (uint64_t)prod;
+            double rem = prod - (double)fp;
+            if ((rem > 0.5) || ((rem == 0.5) && ((err > 0) || ((err == 0) && (fp & 1))))) {
+                fp++;
+            }
+
+            if (fp >= 1000000) {
+                ip++;
+                fp -= 1000000;
+            }
+
+            for (int d = 0; d < 3; ++d) {
+                size_t i = (size_t)(fp % 100) * 2;
+                fp /= 100;
+                wr[--next] = VD_FMT__Digits_Lut[i + 1];
+                wr[--next] = VD_FMT__Digits_Lut[i];
+            }
+
+            wr[--next] = '.';
+
+            do {
+                wr[--next] = (char)('0' + ip % 10);
+                ip /= 10;
+            } while (ip > 0);
+        } else {
+            // (2^52 + mantissa) << (exponent - 1075), as little endian 32 bit words
+            uint32_t words[34] = {0};
+            int shift = exponent - 1075;
+            uint64_t m = mantissa | (1ull << 52);
+            int word = shift / 32;
+            int bit = shift % 32;
+            words[word]     = (uint32_t)(m << bit);
+            words[word + 1] = (uint32_t)(m >> (32 - bit));
+            words[word + 2] = bit ? (uint32_t)(m >> (64 - bit)) : 0;
+            int count = word + 3;
+
+            next -= 7;
+            memcpy(wr + next, ".000000", 7);
+
+            while (count > 0) {
+                // Divide by 10^9, the remainder is the next 9 digits
+                uint64_t r = 0;
+                for (int i = count - 1; i >= 0; --i) {
+                    uint64_t cur = (r << 32) | words[i];
+                    words[i] = (uint32_t)(cur / 1000000000u);
+                    r = cur % 1000000000u;
+                }
+
+                while ((count > 0) && (words[count - 1] == 0)) {
+                    count--;
+                }
+
+                for (int d = 0; d < 9; ++d) {
+                    if ((count == 0) && (r == 0) && (d > 0)) break;
+                    wr[--next] = (char)('0' + r % 10);
+                    r /= 10;
+                }
+            }
+        }
+    }
+
+    if (neg) {
+        wr[--next] = '-';
+    }
+
+    if (n < (length - next)) return length - next;
+    memcpy(out, wr + next, length - next);
+    return length - next;
+}
+
+// Floats are promoted to double when passed through varargs
 static VD_FMT_PROC_FMT(vd_fmt__f32_to_str)
 {
-    float f = va_arg(*a, float);
-    return snprintf(out, n, "%f", f);
+    double f = va_arg(*a, double);
+    return vd_fmt__double_to_str(out, n, (double)(float)f);
 }
 
 static VD_FMT_PROC_FMT(vd_fmt__f64_to_str)
 {
     double f = va_arg(*a, double);
-    return snprintf(out, n, "%f", f);
+    return vd_fmt__double_to_str(out, n, f);
 }
 
 /* ----PATHS------------------------------------------------------------------------------------- */
@@ -280,6 +387,15 @@ static const VD_FmtTable _VD_Fmt_Def_Lut[] = {
     { VD_FMT_LIT("null"),    vd_fmt__null_to_str },
 };
 
+// Perfect hash of the default specifier names: (s[0] + s[1] + 2 * s[len - 1]) & 63 gives the
+// index + 1 into _VD_Fmt_Def_Lut, or 0 if no name hashes there. Must be kept in sync with the table.
+static const unsigned char VD_FMT__Def_Lut_Hash[64] = {
+     3,  0,  0,  0, 10,  0,  2,  4, 14,  0,  0, 11,  7,  0,  0, 12,
+     0,  1,  6,  8,  0,  0,  0,  0,  0,  0,  0,  0,  0,  5,  0,  0,
+     0,  0,  0,  0,  0,  0, 16,  0,  0, 18,  0,  0,  0, 20,  0, 19,
+    15,  0, 17,  0,  0, 21,  0,  0,  0,  0, 13, 22,  0,  9,  0,  0,
+};
+
 static struct {
     VD_FmtTable *lut;
     size_t       n;
@@ -294,69 +410,92 @@ void vd_fmt_set_lut(VD_FmtTable *lut, size_t n)
     _vd_g.n = n;
 }
 
+static VD_FmtProcFmt *vd_fmt__find_proc(const char *spec, size_t len)
+{
+    if (_vd_g.lut == (VD_FmtTable*)_VD_Fmt_Def_Lut) {
+        if (len < 2) return NULL;
+
+        const unsigned char *u = (const unsigned char*)spec;
+        unsigned int h = (u[0] + u[1] + 2u * u[len - 1]) & 63;
+        unsigned int i = VD_FMT__Def_Lut_Hash[h];
+        if (i == 0) return NULL;
+
+        const VD_FmtTable *entry = &_VD_Fmt_Def_Lut[i - 1];
+        if ((entry->s.len != len) || (memcmp(entry->s.dat, spec, len) != 0)) return NULL;
+        return entry->p;
+    }
+
+    for (size_t i = 0; i < _vd_g.n; ++i) {
+        if ((_vd_g.lut[i].s.len == len) &&
+            (memcmp(_vd_g.lut[i].s.dat, spec, len) == 0))
+        {
+            return _vd_g.lut[i].p;
+        }
+    }
+
+    return NULL;
+}
+
 size_t vd_fmt_vsnfmt(char *out, size_t n, const char *fmt, va_list args)
 {
+    // va_list may be an array type, in which case &args would not be a va_list*.
+    va_list ap;
+    va_copy(ap, args);
+
     const char *cf = fmt;
     size_t nwrite = 0;
-    cf = fmt;
-    while (*cf) {
-        if (*cf != '%') {
+    for (;;) {
+        // Copy the literal text up to the next '%' in one go
+        const char *pct = strchr(cf, '%');
+        size_t run = pct ? (size_t)(pct - cf) : strlen(cf);
+        if (nwrite < n) {
+            size_t available = n - nwrite;
+            memcpy(out + nwrite, cf, run < available ? run : available);
+        }
+        nwrite += run;
+        cf += run;
+
+        if (!pct) {
+            break;
+        }
+
+        if (*(cf + 1) != '{') {
             if (nwrite < n) {
                 out[nwrite] = *cf;
             }
-
-            cf++;
             nwrite++;
+            cf++;
             continue;
         }
 
-        if (*(cf + 1) == '{') {
-            const char *beg = cf + 2;
-            const char *end = cf + 2;
-            while (*end && *end != '}') {
-                end++;
-            }
-
-            if (*end != '}') {
-                return 0;
-            }
-
-            ptrdiff_t cl = end - beg;
-            size_t i = 0;
-            int found = 0;
-            while (i < _vd_g.n) {
-                if ((_vd_g.lut[i].s.len == cl) &&
-                    (strncmp(_vd_g.lut[i].s.dat, beg, cl) == 0)) 
-                {
-                    size_t available = n;
-                    if (n < nwrite) {
-                        available = 0;
-                    } else {
-                        available = n - nwrite;
-                    }
-
-                    nwrite += _vd_g.lut[i].p(out + nwrite, available, &args);
-                    found = 1;
-                    break;
-                }
+        const char *beg = cf + 2;
+        const char *end = cf + 2;
+        while (*end && *end != '}') {
+            end++;
+        }
 
-                i++;
-            }
+        if (*end != '}') {
+            va_end(ap);
+            return 0;
+        }
 
-            if (!found) {
-                return 0;
-            }
+        VD_FmtProcFmt *proc = vd_fmt__find_proc(beg, (size_t)(end - beg));
+        if (!proc) {
+            va_end(ap);
+            return 0;
+        }
 
-            cf = end + 1;
+        // Past the end of the buffer the procs only measure, so don't form a pointer out there
+        if (nwrite < n) {
+            nwrite += proc(out + nwrite, n - nwrite, &ap);
         } else {
-            if (nwrite < n) {
-                out[nwrite] = *cf;
-            }
-            nwrite++;
-            cf++;
+            nwrite += proc(out, 0, &ap);
         }
+
+        cf = end + 1;
     }
 
+    va_end(ap);
     return nwrite;
 }
 
@@ -2,6 +2,19 @@
 // 
 // REQUIREMENTS
 // - vd_fmt.h
+// - vd_atomic.h
+// - vd_sysutil.h (VD_LOG_MT)
+//
+// BACKENDS
+// - Without vd_log_init every line opens, appends to and closes the log file.
+// - vd_log_init keeps the log file open and writes every line with a single write call.
+// - vd_log_init with VD_LOG_MT formats every line into a ring buffer of the calling thread, and a
+//   writer thread batches the rings into the file. Lines that do not fit are dropped and counted,
+//   see vd_log_get_dropped. With VD_LOG_FLUSH_ON_CRASH, crash signals write out what is buffered.
+// - VD_LOG_BINARY (implies VD_LOG_MT) skips formatting on the calling thread. Each VD_LOG_* call site
+//   registers its format string once, and every line only copies the site ID and the raw arguments
+//   into the ring. The file holds the format strings and the records, and vd_log_decode (or
+//   "vdcli decode-log") turns it back into text. Stdout still gets text, formatted by the writer.
 // 
 // -------------------------------------------------------------------------------------------------
 // MIT License
@@ -35,17 +48,50 @@
 #include "vd_fmt.h"
 
 #include <stdio.h>
+#include <stdint.h>
 #include <assert.h>
 
 typedef enum {
-	VD_LOG_WRITE_STDOUT = 1 << 0,
-	VD_LOG_MT           = 1 << 1,
-    VD_LOG_WRITE_FILE   = 1 << 2,
+	VD_LOG_WRITE_STDOUT    = 1 << 0,
+	VD_LOG_MT              = 1 << 1,
+    VD_LOG_WRITE_FILE      = 1 << 2,
+    VD_LOG_FLUSH_ON_CRASH  = 1 << 3,
+    VD_LOG_BINARY          = 1 << 4,
 } VD_LogFlags;
 
+/** The most arguments a call site can have, and still be written as binary. */
+#ifndef VD_LOG_MAX_SITE_ARGS
+#define VD_LOG_MAX_SITE_ARGS 16
+#endif
+
+/** A call site of the VD_LOG_* macros, @see VD_LOG_1. */
+typedef struct {
+    const char          *fmt;
+
+    /** 0 until the first line is logged from the site. */
+    volatile uint32_t   id;
+    uint32_t            op_count;
+    uint8_t             ops[VD_LOG_MAX_SITE_ARGS];
+} VD_LogSite;
+
+typedef struct VD_Log__Backend VD_Log__Backend;
+
 typedef struct {
 	const char	*filepath;
 	VD_LogFlags flags;
+
+    /** VD_LOG_MT: The size of each ring buffer, rounded up to a power of two. 0 for the default. */
+    unsigned int    ring_size;
+
+    /**
+     * VD_LOG_MT: The number of ring buffers. Each thread claims its own ring the first time it logs,
+     * and once all but the last are taken the remaining threads share the last one behind a lock.
+     * 0 for the default.
+     */
+    unsigned int    ring_count;
+
+    /** Set by vd_log_init. */
+    VD_Log__Backend *backend;
 } VD_Log;
 
 extern VD_Log *VD__Log;
@@ -58,6 +104,66 @@ extern VD_Log *VD__Log;
 #define VD_LOG_ENABLE_WRN 1
 #endif
 
+#ifndef VD_LOG_DEFAULT_RING_SIZE
+#define VD_LOG_DEFAULT_RING_SIZE (64 * 1024)
+#endif
+
+#ifndef VD_LOG_DEFAULT_RING_COUNT
+#define VD_LOG_DEFAULT_RING_COUNT 16
+#endif
+
+/** The longest line that can be written. Longer lines are dropped. */
+#ifndef VD_LOG_MAX_LINE
+#define VD_LOG_MAX_LINE 4096
+#endif
+
+/**
+ * @brief Start the backend that log->flags asks for. Log lines are written as they were before,
+ * until this is called.
+ * @return 0 on success, < 0 if the file could not be opened or the writer thread not started
+ */
+int vd_log_init(VD_Log *log);
+
+/**
+ * @brief Write a formatted line, @see vd_fmt_vsnfmt. Use the VD_LOG_* macros instead.
+ */
+void vd_log_write(VD_Log *log, const char *fmt, ...);
+
+/**
+ * @brief Write a line of a call site. Binary logs write the raw arguments, others format them with
+ * site->fmt.
+ */
+void vd_log_write_site(VD_Log *log, VD_LogSite *site, ...);
+
+/**
+ * @brief Block until every line that was logged before the call is written.
+ */
+void vd_log_flush(VD_Log *log);
+
+/**
+ * @brief The number of lines that were dropped because their ring was full.
+ */
+uint64_t vd_log_get_dropped(VD_Log *log);
+
+/**
+ * @brief Flush and stop the backend, and close the log file.
+ */
+void vd_log_deinit(VD_Log *log);
+
+#define VD_LOG_DECODE_PROC(name) void name(const char *text, size_t len, void *c)
+typedef VD_LOG_DECODE_PROC(VD_LogDecodeProc);
+
+/**
+ * @brief Turn the contents of a VD_LOG_BINARY log file back into text.
+ * @param data  The contents of the file
+ * @param len   The length of the contents
+ * @param proc  Called with the text of every line
+ * @param c     Passed to proc
+ * @return 0 on success, < 0 if the data is truncated or malformed. Everything before the error was
+ * passed to proc.
+ */
+int vd_log_decode(const void *data, size_t len, VD_LogDecodeProc *proc, void *c);
+
 #define VD_LOG_GET()  (VD__Log)
 #define VD_LOG_SET(x) (VD__Log = (x))
 #define VD_LOG_RESET() \
@@ -70,22 +176,12 @@ extern VD_Log *VD__Log;
         }                                                   \
 	} while (0)
 
-#define VD_LOG_1(fmt, ...)                                  \
-	do                                                      \
-	{                                                       \
-        if (VD_LOG_GET()->flags & VD_LOG_WRITE_FILE)        \
-        {                                                   \
-            FILE *f = fopen(VD_LOG_GET()->filepath, "a");   \
-            assert(f != 0);                                 \
-            vd_fmt_fprintf(f, fmt, __VA_ARGS__);            \
-            fflush(f);                                      \
-            fclose(f);  								    \
-        }                                                   \
-		if (VD_LOG_GET()->flags & VD_LOG_WRITE_STDOUT)      \
-		{                                                   \
-			vd_fmt_fprintf(stdout, fmt, __VA_ARGS__);       \
-		}                                                   \
-	} while (0)
+#define VD_LOG_1(site_fmt, ...)                                     \
+    do                                                              \
+    {                                                               \
+        static VD_LogSite vd__log_site_ = { .fmt = site_fmt, .id = 0 }; \
+        vd_log_write_site(VD_LOG_GET(), &vd__log_site_, __VA_ARGS__); \
+    } while (0)
 
 #define VD_LOG_FMT(category, fmt, ...) VD_LOG_1("[" category "/LOG]: " fmt "\n", __VA_ARGS__)
 #define VD_LOG(category, message) VD_LOG_FMT(category, "%{cstr}", message)
@@ -113,7 +209,1142 @@ extern VD_Log *VD__Log;
 
 
 #ifdef VD_LOG_IMPLEMENTATION
+#include "vd_atomic.h"
+#include "vd_sysutil.h"
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#define VD_LOG__STDOUT_FD 1
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#define VD_LOG__STDOUT_FD STDOUT_FILENO
+#endif
 
 VD_Log *VD__Log;
 
+#define VD_LOG__BATCH_SIZE (64 * 1024)
+
+/* ----BINARY FORMAT----------------------------------------------------------------------------- */
+// A binary log is a header followed by records. Every record starts with a VD_Log__RecordHeader.
+// - id & VD_LOG__RECORD_DEFINE: Defines the format string of site (id & ~VD_LOG__RECORD_DEFINE),
+//   which is the payload. Definitions always come before the first line of their site.
+// - id == 0: A line that was formatted when it was logged. The payload is the text.
+// - Otherwise: A line of site id. The payload is the arguments, in the order of the format string,
+//   written as described by VD_Log__Op.
+// Another header can follow a record, when a new session appends to the file. It resets the sites.
+#define VD_LOG__BINARY_MAGIC "VDLOGBIN"
+#define VD_LOG__BINARY_VERSION 1
+#define VD_LOG__RECORD_DEFINE 0x80000000u
+
+/** The most sites that can be written as binary. Lines of later sites are formatted right away. */
+#define VD_LOG__MAX_SITES 4096
+
+/** The ID of sites that could not be parsed, and are always formatted right away. */
+#define VD_LOG__SITE_TEXT 0xFFFFFFFFu
+
+/** The layout of the string slices that %{stru32}, %{pathu32} and %{stru64} take. */
+struct VD_Log__StrU32 { const char *data; uint32_t len; };
+struct VD_Log__StrU64 { const char *data; uint64_t len; };
+
+typedef struct {
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    reserved;
+} VD_Log__BinaryHeader;
+
+typedef struct {
+    uint32_t    id;
+    uint32_t    len;
+} VD_Log__RecordHeader;
+
+typedef enum {
+    /** int32_t, for i8, i16 and i32 */
+    VD_LOG__OP_I32 = 1,
+    /** uint32_t, for u8, u16 and u32 */
+    VD_LOG__OP_U32,
+    VD_LOG__OP_I64,
+    VD_LOG__OP_U64,
+    /** double, for f32 and f64 */
+    VD_LOG__OP_F64,
+    /** The ops below are written as a uint32_t length followed by the characters */
+    VD_LOG__OP_CSTR,
+    VD_LOG__OP_STRU32,
+    VD_LOG__OP_STRU64,
+    VD_LOG__OP_PATHU32,
+    /** Not written */
+    VD_LOG__OP_NULL,
+} VD_Log__Op;
+
+static const struct {
+    const char  *name;
+    VD_Log__Op  op;
+} VD_Log__Op_Names[] = {
+    { "i8",      VD_LOG__OP_I32     },
+    { "i16",     VD_LOG__OP_I32     },
+    { "i32",     VD_LOG__OP_I32     },
+    { "u8",      VD_LOG__OP_U32     },
+    { "u16",     VD_LOG__OP_U32     },
+    { "u32",     VD_LOG__OP_U32     },
+    { "i64",     VD_LOG__OP_I64     },
+    { "u64",     VD_LOG__OP_U64     },
+    { "f32",     VD_LOG__OP_F64     },
+    { "f64",     VD_LOG__OP_F64     },
+    { "cstr",    VD_LOG__OP_CSTR    },
+    { "stru32",  VD_LOG__OP_STRU32  },
+    { "stru64",  VD_LOG__OP_STRU64  },
+    { "pathu32", VD_LOG__OP_PATHU32 },
+    { "null",    VD_LOG__OP_NULL    },
+};
+
+/** Format strings by site ID. Filled in once per site, and never changed after. */
+static const char *VD_Log__Site_Formats[VD_LOG__MAX_SITES];
+static uint32_t VD_Log__Site_Count;
+static volatile int32_t VD_Log__Site_Lock;
+
+typedef struct {
+    /** Written by the thread(s) that log. */
+    volatile uint64_t   head;
+    char                pad0[56];
+
+    /** Written by the writer thread. */
+    volatile uint64_t   tail;
+    char                pad1[56];
+
+    /** Only taken on the shared ring. */
+    volatile int32_t    lock;
+    char                *data;
+} VD_Log__Ring;
+
+struct VD_Log__Backend {
+    int                 fd;
+    VD_LogFlags         flags;
+    uint32_t            id;
+
+    VD_Log__Ring        *rings;
+    uint32_t            ring_count;
+    uint32_t            ring_size;
+    volatile int32_t    next_ring;
+    volatile int64_t    dropped;
+
+    VD_SysUtilThread    writer;
+    volatile int32_t    running;
+    volatile int32_t    drain_lock;
+    volatile int64_t    flush_requested;
+    volatile int64_t    flush_completed;
+
+    /** The writer copies rings here so that it writes everything with as few calls as possible. */
+    char                *batch;
+    uint32_t            batch_size;
+
+    /** VD_LOG_BINARY: The sites that were defined in the file. Only touched by the writer. */
+    uint32_t            defined_sites;
+
+    /** VD_LOG_BINARY: The text that goes to stdout. */
+    char                *text_batch;
+    uint32_t            text_batched;
+};
+
+typedef struct {
+    uint32_t        backend_id;
+    VD_Log__Ring    *ring;
+} VD_Log__ThreadRing;
+
+static _Thread_local VD_Log__ThreadRing VD_Log__Thread_Ring;
+static volatile int32_t VD_Log__Next_Backend_ID;
+static VD_Log__Backend *volatile VD_Log__Crash_Backend;
+
+static int vd_log__open(const char *filepath)
+{
+#if defined(_WIN32)
+    return _open(filepath, _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    return open(filepath, O_WRONLY | O_CREAT | O_APPEND, 0644);
+#endif
+}
+
+static void vd_log__close(int fd)
+{
+#if defined(_WIN32)
+    _close(fd);
+#else
+    close(fd);
+#endif
+}
+
+static void vd_log__write_fd(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+#if defined(_WIN32)
+        int written = _write(fd, data, (unsigned int)len);
+#else
+        ssize_t written = write(fd, data, len);
+#endif
+        if (written <= 0) {
+            return;
+        }
+
+        data += written;
+        len -= (size_t)written;
+    }
+}
+
+static void vd_log__sleep_ms(unsigned int ms)
+{
+#if defined(_WIN32)
+    Sleep(ms);
+#else
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, 0);
+#endif
+}
+
+static void vd_log__output(VD_Log__Backend *backend, const char *data, size_t len)
+{
+    if (backend->fd >= 0) {
+        vd_log__write_fd(backend->fd, data, len);
+    }
+
+    if (backend->flags & VD_LOG_WRITE_STDOUT) {
+        vd_log__write_fd(VD_LOG__STDOUT_FD, data, len);
+    }
+}
+
+static void vd_log__lock(volatile int32_t *lock)
+{
+    while (vd_atomic_compare_and_swap32(lock, 1, 0) != 0);
+}
+
+static void vd_log__unlock(volatile int32_t *lock)
+{
+    vd_atomic_fence();
+    *lock = 0;
+}
+
+/**
+ * @brief Write out everything that is in the rings.
+ * @return The number of bytes written.
+ */
+static size_t vd_log__drain_text(VD_Log__Backend *backend)
+{
+    uint64_t mask = backend->ring_size - 1;
+    size_t total = 0;
+    size_t batched = 0;
+
+    for (uint32_t i = 0; i < backend->ring_count; ++i) {
+        VD_Log__Ring *ring = &backend->rings[i];
+        uint64_t tail = ring->tail;
+        uint64_t head = ring->head;
+        vd_atomic_fence();
+
+        while (tail != head) {
+            uint64_t offset = tail & mask;
+            uint64_t n = head - tail;
+            if (n > backend->ring_size - offset) {
+                n = backend->ring_size - offset;
+            }
+
+            if (n > backend->batch_size - batched) {
+                n = backend->batch_size - batched;
+            }
+
+            memcpy(backend->batch + batched, ring->data + offset, (size_t)n);
+            batched += (size_t)n;
+            tail += n;
+
+            if (batched == backend->batch_size) {
+                vd_log__output(backend, backend->batch, batched);
+                total += batched;
+                batched = 0;
+            }
+        }
+
+        vd_atomic_fence();
+        ring->tail = tail;
+    }
+
+    if (batched > 0) {
+        vd_log__output(backend, backend->batch, batched);
+        total += batched;
+    }
+
+    return total;
+}
+
+/** Copy out of a ring, wrapping around its end. */
+static void vd_log__ring_read(VD_Log__Backend *backend, VD_Log__Ring *ring, uint64_t pos, void *dst, size_t len)
+{
+    size_t offset = (size_t)(pos & (backend->ring_size - 1));
+    size_t first = backend->ring_size - offset;
+    if (first > len) {
+        first = len;
+    }
+
+    memcpy(dst, ring->data + offset, first);
+    memcpy((char*)dst + first, ring->data, len - first);
+}
+
+/** Copy into a ring, wrapping around its end. */
+static void vd_log__ring_write(VD_Log__Backend *backend, VD_Log__Ring *ring, uint64_t pos, const void *src, size_t len)
+{
+    size_t offset = (size_t)(pos & (backend->ring_size - 1));
+    size_t first = backend->ring_size - offset;
+    if (first > len) {
+        first = len;
+    }
+
+    memcpy(ring->data + offset, src, first);
+    memcpy(ring->data, (const char*)src + first, len - first);
+}
+
+static VD_Log__Op vd_log__get_op(const char *name, size_t len)
+{
+    for (size_t i = 0; i < sizeof(VD_Log__Op_Names) / sizeof(VD_Log__Op_Names[0]); ++i) {
+        if (strlen(VD_Log__Op_Names[i].name) == len && memcmp(VD_Log__Op_Names[i].name, name, len) == 0) {
+            return VD_Log__Op_Names[i].op;
+        }
+    }
+
+    return (VD_Log__Op)0;
+}
+
+/**
+ * @brief Format the payload of a binary record with its format string.
+ * @return The length of the text, at most n. 0 if the payload does not match the format.
+ */
+static size_t vd_log__format_record(
+    const char *fmt,
+    size_t fmt_len,
+    const char *payload,
+    size_t payload_len,
+    char *out,
+    size_t n)
+{
+    const char *payload_end = payload + payload_len;
+    const char *fmt_end = fmt + fmt_len;
+    size_t w = 0;
+
+    while (fmt < fmt_end && w < n) {
+        if (fmt[0] != '%' || fmt + 1 >= fmt_end || fmt[1] != '{') {
+            out[w++] = *fmt++;
+            continue;
+        }
+
+        const char *name = fmt + 2;
+        const char *name_end = name;
+        while (name_end < fmt_end && *name_end != '}') {
+            name_end++;
+        }
+
+        if (name_end == fmt_end) {
+            return 0;
+        }
+
+        fmt = name_end + 1;
+
+        VD_Log__Op op = vd_log__get_op(name, (size_t)(name_end - name));
+        size_t arg_size = op == VD_LOG__OP_NULL ? 0 : op < VD_LOG__OP_I64 ? 4 : op < VD_LOG__OP_CSTR ? 8 : 4;
+        if (op == 0 || (size_t)(payload_end - payload) < arg_size) {
+            return 0;
+        }
+
+        char number[64];
+        const char *text = number;
+        size_t text_len = 0;
+
+        switch (op) {
+            case VD_LOG__OP_I32: {
+                int32_t v;
+                memcpy(&v, payload, 4);
+                text_len = vd_fmt_snfmt(number, sizeof(number), "%{i32}", v);
+            } break;
+
+            case VD_LOG__OP_U32: {
+                uint32_t v;
+                memcpy(&v, payload, 4);
+                text_len = vd_fmt_snfmt(number, sizeof(number), "%{u32}", v);
+            } break;
+
+            case VD_LOG__OP_I64: {
+                int64_t v;
+                memcpy(&v, payload, 8);
+                text_len = vd_fmt_snfmt(number, sizeof(number), "%{i64}", v);
+            } break;
+
+            case VD_LOG__OP_U64: {
+                uint64_t v;
+                memcpy(&v, payload, 8);
+                text_len = vd_fmt_snfmt(number, sizeof(number), "%{u64}", v);
+            } break;
+
+            case VD_LOG__OP_F64: {
+                double v;
+                memcpy(&v, payload, 8);
+                int len = snprintf(number, sizeof(number), "%f", v);
+                text_len = len < 0 ? 0 : (size_t)len;
+            } break;
+
+            case VD_LOG__OP_CSTR:
+            case VD_LOG__OP_STRU32:
+            case VD_LOG__OP_STRU64:
+            case VD_LOG__OP_PATHU32: {
+                uint32_t len;
+                memcpy(&len, payload, 4);
+                if ((size_t)(payload_end - payload - 4) < len) {
+                    return 0;
+                }
+
+                text = payload + 4;
+                text_len = len;
+                arg_size += len;
+            } break;
+
+            case VD_LOG__OP_NULL: {
+                number[0] = 0;
+                text_len = 1;
+            } break;
+        }
+
+        payload += arg_size;
+
+        if (text_len > sizeof(number) && text == number) {
+            text_len = 0;
+        }
+
+        if (text_len > n - w) {
+            text_len = n - w;
+        }
+
+        for (size_t i = 0; i < text_len; ++i) {
+            out[w + i] = (op == VD_LOG__OP_PATHU32 && text[i] == '\\') ? '/' : text[i];
+        }
+
+        w += text_len;
+    }
+
+    return w;
+}
+
+static void vd_log__flush_batch(VD_Log__Backend *backend, size_t *batched)
+{
+    if (*batched > 0 && backend->fd >= 0) {
+        vd_log__write_fd(backend->fd, backend->batch, *batched);
+    }
+
+    *batched = 0;
+}
+
+static void vd_log__flush_text_batch(VD_Log__Backend *backend)
+{
+    if (backend->text_batched > 0) {
+        vd_log__write_fd(VD_LOG__STDOUT_FD, backend->text_batch, backend->text_batched);
+    }
+
+    backend->text_batched = 0;
+}
+
+/** Append the definitions of every site up to and including id to the batch. */
+static void vd_log__define_sites(VD_Log__Backend *backend, uint32_t id, size_t *batched)
+{
+    while (backend->defined_sites < id) {
+        uint32_t site = ++backend->defined_sites;
+        const char *fmt = VD_Log__Site_Formats[site];
+        size_t fmt_len = strlen(fmt);
+
+        if (*batched + sizeof(VD_Log__RecordHeader) + fmt_len > backend->batch_size) {
+            vd_log__flush_batch(backend, batched);
+        }
+
+        VD_Log__RecordHeader header = { site | VD_LOG__RECORD_DEFINE, (uint32_t)fmt_len };
+        if (sizeof(header) + fmt_len > backend->batch_size) {
+            // Too long to batch, which should never happen for a format string
+            vd_log__write_fd(backend->fd, (const char*)&header, sizeof(header));
+            vd_log__write_fd(backend->fd, fmt, fmt_len);
+            continue;
+        }
+
+        memcpy(backend->batch + *batched, &header, sizeof(header));
+        memcpy(backend->batch + *batched + sizeof(header), fmt, fmt_len);
+        *batched += sizeof(header) + fmt_len;
+    }
+}
+
+/**
+ * @brief Write out every record that is in the rings, and the definitions of sites that the file
+ * does not have yet.
+ * @return The number of bytes read from the rings.
+ */
+static size_t vd_log__drain_binary(VD_Log__Backend *backend)
+{
+    size_t total = 0;
+    size_t batched = 0;
+
+    for (uint32_t i = 0; i < backend->ring_count; ++i) {
+        VD_Log__Ring *ring = &backend->rings[i];
+        uint64_t tail = ring->tail;
+        uint64_t head = ring->head;
+        vd_atomic_fence();
+
+        while (tail != head) {
+            VD_Log__RecordHeader header;
+            vd_log__ring_read(backend, ring, tail, &header, sizeof(header));
+            size_t record_len = sizeof(header) + header.len;
+
+            if (header.id != 0 && header.id > backend->defined_sites) {
+                vd_log__define_sites(backend, header.id, &batched);
+            }
+
+            if (batched + record_len > backend->batch_size) {
+                vd_log__flush_batch(backend, &batched);
+            }
+
+            char *record = backend->batch + batched;
+            vd_log__ring_read(backend, ring, tail, record, record_len);
+            batched += record_len;
+            tail += record_len;
+            total += record_len;
+
+            if (backend->flags & VD_LOG_WRITE_STDOUT) {
+                if (backend->text_batched + VD_LOG_MAX_LINE > backend->batch_size) {
+                    vd_log__flush_text_batch(backend);
+                }
+
+                char *text = backend->text_batch + backend->text_batched;
+                const char *payload = record + sizeof(header);
+                if (header.id == 0) {
+                    memcpy(text, payload, header.len);
+                    backend->text_batched += header.len;
+                } else {
+                    const char *fmt = VD_Log__Site_Formats[header.id];
+                    backend->text_batched += (uint32_t)vd_log__format_record(
+                        fmt, strlen(fmt), payload, header.len, text, VD_LOG_MAX_LINE);
+                }
+            }
+        }
+
+        vd_atomic_fence();
+        ring->tail = tail;
+    }
+
+    vd_log__flush_batch(backend, &batched);
+    vd_log__flush_text_batch(backend);
+    return total;
+}
+
+static size_t vd_log__drain(VD_Log__Backend *backend)
+{
+    return (backend->flags & VD_LOG_BINARY) ? vd_log__drain_binary(backend) : vd_log__drain_text(backend);
+}
+
+static int vd_log__writer_proc(void *arg)
+{
+    VD_Log__Backend *backend = (VD_Log__Backend*)arg;
+    unsigned int idle_ms = 1;
+
+    for (;;) {
+        int32_t running = backend->running;
+        int64_t flush_requested = backend->flush_requested;
+        vd_atomic_fence();
+
+        vd_log__lock(&backend->drain_lock);
+        size_t written = vd_log__drain(backend);
+        vd_log__unlock(&backend->drain_lock);
+
+        // Everything that was logged before flush_requested was read is out now
+        backend->flush_completed = flush_requested;
+
+        if (written > 0) {
+            idle_ms = 1;
+            continue;
+        }
+
+        if (!running) {
+            break;
+        }
+
+        vd_log__sleep_ms(idle_ms);
+        if (idle_ms < 8) {
+            idle_ms *= 2;
+        }
+    }
+
+    return 0;
+}
+
+static void vd_log__crash_handler(int sig)
+{
+    VD_Log__Backend *backend = VD_Log__Crash_Backend;
+    if (backend) {
+        // The writer might be the one that crashed, so don't wait on it forever
+        int locked = 0;
+        for (int i = 0; i < (1 << 20) && !locked; ++i) {
+            locked = vd_atomic_compare_and_swap32(&backend->drain_lock, 1, 0) == 0;
+        }
+
+        vd_log__drain(backend);
+    }
+
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+static void vd_log__install_crash_handlers(void)
+{
+    signal(SIGSEGV, vd_log__crash_handler);
+    signal(SIGABRT, vd_log__crash_handler);
+    signal(SIGFPE, vd_log__crash_handler);
+    signal(SIGILL, vd_log__crash_handler);
+#ifdef SIGBUS
+    signal(SIGBUS, vd_log__crash_handler);
+#endif
+}
+
+static VD_Log__Ring *vd_log__get_thread_ring(VD_Log__Backend *backend)
+{
+    VD_Log__ThreadRing *thread_ring = &VD_Log__Thread_Ring;
+    if (thread_ring->backend_id == backend->id) {
+        return thread_ring->ring;
+    }
+
+    uint32_t index = (uint32_t)(vd_atomic_inc_and_fetch32(&backend->next_ring) - 1);
+    if (index >= backend->ring_count - 1) {
+        index = backend->ring_count - 1;
+    }
+
+    thread_ring->backend_id = backend->id;
+    thread_ring->ring = &backend->rings[index];
+    return thread_ring->ring;
+}
+
+static void vd_log__push(VD_Log__Backend *backend, const char *fmt, va_list args)
+{
+    VD_Log__Ring *ring = vd_log__get_thread_ring(backend);
+    int shared = ring == &backend->rings[backend->ring_count - 1];
+    if (shared) {
+        vd_log__lock(&ring->lock);
+    }
+
+    uint64_t size = backend->ring_size;
+    uint64_t head = ring->head;
+    uint64_t tail = ring->tail;
+    vd_atomic_fence();
+
+    uint64_t available = size - (head - tail);
+    uint64_t offset = head & (size - 1);
+    uint64_t contiguous = size - offset;
+    if (contiguous > available) {
+        contiguous = available;
+    }
+
+    // Format straight into the ring. Whatever doesn't fit only touches space that is not in use.
+    size_t len = vd_fmt_vsnfmt(ring->data + offset, (size_t)contiguous, fmt, args);
+
+    if (len > contiguous) {
+        // The length that a short buffer reports is only an upper bound, so format the line in full
+        // before deciding whether it fits around the end of the ring.
+        char line[VD_LOG_MAX_LINE];
+        len = vd_fmt_vsnfmt(line, sizeof(line), fmt, args);
+
+        if (len > available || len > sizeof(line)) {
+            vd_atomic_fetch_and_add64(&backend->dropped, 1);
+            len = 0;
+        } else if (len > contiguous) {
+            memcpy(ring->data + offset, line, (size_t)contiguous);
+            memcpy(ring->data, line + contiguous, len - (size_t)contiguous);
+        } else {
+            memcpy(ring->data + offset, line, len);
+        }
+    }
+
+    vd_atomic_fence();
+    ring->head = head + len;
+
+    if (shared) {
+        vd_log__unlock(&ring->lock);
+    }
+}
+
+/** Copy a record into the ring of the calling thread, or drop it. */
+static void vd_log__push_record(VD_Log__Backend *backend, const void *record, size_t len)
+{
+    VD_Log__Ring *ring = vd_log__get_thread_ring(backend);
+    int shared = ring == &backend->rings[backend->ring_count - 1];
+    if (shared) {
+        vd_log__lock(&ring->lock);
+    }
+
+    uint64_t head = ring->head;
+    uint64_t tail = ring->tail;
+    vd_atomic_fence();
+
+    if (len > backend->ring_size - (head - tail)) {
+        vd_atomic_fetch_and_add64(&backend->dropped, 1);
+    } else {
+        vd_log__ring_write(backend, ring, head, record, len);
+        vd_atomic_fence();
+        ring->head = head + len;
+    }
+
+    if (shared) {
+        vd_log__unlock(&ring->lock);
+    }
+}
+
+static void vd_log__push_text_record(VD_Log__Backend *backend, const char *fmt, va_list args)
+{
+    char record[sizeof(VD_Log__RecordHeader) + VD_LOG_MAX_LINE];
+    size_t len = vd_fmt_vsnfmt(record + sizeof(VD_Log__RecordHeader), VD_LOG_MAX_LINE, fmt, args);
+    if (len > VD_LOG_MAX_LINE) {
+        vd_atomic_fetch_and_add64(&backend->dropped, 1);
+        return;
+    }
+
+    VD_Log__RecordHeader header = { 0, (uint32_t)len };
+    memcpy(record, &header, sizeof(header));
+    vd_log__push_record(backend, record, sizeof(header) + len);
+}
+
+/**
+ * @brief Give a site its ID, the first time that it is used.
+ * @return The ID, or VD_LOG__SITE_TEXT if the site must be formatted right away.
+ */
+static uint32_t vd_log__register_site(VD_LogSite *site)
+{
+    vd_log__lock(&VD_Log__Site_Lock);
+
+    if (site->id == 0) {
+        int ok = 1;
+        uint32_t op_count = 0;
+        const char *c = site->fmt;
+
+        while (*c && ok) {
+            if (c[0] != '%' || c[1] != '{') {
+                c++;
+                continue;
+            }
+
+            const char *name = c + 2;
+            const char *name_end = name;
+            while (*name_end && *name_end != '}') {
+                name_end++;
+            }
+
+            VD_Log__Op op = *name_end ? vd_log__get_op(name, (size_t)(name_end - name)) : (VD_Log__Op)0;
+            if (op == 0 || op_count == VD_LOG_MAX_SITE_ARGS) {
+                ok = 0;
+                break;
+            }
+
+            site->ops[op_count++] = (uint8_t)op;
+            c = name_end + 1;
+        }
+
+        uint32_t id = VD_LOG__SITE_TEXT;
+        if (ok && VD_Log__Site_Count + 1 < VD_LOG__MAX_SITES) {
+            id = ++VD_Log__Site_Count;
+            VD_Log__Site_Formats[id] = site->fmt;
+        }
+
+        site->op_count = op_count;
+        vd_atomic_fence();
+        site->id = id;
+    }
+
+    vd_log__unlock(&VD_Log__Site_Lock);
+    return site->id;
+}
+
+static void vd_log__push_binary(VD_Log__Backend *backend, VD_LogSite *site, va_list args)
+{
+    char record[sizeof(VD_Log__RecordHeader) + VD_LOG_MAX_LINE];
+    size_t len = sizeof(VD_Log__RecordHeader);
+
+    for (uint32_t i = 0; i < site->op_count; ++i) {
+        // Every op takes at most 8 bytes, plus the characters of strings
+        if (len + 8 > sizeof(record)) {
+            vd_atomic_fetch_and_add64(&backend->dropped, 1);
+            return;
+        }
+
+        const char *str_data = 0;
+        size_t str_len = 0;
+
+        switch ((VD_Log__Op)site->ops[i]) {
+            case VD_LOG__OP_I32: {
+                int32_t v = va_arg(args, int32_t);
+                memcpy(record + len, &v, 4);
+                len += 4;
+            } continue;
+
+            case VD_LOG__OP_U32: {
+                uint32_t v = va_arg(args, uint32_t);
+                memcpy(record + len, &v, 4);
+                len += 4;
+            } continue;
+
+            case VD_LOG__OP_I64: {
+                int64_t v = va_arg(args, int64_t);
+                memcpy(record + len, &v, 8);
+                len += 8;
+            } continue;
+
+            case VD_LOG__OP_U64: {
+                uint64_t v = va_arg(args, uint64_t);
+                memcpy(record + len, &v, 8);
+                len += 8;
+            } continue;
+
+            case VD_LOG__OP_F64: {
+                // f32 arguments are promoted to double
+                double v = va_arg(args, double);
+                memcpy(record + len, &v, 8);
+                len += 8;
+            } continue;
+
+            case VD_LOG__OP_CSTR: {
+                str_data = va_arg(args, const char*);
+                str_len = strlen(str_data);
+            } break;
+
+            case VD_LOG__OP_STRU32:
+            case VD_LOG__OP_PATHU32: {
+                struct VD_Log__StrU32 v = va_arg(args, struct VD_Log__StrU32);
+                str_data = v.data;
+                str_len = v.len;
+            } break;
+
+            case VD_LOG__OP_STRU64: {
+                struct VD_Log__StrU64 v = va_arg(args, struct VD_Log__StrU64);
+                str_data = v.data;
+                str_len = (size_t)v.len;
+            } break;
+
+            case VD_LOG__OP_NULL: continue;
+        }
+
+        if (str_len > sizeof(record) - len - 4) {
+            vd_atomic_fetch_and_add64(&backend->dropped, 1);
+            return;
+        }
+
+        uint32_t str_len32 = (uint32_t)str_len;
+        memcpy(record + len, &str_len32, 4);
+        memcpy(record + len + 4, str_data, str_len);
+        len += 4 + str_len;
+    }
+
+    VD_Log__RecordHeader header = { site->id, (uint32_t)(len - sizeof(header)) };
+    memcpy(record, &header, sizeof(header));
+    vd_log__push_record(backend, record, len);
+}
+
+int vd_log_init(VD_Log *log)
+{
+    VD_Log__Backend *backend = (VD_Log__Backend*)calloc(1, sizeof(VD_Log__Backend));
+    backend->flags = log->flags;
+    backend->fd = -1;
+    backend->id = (uint32_t)vd_atomic_inc_and_fetch32(&VD_Log__Next_Backend_ID);
+
+    // Binary records can only be written by the writer thread
+    if (backend->flags & VD_LOG_BINARY) {
+        backend->flags |= VD_LOG_MT;
+    }
+
+    if (backend->flags & VD_LOG_WRITE_FILE) {
+        backend->fd = vd_log__open(log->filepath);
+        if (backend->fd < 0) {
+            free(backend);
+            return -1;
+        }
+
+        if (backend->flags & VD_LOG_BINARY) {
+            VD_Log__BinaryHeader header = { VD_LOG__BINARY_MAGIC, VD_LOG__BINARY_VERSION, 0 };
+            vd_log__write_fd(backend->fd, (const char*)&header, sizeof(header));
+        }
+    }
+
+    if (backend->flags & VD_LOG_MT) {
+        uint32_t ring_size = 1024;
+        uint32_t wanted_size = log->ring_size ? log->ring_size : VD_LOG_DEFAULT_RING_SIZE;
+        while (ring_size < wanted_size) {
+            ring_size *= 2;
+        }
+
+        backend->ring_size = ring_size;
+        backend->ring_count = log->ring_count ? log->ring_count : VD_LOG_DEFAULT_RING_COUNT;
+        backend->batch_size = VD_LOG__BATCH_SIZE;
+
+        size_t batches_size = (backend->flags & VD_LOG_BINARY) ? backend->batch_size * 2 : backend->batch_size;
+        backend->rings = (VD_Log__Ring*)calloc(backend->ring_count, sizeof(VD_Log__Ring));
+        char *memory = (char*)malloc((size_t)ring_size * backend->ring_count + batches_size);
+        for (uint32_t i = 0; i < backend->ring_count; ++i) {
+            backend->rings[i].data = memory + (size_t)ring_size * i;
+        }
+
+        backend->batch = memory + (size_t)ring_size * backend->ring_count;
+        if (backend->flags & VD_LOG_BINARY) {
+            backend->text_batch = backend->batch + backend->batch_size;
+        }
+
+        backend->running = 1;
+
+        if (vd_sysutil_thread_create(&backend->writer, vd_log__writer_proc, backend) != 0) {
+            if (backend->fd >= 0) {
+                vd_log__close(backend->fd);
+            }
+
+            free(memory);
+            free(backend->rings);
+            free(backend);
+            return -1;
+        }
+
+        if (backend->flags & VD_LOG_FLUSH_ON_CRASH) {
+            VD_Log__Crash_Backend = backend;
+            vd_log__install_crash_handlers();
+        }
+    }
+
+    vd_atomic_fence();
+    log->backend = backend;
+    return 0;
+}
+
+static void vd_log__writev(VD_Log *log, const char *fmt, va_list args)
+{
+    VD_Log__Backend *backend = log->backend;
+    if (backend && (backend->flags & VD_LOG_BINARY)) {
+        vd_log__push_text_record(backend, fmt, args);
+    } else if (backend && (backend->flags & VD_LOG_MT)) {
+        vd_log__push(backend, fmt, args);
+    } else if (backend) {
+        char line[VD_LOG_MAX_LINE];
+        size_t len = vd_fmt_vsnfmt(line, sizeof(line), fmt, args);
+        if (len > sizeof(line)) {
+            len = sizeof(line);
+        }
+
+        vd_log__output(backend, line, len);
+    } else {
+        if (log->flags & VD_LOG_WRITE_FILE) {
+            FILE *f = fopen(log->filepath, "a");
+            assert(f != 0);
+            vd_fmt_vfprintf(f, fmt, args);
+            fflush(f);
+            fclose(f);
+        }
+
+        if (log->flags & VD_LOG_WRITE_STDOUT) {
+            vd_fmt_vfprintf(stdout, fmt, args);
+        }
+    }
+}
+
+void vd_log_write(VD_Log *log, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    vd_log__writev(log, fmt, args);
+    va_end(args);
+}
+
+void vd_log_write_site(VD_Log *log, VD_LogSite *site, ...)
+{
+    va_list args;
+    va_start(args, site);
+
+    VD_Log__Backend *backend = log->backend;
+    if (backend && (backend->flags & VD_LOG_BINARY)) {
+        uint32_t id = site->id;
+        if (id == 0) {
+            id = vd_log__register_site(site);
+        }
+
+        if (id == VD_LOG__SITE_TEXT) {
+            vd_log__push_text_record(backend, site->fmt, args);
+        } else {
+            vd_log__push_binary(backend, site, args);
+        }
+    } else {
+        vd_log__writev(log, site->fmt, args);
+    }
+
+    va_end(args);
+}
+
+void vd_log_flush(VD_Log *log)
+{
+    VD_Log__Backend *backend = log->backend;
+    if (!backend || !(backend->flags & VD_LOG_MT)) {
+        return;
+    }
+
+    int64_t request = vd_atomic_fetch_and_add64(&backend->flush_requested, 1) + 1;
+    while (backend->flush_completed < request) {
+        vd_log__sleep_ms(1);
+    }
+}
+
+uint64_t vd_log_get_dropped(VD_Log *log)
+{
+    return log->backend ? (uint64_t)log->backend->dropped : 0;
+}
+
+void vd_log_deinit(VD_Log *log)
+{
+    VD_Log__Backend *backend = log->backend;
+    if (!backend) {
+        return;
+    }
+
+    log->backend = 0;
+    vd_atomic_fence();
+
+    if (backend->flags & VD_LOG_MT) {
+        backend->running = 0;
+        vd_sysutil_thread_join(&backend->writer);
+
+        if (VD_Log__Crash_Backend == backend) {
+            VD_Log__Crash_Backend = 0;
+        }
+
+        if (backend->dropped > 0) {
+            char record[sizeof(VD_Log__RecordHeader) + 128];
+            char *line = record + sizeof(VD_Log__RecordHeader);
+            size_t len = vd_fmt_snfmt(
+                line,
+                128,
+                "[Log/WRN]: Dropped %{i64} lines\n",
+                (int64_t)backend->dropped);
+
+            if (backend->flags & VD_LOG_BINARY) {
+                VD_Log__RecordHeader header = { 0, (uint32_t)len };
+                memcpy(record, &header, sizeof(header));
+
+                if (backend->fd >= 0) {
+                    vd_log__write_fd(backend->fd, record, sizeof(header) + len);
+                }
+
+                if (backend->flags & VD_LOG_WRITE_STDOUT) {
+                    vd_log__write_fd(VD_LOG__STDOUT_FD, line, len);
+                }
+            } else {
+                vd_log__output(backend, line, len);
+            }
+        }
+
+        free(backend->rings[0].data);
+        free(backend->rings);
+    }
+
+    if (backend->fd >= 0) {
+        vd_log__close(backend->fd);
+    }
+
+    free(backend);
+}
+
+int vd_log_decode(const void *data, size_t len, VD_LogDecodeProc *proc, void *c)
+{
+    typedef struct {
+        const char  *fmt;
+        uint32_t    len;
+    } SiteFormat;
+
+    const char *cursor = (const char*)data;
+    const char *end = cursor + len;
+
+    SiteFormat *sites = 0;
+    uint32_t sites_cap = 0;
+    int result = 0;
+    char line[VD_LOG_MAX_LINE];
+
+    while (cursor < end) {
+        if ((size_t)(end - cursor) >= sizeof(VD_Log__BinaryHeader) &&
+            memcmp(cursor, VD_LOG__BINARY_MAGIC, 8) == 0)
+        {
+            VD_Log__BinaryHeader header;
+            memcpy(&header, cursor, sizeof(header));
+            if (header.version != VD_LOG__BINARY_VERSION) {
+                result = -1;
+                break;
+            }
+
+            // A new session, with its own site IDs
+            if (sites) {
+                memset(sites, 0, sizeof(SiteFormat) * sites_cap);
+            }
+
+            cursor += sizeof(header);
+            continue;
+        }
+
+        VD_Log__RecordHeader header;
+        if ((size_t)(end - cursor) < sizeof(header)) {
+            result = -1;
+            break;
+        }
+
+        memcpy(&header, cursor, sizeof(header));
+        const char *payload = cursor + sizeof(header);
+        if ((size_t)(end - payload) < header.len) {
+            result = -1;
+            break;
+        }
+
+        cursor = payload + header.len;
+
+        if (header.id & VD_LOG__RECORD_DEFINE) {
+            uint32_t id = header.id & ~VD_LOG__RECORD_DEFINE;
+            if (id >= VD_LOG__MAX_SITES) {
+                result = -1;
+                break;
+            }
+
+            if (id >= sites_cap) {
+                uint32_t new_cap = sites_cap ? sites_cap : 64;
+                while (new_cap <= id) {
+                    new_cap *= 2;
+                }
+
+                sites = (SiteFormat*)realloc(sites, sizeof(SiteFormat) * new_cap);
+                memset(sites + sites_cap, 0, sizeof(SiteFormat) * (new_cap - sites_cap));
+                sites_cap = new_cap;
+            }
+
+            sites[id].fmt = payload;
+            sites[id].len = header.len;
+        } else if (header.id == 0) {
+            proc(payload, header.len, c);
+        } else {
+            if (header.id >= sites_cap || sites[header.id].fmt == 0) {
+                result = -1;
+                break;
+            }
+
+            size_t line_len = vd_log__format_record(
+                sites[header.id].fmt,
+                sites[header.id].len,
+                payload,
+                header.len,
+                line,
+                sizeof(line));
+            proc(line, line_len, c);
+        }
+    }
+
+    free(sites);
+    return result;
+}
+
 #endif
@@ -54,6 +54,10 @@
 #define VD_META_ALLOC_PROC(name) void *name(void *ptr, size_t prevsize, size_t newsize, void *c)
 typedef VD_META_ALLOC_PROC(VD_Meta_AllocProc);
 
+/** Reads up to cap bytes into dst, and returns how many were read. Returns 0 at the end. */
+#define VD_META_READ_PROC(name) size_t name(void *dst, size_t cap, void *c)
+typedef VD_META_READ_PROC(VD_Meta_ReadProc);
+
 typedef struct VD_Meta_Descriptor VD_Meta_Descriptor;
 
 typedef enum {
@@ -92,6 +96,8 @@ enum {
     VD_META_INVALID_TYPE = -3,
     VD_META_TYPE_NOT_FOUND = -4,
     VD_META_TYPE_MISMATCH = -5,
+    VD_META_INVALID_BINARY = -6,
+    VD_META_SCHEMA_MISMATCH = -7,
 };
 
 typedef struct {
@@ -123,6 +129,10 @@ typedef struct {
     size_t              offset;
     VD_Meta_FieldFlags  flags;
 
+    /** Filled in by vd_meta_register, so that parsers can match keys without comparing names. */
+    uint32_t            name_len;
+    uint32_t            name_hash;
+
     union {
         struct {
             size_t len;
@@ -171,6 +181,63 @@ struct VD_Meta_Descriptor {
     } string;
 };
 
+typedef struct VD_Meta_Plan VD_Meta_Plan;
+
+typedef enum {
+    /** Copy size bytes as they are. Only in VD_Meta_Plan.ops, for runs of primitives. */
+    VD_META_PLAN_OP_COPY,
+    VD_META_PLAN_OP_PRIMITIVE,
+    VD_META_PLAN_OP_CSTRING,
+    /** An object, described by VD_Meta_PlanOp.plan */
+    VD_META_PLAN_OP_OBJECT,
+    /** A type that isn't serialized */
+    VD_META_PLAN_OP_SKIP,
+} VD_Meta_PlanOpKind;
+
+typedef struct {
+    VD_Meta_PlanOpKind                  kind;
+    VD_Meta_PrimitiveType               primitive;
+    /** VD_META_FIELD_FLAG_FIXED_ARRAY or VD_META_FIELD_FLAG_INTRUSIVE_ARRAY */
+    VD_Meta_FieldFlags                  flags;
+    uint32_t                            offset;
+    /** The size of one element, or of the whole run for VD_META_PLAN_OP_COPY */
+    uint32_t                            size;
+    /** The length of fixed arrays, 1 otherwise */
+    uint32_t                            count;
+    /** The field that the op reads, null for copies that span more than one field */
+    VD_Meta_Field                       *field;
+    VD_Meta_Plan                        *plan;
+    VD_Meta_IntrusiveArrayProperties    *props;
+} VD_Meta_PlanOp;
+
+/**
+ * A type flattened for serialization, with the descriptors of its fields already looked up.
+ * @see vd_meta_get_plan
+ */
+struct VD_Meta_Plan {
+    VD_Meta_ID          id;
+    const char          *name;
+    VD_Meta_TypeClass   type_class;
+    size_t              size;
+    uint64_t            schema_hash;
+
+    /** One op per field, in order; a single op at offset 0 for types that aren't objects. */
+    VD_Meta_PlanOp      *fields;
+    size_t              fields_len;
+
+    /**
+     * The same fields, with the ops of nested objects inlined and runs of primitives that are
+     * contiguous in memory merged into single copies.
+     */
+    VD_Meta_PlanOp      *ops;
+    size_t              ops_len;
+
+    /** The whole value is a single copy, so arrays of it can be copied as one block. */
+    int                 is_flat;
+    /** Values hold pointers (strings or intrusive arrays), directly or in nested objects. */
+    int                 has_pointers;
+};
+
 typedef struct {
 
     VD_Meta_AllocProc                   *alloc;
@@ -185,9 +252,28 @@ typedef struct {
     VD_Meta__IDEntry    **type_ids;
     size_t              type_ids_cap;
 
+    /** Caches Symbol -> ID, @see vd_meta_get_id_by_symbol */
+    VD_Meta_ID          *symbol_ids;
+    size_t              symbol_ids_cap;
+
+    /** Caches ID -> Plan, open addressed, @see vd_meta_get_plan */
+    VD_Meta_Plan        **plans;
+    size_t              plans_cap;
+    size_t              plans_len;
+
     uint64_t            next_id;
 } VD_Meta_Registry;
 
+typedef enum {
+    VD_META_BINARY_FLAG_NONE = 0,
+    /**
+     * Lay objects out as they are in memory, with pointers stored as offsets relative to their own
+     * location, so that the data can be mmapped and read in place.
+     * @see vd_meta_binary_get_root, vd_meta_binary_relocate
+     */
+    VD_META_BINARY_FLAG_IN_PLACE = 1 << 0,
+} VD_Meta_BinaryFlags;
+
 typedef struct {
     /** 
      * Writes the type name of @see VD_META_TYPE_OBJECT so that parsers can validate that they are
@@ -200,6 +286,8 @@ typedef struct {
     void                *alloc_ctx;
     /** Set to -1 to output the minifed version, set to 0 to output a pretty (spaced) version. */
     int                 pretty;
+    /** Only used by vd_meta_write_binary */
+    VD_Meta_BinaryFlags binary_flags;
 } VD_Meta_WriteOptions;
 
 typedef struct {
@@ -211,6 +299,12 @@ typedef struct {
 
     VD_Meta_ID          type;
     VD_Meta_ID          *out_type;
+
+    /**
+     * The size of the window that vd_meta_parse_json_stream reads into, 64KB if 0. It grows when a
+     * single string or number doesn't fit.
+     */
+    size_t              chunk_size;
 } VD_Meta_ParseOptions;
 
 /**
@@ -230,14 +324,34 @@ int vd_meta_init(VD_Meta_Registry *registry);
 VD_Meta_ID vd_meta_register(VD_Meta_Registry *registry, VD_Meta_Descriptor *descriptor);
 
 VD_Meta_ID vd_meta_get_id(VD_Meta_Registry *registry, const char *name);
+
+/**
+ * @brief Get the ID of a type by an interned name. The first lookup of a symbol goes through
+ * vd_meta_get_id, and later lookups read the ID from a table indexed by the symbol.
+ * @param symbol    A small, dense, non-zero number that stands for name, e.g. a VD_Symbol
+ * @param name      The name of the type
+ * @return The ID of the type, or an ID with value 0 if there is no such type
+ */
+VD_Meta_ID vd_meta_get_id_by_symbol(VD_Meta_Registry *registry, uint32_t symbol, const char *name);
 VD_Meta_Descriptor *vd_meta_get_descriptor(VD_Meta_Registry *registry, VD_Meta_ID id);
 
+/**
+ * @brief Get the serialization plan of a type, compiling it the first time. The JSON and binary
+ * readers and writers run on plans, so that descriptors are looked up once per type instead of
+ * once per value.
+ * @param registry  The registry to use
+ * @param type      The type
+ * @return The plan, or null if the type or a type it refers to is not registered
+ * @note Plans are cached until vd_meta_deinit, so types must not be changed after they are used.
+ */
+VD_Meta_Plan *vd_meta_get_plan(VD_Meta_Registry *registry, VD_Meta_ID type);
+
 /**
  * @brief Parse a json string into an object
  * @param registry  The registry to use
  * @param options   The parse options
  * @param json      The json string
- * @param len       The length of the json string
+ * @param len       The length of the json string, which does not need to be null terminated
  * @param out_obj   The output object
  * @return          0 on success, < 0 on error
  */
@@ -248,6 +362,24 @@ int vd_meta_parse_json(
     size_t len,
     void **out_obj);
 
+/**
+ * @brief Parse json that is read in chunks, so that large files don't have to be loaded whole.
+ * @param registry  The registry to use
+ * @param options   The parse options, @see vd_meta_parse_json
+ * @param read      Called whenever the parser needs more input
+ * @param read_ctx  Passed to read
+ * @param out_obj   The output object
+ * @return          0 on success, < 0 on error
+ * @note The type of the root object comes from its first key ("--vd-meta-type-name--", which is
+ * where vd_meta_write_json puts it) or from VD_Meta_ParseOptions.type.
+ */
+int vd_meta_parse_json_stream(
+    VD_Meta_Registry *registry,
+    VD_Meta_ParseOptions *options,
+    VD_Meta_ReadProc *read,
+    void *read_ctx,
+    void **out_object);
+
 /**
  * @brief Write an object to a json string
  * @param registry  The registry to use
@@ -294,6 +426,95 @@ void vd_meta_field_array_set(
     void *object,
     void *new_value);
 
+/**
+ * @brief Hash the layout of a type: names, sizes, offsets and flags of it and of every type it
+ * refers to. Binary data is only read back if the hash it was written with still matches.
+ */
+uint64_t vd_meta_get_schema_hash(VD_Meta_Registry *registry, VD_Meta_ID type);
+
+/**
+ * @brief Write an object in the binary format
+ * @param registry  The registry to use
+ * @param object    The object to write
+ * @param type      The type of the object
+ * @param options   The write options (alloc, binary_flags)
+ * @param out_data  The output data
+ * @param out_len   The length of the output data
+ * @return          0 on success, < 0 on error
+ * @note Primitives are written in the byte order of the host. Without VD_META_BINARY_FLAG_IN_PLACE,
+ * fields are written in order, with runs of primitives copied as blocks and varint lengths for
+ * strings and intrusive arrays.
+ */
+int vd_meta_write_binary(
+    VD_Meta_Registry *registry,
+    void *object,
+    VD_Meta_ID type,
+    VD_Meta_WriteOptions *options,
+    void **out_data,
+    size_t *out_len);
+
+/**
+ * @brief Parse data written by vd_meta_write_binary (without VD_META_BINARY_FLAG_IN_PLACE)
+ * @param registry  The registry to use
+ * @param options   The parse options. The type is taken from the data if options->type is 0.
+ * @param data      The data
+ * @param len       The length of the data
+ * @param out_obj   The output object
+ * @return          0 on success, VD_META_SCHEMA_MISMATCH if the type changed since the data was
+ *                  written, < 0 on other errors
+ */
+int vd_meta_parse_binary(
+    VD_Meta_Registry *registry,
+    VD_Meta_ParseOptions *options,
+    const void *data,
+    size_t len,
+    void **out_object);
+
+/**
+ * @brief Get the root object of data written with VD_META_BINARY_FLAG_IN_PLACE, without copying.
+ * Pointer fields hold relative offsets and have to be read with VD_META_REL_PTR.
+ * @param registry  The registry to use
+ * @param data      The data, aligned to 8 bytes (e.g. mmapped)
+ * @param len       The length of the data
+ * @param type      The expected type, or 0 to take it from the data
+ * @param out_obj   The root object, inside data
+ * @return          0 on success, < 0 on error
+ * @note Only the header is checked, so the data has to come from a trusted source.
+ */
+int vd_meta_binary_get_root(
+    VD_Meta_Registry *registry,
+    const void *data,
+    size_t len,
+    VD_Meta_ID type,
+    const void **out_object);
+
+/**
+ * @brief Turn the relative offsets of data written with VD_META_BINARY_FLAG_IN_PLACE into
+ * pointers, so that the objects can be used directly. Intrusive arrays use the VD_META_ARRAY
+ * layout, and nothing is allocated, so the data must stay alive (and not be freed piecewise).
+ * @param registry  The registry to use
+ * @param data      The data, writable and aligned to 8 bytes
+ * @param len       The length of the data
+ * @param type      The expected type, or 0 to take it from the data
+ * @param out_obj   The root object, inside data
+ * @return          0 on success, < 0 on error. Every offset is bounds checked.
+ */
+int vd_meta_binary_relocate(
+    VD_Meta_Registry *registry,
+    void *data,
+    size_t len,
+    VD_Meta_ID type,
+    void **out_object);
+
+/** Read a pointer field of data that is read in place, @see vd_meta_binary_get_root */
+#define VD_META_REL_PTR(type, field) ((type*)vd_meta_rel_ptr(&(field)))
+
+static inline const void *vd_meta_rel_ptr(const void *field)
+{
+    int64_t offset = *(const int64_t*)field;
+    return offset ? (const char*)field + offset : 0;
+}
+
 /**
  * @brief Deinitialize the meta registry
  * @param registry The registry to deinitialize
@@ -576,7 +797,8 @@ static inline uint64_t vd_meta__hash(const void *key, uint32_t len, uint32_t see
     const uint8_t *data = (const uint8_t *)key;
 
     while (len >= 4) {
-        uint32_t k = *(uint32_t*)data;
+        uint32_t k;
+        memcpy(&k, data, sizeof(k));
 
         k *= m;
         k ^= k >> r;
@@ -591,8 +813,8 @@ static inline uint64_t vd_meta__hash(const void *key, uint32_t len, uint32_t see
 
     // Handle the last few bytes of the input array
     switch(len) {
-        case 3: h ^= data[2] << 16;
-        case 2: h ^= data[1] << 8;
+        case 3: h ^= data[2] << 16; /* fallthrough */
+        case 2: h ^= data[1] << 8;  /* fallthrough */
         case 1: h ^= data[0];
                 h *= m;
     };
@@ -606,6 +828,11 @@ static inline uint64_t vd_meta__hash(const void *key, uint32_t len, uint32_t see
     return h;
 }
 
+static inline uint32_t vd_meta__field_name_hash(const char *name, size_t len)
+{
+    return (uint32_t)vd_meta__hash(name, (uint32_t)len, 0x3F1E1D);
+}
+
 static VD_META_INTRUSIVE_ARRAY_ADD_PROC(vd_meta__intrusive_array_add_default_proc)
 {
     VD_Meta_Registry *registry = (VD_Meta_Registry*)c;
@@ -659,6 +886,8 @@ int vd_meta_init(VD_Meta_Registry *registry)
 
     memset(registry->type_ids, 0, registry->type_ids_cap * sizeof(VD_Meta__IDEntry*));
 
+    registry->symbol_ids = 0;
+    registry->symbol_ids_cap = 0;
     registry->next_id = 1;
 
 #if VD_META_OPTION_DEFINE_DEFAULT_TYPES
@@ -768,9 +997,11 @@ VD_Meta_ID vd_meta_register(VD_Meta_Registry *registry, VD_Meta_Descriptor *desc
                 descriptor->object.fields,
                 descriptor->object.len * sizeof(VD_Meta_Field));
 
-            for (int i = 0; i < copy_desc.object.len; ++i) {
+            for (size_t i = 0; i < copy_desc.object.len; ++i) {
                 VD_Meta_Field *field = &copy_desc.object.fields[i];
                 field->name = strdup(field->name);
+                field->name_len = (uint32_t)strlen(field->name);
+                field->name_hash = vd_meta__field_name_hash(field->name, field->name_len);
             }
         } break;
     }
@@ -812,6 +1043,42 @@ VD_Meta_ID vd_meta_get_id(VD_Meta_Registry *registry, const char *name)
     return (VD_Meta_ID) { 0 };
 }
 
+VD_Meta_ID vd_meta_get_id_by_symbol(VD_Meta_Registry *registry, uint32_t symbol, const char *name)
+{
+    if (symbol < registry->symbol_ids_cap && registry->symbol_ids[symbol].value != 0) {
+        return registry->symbol_ids[symbol];
+    }
+
+    VD_Meta_ID id = vd_meta_get_id(registry, name);
+
+    // Types can be registered later, so only found IDs are cached
+    if (id.value == 0) {
+        return id;
+    }
+
+    if (symbol >= registry->symbol_ids_cap) {
+        size_t new_cap = registry->symbol_ids_cap ? registry->symbol_ids_cap : 64;
+        while (new_cap <= symbol) {
+            new_cap *= 2;
+        }
+
+        registry->symbol_ids = (VD_Meta_ID*)registry->alloc(
+            registry->symbol_ids,
+            registry->symbol_ids_cap * sizeof(VD_Meta_ID),
+            new_cap * sizeof(VD_Meta_ID),
+            registry->alloc_ctx);
+
+        memset(
+            registry->symbol_ids + registry->symbol_ids_cap,
+            0,
+            (new_cap - registry->symbol_ids_cap) * sizeof(VD_Meta_ID));
+        registry->symbol_ids_cap = new_cap;
+    }
+
+    registry->symbol_ids[symbol] = id;
+    return id;
+}
+
 VD_Meta_Descriptor *vd_meta_get_descriptor(VD_Meta_Registry *registry, VD_Meta_ID id)
 {
     uint64_t hash = vd_meta__hash(&id.value, sizeof(id.value), 0x23320);
@@ -827,507 +1094,520 @@ VD_Meta_Descriptor *vd_meta_get_descriptor(VD_Meta_Registry *registry, VD_Meta_I
     return 0;
 }
 
-static int vd_meta__write_json_descriptor(
-    VD_Meta_Registry *registry,
-    void *object,
-    VD_Meta_ID type,
-    VD_Meta__Buffer *buffer,
-    int pretty);
+/* ----PLANS------------------------------------------------------------------------------------- */
+#define VD_META__MAX_TYPE_DEPTH 64
 
-static int vd_meta__write_json_object(
+static VD_Meta_IntrusiveArrayProperties *vd_meta__field_array_props(
     VD_Meta_Registry *registry,
-    void *object,
-    VD_Meta_ID type,
-    VD_Meta__Buffer *buffer,
-    int pretty);
+    VD_Meta_Field *field)
+{
+    if (field->intrusive_array.props.add != 0) {
+        return &field->intrusive_array.props;
+    }
 
-static int vd_meta__write_json_field(
-    VD_Meta_Registry *registry,
-    void *object,
-    VD_Meta_Field *field,
-    VD_Meta__Buffer *buffer,
-    int pretty);
+    return &registry->intrusive_array_props;
+}
 
-static int vd_meta__write_json_field(
-    VD_Meta_Registry *registry,
-    void *object,
-    VD_Meta_Field *field,
-    VD_Meta__Buffer *buffer,
-    int pretty)
+static VD_Meta_Plan *vd_meta__find_plan(VD_Meta_Registry *registry, VD_Meta_ID type)
 {
-    if (field->flags & VD_META_FIELD_FLAG_FIXED_ARRAY)
-    {
-        if (pretty >= 0) vd_meta__buffer_pushstr(buffer, "\n");
+    if (registry->plans_cap == 0) {
+        return 0;
+    }
 
-        for (int i = 0; i < pretty; ++i) {
-            vd_meta__buffer_pushchar(buffer, ' ');
+    size_t mask = registry->plans_cap - 1;
+    size_t i = vd_meta__hash(&type.value, sizeof(type.value), 0x23320) & mask;
+    for (;; i = (i + 1) & mask) {
+        VD_Meta_Plan *plan = registry->plans[i];
+        if (plan == 0 || plan->id.value == type.value) {
+            return plan;
         }
+    }
+}
 
-        vd_meta__buffer_pushstr(buffer, "[");
+static void vd_meta__insert_plan(VD_Meta_Registry *registry, VD_Meta_Plan *plan)
+{
+    // Kept at most half full
+    if ((registry->plans_len + 1) * 2 > registry->plans_cap) {
+        VD_Meta_Plan **old = registry->plans;
+        size_t old_cap = registry->plans_cap;
 
-        if (pretty >= 0) vd_meta__buffer_pushstr(buffer, "\n");
-        
-        if (pretty >= 0) {
-            pretty += 4;
+        registry->plans_cap = old_cap ? old_cap * 2 : 64;
+        registry->plans = (VD_Meta_Plan**)registry->alloc(
+            0,
+            0,
+            registry->plans_cap * sizeof(VD_Meta_Plan*),
+            registry->alloc_ctx);
+        memset(registry->plans, 0, registry->plans_cap * sizeof(VD_Meta_Plan*));
+        registry->plans_len = 0;
+
+        for (size_t i = 0; i < old_cap; ++i) {
+            if (old[i]) {
+                vd_meta__insert_plan(registry, old[i]);
+            }
         }
 
-        VD_Meta_Descriptor *sub_descriptor = vd_meta_get_descriptor(registry, field->type);
-
-        for (size_t i = 0; i < field->fixed_array.len; ++i) {
-            for (int i = 0; i < pretty; ++i) {
-                vd_meta__buffer_pushchar(buffer, ' ');
-            }
+        if (old) {
+            registry->alloc(old, old_cap * sizeof(VD_Meta_Plan*), 0, registry->alloc_ctx);
+        }
+    }
 
-            vd_meta__write_json_descriptor(
-                registry,
-                (char*)object + field->offset + i * sub_descriptor->size,
-                field->type,
-                buffer,
-                pretty);
+    size_t mask = registry->plans_cap - 1;
+    size_t i = vd_meta__hash(&plan->id.value, sizeof(plan->id.value), 0x23320) & mask;
+    while (registry->plans[i]) {
+        i = (i + 1) & mask;
+    }
 
-            if (i < field->fixed_array.len - 1) {
-                vd_meta__buffer_pushstr(buffer, ",");
-            }
+    registry->plans[i] = plan;
+    registry->plans_len++;
+}
 
-            if (pretty >= 0) vd_meta__buffer_pushchar(buffer, '\n');
-        }
+/** Whether every type that type refers to is registered, so that compiling its plan can't fail. */
+static int vd_meta__plan_check(VD_Meta_Registry *registry, VD_Meta_ID type, VD_Meta_ID *stack, int depth)
+{
+    if (vd_meta__find_plan(registry, type)) {
+        return 1;
+    }
 
-        if (pretty >= 0) {
-            pretty -= 4;
-        }
+    VD_Meta_Descriptor *desc = vd_meta_get_descriptor(registry, type);
+    if (desc == 0) {
+        return 0;
+    }
 
-        for (int i = 0; i < pretty; ++i) {
-            vd_meta__buffer_pushchar(buffer, ' ');
+    for (int i = 0; i < depth; ++i) {
+        if (stack[i].value == type.value) {
+            return 1;
         }
+    }
 
-        vd_meta__buffer_pushstr(buffer, "]");
-    } else if (field->flags & VD_META_FIELD_FLAG_INTRUSIVE_ARRAY) {
-        if (pretty >= 0) vd_meta__buffer_pushstr(buffer, "\n");
+    if (desc->type_class != VD_META_TYPE_OBJECT || depth >= VD_META__MAX_TYPE_DEPTH) {
+        return 1;
+    }
 
-        for (int i = 0; i < pretty; ++i) {
-            vd_meta__buffer_pushchar(buffer, ' ');
+    stack[depth] = type;
+    for (size_t i = 0; i < desc->object.len; ++i) {
+        if (!vd_meta__plan_check(registry, desc->object.fields[i].type, stack, depth + 1)) {
+            return 0;
         }
+    }
 
-        vd_meta__buffer_pushstr(buffer, "[");
+    return 1;
+}
 
-        if (pretty >= 0) vd_meta__buffer_pushstr(buffer, "\n");
-        
-        if (pretty >= 0) {
-            pretty += 4;
+static void vd_meta__plan_push_op(VD_Meta_Registry *registry, VD_Meta_Plan *plan, VD_Meta_PlanOp op)
+{
+    if (op.kind == VD_META_PLAN_OP_COPY && plan->ops_len > 0) {
+        VD_Meta_PlanOp *last = &plan->ops[plan->ops_len - 1];
+        if (last->kind == VD_META_PLAN_OP_COPY && last->offset + last->size == op.offset) {
+            last->size += op.size;
+            last->field = 0;
+            return;
         }
+    }
 
-        uintptr_t array = *((uintptr_t *)((char *)object + field->offset));
-        size_t len = registry->intrusive_array_props.len(
-            (void*)array,
-            registry->intrusive_array_props.c);
-
-        VD_Meta_Descriptor *sub_descriptor = vd_meta_get_descriptor(registry, field->type);
-
-        for (size_t i = 0; i < len; ++i) {
-            for (int i = 0; i < pretty; ++i) {
-                vd_meta__buffer_pushchar(buffer, ' ');
-            }
-
-            vd_meta__write_json_descriptor(
-                registry,
-                (char*)array + i * sub_descriptor->size,
-                field->type,
-                buffer,
-                pretty);
+    VD_META_ARRAY_ADD(plan->ops, op, registry->alloc, registry->alloc_ctx);
+    plan->ops_len++;
+}
 
-            if (i < len - 1) {
-                vd_meta__buffer_pushstr(buffer, ",");
-            }
+/** Add the ops that serialize the value of op at base + op->offset. */
+static void vd_meta__plan_emit(
+    VD_Meta_Registry *registry,
+    VD_Meta_Plan *plan,
+    const VD_Meta_PlanOp *op,
+    uint32_t base)
+{
+    VD_Meta_PlanOp emit = *op;
+    emit.offset += base;
 
-            if (pretty >= 0) vd_meta__buffer_pushchar(buffer, '\n');
+    if (!(op->flags & VD_META_FIELD_FLAG_INTRUSIVE_ARRAY)) {
+        if (op->kind == VD_META_PLAN_OP_PRIMITIVE ||
+            (op->kind == VD_META_PLAN_OP_OBJECT && op->plan->is_flat))
+        {
+            emit.kind = VD_META_PLAN_OP_COPY;
+            emit.size = op->size * op->count;
+            emit.count = 1;
+            emit.flags = VD_META_FIELD_FLAG_NONE;
+            emit.plan = 0;
+            vd_meta__plan_push_op(registry, plan, emit);
+            return;
         }
 
-        if (pretty >= 0) {
-            pretty -= 4;
-        }
+        // Nested objects are always complete here, since an object can't contain itself by value
+        if (op->kind == VD_META_PLAN_OP_OBJECT && op->count == 1) {
+            for (size_t i = 0; i < op->plan->ops_len; ++i) {
+                VD_Meta_PlanOp inner = op->plan->ops[i];
+                inner.offset += emit.offset;
+                vd_meta__plan_push_op(registry, plan, inner);
+            }
 
-        for (int i = 0; i < pretty; ++i) {
-            vd_meta__buffer_pushchar(buffer, ' ');
+            return;
         }
-
-        vd_meta__buffer_pushstr(buffer, "]");
-    } else {
-        vd_meta__write_json_descriptor(
-            registry,
-            (char*)object + field->offset,
-            field->type,
-            buffer,
-            pretty);
     }
 
-    return 0;
+    vd_meta__plan_push_op(registry, plan, emit);
+}
+
+static int vd_meta__plan_op_has_pointers(const VD_Meta_PlanOp *op)
+{
+    return (op->flags & VD_META_FIELD_FLAG_INTRUSIVE_ARRAY) ||
+        op->kind == VD_META_PLAN_OP_CSTRING ||
+        op->kind == VD_META_PLAN_OP_SKIP ||
+        (op->kind == VD_META_PLAN_OP_OBJECT && op->plan->has_pointers);
 }
 
-static int vd_meta__write_json_descriptor(
+static VD_Meta_Plan *vd_meta__compile_plan(VD_Meta_Registry *registry, VD_Meta_ID type);
+
+/** Describe a value of type, at the offset of field (if any). */
+static VD_Meta_PlanOp vd_meta__plan_value_op(
     VD_Meta_Registry *registry,
-    void *object,
     VD_Meta_ID type,
-    VD_Meta__Buffer *buffer,
-    int pretty)
+    VD_Meta_Field *field)
 {
-    VD_Meta_Descriptor *descriptor = vd_meta_get_descriptor(registry, type);
+    VD_Meta_Descriptor *desc = vd_meta_get_descriptor(registry, type);
+    VD_Meta_PlanOp op = {
+        .kind = VD_META_PLAN_OP_SKIP,
+        .size = (uint32_t)desc->size,
+        .count = 1,
+        .field = field,
+    };
 
-    if (descriptor == 0) {
-        return VD_META_DESCRIPTOR_NOT_FOUND;
-    }
+    switch (desc->type_class) {
+        case VD_META_TYPE_PRIMITIVE: {
+            op.kind = VD_META_PLAN_OP_PRIMITIVE;
+            op.primitive = desc->primitive.type;
+        } break;
 
-    switch (descriptor->type_class) {
-        case VD_META_TYPE_STRING:
-        {
-            switch (descriptor->string.type) {
-                case VD_META_STRING_TYPE_CSTRING:
-                {
-                    vd_meta__buffer_pushstr(buffer, "\"");
-                    vd_meta__buffer_pushstr(buffer, *(char**)object);
-                    vd_meta__buffer_pushstr(buffer, "\"");
-                } break;
+        case VD_META_TYPE_STRING: {
+            if (desc->string.type == VD_META_STRING_TYPE_CSTRING) {
+                op.kind = VD_META_PLAN_OP_CSTRING;
             }
         } break;
-        case VD_META_TYPE_PRIMITIVE:
-        {
-            switch (descriptor->primitive.type) {
-                case VD_META_PRIMITIVE_TYPE_I8:
-                {
-                    char str[32];
-                    snprintf(str, 32, "%d", *(int8_t*)object);
-                    vd_meta__buffer_pushstr(buffer, str);
-                } break;
-                case VD_META_PRIMITIVE_TYPE_U8:
-                {
-                    char str[32];
-                    snprintf(str, 32, "%u", *(uint8_t*)object);
-                    vd_meta__buffer_pushstr(buffer, str);
-                } break;
-                case VD_META_PRIMITIVE_TYPE_I16:
-                {
-                    char str[32];
-                    snprintf(str, 32, "%d", *(int16_t*)object);
-                    vd_meta__buffer_pushstr(buffer, str);
-                } break;
-                case VD_META_PRIMITIVE_TYPE_U16:
-                {
-                    char str[32];
-                    snprintf(str, 32, "%u", *(uint16_t*)object);
-                    vd_meta__buffer_pushstr(buffer, str);
-                } break;
-                case VD_META_PRIMITIVE_TYPE_I32:
-                {
-                    char str[32];
-                    snprintf(str, 32, "%d", *(int32_t*)object);
-                    vd_meta__buffer_pushstr(buffer, str);
-                } break;
-                case VD_META_PRIMITIVE_TYPE_U32:
-                {
-                    char str[32];
-                    snprintf(str, 32, "%u", *(uint32_t*)object);
-                    vd_meta__buffer_pushstr(buffer, str);
-                } break;
-                case VD_META_PRIMITIVE_TYPE_I64:
-                {
-                    char str[32];
-                    snprintf(str, 32, "%lld", *(int64_t*)object);
-                    vd_meta__buffer_pushstr(buffer, str);
-                } break;
-                case VD_META_PRIMITIVE_TYPE_U64:
-                {
-                    char str[32];
-                    snprintf(str, 32, "%llu", *(uint64_t*)object);
-                    vd_meta__buffer_pushstr(buffer, str);
-                } break;
-                case VD_META_PRIMITIVE_TYPE_F32:
-                {
-                    char str[32];
-                    snprintf(str, 32, "%f", *(float*)object);
-                    vd_meta__buffer_pushstr(buffer, str);
-                } break;
-                case VD_META_PRIMITIVE_TYPE_F64:
-                {
-                    char str[32];
-                    snprintf(str, 32, "%f", *(double*)object);
-                    vd_meta__buffer_pushstr(buffer, str);
-                } break;
-                case VD_META_PRIMITIVE_TYPE_CHAR8:
-                {
-                    vd_meta__buffer_pushstr(buffer, "\"");
-                    vd_meta__buffer_pushchar(buffer, *(char*)object);
-                    vd_meta__buffer_pushstr(buffer, "\"");
-                } break;
+
+        case VD_META_TYPE_OBJECT: {
+            op.kind = VD_META_PLAN_OP_OBJECT;
+            op.plan = vd_meta__find_plan(registry, type);
+            if (op.plan == 0) {
+                op.plan = vd_meta__compile_plan(registry, type);
             }
         } break;
 
-        case VD_META_TYPE_OBJECT:
-        {
-            vd_meta__write_json_object(registry, object, type, buffer, pretty);
-        } break;
+        default: break;
     }
 
-    return 0;
+    if (field) {
+        op.offset = (uint32_t)field->offset;
+        op.flags = field->flags & (VD_META_FIELD_FLAG_FIXED_ARRAY | VD_META_FIELD_FLAG_INTRUSIVE_ARRAY);
+        if (field->flags & VD_META_FIELD_FLAG_FIXED_ARRAY) {
+            op.count = (uint32_t)field->fixed_array.len;
+        } else if (field->flags & VD_META_FIELD_FLAG_INTRUSIVE_ARRAY) {
+            op.props = vd_meta__field_array_props(registry, field);
+        }
+    }
+
+    return op;
 }
 
-static int vd_meta__write_json_object(
-    VD_Meta_Registry *registry,
-    void *object,
-    VD_Meta_ID type,
-    VD_Meta__Buffer *buffer,
-    int pretty)
+static VD_Meta_Plan *vd_meta__compile_plan(VD_Meta_Registry *registry, VD_Meta_ID type)
 {
-    VD_Meta_Descriptor *descriptor = vd_meta_get_descriptor(registry, type);
+    VD_Meta_Descriptor *desc = vd_meta_get_descriptor(registry, type);
 
-    if (descriptor == 0) {
-        return VD_META_DESCRIPTOR_NOT_FOUND;
-    }
+    VD_Meta_Plan *plan = (VD_Meta_Plan*)registry->alloc(0, 0, sizeof(VD_Meta_Plan), registry->alloc_ctx);
+    memset(plan, 0, sizeof(*plan));
+    plan->id = desc->id;
+    plan->name = desc->name;
+    plan->type_class = desc->type_class;
+    plan->size = desc->size;
+    plan->schema_hash = vd_meta_get_schema_hash(registry, type);
 
-    vd_meta__buffer_pushchar(buffer, '{');
-    if (pretty >= 0) vd_meta__buffer_pushchar(buffer, '\n');
+    // Cached before the fields are compiled, so that types with arrays of themselves find it
+    vd_meta__insert_plan(registry, plan);
+
+    if (desc->type_class == VD_META_TYPE_OBJECT) {
+        VD_Meta_Field *fields = desc->object.fields;
+        size_t len = desc->object.len;
 
-    if (pretty >= 0) {
-        pretty += 4;
+        for (size_t i = 0; i < len; ++i) {
+            VD_Meta_PlanOp op = vd_meta__plan_value_op(registry, fields[i].type, &fields[i]);
+            VD_META_ARRAY_ADD(plan->fields, op, registry->alloc, registry->alloc_ctx);
+            plan->fields_len++;
+        }
+    } else {
+        VD_Meta_PlanOp op = vd_meta__plan_value_op(registry, type, 0);
+        VD_META_ARRAY_ADD(plan->fields, op, registry->alloc, registry->alloc_ctx);
+        plan->fields_len++;
     }
 
-    for (int i = 0; i < pretty; ++i) {
-        vd_meta__buffer_pushchar(buffer, ' ');
+    for (size_t i = 0; i < plan->fields_len; ++i) {
+        vd_meta__plan_emit(registry, plan, &plan->fields[i], 0);
+        plan->has_pointers |= vd_meta__plan_op_has_pointers(&plan->fields[i]);
     }
 
-    // Write the type name
-    vd_meta__buffer_pushstr(buffer, "\"--vd-meta-type-name--\":");
-    if (pretty >= 0) vd_meta__buffer_pushchar(buffer, ' ');
-    vd_meta__buffer_pushstr(buffer, "\"");
-    vd_meta__buffer_pushstr(buffer, descriptor->name);
-    vd_meta__buffer_pushstr(buffer, "\"");
-    vd_meta__buffer_pushstr(buffer, ",");
-    if (pretty >= 0) vd_meta__buffer_pushchar(buffer, '\n');
+    plan->is_flat =
+        plan->ops_len == 1 &&
+        plan->ops[0].kind == VD_META_PLAN_OP_COPY &&
+        plan->ops[0].offset == 0 &&
+        plan->ops[0].size == plan->size;
 
-    // Write the fields
-    for (int fi = 0; fi < descriptor->object.len; ++fi) {
-        for (int i = 0; i < pretty; ++i) {
-            vd_meta__buffer_pushchar(buffer, ' ');
-        }
+    return plan;
+}
 
-        VD_Meta_Field *field = &descriptor->object.fields[fi];
+VD_Meta_Plan *vd_meta_get_plan(VD_Meta_Registry *registry, VD_Meta_ID type)
+{
+    VD_Meta_Plan *plan = vd_meta__find_plan(registry, type);
+    if (plan) {
+        return plan;
+    }
 
-        vd_meta__buffer_pushstr(buffer, "\"");
-        vd_meta__buffer_pushstr(buffer, field->name);
-        vd_meta__buffer_pushstr(buffer, "\":");
-        if (pretty >= 0) vd_meta__buffer_pushchar(buffer, ' ');
+    VD_Meta_ID stack[VD_META__MAX_TYPE_DEPTH];
+    if (!vd_meta__plan_check(registry, type, stack, 0)) {
+        return 0;
+    }
 
-        vd_meta__write_json_field(
-            registry,
-            object,
-            field,
-            buffer,
-            pretty);
+    return vd_meta__compile_plan(registry, type);
+}
 
-        if (fi < descriptor->object.len - 1) {
-            vd_meta__buffer_pushstr(buffer, ",");
-        }
+static void vd_meta__free_plan(VD_Meta_Registry *registry, VD_Meta_Plan *plan)
+{
+    VD_META_ARRAY_FREE(plan->fields, registry->alloc, registry->alloc_ctx);
+    VD_META_ARRAY_FREE(plan->ops, registry->alloc, registry->alloc_ctx);
+    registry->alloc(plan, sizeof(*plan), 0, registry->alloc_ctx);
+}
 
-        if (pretty >= 0) vd_meta__buffer_pushchar(buffer, '\n');
+static void vd_meta__buffer_push(VD_Meta__Buffer *buffer, const void *data, size_t len)
+{
+    // Empty intrusive arrays come in as a null pointer
+    if (len == 0) {
+        return;
     }
 
-    if (pretty >= 0) {
-        pretty -= 4;
-        pretty = pretty < 0 ? 0 : pretty;
-    }
+    vd_meta__buffer_ensure_add(buffer, len);
+    memcpy(buffer->ptr + buffer->len, data, len);
+    buffer->len += len;
+}
 
-    for (int i = 0; i < pretty; ++i) {
-        vd_meta__buffer_pushchar(buffer, ' ');
+static void vd_meta__buffer_push_indent(VD_Meta__Buffer *buffer, int pretty)
+{
+    if (pretty > 0) {
+        vd_meta__buffer_ensure_add(buffer, pretty);
+        memset(buffer->ptr + buffer->len, ' ', pretty);
+        buffer->len += pretty;
     }
+}
 
-    vd_meta__buffer_pushchar(buffer, '}');
+static void vd_meta__buffer_push_int(VD_Meta__Buffer *buffer, uint64_t v, int negative)
+{
+    char str[24];
+    char *end = str + sizeof(str);
+    char *p = end;
 
-    return 0;
+    do {
+        *--p = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+
+    if (negative) {
+        *--p = '-';
+    }
+
+    vd_meta__buffer_push(buffer, p, end - p);
 }
 
-int vd_meta_write_json(
-    VD_Meta_Registry *registry,
+static void vd_meta__write_json_object(
+    VD_Meta_Plan *plan,
     void *object,
-    VD_Meta_ID type,
-    VD_Meta_WriteOptions *options,
-    char **out_json,
-    size_t *out_len)
+    VD_Meta__Buffer *buffer,
+    int pretty);
+
+static void vd_meta__write_json_value(
+    const VD_Meta_PlanOp *op,
+    void *object,
+    VD_Meta__Buffer *buffer,
+    int pretty)
 {
-    if (options->alloc == 0) {
-        options->alloc = registry->alloc;
-        options->alloc_ctx = registry->alloc_ctx;
-    }
+    switch (op->kind) {
+        case VD_META_PLAN_OP_CSTRING: {
+            const char *str = *(char**)object;
+            if (str == 0) {
+                vd_meta__buffer_push(buffer, "null", 4);
+                break;
+            }
 
-    VD_Meta__Buffer buffer = {
-        .ptr = 0,
-        .len = 0,
-        .cap = 0,
-        .alloc = options->alloc,
-        .alloc_ctx = options->alloc_ctx,
-    };
+            vd_meta__buffer_pushchar(buffer, '"');
+            vd_meta__buffer_pushstr(buffer, str);
+            vd_meta__buffer_pushchar(buffer, '"');
+        } break;
 
-    vd_meta__write_json_object(registry, object, type, &buffer, options->pretty);
-    vd_meta__buffer_terminate(&buffer);
+        case VD_META_PLAN_OP_PRIMITIVE: {
+            switch (op->primitive) {
+                case VD_META_PRIMITIVE_TYPE_I8:
+                case VD_META_PRIMITIVE_TYPE_I16:
+                case VD_META_PRIMITIVE_TYPE_I32:
+                case VD_META_PRIMITIVE_TYPE_I64: {
+                    int64_t v =
+                        op->primitive == VD_META_PRIMITIVE_TYPE_I8  ? *(int8_t*)object  :
+                        op->primitive == VD_META_PRIMITIVE_TYPE_I16 ? *(int16_t*)object :
+                        op->primitive == VD_META_PRIMITIVE_TYPE_I32 ? *(int32_t*)object :
+                                                                      *(int64_t*)object;
+                    vd_meta__buffer_push_int(buffer, v < 0 ? 0 - (uint64_t)v : (uint64_t)v, v < 0);
+                } break;
 
-    *out_json = buffer.ptr;
-    *out_len = buffer.len;
+                case VD_META_PRIMITIVE_TYPE_U8:
+                case VD_META_PRIMITIVE_TYPE_U16:
+                case VD_META_PRIMITIVE_TYPE_U32:
+                case VD_META_PRIMITIVE_TYPE_U64: {
+                    uint64_t v =
+                        op->primitive == VD_META_PRIMITIVE_TYPE_U8  ? *(uint8_t*)object  :
+                        op->primitive == VD_META_PRIMITIVE_TYPE_U16 ? *(uint16_t*)object :
+                        op->primitive == VD_META_PRIMITIVE_TYPE_U32 ? *(uint32_t*)object :
+                                                                      *(uint64_t*)object;
+                    vd_meta__buffer_push_int(buffer, v, 0);
+                } break;
 
-    return 0;
-}
+                case VD_META_PRIMITIVE_TYPE_F32:
+                case VD_META_PRIMITIVE_TYPE_F64: {
+                    double v = op->primitive == VD_META_PRIMITIVE_TYPE_F32 ? *(float*)object : *(double*)object;
+                    char str[352];
+                    int len = snprintf(str, sizeof(str), "%f", v);
+                    vd_meta__buffer_push(buffer, str, (size_t)len);
+                } break;
 
-typedef struct {
-    const char *str;
-    size_t len;
-    size_t pos;
-} VD_Meta__Slice;
+                case VD_META_PRIMITIVE_TYPE_CHAR8: {
+                    vd_meta__buffer_pushchar(buffer, '"');
+                    vd_meta__buffer_pushchar(buffer, *(char*)object);
+                    vd_meta__buffer_pushchar(buffer, '"');
+                } break;
+            }
+        } break;
 
-static int vd_meta__slice_at_end(VD_Meta__Slice *slice)
-{
-    if (slice->pos >= slice->len) {
-        return 1;
-    }
+        case VD_META_PLAN_OP_OBJECT: {
+            vd_meta__write_json_object(op->plan, object, buffer, pretty);
+        } break;
 
-    return 0;
+        default: {
+            vd_meta__buffer_push(buffer, "null", 4);
+        } break;
+    }
 }
 
-static int vd_meta__slice_expect_char(VD_Meta__Slice *slice, char c)
+static void vd_meta__write_json_field(
+    const VD_Meta_PlanOp *op,
+    void *object,
+    VD_Meta__Buffer *buffer,
+    int pretty)
 {
-    if (slice->pos >= slice->len) {
-        return 0;
+    char *location = (char*)object + op->offset;
+    if (!(op->flags & (VD_META_FIELD_FLAG_FIXED_ARRAY | VD_META_FIELD_FLAG_INTRUSIVE_ARRAY))) {
+        vd_meta__write_json_value(op, location, buffer, pretty);
+        return;
     }
 
-    if (slice->str[slice->pos] != c) {
-        return 0;
+    char *array = location;
+    size_t len = op->count;
+    if (op->flags & VD_META_FIELD_FLAG_INTRUSIVE_ARRAY) {
+        array = *(char**)location;
+        len = op->props->len(array, op->props->c);
     }
 
-    slice->pos++;
-
-    return 1;
-}
+    if (pretty >= 0) vd_meta__buffer_pushchar(buffer, '\n');
+    vd_meta__buffer_push_indent(buffer, pretty);
+    vd_meta__buffer_pushchar(buffer, '[');
+    if (pretty >= 0) vd_meta__buffer_pushchar(buffer, '\n');
 
-static int vd_meta__slice_peek_char(VD_Meta__Slice *slice, char c)
-{
-    if (slice->pos >= slice->len) {
-        return 0;
-    }
+    int inner = pretty >= 0 ? pretty + 4 : pretty;
+    for (size_t i = 0; i < len; ++i) {
+        vd_meta__buffer_push_indent(buffer, inner);
+        vd_meta__write_json_value(op, array + i * op->size, buffer, inner);
 
-    return slice->str[slice->pos] == c;
-}
+        if (i < len - 1) {
+            vd_meta__buffer_pushchar(buffer, ',');
+        }
 
-static char vd_meta__slice_read_char(VD_Meta__Slice *slice)
-{
-    if (slice->pos >= slice->len) {
-        return 0;
+        if (pretty >= 0) vd_meta__buffer_pushchar(buffer, '\n');
     }
 
-    return slice->str[slice->pos++];
+    vd_meta__buffer_push_indent(buffer, pretty);
+    vd_meta__buffer_pushchar(buffer, ']');
 }
 
-static int vd_meta__slice_skip_whitespace(VD_Meta__Slice *slice)
+static void vd_meta__write_json_object(
+    VD_Meta_Plan *plan,
+    void *object,
+    VD_Meta__Buffer *buffer,
+    int pretty)
 {
-    while (slice->pos < slice->len) {
-        if (slice->str[slice->pos] == ' ' ||
-            slice->str[slice->pos] == '\t' ||
-            slice->str[slice->pos] == '\n' ||
-            slice->str[slice->pos] == '\r') {
-            slice->pos++;
-        } else {
-            break;
-        }
-    }
+    vd_meta__buffer_pushchar(buffer, '{');
+    if (pretty >= 0) vd_meta__buffer_pushchar(buffer, '\n');
 
-    return 1;
-}
+    int inner = pretty >= 0 ? pretty + 4 : pretty;
+
+    // Write the type name
+    vd_meta__buffer_push_indent(buffer, inner);
+    vd_meta__buffer_pushstr(buffer, "\"--vd-meta-type-name--\":");
+    if (pretty >= 0) vd_meta__buffer_pushchar(buffer, ' ');
+    vd_meta__buffer_pushchar(buffer, '"');
+    vd_meta__buffer_pushstr(buffer, plan->name);
+    vd_meta__buffer_push(buffer, "\",", 2);
+    if (pretty >= 0) vd_meta__buffer_pushchar(buffer, '\n');
 
-#define VD_META__SLICE_COPY(x) (VD_Meta__Slice)  \
-    {.str = (x)->str + (x)->pos, .len = (x)->len - (x)->pos, .pos = 0} 
+    // Write the fields
+    for (size_t fi = 0; fi < plan->fields_len; ++fi) {
+        const VD_Meta_PlanOp *op = &plan->fields[fi];
 
-#define VD_META__SLICE_SUB(s, l) (VD_Meta__Slice) \
-    {.str = (s)->str + (s)->pos, .len = l, .pos = 0}
+        vd_meta__buffer_push_indent(buffer, inner);
+        vd_meta__buffer_pushchar(buffer, '"');
+        vd_meta__buffer_push(buffer, op->field->name, op->field->name_len);
+        vd_meta__buffer_push(buffer, "\":", 2);
+        if (pretty >= 0) vd_meta__buffer_pushchar(buffer, ' ');
 
-#define VD_META__SLICE_APPLY(from, to) do {\
-    (to)->pos += (from)->pos; \
-    } while (0)
+        vd_meta__write_json_field(op, object, buffer, inner);
 
-static VD_Meta_Field *find_field(VD_Meta_Descriptor *descriptor, const char *name)
-{
-    for (int i = 0; i < descriptor->object.len; ++i) {
-        if (strcmp(descriptor->object.fields[i].name, name) == 0) {
-            return &descriptor->object.fields[i];
+        if (fi < plan->fields_len - 1) {
+            vd_meta__buffer_pushchar(buffer, ',');
         }
+
+        if (pretty >= 0) vd_meta__buffer_pushchar(buffer, '\n');
     }
 
-    return 0;
+    vd_meta__buffer_push_indent(buffer, pretty);
+    vd_meta__buffer_pushchar(buffer, '}');
 }
 
-static int vd_meta__parse_json_string(
-    VD_Meta__Slice *slice,
-    VD_Meta__Buffer *buffer,
-    const char **key)
+int vd_meta_write_json(
+    VD_Meta_Registry *registry,
+    void *object,
+    VD_Meta_ID type,
+    VD_Meta_WriteOptions *options,
+    char **out_json,
+    size_t *out_len)
 {
-    VD_Meta__Slice s = VD_META__SLICE_COPY(slice);
-
-    if (!vd_meta__slice_expect_char(&s, '\"')) {
-        return 0;
+    if (options->alloc == 0) {
+        options->alloc = registry->alloc;
+        options->alloc_ctx = registry->alloc_ctx;
     }
 
-    char c = vd_meta__slice_read_char(&s);
-    size_t start = vd_meta__buffer_now(buffer);
-
-    while (c != '\"' && c != 0) {
-        if (c == '\\') {
-            char e = vd_meta__slice_read_char(&s);
-            switch (e) {
-                case '\\': vd_meta__buffer_pushchar(buffer, '\\'); break;
-                case '\"': vd_meta__buffer_pushchar(buffer, '\"'); break;
-                case '/': vd_meta__buffer_pushchar(buffer, '/'); break;
-                case 'b': vd_meta__buffer_pushchar(buffer, '\b'); break;
-                case 'f': vd_meta__buffer_pushchar(buffer, '\f'); break;
-                case 'n': vd_meta__buffer_pushchar(buffer, '\n'); break;
-                case 'r': vd_meta__buffer_pushchar(buffer, '\r'); break;
-                case 't': vd_meta__buffer_pushchar(buffer, '\t'); break;
-                default: vd_meta__buffer_pushchar(buffer, e); break;
-            }
-        } else {
-            vd_meta__buffer_pushchar(buffer, c);
-        }
-
-        c = vd_meta__slice_read_char(&s);
+    VD_Meta_Plan *plan = vd_meta_get_plan(registry, type);
+    if (plan == 0) {
+        return VD_META_DESCRIPTOR_NOT_FOUND;
     }
 
-    if (c == 0) {
-        return 0;
+    if (plan->type_class != VD_META_TYPE_OBJECT) {
+        return VD_META_INVALID_TYPE;
     }
 
-    vd_meta__buffer_terminate(buffer);
-
-    *key = (char *)vd_meta__buffer_get(buffer, start);
-
-    VD_META__SLICE_APPLY(&s, slice);
+    VD_Meta__Buffer buffer = {
+        .ptr = 0,
+        .len = 0,
+        .cap = 0,
+        .alloc = options->alloc,
+        .alloc_ctx = options->alloc_ctx,
+    };
 
-    return 1;
-}
+    vd_meta__write_json_object(plan, object, &buffer, options->pretty);
+    vd_meta__buffer_terminate(&buffer);
 
-static int vd_meta__json_skip_value(VD_Meta__Slice *slice)
-{
-    int num_brackets = 0;
-    int num_braces = 0;
-    while (1) {
-        char c = vd_meta__slice_read_char(slice);
-        if (c == 0) {
-            return 0;
-        }
+    *out_json = buffer.ptr;
+    *out_len = buffer.len;
 
-        if (c == '[') {
-            num_brackets++;
-        } else if (c == ']') {
-            num_brackets--;
-        } else if (c == '{') {
-            num_braces++;
-        } else if (c == '}') {
-            num_braces--;
-        } else if (c == ',' && num_brackets == 0 && num_braces == 0) {
-            return 1;
-        }
-    }
+    return 0;
 }
 
 void *vd_meta_field_array_add(
@@ -1364,9 +1644,7 @@ size_t vd_meta_field_array_len(
     VD_Meta_Field *field,
     void *object)
 {
-    if (!(field->flags & VD_META_FIELD_FLAG_INTRUSIVE_ARRAY) ||
-        !(field->flags & VD_META_FIELD_FLAG_FIXED_ARRAY))
-    {
+    if (!(field->flags & (VD_META_FIELD_FLAG_FIXED_ARRAY | VD_META_FIELD_FLAG_INTRUSIVE_ARRAY))) {
         return 0;
     }
 
@@ -1392,9 +1670,7 @@ void vd_meta_field_array_set(
     void *object,
     void *new_value)
 {
-    if (!(field->flags & VD_META_FIELD_FLAG_INTRUSIVE_ARRAY) ||
-        !(field->flags & VD_META_FIELD_FLAG_FIXED_ARRAY))
-    {
+    if (!(field->flags & (VD_META_FIELD_FLAG_FIXED_ARRAY | VD_META_FIELD_FLAG_INTRUSIVE_ARRAY))) {
         return;
     }
 
@@ -1403,10 +1679,12 @@ void vd_meta_field_array_set(
     if (field->flags & VD_META_FIELD_FLAG_FIXED_ARRAY) {
         void *array = (void*)((char*)object + field->offset);
         item_location = (char*)array + i * field_desc->size;
-    } else if (field->flags & VD_META_FIELD_FLAG_INTRUSIVE_ARRAY) {
+    } else {
         void *array = *(void**)((char*)object + field->offset);
         item_location = (char*)array + i * field_desc->size;
     }
+
+    memcpy(item_location, new_value, field_desc->size);
 }
 
 void *vd_meta_field_array_get(
@@ -1424,415 +1702,1533 @@ void *vd_meta_field_array_get(
     return (char*)array + i * field_desc->size;
 }
 
-static int vd_meta__parse_json_object(
-    VD_Meta_Registry *registry,
-    VD_Meta_ID type,
-    VD_Meta__Arena *temp,
-    VD_Meta__Buffer *btemp,
-    VD_Meta__Slice *slice,
-    VD_Meta_AllocProc *alloc,
-    void *alloc_ctx,
-    void *out_object);
-
-static int vd_meta__parse_json_descriptor(
-    VD_Meta_Registry *registry,
-    VD_Meta_Field *field,
-    VD_Meta__Arena *temp,
-    VD_Meta__Buffer *btemp,
-    VD_Meta__Slice *slice,
-    VD_Meta_AllocProc *alloc,
-    void *alloc_ctx,
-    VD_Meta_Descriptor *desc,
-    void *object)
-{
-    VD_Meta__Slice s = VD_META__SLICE_COPY(slice);
-    if (vd_meta__slice_peek_char(&s, '{')) {
-        int ret = vd_meta__parse_json_object(
-            registry,
-            field->type,
-            temp,
-            btemp,
-            &s,
-            alloc,
-            alloc_ctx,
-            object);
+/* ----JSON READER------------------------------------------------------------------------------- */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define VD_META__SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define VD_META__NEON 1
+#include <arm_neon.h>
+#endif
 
-        if (ret < 0) {
-            return ret;
-        }
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
-        VD_META__SLICE_APPLY(&s, slice);
-        return 0;
-    } else {
-        switch (desc->type_class) {
-            case VD_META_TYPE_PRIMITIVE: {
-
-                switch (desc->primitive.type) {
-                    case VD_META_PRIMITIVE_TYPE_I8: {
-                        char *end;
-                        *(int8_t*)object = strtol(s.str, &end, 10);
-                        s.pos += end - s.str;
-                        VD_META__SLICE_APPLY(&s, slice);
-                    } break;
-
-                    case VD_META_PRIMITIVE_TYPE_U8: {
-                        char *end;
-                        *(uint8_t*)object = strtoul(s.str, &end, 10);
-                        s.pos += end - s.str;
-                        VD_META__SLICE_APPLY(&s, slice);
-                    } break;
-
-                    case VD_META_PRIMITIVE_TYPE_I16: {
-                        char *end;
-                        *(int16_t*)object = strtol(s.str, &end, 10);
-                        s.pos += end - s.str;
-                        VD_META__SLICE_APPLY(&s, slice);
-                    } break;
-
-                    case VD_META_PRIMITIVE_TYPE_U16: {
-                        char *end;
-                        *(uint16_t*)object = strtoul(s.str, &end, 10);
-                        s.pos += end - s.str;
-                        VD_META__SLICE_APPLY(&s, slice);
-                    } break;
-
-                    case VD_META_PRIMITIVE_TYPE_I32: {
-                        char *end;
-                        *(int32_t*)object = strtol(s.str, &end, 10);
-                        s.pos += end - s.str;
-                        VD_META__SLICE_APPLY(&s, slice);
-                    } break;
-
-                    case VD_META_PRIMITIVE_TYPE_U32: {
-                        char *end;
-                        *(uint32_t*)object = strtoul(s.str, &end, 10);
-                        s.pos += end - s.str;
-                        VD_META__SLICE_APPLY(&s, slice);
-                    } break;
-
-                    case VD_META_PRIMITIVE_TYPE_I64: {
-                        char *end;
-                        *(int64_t*)object = strtoll(s.str, &end, 10);
-                        s.pos += end - s.str;
-                        VD_META__SLICE_APPLY(&s, slice);
-                    } break;
-
-                    case VD_META_PRIMITIVE_TYPE_U64: {
-                        char *end;
-                        *(uint64_t*)object = strtoull(s.str, &end, 10);
-                        s.pos += end - s.str;
-                        VD_META__SLICE_APPLY(&s, slice);
-                    } break;
-
-                    case VD_META_PRIMITIVE_TYPE_F32: {
-                        char *end;
-                        *(float*)object = strtof(s.str, &end);
-                        s.pos += end - s.str;
-                        VD_META__SLICE_APPLY(&s, slice);
-                    } break;
-
-                    case VD_META_PRIMITIVE_TYPE_F64: {
-                        char *end;
-                        *(double*)object = strtod(s.str, &end);
-                        s.pos += end - s.str;
-                        VD_META__SLICE_APPLY(&s, slice);
-                    } break;
-
-                    case VD_META_PRIMITIVE_TYPE_CHAR8: {
-                        if (vd_meta__slice_expect_char(&s, '"')) {
-                            *(char*)object = vd_meta__slice_read_char(&s);
-                            if (vd_meta__slice_expect_char(&s, '"')) {
-                                VD_META__SLICE_APPLY(&s, slice);
-                            }
-                        }
-                    } break;
-                }
+#ifndef VD_META__SSE2
+#define VD_META__SSE2 0
+#endif
 
-            } break;
-
-            case VD_META_TYPE_STRING: {
-                switch (desc->string.type) {
-                    case VD_META_STRING_TYPE_CSTRING: {
-                        const char *key;
-                        if (vd_meta__parse_json_string(&s, btemp, &key)) {
-                            *(char**)object = alloc(0, 0, strlen(key) + 1, alloc_ctx);
-                            strcpy(*(char**)object, key);
-                            VD_META__SLICE_APPLY(&s, slice);
-                        }
-                    } break;
-                }
-            } break;
-        }
+#ifndef VD_META__NEON
+#define VD_META__NEON 0
+#endif
 
-        return 0;
-    }
-}
+#define VD_META__TYPE_NAME_KEY "--vd-meta-type-name--"
+#define VD_META__DEFAULT_CHUNK_SIZE (64 * 1024)
 
-static int vd_meta__parse_json_field(
-    VD_Meta_Registry *registry,
-    VD_Meta_Field *field,
-    VD_Meta__Arena *temp,
-    VD_Meta__Buffer *btemp,
-    VD_Meta__Slice *slice,
-    VD_Meta_AllocProc *alloc,
-    void *alloc_ctx,
-    void *object)
+static inline uint32_t vd_meta__ctz64(uint64_t x)
 {
-    VD_Meta__Slice s = VD_META__SLICE_COPY(slice);
-    vd_meta__slice_skip_whitespace(&s);
-
-    if (vd_meta__slice_peek_char(&s, '[')) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctzll(x);
+#endif
+}
 
-        VD_Meta_Descriptor *field_desc = vd_meta_get_descriptor(registry, field->type);
+enum {
+    /** Stop at '"' and '\\' */
+    VD_META__JSON_SCAN_STRING,
+    /** Stop at '"', '{', '}', '[' and ']' */
+    VD_META__JSON_SCAN_STRUCTURAL,
+};
 
-        if (!field->flags & VD_META_FIELD_FLAG_FIXED_ARRAY ||
-            !field->flags & VD_META_FIELD_FLAG_INTRUSIVE_ARRAY)
-        {
-            return VD_META_INVALID_JSON;
+/**
+ * @brief Find the first character of interest in [p, end), 16 bytes at a time.
+ * @return The offset of the character, or end - p if there is none.
+ * @note '{' | 0x20 == '{' == '[' | 0x20, and the same holds for '}' and ']', so the structural scan
+ * needs three compares per block.
+ */
+static inline size_t vd_meta__json_scan(const char *p, const char *end, int mode)
+{
+    const char *s = p;
+
+#if VD_META__SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i lower = _mm_set1_epi8(0x20);
+    const __m128i open = _mm_set1_epi8('{');
+    const __m128i close = _mm_set1_epi8('}');
+    while (end - s >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)s);
+        __m128i eq;
+        if (mode == VD_META__JSON_SCAN_STRING) {
+            eq = _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash));
+        } else {
+            __m128i folded = _mm_or_si128(v, lower);
+            eq = _mm_or_si128(
+                _mm_cmpeq_epi8(v, quote),
+                _mm_or_si128(_mm_cmpeq_epi8(folded, open), _mm_cmpeq_epi8(folded, close)));
         }
 
-        vd_meta__slice_expect_char(&s, '[');
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(eq);
+        if (mask) {
+            return (size_t)(s - p) + vd_meta__ctz64(mask);
+        }
 
-        int i = 0;
-        while (1) {
-            vd_meta__slice_skip_whitespace(&s);
+        s += 16;
+    }
+#elif VD_META__NEON
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    const uint8x16_t lower = vdupq_n_u8(0x20);
+    const uint8x16_t open = vdupq_n_u8('{');
+    const uint8x16_t close = vdupq_n_u8('}');
+    while (end - s >= 16) {
+        uint8x16_t v = vld1q_u8((const uint8_t*)s);
+        uint8x16_t eq;
+        if (mode == VD_META__JSON_SCAN_STRING) {
+            eq = vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, backslash));
+        } else {
+            uint8x16_t folded = vorrq_u8(v, lower);
+            eq = vorrq_u8(vceqq_u8(v, quote), vorrq_u8(vceqq_u8(folded, open), vceqq_u8(folded, close)));
+        }
 
-            if (field->flags & VD_META_FIELD_FLAG_FIXED_ARRAY) {
-                if (i >= field->fixed_array.len) {
-                    return VD_META_INVALID_JSON;
-                }
+        // No movemask on NEON, so narrow to 4 bits per lane
+        uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+        if (mask) {
+            return (size_t)(s - p) + (vd_meta__ctz64(mask) >> 2);
+        }
 
-                void *ptr = vd_meta_field_array_get(registry, field_desc, field, i, object);
+        s += 16;
+    }
+#else
+    // 8 bytes at a time. has_zero can flag bytes after a real match, but never before one, so the
+    // lowest flagged byte is always right.
+    #define VD_META__HAS_ZERO(x) (((x) - 0x0101010101010101ull) & ~(x) & 0x8080808080808080ull)
+    while (end - s >= 8) {
+        uint64_t v;
+        memcpy(&v, s, sizeof(v));
+        uint64_t mask;
+        if (mode == VD_META__JSON_SCAN_STRING) {
+            uint64_t q = v ^ 0x2222222222222222ull;
+            uint64_t b = v ^ 0x5C5C5C5C5C5C5C5Cull;
+            mask = VD_META__HAS_ZERO(q) | VD_META__HAS_ZERO(b);
+        } else {
+            uint64_t folded = v | 0x2020202020202020ull;
+            uint64_t q = v ^ 0x2222222222222222ull;
+            uint64_t o = folded ^ 0x7B7B7B7B7B7B7B7Bull;
+            uint64_t c = folded ^ 0x7D7D7D7D7D7D7D7Dull;
+            mask = VD_META__HAS_ZERO(q) | VD_META__HAS_ZERO(o) | VD_META__HAS_ZERO(c);
+        }
 
-                int ret = vd_meta__parse_json_descriptor(
-                    registry,
-                    field,
-                    temp,
-                    btemp,
-                    &s,
-                    alloc,
-                    alloc_ctx,
-                    vd_meta_get_descriptor(registry, field->type),
-                    ptr);
+        if (mask) {
+            return (size_t)(s - p) + (vd_meta__ctz64(mask) >> 3);
+        }
 
-                if (ret < 0) {
-                    return ret;
-                }
-            }
+        s += 8;
+    }
+    #undef VD_META__HAS_ZERO
+#endif
 
-            if (field->flags & VD_META_FIELD_FLAG_INTRUSIVE_ARRAY) {
-                void *ptr = vd_meta_field_array_add(registry, field_desc, field, object);
+    if (mode == VD_META__JSON_SCAN_STRING) {
+        while (s < end && *s != '"' && *s != '\\') {
+            s++;
+        }
+    } else {
+        while (s < end && *s != '"' && (*s | 0x20) != '{' && (*s | 0x20) != '}') {
+            s++;
+        }
+    }
 
-                int ret = vd_meta__parse_json_descriptor(
-                    registry,
-                    field,
-                    temp,
-                    btemp,
-                    &s,
-                    alloc,
-                    alloc_ctx,
-                    vd_meta_get_descriptor(registry, field->type),
-                    ptr);
+    return (size_t)(s - p);
+}
 
-                if (ret < 0) {
-                    return ret;
-                }
-            }
+typedef struct {
+    const char *data;
+    size_t      len;
+} VD_Meta__JsonStr;
 
-            if (vd_meta__slice_expect_char(&s, ']')) {
-                break;
-            }
+typedef struct {
+    /** The cursor, and the end of the input that is available right now */
+    const char          *p;
+    const char          *end;
 
-            if (!vd_meta__slice_expect_char(&s, ',')) {
-                return VD_META_INVALID_JSON;
-            }
+    /** The window that streamed input is read into. Unused when parsing a whole buffer. */
+    char                *buf;
+    size_t              cap;
+    VD_Meta_ReadProc    *read;
+    void                *read_ctx;
+    int                 eof;
 
-            i++;
-        }
+    /** Strings with escapes are unescaped here. */
+    VD_Meta__Buffer     scratch;
+} VD_Meta__JsonReader;
 
-        VD_META__SLICE_APPLY(&s, slice);
+/**
+ * @brief Read more streamed input. Everything from *anchor (or the cursor if anchor is null) on is
+ * kept, moved to the front of the window. The cursor and the anchor are updated to point into it.
+ * @return 1 if there is more input, 0 at the end.
+ */
+static int vd_meta__json_refill(VD_Meta__JsonReader *r, const char **anchor)
+{
+    if (r->read == 0 || r->eof) {
+        return 0;
+    }
 
-    } else {
-        VD_Meta_Descriptor *desc = vd_meta_get_descriptor(registry, field->type);
+    const char *keep = anchor ? *anchor : r->p;
+    size_t kept = (size_t)(r->end - keep);
+    size_t cursor = (size_t)(r->p - keep);
 
-        if (desc == 0) {
-            return VD_META_DESCRIPTOR_NOT_FOUND;
-        }
+    if (kept > 0 && keep != r->buf) {
+        memmove(r->buf, keep, kept);
+    }
 
-        int ret = vd_meta__parse_json_descriptor(
-            registry,
-            field,
-            temp,
-            btemp,
-            &s,
-            alloc,
-            alloc_ctx,
-            desc,
-            object);
+    // A single token fills the whole window
+    if (kept == r->cap) {
+        r->buf = (char*)r->scratch.alloc(r->buf, r->cap, r->cap * 2, r->scratch.alloc_ctx);
+        r->cap *= 2;
+    }
 
-        if (ret < 0) {
-            return ret;
-        }
+    size_t got = r->read(r->buf + kept, r->cap - kept, r->read_ctx);
+    if (got == 0) {
+        r->eof = 1;
+    }
 
-        VD_META__SLICE_APPLY(&s, slice);
+    r->p = r->buf + cursor;
+    r->end = r->buf + kept + got;
+    if (anchor) {
+        *anchor = r->buf;
     }
 
-    return 0;
+    return got > 0;
 }
 
-static int vd_meta__parse_json_object(
-    VD_Meta_Registry *registry,
-    VD_Meta_ID type,
-    VD_Meta__Arena *temp,
-    VD_Meta__Buffer *btemp,
-    VD_Meta__Slice *slice,
-    VD_Meta_AllocProc *alloc,
-    void *alloc_ctx,
-    void *out_object)
+/** Makes sure that at least n bytes from *anchor on are available. */
+static int vd_meta__json_ensure(VD_Meta__JsonReader *r, const char **anchor, size_t n)
 {
-    VD_Meta_Descriptor *descriptor = vd_meta_get_descriptor(registry, type);
-    if (descriptor == 0) {
-        return VD_META_DESCRIPTOR_NOT_FOUND;
+    while ((size_t)(r->end - *anchor) < n) {
+        if (!vd_meta__json_refill(r, anchor)) {
+            return 0;
+        }
     }
 
-    VD_Meta__Slice s = VD_META__SLICE_COPY(slice);
-    vd_meta__slice_skip_whitespace(&s);
-
-    if (!vd_meta__slice_expect_char(&s, '{')) {
-        return VD_META_INVALID_JSON;
-    }
+    return 1;
+}
 
-    while (1) {
-        vd_meta__slice_skip_whitespace(&s);
+/** Skips whitespace and returns the next character without consuming it, or 0 at the end. */
+static char vd_meta__json_peek(VD_Meta__JsonReader *r)
+{
+    for (;;) {
+        while (r->p < r->end) {
+            char c = *r->p;
+            if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+                return c;
+            }
 
-        const char *key;
-        if (!vd_meta__parse_json_string(&s, btemp, &key) < 0) {
-            return VD_META_INVALID_JSON;
+            r->p++;
         }
 
-        vd_meta__slice_skip_whitespace(&s);
-
-        if (!vd_meta__slice_expect_char(&s, ':')) {
-            return VD_META_INVALID_JSON;
+        if (!vd_meta__json_refill(r, 0)) {
+            return 0;
         }
+    }
+}
 
-        vd_meta__slice_skip_whitespace(&s);
+static int vd_meta__json_expect(VD_Meta__JsonReader *r, char c)
+{
+    if (vd_meta__json_peek(r) != c) {
+        return 0;
+    }
 
-        VD_Meta_Field *field = find_field(descriptor, key);
+    r->p++;
+    return 1;
+}
 
-        if (field == 0) {
-            if (!vd_meta__json_skip_value(&s)) {
+static void vd_meta__json_push(VD_Meta__Buffer *buffer, const char *s, size_t len)
+{
+    vd_meta__buffer_ensure_add(buffer, len);
+    memcpy(buffer->ptr + buffer->len, s, len);
+    buffer->len += len;
+}
+
+static int vd_meta__json_hex4(const char *s, uint32_t *out)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) {
+        char c = s[i];
+        v <<= 4;
+        if (c >= '0' && c <= '9') {
+            v |= (uint32_t)(c - '0');
+        } else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+            v |= (uint32_t)((c | 0x20) - 'a' + 10);
+        } else {
+            return 0;
+        }
+    }
+
+    *out = v;
+    return 1;
+}
+
+static void vd_meta__json_push_utf8(VD_Meta__Buffer *buffer, uint32_t cp)
+{
+    char u[4];
+    size_t n;
+    if (cp < 0x80) {
+        u[0] = (char)cp;
+        n = 1;
+    } else if (cp < 0x800) {
+        u[0] = (char)(0xC0 | (cp >> 6));
+        u[1] = (char)(0x80 | (cp & 0x3F));
+        n = 2;
+    } else if (cp < 0x10000) {
+        u[0] = (char)(0xE0 | (cp >> 12));
+        u[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        u[2] = (char)(0x80 | (cp & 0x3F));
+        n = 3;
+    } else {
+        u[0] = (char)(0xF0 | (cp >> 18));
+        u[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        u[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        u[3] = (char)(0x80 | (cp & 0x3F));
+        n = 4;
+    }
+
+    vd_meta__json_push(buffer, u, n);
+}
+
+/**
+ * @brief Read the string at the cursor. Strings without escapes are returned as a slice of the
+ * input, the rest are unescaped into the scratch buffer. Either way, the result is only valid
+ * until the next read.
+ */
+static int vd_meta__json_read_string(VD_Meta__JsonReader *r, VD_Meta__JsonStr *out)
+{
+    if (!vd_meta__json_expect(r, '"')) {
+        return 0;
+    }
+
+    // start is the first byte that isn't part of the result yet
+    const char *start = r->p;
+    size_t at = 0;
+    int escaped = 0;
+
+    for (;;) {
+        at += vd_meta__json_scan(start + at, r->end, VD_META__JSON_SCAN_STRING);
+        if (start + at >= r->end) {
+            r->p = r->end;
+            if (!vd_meta__json_refill(r, &start)) {
+                return 0;
+            }
+
+            continue;
+        }
+
+        if (start[at] == '"') {
+            if (escaped) {
+                vd_meta__json_push(&r->scratch, start, at);
+                out->data = r->scratch.ptr;
+                out->len = r->scratch.len;
+            } else {
+                out->data = start;
+                out->len = at;
+            }
+
+            r->p = start + at + 1;
+            return 1;
+        }
+
+        if (!escaped) {
+            escaped = 1;
+            vd_meta__buffer_clear(&r->scratch);
+        }
+
+        vd_meta__json_push(&r->scratch, start, at);
+        start += at;
+        at = 0;
+        r->p = start;
+
+        if (!vd_meta__json_ensure(r, &start, 2)) {
+            return 0;
+        }
+
+        char e = start[1];
+        char c;
+        switch (e) {
+            case 'b': c = '\b'; break;
+            case 'f': c = '\f'; break;
+            case 'n': c = '\n'; break;
+            case 'r': c = '\r'; break;
+            case 't': c = '\t'; break;
+            case 'u': c = 0;    break;
+            default:  c = e;    break;
+        }
+
+        if (e != 'u') {
+            vd_meta__buffer_pushchar(&r->scratch, c);
+            start += 2;
+            continue;
+        }
+
+        uint32_t cp;
+        if (!vd_meta__json_ensure(r, &start, 6) || !vd_meta__json_hex4(start + 2, &cp)) {
+            return 0;
+        }
+
+        start += 6;
+        r->p = start;
+
+        // A high surrogate is followed by the low one
+        if (cp >= 0xD800 && cp <= 0xDBFF &&
+            vd_meta__json_ensure(r, &start, 6) &&
+            start[0] == '\\' && start[1] == 'u')
+        {
+            uint32_t low;
+            if (vd_meta__json_hex4(start + 2, &low) && low >= 0xDC00 && low <= 0xDFFF) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                start += 6;
+            }
+        }
+
+        vd_meta__json_push_utf8(&r->scratch, cp);
+    }
+}
+
+/** Read the number, true, false or null at the cursor, as a slice of the input. */
+static int vd_meta__json_read_scalar(VD_Meta__JsonReader *r, VD_Meta__JsonStr *out)
+{
+    if (vd_meta__json_peek(r) == 0) {
+        return 0;
+    }
+
+    const char *start = r->p;
+    size_t at = 0;
+    for (;;) {
+        while (start + at < r->end) {
+            char c = start[at];
+            if (c == ',' || c == '}' || c == ']' || c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+                break;
+            }
+
+            at++;
+        }
+
+        if (start + at < r->end) {
+            break;
+        }
+
+        r->p = r->end;
+        if (!vd_meta__json_refill(r, &start)) {
+            break;
+        }
+    }
+
+    if (at == 0) {
+        return 0;
+    }
+
+    out->data = start;
+    out->len = at;
+    r->p = start + at;
+    return 1;
+}
+
+static int vd_meta__json_str_eq(VD_Meta__JsonStr s, const char *lit)
+{
+    size_t len = strlen(lit);
+    return s.len == len && memcmp(s.data, lit, len) == 0;
+}
+
+/** Copies a scalar into a null terminated buffer, for the strto* fallbacks. */
+static int vd_meta__json_scalar_to_cstr(VD_Meta__JsonStr s, char *buf, size_t cap)
+{
+    if (s.len >= cap) {
+        return 0;
+    }
+
+    memcpy(buf, s.data, s.len);
+    buf[s.len] = 0;
+    return 1;
+}
+
+static const double VD_META__POW10[23] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/**
+ * @brief Parse a number the fast way, when the result is exact: up to 19 digits, and, for the
+ * fractional ones, a mantissa under 2^53 scaled by a power of 10 no larger than 1e22 (Clinger).
+ * @return 0 if the number has to go through strtod/strtoll instead.
+ */
+static int vd_meta__json_parse_number(
+    VD_Meta__JsonStr s,
+    int *out_neg,
+    uint64_t *out_int,
+    int *out_is_int,
+    double *out_f64)
+{
+    const char *p = s.data;
+    const char *end = s.data + s.len;
+    int neg = 0;
+    if (p < end && *p == '-') {
+        neg = 1;
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exp10 = 0;
+    int is_int = 1;
+
+    while (p < end && *p >= '0' && *p <= '9') {
+        mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+        digits++;
+        p++;
+    }
+
+    if (p < end && *p == '.') {
+        is_int = 0;
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            digits++;
+            exp10--;
+            p++;
+        }
+    }
+
+    if (p < end && (*p | 0x20) == 'e') {
+        is_int = 0;
+        p++;
+        int eneg = 0;
+        if (p < end && (*p == '-' || *p == '+')) {
+            eneg = *p == '-';
+            p++;
+        }
+
+        int e = 0;
+        while (p < end && *p >= '0' && *p <= '9' && e < 10000) {
+            e = e * 10 + (*p - '0');
+            p++;
+        }
+
+        exp10 += eneg ? -e : e;
+    }
+
+    if (p != end || digits == 0 || digits > 19) {
+        return 0;
+    }
+
+    *out_neg = neg;
+    *out_int = mantissa;
+    *out_is_int = is_int;
+
+    if (is_int) {
+        *out_f64 = neg ? -(double)mantissa : (double)mantissa;
+        return 1;
+    }
+
+    // The trailing zeros that "%f" writes don't need to be part of the mantissa
+    while (exp10 < 0 && mantissa != 0 && mantissa % 10 == 0) {
+        mantissa /= 10;
+        exp10++;
+    }
+
+    if (mantissa > (1ull << 53) || exp10 < -22 || exp10 > 22) {
+        return 0;
+    }
+
+    double d = (double)mantissa;
+    d = exp10 < 0 ? d / VD_META__POW10[-exp10] : d * VD_META__POW10[exp10];
+    *out_f64 = neg ? -d : d;
+    return 1;
+}
+
+static int vd_meta__json_parse_primitive(VD_Meta__JsonStr s, VD_Meta_PrimitiveType type, void *object)
+{
+    int neg, is_int;
+    uint64_t u;
+    double d;
+    char buf[512];
+
+    if (!vd_meta__json_parse_number(s, &neg, &u, &is_int, &d)) {
+        if (!vd_meta__json_scalar_to_cstr(s, buf, sizeof(buf))) {
+            return 0;
+        }
+
+        char *end;
+        if (type == VD_META_PRIMITIVE_TYPE_F32) {
+            *(float*)object = strtof(buf, &end);
+            return *end == 0;
+        }
+
+        d = strtod(buf, &end);
+        if (*end != 0) {
+            return 0;
+        }
+
+        neg = d < 0;
+        is_int = 0;
+        u = 0;
+
+        if (type == VD_META_PRIMITIVE_TYPE_U64 && buf[0] != '-' && !strpbrk(buf, ".eE")) {
+            u = strtoull(buf, &end, 10);
+            is_int = 1;
+        } else if (type == VD_META_PRIMITIVE_TYPE_I64 && !strpbrk(buf, ".eE")) {
+            int64_t i = strtoll(buf, &end, 10);
+            u = neg ? (uint64_t)0 - (uint64_t)i : (uint64_t)i;
+            is_int = 1;
+        }
+    }
+
+    if (type == VD_META_PRIMITIVE_TYPE_F32) {
+        // Rounding to double and then to float only goes wrong when the double lands exactly
+        // halfway between two floats, or in the float denormal range.
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        double ad = d < 0 ? -d : d;
+        if (((bits & ((1ull << 29) - 1)) == (1ull << 28)) || (ad != 0 && ad < 1.2e-38)) {
+            if (!vd_meta__json_scalar_to_cstr(s, buf, sizeof(buf))) {
+                return 0;
+            }
+
+            *(float*)object = strtof(buf, 0);
+        } else {
+            *(float*)object = (float)d;
+        }
+
+        return 1;
+    }
+
+    if (type == VD_META_PRIMITIVE_TYPE_F64) {
+        *(double*)object = d;
+        return 1;
+    }
+
+    int64_t i = is_int ? (int64_t)(neg ? (uint64_t)0 - u : u) : (int64_t)d;
+    switch (type) {
+        case VD_META_PRIMITIVE_TYPE_I8:  *(int8_t*)object   = (int8_t)i;   break;
+        case VD_META_PRIMITIVE_TYPE_U8:  *(uint8_t*)object  = (uint8_t)i;  break;
+        case VD_META_PRIMITIVE_TYPE_I16: *(int16_t*)object  = (int16_t)i;  break;
+        case VD_META_PRIMITIVE_TYPE_U16: *(uint16_t*)object = (uint16_t)i; break;
+        case VD_META_PRIMITIVE_TYPE_I32: *(int32_t*)object  = (int32_t)i;  break;
+        case VD_META_PRIMITIVE_TYPE_U32: *(uint32_t*)object = (uint32_t)i; break;
+        case VD_META_PRIMITIVE_TYPE_I64: *(int64_t*)object  = i;           break;
+        case VD_META_PRIMITIVE_TYPE_U64: {
+            *(uint64_t*)object = is_int ? (neg ? (uint64_t)0 - u : u) : (uint64_t)d;
+        } break;
+        default: return 0;
+    }
+
+    return 1;
+}
+
+/** Skips the value at the cursor. Strings are skipped whole, so brackets in them don't count. */
+static int vd_meta__json_skip_value(VD_Meta__JsonReader *r)
+{
+    VD_Meta__JsonStr s;
+    char c = vd_meta__json_peek(r);
+
+    if (c == '"') {
+        return vd_meta__json_read_string(r, &s);
+    }
+
+    if (c != '{' && c != '[') {
+        return vd_meta__json_read_scalar(r, &s);
+    }
+
+    int depth = 0;
+    for (;;) {
+        r->p += vd_meta__json_scan(r->p, r->end, VD_META__JSON_SCAN_STRUCTURAL);
+        if (r->p >= r->end) {
+            if (!vd_meta__json_refill(r, 0)) {
+                return 0;
+            }
+
+            continue;
+        }
+
+        c = *r->p;
+        if (c == '"') {
+            if (!vd_meta__json_read_string(r, &s)) {
+                return 0;
+            }
+
+            continue;
+        }
+
+        r->p++;
+        if (c == '{' || c == '[') {
+            depth++;
+        } else if (--depth == 0) {
+            return 1;
+        }
+    }
+}
+
+static const VD_Meta_PlanOp *vd_meta__json_find_field(
+    VD_Meta_Plan *plan,
+    VD_Meta__JsonStr key,
+    size_t *hint)
+{
+    uint32_t hash = vd_meta__field_name_hash(key.data, key.len);
+    size_t len = plan->fields_len;
+
+    // Keys usually come in the order of the fields, so start looking after the last match
+    for (size_t n = 0; n < len; ++n) {
+        size_t i = *hint + n;
+        if (i >= len) {
+            i -= len;
+        }
+
+        VD_Meta_Field *field = plan->fields[i].field;
+        if (field->name_hash == hash &&
+            field->name_len == key.len &&
+            memcmp(field->name, key.data, key.len) == 0)
+        {
+            *hint = i + 1 < len ? i + 1 : 0;
+            return &plan->fields[i];
+        }
+    }
+
+    return 0;
+}
+
+static int vd_meta__json_parse_members(
+    VD_Meta__JsonReader *r,
+    VD_Meta_Plan *plan,
+    VD_Meta_AllocProc *alloc,
+    void *alloc_ctx,
+    void *object,
+    VD_Meta__JsonStr *first_key);
+
+static int vd_meta__json_parse_value(
+    VD_Meta__JsonReader *r,
+    const VD_Meta_PlanOp *op,
+    VD_Meta_AllocProc *alloc,
+    void *alloc_ctx,
+    void *object)
+{
+    VD_Meta__JsonStr s;
+    char c = vd_meta__json_peek(r);
+
+    // Leave nulls zeroed
+    if (c == 'n') {
+        if (!vd_meta__json_read_scalar(r, &s) || !vd_meta__json_str_eq(s, "null")) {
+            return VD_META_INVALID_JSON;
+        }
+
+        return 0;
+    }
+
+    switch (op->kind) {
+        case VD_META_PLAN_OP_OBJECT: {
+            if (!vd_meta__json_expect(r, '{')) {
                 return VD_META_INVALID_JSON;
             }
 
-            continue;
+            return vd_meta__json_parse_members(r, op->plan, alloc, alloc_ctx, object, 0);
+        } break;
+
+        case VD_META_PLAN_OP_PRIMITIVE: {
+            if (op->primitive == VD_META_PRIMITIVE_TYPE_CHAR8) {
+                if (!vd_meta__json_read_string(r, &s)) {
+                    return VD_META_INVALID_JSON;
+                }
+
+                *(char*)object = s.len > 0 ? s.data[0] : 0;
+                return 0;
+            }
+
+            if (!vd_meta__json_read_scalar(r, &s)) {
+                return VD_META_INVALID_JSON;
+            }
+
+            if (!vd_meta__json_parse_primitive(s, op->primitive, object)) {
+                return VD_META_INVALID_JSON;
+            }
+        } break;
+
+        case VD_META_PLAN_OP_CSTRING: {
+            if (!vd_meta__json_read_string(r, &s)) {
+                return VD_META_INVALID_JSON;
+            }
+
+            char *str = (char*)alloc(0, 0, s.len + 1, alloc_ctx);
+            memcpy(str, s.data, s.len);
+            str[s.len] = 0;
+            *(char**)object = str;
+        } break;
+
+        default: {
+            return vd_meta__json_skip_value(r) ? 0 : VD_META_INVALID_JSON;
+        } break;
+    }
+
+    return 0;
+}
+
+static int vd_meta__json_parse_field(
+    VD_Meta__JsonReader *r,
+    const VD_Meta_PlanOp *op,
+    VD_Meta_AllocProc *alloc,
+    void *alloc_ctx,
+    void *object)
+{
+    char *location = (char*)object + op->offset;
+    if (!(op->flags & (VD_META_FIELD_FLAG_FIXED_ARRAY | VD_META_FIELD_FLAG_INTRUSIVE_ARRAY))) {
+        return vd_meta__json_parse_value(r, op, alloc, alloc_ctx, location);
+    }
+
+    if (!vd_meta__json_expect(r, '[')) {
+        return VD_META_INVALID_JSON;
+    }
+
+    if (vd_meta__json_expect(r, ']')) {
+        return 0;
+    }
+
+    for (size_t i = 0;; ++i) {
+        char *ptr;
+        if (op->flags & VD_META_FIELD_FLAG_FIXED_ARRAY) {
+            if (i >= op->count) {
+                return VD_META_INVALID_JSON;
+            }
+
+            ptr = location + i * op->size;
+        } else {
+            void **array = (void**)location;
+            size_t len = op->props->len(*array, op->props->c);
+            op->props->add(array, 0, op->size, op->props->c);
+            ptr = (char*)*array + len * op->size;
+            memset(ptr, 0, op->size);
+        }
+
+        int ret = vd_meta__json_parse_value(r, op, alloc, alloc_ctx, ptr);
+        if (ret < 0) {
+            return ret;
+        }
+
+        if (vd_meta__json_expect(r, ']')) {
+            return 0;
+        }
+
+        if (!vd_meta__json_expect(r, ',')) {
+            return VD_META_INVALID_JSON;
+        }
+    }
+}
+
+/**
+ * @brief Parse the members of an object, after its '{'.
+ * @param first_key If not null, the first key has already been read (but not its ':').
+ */
+static int vd_meta__json_parse_members(
+    VD_Meta__JsonReader *r,
+    VD_Meta_Plan *plan,
+    VD_Meta_AllocProc *alloc,
+    void *alloc_ctx,
+    void *object,
+    VD_Meta__JsonStr *first_key)
+{
+    if (!first_key && vd_meta__json_expect(r, '}')) {
+        return 0;
+    }
+
+    size_t hint = 0;
+    for (;;) {
+        VD_Meta__JsonStr key;
+        if (first_key) {
+            key = *first_key;
+            first_key = 0;
+        } else if (!vd_meta__json_read_string(r, &key)) {
+            return VD_META_INVALID_JSON;
+        }
+
+        const VD_Meta_PlanOp *op = vd_meta__json_find_field(plan, key, &hint);
+
+        if (!vd_meta__json_expect(r, ':')) {
+            return VD_META_INVALID_JSON;
+        }
+
+        if (op == 0) {
+            if (!vd_meta__json_skip_value(r)) {
+                return VD_META_INVALID_JSON;
+            }
+        } else {
+            int ret = vd_meta__json_parse_field(r, op, alloc, alloc_ctx, object);
+            if (ret < 0) {
+                return ret;
+            }
+        }
+
+        if (vd_meta__json_expect(r, '}')) {
+            return 0;
+        }
+
+        if (!vd_meta__json_expect(r, ',')) {
+            return VD_META_INVALID_JSON;
+        }
+    }
+}
+
+static int vd_meta__json_parse_root(
+    VD_Meta_Registry *registry,
+    VD_Meta_ParseOptions *options,
+    VD_Meta__JsonReader *r,
+    void **out_object)
+{
+    if (options->alloc == 0) {
+        options->alloc = registry->alloc;
+        options->alloc_ctx = registry->alloc_ctx;
+    }
+
+    if (!vd_meta__json_expect(r, '{')) {
+        return VD_META_INVALID_JSON;
+    }
+
+    // The writer puts the type name first, so the type is known before anything else is read
+    VD_Meta_ID type = options->type;
+    VD_Meta__JsonStr key;
+    VD_Meta__JsonStr *first_key = 0;
+    int empty = vd_meta__json_expect(r, '}');
+
+    if (!empty) {
+        if (!vd_meta__json_read_string(r, &key)) {
+            return VD_META_INVALID_JSON;
+        }
+
+        if (vd_meta__json_str_eq(key, VD_META__TYPE_NAME_KEY)) {
+            VD_Meta__JsonStr type_name;
+            char name[256];
+            if (!vd_meta__json_expect(r, ':') ||
+                !vd_meta__json_read_string(r, &type_name) ||
+                !vd_meta__json_scalar_to_cstr(type_name, name, sizeof(name)))
+            {
+                return VD_META_INVALID_JSON;
+            }
+
+            VD_Meta_ID id = vd_meta_get_id(registry, name);
+            if (id.value == 0) {
+                return VD_META_INVALID_TYPE;
+            }
+
+            if (options->type.value != 0 && id.value != options->type.value) {
+                return VD_META_TYPE_MISMATCH;
+            }
+
+            type = id;
+
+            if (vd_meta__json_expect(r, '}')) {
+                empty = 1;
+            } else if (!vd_meta__json_expect(r, ',')) {
+                return VD_META_INVALID_JSON;
+            }
+        } else {
+            first_key = &key;
+        }
+    }
+
+    if (type.value == 0) {
+        return VD_META_TYPE_NOT_FOUND;
+    }
+
+    VD_Meta_Plan *plan = vd_meta_get_plan(registry, type);
+    if (plan == 0) {
+        return VD_META_DESCRIPTOR_NOT_FOUND;
+    }
+
+    if (plan->type_class != VD_META_TYPE_OBJECT) {
+        return VD_META_INVALID_TYPE;
+    }
+
+    if (options->out_type) {
+        *options->out_type = type;
+    }
+
+    *out_object = options->alloc(0, 0, plan->size, options->alloc_ctx);
+    memset(*out_object, 0, plan->size);
+
+    if (empty) {
+        return 0;
+    }
+
+    return vd_meta__json_parse_members(
+        r,
+        plan,
+        options->alloc,
+        options->alloc_ctx,
+        *out_object,
+        first_key);
+}
+
+int vd_meta_parse_json(
+    VD_Meta_Registry *registry,
+    VD_Meta_ParseOptions *options,
+    const char *json,
+    size_t len,
+    void **out_object)
+{
+    if (options->temp_alloc == 0) {
+        options->temp_alloc = registry->alloc;
+        options->temp_alloc_ctx = registry->alloc_ctx;
+    }
+
+    VD_Meta__JsonReader r = {
+        .p = json,
+        .end = json + len,
+        .eof = 1,
+        .scratch = {
+            .alloc = options->temp_alloc,
+            .alloc_ctx = options->temp_alloc_ctx,
+        },
+    };
+
+    int ret = vd_meta__json_parse_root(registry, options, &r, out_object);
+
+    vd_meta__buffer_free(&r.scratch);
+    return ret;
+}
+
+int vd_meta_parse_json_stream(
+    VD_Meta_Registry *registry,
+    VD_Meta_ParseOptions *options,
+    VD_Meta_ReadProc *read,
+    void *read_ctx,
+    void **out_object)
+{
+    if (options->temp_alloc == 0) {
+        options->temp_alloc = registry->alloc;
+        options->temp_alloc_ctx = registry->alloc_ctx;
+    }
+
+    size_t cap = options->chunk_size ? options->chunk_size : VD_META__DEFAULT_CHUNK_SIZE;
+
+    VD_Meta__JsonReader r = {
+        .buf = (char*)options->temp_alloc(0, 0, cap, options->temp_alloc_ctx),
+        .cap = cap,
+        .read = read,
+        .read_ctx = read_ctx,
+        .scratch = {
+            .alloc = options->temp_alloc,
+            .alloc_ctx = options->temp_alloc_ctx,
+        },
+    };
+    r.p = r.buf;
+    r.end = r.buf;
+
+    int ret = vd_meta__json_parse_root(registry, options, &r, out_object);
+
+    options->temp_alloc(r.buf, r.cap, 0, options->temp_alloc_ctx);
+    vd_meta__buffer_free(&r.scratch);
+    return ret;
+}
+
+/* ----BINARY------------------------------------------------------------------------------------ */
+#define VD_META__BINARY_VERSION 1
+
+typedef struct {
+    char        magic[4];
+    /** Also catches data written with the other byte order */
+    uint16_t    version;
+    uint16_t    flags;
+    uint64_t    schema_hash;
+    /** Where the root object starts, from the start of the data */
+    uint32_t    root_offset;
+    /** The name of the root type follows the header */
+    uint32_t    name_len;
+} VD_Meta__BinaryHeader;
+
+/** FNV-1a */
+static uint64_t vd_meta__schema_mix(uint64_t h, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t*)data;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= p[i];
+        h *= 0x100000001B3ull;
+    }
+
+    return h;
+}
+
+static uint64_t vd_meta__schema_mix_u64(uint64_t h, uint64_t v)
+{
+    return vd_meta__schema_mix(h, &v, sizeof(v));
+}
+
+static uint64_t vd_meta__schema_hash(
+    VD_Meta_Registry *registry,
+    VD_Meta_ID type,
+    VD_Meta_ID *stack,
+    int depth)
+{
+    uint64_t h = 0xCBF29CE484222325ull;
+    VD_Meta_Descriptor *desc = vd_meta_get_descriptor(registry, type);
+    if (desc == 0) {
+        return h;
+    }
+
+    h = vd_meta__schema_mix(h, desc->name, strlen(desc->name) + 1);
+    h = vd_meta__schema_mix_u64(h, (uint64_t)desc->type_class);
+    h = vd_meta__schema_mix_u64(h, (uint64_t)desc->size);
+
+    // Types that contain themselves (through an array) are only named the second time around
+    for (int i = 0; i < depth; ++i) {
+        if (stack[i].value == type.value) {
+            return h;
+        }
+    }
+
+    if (depth >= VD_META__MAX_TYPE_DEPTH) {
+        return h;
+    }
+
+    stack[depth] = type;
+
+    switch (desc->type_class) {
+        case VD_META_TYPE_PRIMITIVE: {
+            h = vd_meta__schema_mix_u64(h, (uint64_t)desc->primitive.type);
+        } break;
+
+        case VD_META_TYPE_STRING: {
+            h = vd_meta__schema_mix_u64(h, (uint64_t)desc->string.type);
+        } break;
+
+        case VD_META_TYPE_OBJECT: {
+            for (size_t i = 0; i < desc->object.len; ++i) {
+                VD_Meta_Field *field = &desc->object.fields[i];
+                h = vd_meta__schema_mix(h, field->name, strlen(field->name) + 1);
+                h = vd_meta__schema_mix_u64(h, (uint64_t)field->offset);
+                h = vd_meta__schema_mix_u64(h, (uint64_t)field->flags);
+                if (field->flags & VD_META_FIELD_FLAG_FIXED_ARRAY) {
+                    h = vd_meta__schema_mix_u64(h, (uint64_t)field->fixed_array.len);
+                }
+
+                h = vd_meta__schema_mix_u64(h, vd_meta__schema_hash(registry, field->type, stack, depth + 1));
+            }
+        } break;
+
+        default: break;
+    }
+
+    return h;
+}
+
+uint64_t vd_meta_get_schema_hash(VD_Meta_Registry *registry, VD_Meta_ID type)
+{
+    VD_Meta_ID stack[VD_META__MAX_TYPE_DEPTH];
+    return vd_meta__schema_hash(registry, type, stack, 0);
+}
+
+static void vd_meta__bin_push_varint(VD_Meta__Buffer *buffer, uint64_t v)
+{
+    char bytes[10];
+    size_t n = 0;
+    while (v >= 0x80) {
+        bytes[n++] = (char)(v | 0x80);
+        v >>= 7;
+    }
+
+    bytes[n++] = (char)v;
+    vd_meta__buffer_push(buffer, bytes, n);
+}
+
+static size_t vd_meta__bin_align(VD_Meta__Buffer *buffer, size_t align)
+{
+    size_t pad = (align - (buffer->len & (align - 1))) & (align - 1);
+    vd_meta__buffer_push_zeroes(buffer, pad);
+    return buffer->len;
+}
+
+static size_t vd_meta__bin_push_header(
+    VD_Meta__Buffer *buffer,
+    VD_Meta_Plan *plan,
+    VD_Meta_BinaryFlags flags)
+{
+    VD_Meta__BinaryHeader header = {
+        .magic = {'V', 'D', 'M', 'B'},
+        .version = VD_META__BINARY_VERSION,
+        .flags = (uint16_t)flags,
+        .schema_hash = plan->schema_hash,
+        .name_len = (uint32_t)strlen(plan->name),
+    };
+
+    vd_meta__buffer_push(buffer, &header, sizeof(header));
+    vd_meta__buffer_push(buffer, plan->name, header.name_len);
+
+    size_t root_offset = vd_meta__bin_align(buffer, 16);
+    header.root_offset = (uint32_t)root_offset;
+    memcpy(buffer->ptr, &header, sizeof(header));
+    return root_offset;
+}
+
+static void vd_meta__bin_write_ops(VD_Meta__Buffer *buffer, VD_Meta_Plan *plan, const char *object);
+
+static void vd_meta__bin_write_elements(
+    VD_Meta__Buffer *buffer,
+    const VD_Meta_PlanOp *op,
+    const char *elements,
+    size_t count)
+{
+    switch (op->kind) {
+        case VD_META_PLAN_OP_PRIMITIVE: {
+            vd_meta__buffer_push(buffer, elements, count * op->size);
+        } break;
+
+        case VD_META_PLAN_OP_CSTRING: {
+            // Length + 1, so that 0 can stand for null
+            for (size_t i = 0; i < count; ++i) {
+                const char *str = ((const char**)elements)[i];
+                size_t len = str ? strlen(str) : 0;
+                vd_meta__bin_push_varint(buffer, str ? len + 1 : 0);
+                vd_meta__buffer_push(buffer, str, len);
+            }
+        } break;
+
+        case VD_META_PLAN_OP_OBJECT: {
+            if (op->plan->is_flat) {
+                vd_meta__buffer_push(buffer, elements, count * op->size);
+                break;
+            }
+
+            for (size_t i = 0; i < count; ++i) {
+                vd_meta__bin_write_ops(buffer, op->plan, elements + i * op->size);
+            }
+        } break;
+
+        default: break;
+    }
+}
+
+static void vd_meta__bin_write_ops(VD_Meta__Buffer *buffer, VD_Meta_Plan *plan, const char *object)
+{
+    for (size_t i = 0; i < plan->ops_len; ++i) {
+        const VD_Meta_PlanOp *op = &plan->ops[i];
+        const char *location = object + op->offset;
+
+        if (op->kind == VD_META_PLAN_OP_COPY) {
+            vd_meta__buffer_push(buffer, location, op->size);
+        } else if (op->flags & VD_META_FIELD_FLAG_INTRUSIVE_ARRAY) {
+            const char *array = *(const char**)location;
+            size_t count = array ? op->props->len((void*)array, op->props->c) : 0;
+            vd_meta__bin_push_varint(buffer, count);
+            vd_meta__bin_write_elements(buffer, op, array, count);
+        } else {
+            vd_meta__bin_write_elements(buffer, op, location, op->count);
         }
-        
-        int ret = vd_meta__parse_json_field(
-            registry,
-            field,
-            temp,
-            btemp,
-            &s,
-            alloc,
-            alloc_ctx,
-            (char*)out_object + field->offset);
+    }
+}
 
-        if (ret < 0) {
-            return ret;
+/** Append data to the in place layout, and return its offset. */
+static size_t vd_meta__bin_place_bytes(VD_Meta__Buffer *buffer, const void *data, size_t len, size_t align)
+{
+    size_t at = vd_meta__bin_align(buffer, align);
+    vd_meta__buffer_push(buffer, data, len);
+    return at;
+}
+
+/** Store target as an offset relative to the pointer slot at "at", or 0 for null. */
+static void vd_meta__bin_patch(VD_Meta__Buffer *buffer, size_t at, size_t target, int is_null)
+{
+    int64_t rel = is_null ? 0 : (int64_t)target - (int64_t)at;
+    memcpy(buffer->ptr + at, &rel, sizeof(rel));
+}
+
+static void vd_meta__bin_place_fields(VD_Meta__Buffer *buffer, VD_Meta_Plan *plan, size_t at, const char *object);
+
+/**
+ * @brief Fix up an element that has been copied as is to offset "at": append whatever its pointers
+ * point to, and replace them with relative offsets.
+ */
+static void vd_meta__bin_place_element(VD_Meta__Buffer *buffer, const VD_Meta_PlanOp *op, size_t at, const char *element)
+{
+    switch (op->kind) {
+        case VD_META_PLAN_OP_CSTRING: {
+            const char *str = *(const char**)element;
+            size_t target = str ? vd_meta__bin_place_bytes(buffer, str, strlen(str) + 1, 1) : 0;
+            vd_meta__bin_patch(buffer, at, target, str == 0);
+        } break;
+
+        case VD_META_PLAN_OP_OBJECT: {
+            vd_meta__bin_place_fields(buffer, op->plan, at, element);
+        } break;
+
+        case VD_META_PLAN_OP_SKIP: {
+            memset(buffer->ptr + at, 0, op->size);
+        } break;
+
+        default: break;
+    }
+}
+
+static void vd_meta__bin_place_fields(VD_Meta__Buffer *buffer, VD_Meta_Plan *plan, size_t at, const char *object)
+{
+    for (size_t i = 0; i < plan->fields_len; ++i) {
+        const VD_Meta_PlanOp *op = &plan->fields[i];
+        if (!vd_meta__plan_op_has_pointers(op)) {
+            continue;
         }
 
-        vd_meta__slice_skip_whitespace(&s);
+        size_t field_at = at + op->offset;
+        const char *location = object + op->offset;
+        const char *elements = location;
+        size_t elements_at = field_at;
+        size_t count = op->count;
+
+        if (op->flags & VD_META_FIELD_FLAG_INTRUSIVE_ARRAY) {
+            elements = *(const char**)location;
+            count = elements ? op->props->len((void*)elements, op->props->c) : 0;
+            if (count == 0) {
+                vd_meta__bin_patch(buffer, field_at, 0, 1);
+                continue;
+            }
 
-        if (vd_meta__slice_expect_char(&s, '}')) {
-            break;
+            // The same layout as VD_META_ARRAY, with the elements 16 byte aligned
+            VD_Meta__ArrayHeader header = { (uint32_t)count, (uint32_t)count };
+            vd_meta__bin_align(buffer, 16);
+            vd_meta__buffer_push_zeroes(buffer, 16 - sizeof(header));
+            vd_meta__buffer_push(buffer, &header, sizeof(header));
+            elements_at = vd_meta__bin_place_bytes(buffer, elements, count * op->size, 1);
+            vd_meta__bin_patch(buffer, field_at, elements_at, 0);
         }
 
-        if (!vd_meta__slice_expect_char(&s, ',')) {
-            return VD_META_INVALID_JSON;
+        if (op->kind == VD_META_PLAN_OP_PRIMITIVE ||
+            (op->kind == VD_META_PLAN_OP_OBJECT && !op->plan->has_pointers))
+        {
+            continue;
+        }
+
+        for (size_t e = 0; e < count; ++e) {
+            vd_meta__bin_place_element(buffer, op, elements_at + e * op->size, elements + e * op->size);
         }
     }
+}
+
+int vd_meta_write_binary(
+    VD_Meta_Registry *registry,
+    void *object,
+    VD_Meta_ID type,
+    VD_Meta_WriteOptions *options,
+    void **out_data,
+    size_t *out_len)
+{
+    if (options->alloc == 0) {
+        options->alloc = registry->alloc;
+        options->alloc_ctx = registry->alloc_ctx;
+    }
+
+    VD_Meta_Plan *plan = vd_meta_get_plan(registry, type);
+    if (plan == 0) {
+        return VD_META_DESCRIPTOR_NOT_FOUND;
+    }
+
+    VD_Meta__Buffer buffer = {
+        .alloc = options->alloc,
+        .alloc_ctx = options->alloc_ctx,
+    };
+
+    size_t root_offset = vd_meta__bin_push_header(&buffer, plan, options->binary_flags);
 
-    VD_META__SLICE_APPLY(&s, slice);
+    if (options->binary_flags & VD_META_BINARY_FLAG_IN_PLACE) {
+        vd_meta__buffer_push(&buffer, object, plan->size);
+        vd_meta__bin_place_fields(&buffer, plan, root_offset, (const char*)object);
+    } else {
+        vd_meta__bin_write_ops(&buffer, plan, (const char*)object);
+    }
 
+    *out_data = buffer.ptr;
+    *out_len = buffer.len;
     return 0;
 }
 
-static int vd_meta__json_get_object_type(
+/** Check the header, and find the plan of the root. */
+static int vd_meta__bin_read_header(
     VD_Meta_Registry *registry,
-    VD_Meta_ID expected_type,
-    VD_Meta_ID *actual_type,
-    VD_Meta__Slice *slice,
-    VD_Meta__Arena *temp,
-    VD_Meta__Buffer *btemp)
+    const void *data,
+    size_t len,
+    VD_Meta_ID type,
+    VD_Meta__BinaryHeader *out_header,
+    VD_Meta_Plan **out_plan)
 {
-    VD_Meta__Slice s = VD_META__SLICE_COPY(slice);
-    vd_meta__slice_skip_whitespace(&s);
-
-    if (!vd_meta__slice_expect_char(&s, '{')) {
-        return VD_META_INVALID_JSON;
+    VD_Meta__BinaryHeader header;
+    if (len < sizeof(header)) {
+        return VD_META_INVALID_BINARY;
     }
 
-    for (;;) {
-        vd_meta__slice_skip_whitespace(&s);
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, "VDMB", 4) != 0 ||
+        header.version != VD_META__BINARY_VERSION ||
+        header.name_len > len - sizeof(header) ||
+        header.root_offset > len)
+    {
+        return VD_META_INVALID_BINARY;
+    }
 
-        if (vd_meta__slice_expect_char(&s, '}')) {
-            break;
+    if (type.value == 0) {
+        char name[256];
+        if (header.name_len >= sizeof(name)) {
+            return VD_META_INVALID_TYPE;
         }
 
-        if (vd_meta__slice_at_end(&s)) {
-            return VD_META_INVALID_JSON;
+        memcpy(name, (const char*)data + sizeof(header), header.name_len);
+        name[header.name_len] = 0;
+        type = vd_meta_get_id(registry, name);
+        if (type.value == 0) {
+            return VD_META_INVALID_TYPE;
         }
+    }
 
-        const char *key;
-        vd_meta__parse_json_string(&s, btemp, &key);
+    VD_Meta_Plan *plan = vd_meta_get_plan(registry, type);
+    if (plan == 0) {
+        return VD_META_DESCRIPTOR_NOT_FOUND;
+    }
 
-        vd_meta__slice_skip_whitespace(&s);
-        if (!vd_meta__slice_expect_char(&s, ':')) {
-            return VD_META_INVALID_JSON;
+    if (plan->schema_hash != header.schema_hash) {
+        return VD_META_SCHEMA_MISMATCH;
+    }
+
+    *out_header = header;
+    *out_plan = plan;
+    return 0;
+}
+
+typedef struct {
+    const char          *p;
+    const char          *end;
+    VD_Meta_AllocProc   *alloc;
+    void                *alloc_ctx;
+} VD_Meta__BinReader;
+
+static int vd_meta__bin_read(VD_Meta__BinReader *r, void *dst, size_t len)
+{
+    if ((size_t)(r->end - r->p) < len) {
+        return 0;
+    }
+
+    memcpy(dst, r->p, len);
+    r->p += len;
+    return 1;
+}
+
+static int vd_meta__bin_read_varint(VD_Meta__BinReader *r, uint64_t *out)
+{
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64 && r->p < r->end; shift += 7) {
+        uint8_t b = (uint8_t)*r->p++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *out = v;
+            return 1;
         }
+    }
+
+    return 0;
+}
 
-        if (strcmp(key, "--vd-meta-type-name--") == 0) {
-            vd_meta__slice_skip_whitespace(&s);
+static int vd_meta__bin_read_ops(VD_Meta__BinReader *r, VD_Meta_Plan *plan, char *object);
+
+static int vd_meta__bin_read_elements(
+    VD_Meta__BinReader *r,
+    const VD_Meta_PlanOp *op,
+    char *elements,
+    size_t count)
+{
+    switch (op->kind) {
+        case VD_META_PLAN_OP_PRIMITIVE: {
+            return vd_meta__bin_read(r, elements, count * op->size) ? 0 : VD_META_INVALID_BINARY;
+        } break;
 
-            const char *type_name;
-            vd_meta__parse_json_string(&s, btemp, &type_name);
+        case VD_META_PLAN_OP_CSTRING: {
+            for (size_t i = 0; i < count; ++i) {
+                uint64_t len_plus_one;
+                if (!vd_meta__bin_read_varint(r, &len_plus_one) || len_plus_one > (uint64_t)(r->end - r->p) + 1) {
+                    return VD_META_INVALID_BINARY;
+                }
 
-            VD_Meta_ID id = vd_meta_get_id(registry, type_name);
-            if (id.value == 0) {
-                return VD_META_INVALID_TYPE;
+                char *str = 0;
+                if (len_plus_one != 0) {
+                    str = (char*)r->alloc(0, 0, (size_t)len_plus_one, r->alloc_ctx);
+                    vd_meta__bin_read(r, str, (size_t)len_plus_one - 1);
+                    str[len_plus_one - 1] = 0;
+                }
+
+                ((char**)elements)[i] = str;
             }
+        } break;
 
-            *actual_type = id;
-            if (expected_type.value != 0 && id.value != expected_type.value) {
-                return VD_META_TYPE_MISMATCH;
+        case VD_META_PLAN_OP_OBJECT: {
+            if (op->plan->is_flat) {
+                return vd_meta__bin_read(r, elements, count * op->size) ? 0 : VD_META_INVALID_BINARY;
             }
 
-            return 0;
-        } else {
+            for (size_t i = 0; i < count; ++i) {
+                int ret = vd_meta__bin_read_ops(r, op->plan, elements + i * op->size);
+                if (ret < 0) {
+                    return ret;
+                }
+            }
+        } break;
+
+        default: break;
+    }
+
+    return 0;
+}
 
-            vd_meta__slice_skip_whitespace(&s);
+static int vd_meta__bin_read_ops(VD_Meta__BinReader *r, VD_Meta_Plan *plan, char *object)
+{
+    for (size_t i = 0; i < plan->ops_len; ++i) {
+        const VD_Meta_PlanOp *op = &plan->ops[i];
+        char *location = object + op->offset;
+        int ret;
+
+        if (op->kind == VD_META_PLAN_OP_COPY) {
+            ret = vd_meta__bin_read(r, location, op->size) ? 0 : VD_META_INVALID_BINARY;
+        } else if (op->flags & VD_META_FIELD_FLAG_INTRUSIVE_ARRAY) {
+            uint64_t count;
+            if (!vd_meta__bin_read_varint(r, &count)) {
+                return VD_META_INVALID_BINARY;
+            }
+
+            // Every element takes at least a byte, so a corrupt count can't allocate much
+            size_t min_size = op->kind == VD_META_PLAN_OP_PRIMITIVE ? op->size : 1;
+            if (count > (uint64_t)(r->end - r->p) / min_size) {
+                return VD_META_INVALID_BINARY;
+            }
 
-            vd_meta__json_skip_value(&s);
+            if (count == 0) {
+                continue;
+            }
 
-            vd_meta__slice_skip_whitespace(&s);
+            void **array = (void**)location;
+            size_t first = *array ? op->props->len(*array, op->props->c) : 0;
+            for (uint64_t e = 0; e < count; ++e) {
+                op->props->add(array, 0, op->size, op->props->c);
+            }
 
-            vd_meta__slice_expect_char(&s, ',');
+            char *elements = (char*)*array + first * op->size;
+            memset(elements, 0, (size_t)count * op->size);
+            ret = vd_meta__bin_read_elements(r, op, elements, (size_t)count);
+        } else {
+            ret = vd_meta__bin_read_elements(r, op, location, op->count);
         }
-    }
 
-    if (expected_type.value != 0) {
-        *actual_type = expected_type;
-        return 0;
+        if (ret < 0) {
+            return ret;
+        }
     }
 
-    return VD_META_TYPE_NOT_FOUND;
+    return 0;
 }
 
-int vd_meta_parse_json(
+int vd_meta_parse_binary(
     VD_Meta_Registry *registry,
     VD_Meta_ParseOptions *options,
-    const char *json,
+    const void *data,
     size_t len,
     void **out_object)
 {
@@ -1841,70 +3237,216 @@ int vd_meta_parse_json(
         options->alloc_ctx = registry->alloc_ctx;
     }
 
-    if (options->temp_alloc == 0) {
-        options->temp_alloc = registry->alloc;
-        options->temp_alloc_ctx = registry->alloc_ctx;
+    VD_Meta__BinaryHeader header;
+    VD_Meta_Plan *plan;
+    int ret = vd_meta__bin_read_header(registry, data, len, options->type, &header, &plan);
+    if (ret < 0) {
+        return ret;
     }
 
-    VD_Meta__Slice slice = {
-        .str = json,
-        .len = len,
-        .pos = 0,
-    };
+    if (header.flags & VD_META_BINARY_FLAG_IN_PLACE) {
+        return VD_META_INVALID_BINARY;
+    }
 
-    VD_Meta__Arena temp;
-    vd_meta__arena_init(&temp, options->temp_alloc, options->temp_alloc_ctx);
+    if (options->out_type) {
+        *options->out_type = plan->id;
+    }
 
-    VD_Meta__Buffer btemp = {
-        .alloc = options->temp_alloc,
-        .alloc_ctx = options->temp_alloc_ctx,
-        .len = 0,
-        .cap = 0,
+    *out_object = options->alloc(0, 0, plan->size, options->alloc_ctx);
+    memset(*out_object, 0, plan->size);
+
+    VD_Meta__BinReader r = {
+        .p = (const char*)data + header.root_offset,
+        .end = (const char*)data + len,
+        .alloc = options->alloc,
+        .alloc_ctx = options->alloc_ctx,
     };
 
-    VD_Meta_ID actual_type;
-    int r = vd_meta__json_get_object_type(
-        registry,
-        options->type,
-        &actual_type,
-        &slice,
-        &temp,
-        &btemp);
+    return vd_meta__bin_read_ops(&r, plan, (char*)*out_object);
+}
 
-    vd_meta__buffer_clear(&btemp);
+int vd_meta_binary_get_root(
+    VD_Meta_Registry *registry,
+    const void *data,
+    size_t len,
+    VD_Meta_ID type,
+    const void **out_object)
+{
+    if ((uintptr_t)data & 7) {
+        return VD_META_INVALID_BINARY;
+    }
 
-    if (r != 0) {
-        return r;
+    VD_Meta__BinaryHeader header;
+    VD_Meta_Plan *plan;
+    int ret = vd_meta__bin_read_header(registry, data, len, type, &header, &plan);
+    if (ret < 0) {
+        return ret;
     }
 
-    VD_Meta_Descriptor *desc = vd_meta_get_descriptor(registry, actual_type);
-    if (desc == 0) {
-        return VD_META_DESCRIPTOR_NOT_FOUND;
+    if (!(header.flags & VD_META_BINARY_FLAG_IN_PLACE) || plan->size > len - header.root_offset) {
+        return VD_META_INVALID_BINARY;
     }
 
-    *out_object = options->alloc(0, 0, desc->size, options->alloc_ctx);
-    memset(*out_object, 0, desc->size);
+    *out_object = (const char*)data + header.root_offset;
+    return 0;
+}
 
-    r = vd_meta__parse_json_object(
-        registry,
-        actual_type,
-        &temp,
-        &btemp,
-        &slice,
-        options->alloc,
-        options->alloc_ctx,
-        *out_object);
+/** Turn the relative offset at "at" into a pointer to a target of len bytes, bounds checked. */
+static int vd_meta__bin_resolve(char *data, size_t len, size_t at, size_t target_len, size_t *out_target)
+{
+    int64_t rel;
+    memcpy(&rel, data + at, sizeof(rel));
+    if (rel == 0) {
+        *out_target = 0;
+        return 1;
+    }
+
+    int64_t target = (int64_t)at + rel;
+    if (target <= 0 || (uint64_t)target > len || target_len > len - (size_t)target) {
+        return 0;
+    }
+
+    void *ptr = data + target;
+    memcpy(data + at, &ptr, sizeof(ptr));
+    *out_target = (size_t)target;
+    return 1;
+}
+
+static int vd_meta__bin_relocate_fields(VD_Meta_Plan *plan, char *data, size_t len, size_t at);
+
+static int vd_meta__bin_relocate_element(const VD_Meta_PlanOp *op, char *data, size_t len, size_t at)
+{
+    size_t target;
+
+    switch (op->kind) {
+        case VD_META_PLAN_OP_CSTRING: {
+            if (!vd_meta__bin_resolve(data, len, at, 1, &target) ||
+                (target && !memchr(data + target, 0, len - target)))
+            {
+                return VD_META_INVALID_BINARY;
+            }
+        } break;
+
+        case VD_META_PLAN_OP_OBJECT: {
+            return vd_meta__bin_relocate_fields(op->plan, data, len, at);
+        } break;
+
+        default: break;
+    }
+
+    return 0;
+}
+
+static int vd_meta__bin_relocate_fields(VD_Meta_Plan *plan, char *data, size_t len, size_t at)
+{
+    for (size_t i = 0; i < plan->fields_len; ++i) {
+        const VD_Meta_PlanOp *op = &plan->fields[i];
+        if (!vd_meta__plan_op_has_pointers(op)) {
+            continue;
+        }
+
+        size_t field_at = at + op->offset;
+        size_t elements_at = field_at;
+        size_t count = op->count;
+
+        if (op->flags & VD_META_FIELD_FLAG_INTRUSIVE_ARRAY) {
+            int64_t rel;
+            memcpy(&rel, data + field_at, sizeof(rel));
+
+            count = 0;
+            if (rel != 0) {
+                int64_t header_at = (int64_t)field_at + rel - (int64_t)sizeof(VD_Meta__ArrayHeader);
+                if (header_at <= 0 || (uint64_t)header_at > len - sizeof(VD_Meta__ArrayHeader)) {
+                    return VD_META_INVALID_BINARY;
+                }
+
+                VD_Meta__ArrayHeader header;
+                memcpy(&header, data + header_at, sizeof(header));
+                count = header.len;
+            }
+
+            if (!vd_meta__bin_resolve(data, len, field_at, count * op->size, &elements_at)) {
+                return VD_META_INVALID_BINARY;
+            }
+        }
 
-    *options->out_type = actual_type;
+        if (op->kind == VD_META_PLAN_OP_PRIMITIVE ||
+            (op->kind == VD_META_PLAN_OP_OBJECT && !op->plan->has_pointers))
+        {
+            continue;
+        }
+
+        for (size_t e = 0; e < count; ++e) {
+            int ret = vd_meta__bin_relocate_element(op, data, len, elements_at + e * op->size);
+            if (ret < 0) {
+                return ret;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int vd_meta_binary_relocate(
+    VD_Meta_Registry *registry,
+    void *data,
+    size_t len,
+    VD_Meta_ID type,
+    void **out_object)
+{
+    if ((uintptr_t)data & 7) {
+        return VD_META_INVALID_BINARY;
+    }
+
+    VD_Meta__BinaryHeader header;
+    VD_Meta_Plan *plan;
+    int ret = vd_meta__bin_read_header(registry, data, len, type, &header, &plan);
+    if (ret < 0) {
+        return ret;
+    }
+
+    if (!(header.flags & VD_META_BINARY_FLAG_IN_PLACE) || plan->size > len - header.root_offset) {
+        return VD_META_INVALID_BINARY;
+    }
 
-    vd_meta__buffer_free(&btemp);
-    vd_meta__arena_free(&temp);
+    ret = vd_meta__bin_relocate_fields(plan, (char*)data, len, header.root_offset);
+    if (ret < 0) {
+        return ret;
+    }
 
-    return r;
+    *out_object = (char*)data + header.root_offset;
+    return 0;
 }
 
 int vd_meta_deinit(VD_Meta_Registry *registry)
 {
+    if (registry->symbol_ids) {
+        registry->alloc(
+            registry->symbol_ids,
+            registry->symbol_ids_cap * sizeof(VD_Meta_ID),
+            0,
+            registry->alloc_ctx);
+        registry->symbol_ids = 0;
+        registry->symbol_ids_cap = 0;
+    }
+
+    if (registry->plans) {
+        for (size_t i = 0; i < registry->plans_cap; ++i) {
+            if (registry->plans[i]) {
+                vd_meta__free_plan(registry, registry->plans[i]);
+            }
+        }
+
+        registry->alloc(
+            registry->plans,
+            registry->plans_cap * sizeof(VD_Meta_Plan*),
+            0,
+            registry->alloc_ctx);
+        registry->plans = 0;
+        registry->plans_cap = 0;
+        registry->plans_len = 0;
+    }
+
     return 0;
 }
 
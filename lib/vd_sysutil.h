@@ -16,6 +16,12 @@ typedef struct _tag_vd_sysutil_file_info {
     char         name[256];
 } VD_SysUtilFileInfo;
 
+typedef struct _tag_vd_sysutil_thread {
+    void *handle;
+} VD_SysUtilThread;
+
+typedef int VD_SysUtilThreadProc(void *arg);
+
 typedef struct _tag_vd_sysutil_timespec {
 #if defined(_WIN32)
 	unsigned long long value;
@@ -32,6 +38,9 @@ VD_SysUtilTimespec vd_sysutil_time_sub(VD_SysUtilTimespec *lhs, VD_SysUtilTimesp
 unsigned long long vd_sysutil_time_to_ms(VD_SysUtilTimespec *s);
 float vd_sysutil_time_to_s(VD_SysUtilTimespec *s);
 
+int vd_sysutil_thread_create(VD_SysUtilThread *thread, VD_SysUtilThreadProc *proc, void *arg);
+int vd_sysutil_thread_join(VD_SysUtilThread *thread);
+
 #ifdef VD_SYSUTIL_IMPLEMENTATION
 #include <string.h>
 
@@ -54,6 +63,12 @@ typedef struct _tag_vd_sysutil__win32_dir_iter {
 #include <errno.h>
 #endif
 
+#if !defined(_WIN32)
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#endif
+
 int vd_sysutil_get_executable_path(char *buf, unsigned int *size)
 {
 #if defined(_WIN32)
@@ -204,5 +219,72 @@ float vd_sysutil_time_to_s(VD_SysUtilTimespec *s)
 	return (float)((double)ms / 1000.0);
 }
 
+typedef struct _tag_vd_sysutil__thread_start {
+    VD_SysUtilThreadProc *proc;
+    void                 *arg;
+} VD_SysUtil__ThreadStart;
+
+#if defined(_WIN32)
+static DWORD WINAPI vd_sysutil__thread_entry(LPVOID param)
+{
+    VD_SysUtil__ThreadStart start = *(VD_SysUtil__ThreadStart*)param;
+    free(param);
+    return (DWORD)start.proc(start.arg);
+}
+#else
+static void *vd_sysutil__thread_entry(void *param)
+{
+    VD_SysUtil__ThreadStart start = *(VD_SysUtil__ThreadStart*)param;
+    free(param);
+    return (void*)(intptr_t)start.proc(start.arg);
+}
+#endif
+
+int vd_sysutil_thread_create(VD_SysUtilThread *thread, VD_SysUtilThreadProc *proc, void *arg)
+{
+    VD_SysUtil__ThreadStart *start = malloc(sizeof(VD_SysUtil__ThreadStart));
+    start->proc = proc;
+    start->arg = arg;
+
+#if defined(_WIN32)
+    HANDLE hnd = CreateThread(NULL, 0, vd_sysutil__thread_entry, start, 0, NULL);
+    if (hnd == NULL) {
+        free(start);
+        return -1;
+    }
+
+    thread->handle = (void*)hnd;
+    return 0;
+#else
+    pthread_t *hnd = malloc(sizeof(pthread_t));
+    if (pthread_create(hnd, NULL, vd_sysutil__thread_entry, start) != 0) {
+        free(hnd);
+        free(start);
+        return -1;
+    }
+
+    thread->handle = (void*)hnd;
+    return 0;
+#endif
+}
+
+int vd_sysutil_thread_join(VD_SysUtilThread *thread)
+{
+#if defined(_WIN32)
+    HANDLE hnd = (HANDLE)thread->handle;
+    DWORD result = 0;
+    WaitForSingleObject(hnd, INFINITE);
+    GetExitCodeThread(hnd, &result);
+    CloseHandle(hnd);
+    return (int)result;
+#else
+    pthread_t *hnd = (pthread_t*)thread->handle;
+    void *result = 0;
+    pthread_join(*hnd, &result);
+    free(hnd);
+    return (int)(intptr_t)result;
+#endif
+}
+
 #endif
 #endif
@@ -104,10 +104,12 @@ typedef struct {
 } StaticMeshComponent;
 extern ECS_COMPONENT_DECLARE(StaticMeshComponent);
 
+extern ECS_SYSTEM_DECLARE(RendererBeginFrameSystem);                // EcsPreFrame
 extern ECS_SYSTEM_DECLARE(RendererRenderToWindowSurfaceComponents); // EcsOnStore
 extern ECS_SYSTEM_DECLARE(RendererCheckWindowComponentSizeChange);  // EcsOnPostLoad
 extern ECS_SYSTEM_DECLARE(RendererGatherStaticMeshComponentSystem); // EcsPreStore
 extern ECS_OBSERVER_DECLARE(RendererOnWindowComponentSet);
+extern ECS_OBSERVER_DECLARE(RendererOnStaticMeshRemove);
 
 
 void BuiltinImport(ecs_world_t *world);
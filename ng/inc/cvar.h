@@ -4,6 +4,10 @@
 #include "vd_common.h"
 #include "delegate.h"
 #include "str.h"
+#include "intern.h"
+#include "vd_atomic.h"
+
+#include <string.h>
 
 typedef struct VD_CVS VD_CVS;
 
@@ -11,17 +15,64 @@ typedef enum {
     VD_CVS_I32,
     VD_CVS_F32,
     VD_CVS_BOOL,
+    VD_CVS_STR,
+    VD_CVS_VEC4,
 } VD_CVarType;
 
+typedef union {
+    i32         i;
+    f32         f;
+    bool        b;
+
+    /** Strings are interned, so that reading one is a single load like any other cvar. */
+    VD_Symbol   s;
+    f32         vec[4];
+} VD_CVarData;
+
 typedef struct {
     VD_CVarType type;
-    union {
-        i32  i;
-        f32  f;
-        bool b;
-    } v;
+    VD_CVarData v;
 } VD_CVarValue;
 
+typedef enum {
+    /** The slot was created by the CVS for a cvar that no code declared, and is freed with it. */
+    VD_CVAR_FLAG_OWNED = 1 << 0,
+} VD_CVarFlags;
+
+typedef struct VD_CVar VD_CVar;
+
+/**
+ * A cvar's storage. Slots never move once bound, so code keeps a pointer to one and reads the value
+ * straight out of it. Every slot of the same name holds the same value; the first one bound is the
+ * head, which the CVS looks names up to.
+ */
+struct VD_CVar {
+    /** The value. Read it with vd_cvar_get_*. */
+    VD_CVarData     v;
+
+    /**
+     * Incremented before and after every write, so it is odd while a write is in progress. 0 until
+     * the slot is bound.
+     */
+    volatile u32    version;
+    VD_CVarType     type;
+    VD_CVarFlags    flags;
+    VD_Symbol       symbol;
+    const char      *name;
+
+    /** The value before binding, for slots declared in code. */
+    VD_CVarData     def;
+    const char      *def_str;
+
+    VD_CVar         *head;
+
+    /** The next slot with the same name. Only used by heads. */
+    VD_CVar         *alias;
+
+    /** Set while the cvar waits for vd_cvs_flush to invoke the change hooks. Only used by heads. */
+    volatile i32    dirty;
+    VD_CVar         *next_dirty;
+};
 
 VD_DELEGATE_DECLARE_PARAMS2_VOID(VD_CVarChangedDelegate, VD_str, name, VD_CVarValue *, var)
 
@@ -31,8 +82,118 @@ void vd_cvs_register_hook(VD_CVS *cvs, VD_CALLBACK(VD_CVarChangedDelegate) *call
 void vd_cvs_unregister_hook(VD_CVS *cvs, VD_CALLBACK(VD_CVarChangedDelegate) *callback);
 VD_bool vd_cvs_get(VD_CVS *cvs, VD_str name, VD_CVarValue *cvar);
 void vd_cvs_set(VD_CVS *cvs, VD_str name, VD_CVarValue value);
+
+/**
+ * @brief Same as vd_cvs_get and vd_cvs_set, but skip hashing the name. Cvars are stored by symbol,
+ * so these are the fast path for names, @see VD_SYMBOL_LIT. Reading a bound slot is faster still.
+ */
+VD_bool vd_cvs_get_symbol(VD_CVS *cvs, VD_Symbol name, VD_CVarValue *cvar);
+void vd_cvs_set_symbol(VD_CVS *cvs, VD_Symbol name, VD_CVarValue value);
+
+/**
+ * @brief Attach a slot to its cvar. A new cvar starts out with the slot's default value, and an
+ * existing one (e.g. loaded from a config file) keeps its value. Binding a bound slot does nothing.
+ * @return The slot.
+ */
+VD_CVar *vd_cvs_bind(VD_CVS *cvs, VD_CVar *cvar);
+
+/**
+ * @brief Write a cvar through any of its slots. Every slot of the cvar gets the value, and the
+ * change hooks run at the next vd_cvs_flush, once no matter how many writes there were.
+ */
+void vd_cvs_write(VD_CVS *cvs, VD_CVar *cvar, VD_CVarData value);
+
+/**
+ * @brief Invoke the change hooks of every cvar that was written since the last flush. Called once
+ * per frame by the instance.
+ * @return The number of cvars that changed.
+ */
+u32 vd_cvs_flush(VD_CVS *cvs);
+
+/**
+ * @brief Set cvars from text with one "name = value" per line. Values are 12, 1.5, true, "text" or
+ * (1, 2, 3, 4). Lines starting with # are comments. Values of declared cvars must match their type,
+ * except that integers can be given for floats and vectors can have fewer than 4 components.
+ * @return The number of lines that could not be applied.
+ */
+u32 vd_cvs_load(VD_CVS *cvs, VD_str text);
+
+/**
+ * @brief vd_cvs_load, from a file.
+ * @return The number of lines that could not be applied, or -1 if the file could not be read.
+ */
+int vd_cvs_load_file(VD_CVS *cvs, const char *path);
+
+/**
+ * @brief Write every cvar to a file, sorted by name, in the format vd_cvs_load reads.
+ * @return 0 on success, -1 if the file could not be written.
+ */
+int vd_cvs_save_file(VD_CVS *cvs, const char *path);
 void vd_cvs_deinit(VD_CVS *cvs);
 
+/** The version of the value, which changes with every write. */
+static VD_INLINE u32 vd_cvar_get_version(const VD_CVar *cvar)
+{
+    return cvar->version;
+}
+
+static VD_INLINE i32 vd_cvar_get_i32(const VD_CVar *cvar)
+{
+    return *(const volatile i32*)&cvar->v.i;
+}
+
+static VD_INLINE f32 vd_cvar_get_f32(const VD_CVar *cvar)
+{
+    return *(const volatile f32*)&cvar->v.f;
+}
+
+static VD_INLINE bool vd_cvar_get_bool(const VD_CVar *cvar)
+{
+    return *(const volatile bool*)&cvar->v.b;
+}
+
+static VD_INLINE VD_str vd_cvar_get_str(const VD_CVar *cvar)
+{
+    return vd_symbol_str(*(const volatile VD_Symbol*)&cvar->v.s);
+}
+
+/** Vectors are more than a word, so this retries until it reads them between writes. */
+static VD_INLINE void vd_cvar_get_vec4(const VD_CVar *cvar, f32 out[4])
+{
+    for (;;) {
+        u32 version = cvar->version;
+        vd_atomic_fence();
+        memcpy(out, (const void*)cvar->v.vec, sizeof(cvar->v.vec));
+        vd_atomic_fence();
+        if (!(version & 1) && version == cvar->version) {
+            return;
+        }
+    }
+}
+
+#define VD_CVAR__SLOT(var, name_lit, deffield, defvalue, deftype)                                   \
+    static VD_CVar var##_vd_cvar_slot_ = { .type = deftype, .name = name_lit, deffield = defvalue }; \
+    VD_CVar *const var = var##_vd_cvar_slot_.version                                                \
+        ? &var##_vd_cvar_slot_                                                                      \
+        : vd_cvs_bind(vd_instance_get_cvs(vd_instance_get()), &var##_vd_cvar_slot_)
+
+/**
+ * @brief Declare a local VD_CVar pointer named var for the cvar name, that has the value defvalue
+ * unless something set it before. The slot is static and bound the first time the declaration
+ * runs, so after that, reading the cvar is a single load.
+ * @code
+ * VD_CVAR_I32(inflight, "r.inflight-frame-count", 2);
+ * array_addn(frame_data, vd_cvar_get_i32(inflight));
+ * @endcode
+ */
+#define VD_CVAR_I32(var, name, defvalue)  VD_CVAR__SLOT(var, name, .def.i, defvalue, VD_CVS_I32)
+#define VD_CVAR_F32(var, name, defvalue)  VD_CVAR__SLOT(var, name, .def.f, defvalue, VD_CVS_F32)
+#define VD_CVAR_BOOL(var, name, defvalue) VD_CVAR__SLOT(var, name, .def.b, defvalue, VD_CVS_BOOL)
+#define VD_CVAR_STR(var, name, defvalue)  VD_CVAR__SLOT(var, name, .def_str, defvalue, VD_CVS_STR)
+#define VD_CVAR_VEC4(var, name, x, y, z, w) \
+    VD_CVAR__SLOT(var, name, .def.vec, VD_CVAR__VEC4_INIT(x, y, z, w), VD_CVS_VEC4)
+#define VD_CVAR__VEC4_INIT(x, y, z, w) { x, y, z, w }
+
 /**
  * @brief Get a cvar
  * @param name  The name of the cvar
@@ -45,8 +206,10 @@ void vd_cvs_deinit(VD_CVS *cvs);
 #define VD_CVS_GET_INT(name, vptr)                                          \
     do                                                                      \
     {                                                                       \
+        VD_SYMBOL_LIT(__cvar_name, name);                                   \
         VD_CVarValue __cvar;                                                \
-        VD_CVS_GET(name, &__cvar);                                          \
+        vd_cvs_get_symbol(                                                  \
+            vd_instance_get_cvs(vd_instance_get()), __cvar_name, &__cvar);  \
         assert(__cvar.type == VD_CVS_I32);                                  \
         *vptr = __cvar.v.i;                                                 \
     } while(0)
@@ -56,17 +219,22 @@ void vd_cvs_deinit(VD_CVS *cvs);
  * @param name  The name of the cvar
  * @param value The value of the cvar
  */
-#define VD_CVS_SET(name, value) \
-    vd_cvs_set(vd_instance_get_cvs(vd_instance_get()), VD_STR_LIT(name), value)
+#define VD_CVS_SET(name, value)                                             \
+    do                                                                      \
+    {                                                                       \
+        VD_SYMBOL_LIT(__cvar_name, name);                                   \
+        vd_cvs_set_symbol(                                                  \
+            vd_instance_get_cvs(vd_instance_get()), __cvar_name, value);    \
+    } while(0)
 
 #define VD_CVS_SET_INT(name, value) \
     VD_CVS_SET(name, ((VD_CVarValue) {.type = VD_CVS_I32, .v.i = value}))
 
 #define VD_CVS_SET_FLOAT(name, value) \
-    VD_CVS_SET(name, (VD_CVarValue) {.type = VD_CVS_F32, .v.f = value})
+    VD_CVS_SET(name, ((VD_CVarValue) {.type = VD_CVS_F32, .v.f = value}))
 
 #define VD_CVS_SET_BOOL(name, value) \
-    VD_CVS_SET(name, (VD_CVarValue) {.type = VD_CVS_BOOL, .v.b = value})
+    VD_CVS_SET(name, ((VD_CVarValue) {.type = VD_CVS_BOOL, .v.b = value}))
 
 /**
  * @brief Register a hook for cvar changes
@@ -87,4 +255,4 @@ void vd_cvs_deinit(VD_CVS *cvs);
         vd_instance_get_cvs(vd_instance_get()), \
         &(VD_CALLBACK(VD_CVarChangedDelegate)) {infptr, 0})
 
-#endif
\ No newline at end of file
+#endif
@@ -3,6 +3,7 @@
 #include "delegate.h"
 #include "builtin.h"
 #include "vd_log.h"
+#include "mm.h"
 
 VD_DELEGATE_DECLARE_PARAMS1_VOID(VD_UpdateDelegate, float, delta)
 
@@ -21,6 +22,18 @@ typedef struct {
         VD_GetPhysicalDevicePresentationSupportProc *get_physical_device_presentation_support;
         void 										*usrdata;
     } vulkan;
+
+    VD_MM_InitInfo                                  mm;
+
+    struct {
+        /** Write engine.vdlog as a binary log, @see VD_LOG_BINARY */
+        int                                         binary;
+    } log;
+
+    struct {
+        /** Config file to set cvars from at startup, @see vd_cvs_load_file */
+        const char                                  *path;
+    } cvars;
 } VD_InstanceInitInfo;
 
 VD_Instance *vd_instance_create();
@@ -31,6 +44,9 @@ void vd_instance_destroy(VD_Instance *instance);
 
 VD_UpdateHook *vd_instance_get_update_hook(VD_Instance *instance);
 
+/** Invocations deferred to this queue with VD_HOOK_DEFER run after the current frame. */
+VD_HookQueue *vd_instance_get_end_of_frame_queue(VD_Instance *instance);
+
 ecs_world_t *vd_instance_get_world(VD_Instance *instance);
 VD_MM 		*vd_instance_get_mm(VD_Instance *instance);
 VD_Renderer *vd_instance_get_renderer(VD_Instance *instance);
@@ -27,6 +27,34 @@ typedef enum {
 typedef struct VD_MM VD_MM;
 typedef struct ecs_iter_t ecs_iter_t;
 
+typedef enum {
+    /** Blocks from the system allocator, chained as needed. */
+    VD_MM_ARENA_BACKEND_CHAINED = 0,
+
+    /** A reserved range of address space, committed as needed. */
+    VD_MM_ARENA_BACKEND_VIRTUAL = 1,
+} VD_MM_ArenaBackend;
+
+/** The most frame arenas a VD_MM can have. */
+#define VD_MM_MAX_FRAME_ARENAS 16
+
+typedef struct {
+    VD_MM_ArenaBackend  frame_arena_backend;
+
+    /**
+     * Number of frame arenas. Every thread that allocates frame memory claims one of them for
+     * itself, except for the last one, which is shared by the threads that come after that.
+     * Defaults to 8, and is at most VD_MM_MAX_FRAME_ARENAS.
+     */
+    u32                 frame_arena_count;
+
+    /** Address space reserved for a virtual frame arena. Defaults to 1GB. */
+    u64                 frame_arena_reserve;
+
+    /** Bytes a virtual frame arena keeps committed between frames. Defaults to 4MB. */
+    u64                 frame_arena_retain;
+} VD_MM_InitInfo;
+
 typedef struct {
     /* Input */
     void            *ptr;
@@ -35,14 +63,34 @@ typedef struct {
     u64             entity_id;
 } VD_AllocationInfo;
 
+/** Number of size classes of the small entity allocation tier. */
+#define VD_MM_SLAB_CLASS_COUNT 12
+
+typedef struct {
+    /** The size of every object in the class. */
+    u32 object_size;
+    u64 num_slabs;
+    u64 used_objects;
+    u64 total_objects;
+} VD_MM_SlabClassStats;
+
 typedef struct {
+    u64 global_used;
+    u64 global_total;
+    u64 global_high_water;
+
+    /** Sums over every frame arena. */
     u64 frame_used;
     u64 frame_total;
+    u64 frame_high_water;
 
     u64 entity_used;
     u64 entity_total;
     u64 num_entity_blocks;
     u64 num_free_entity_blocks;
+
+    /** Entity allocations of up to 512 bytes, which come from slabs instead of their own block. */
+    VD_MM_SlabClassStats slab_classes[VD_MM_SLAB_CLASS_COUNT];
 } VD_MM_Stats;
 
 #define VD_MM_ALLOC(n, t) vd_mm_alloc(vd_instance_get_mm(vd_instance_get()),  \
@@ -67,12 +115,21 @@ typedef struct {
     vd_mm_make_entity_allocator(vd_instance_get_mm(vd_instance_get()), id)
 
 VD_MM *vd_mm_create();
-void vd_mm_init(VD_MM *mm);
+void vd_mm_init(VD_MM *mm, VD_MM_InitInfo *info);
 void *vd_mm_alloc(VD_MM *mm, VD_AllocationInfo *info);
 
 VD_Allocator *vd_mm_get_global_allocator(VD_MM *mm);
 
+/**
+ * @brief Get the frame arena of the calling thread.
+ * @note The arena that is shared between threads must only be used with vd_arena_alloc_t. Prefer
+ * VD_MM_FRAME_ALLOC or the frame allocator, which know the difference.
+ */
 VD_Arena *vd_mm_get_frame_arena(VD_MM *mm);
+
+/**
+ * @brief Get the frame allocator of the calling thread.
+ */
 VD_Allocator *vd_mm_get_frame_allocator(VD_MM *mm);
 
 VD_Allocator vd_mm_make_entity_allocator(VD_MM *mm, u64 entity_id);
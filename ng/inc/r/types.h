@@ -22,6 +22,9 @@ enum {
     VD_PASS_TRANSPARENT = 2000,
     VD_PASS_FINAL = 4000,
     VD_PASS_MAX = 100000,
+
+    /** The most frames a window can have in flight, @see r.inflight-frame-count */
+    VD_MAX_INFLIGHT_FRAMES = 3,
 };
 
 typedef enum {
@@ -69,6 +72,9 @@ typedef struct {
     VD(Allocation)  allocation;
     VkExtent3D      extent;
     VkFormat        format;
+
+    /** The index of the texture in the bindless texture array, 0 if it has none. */
+    u32             bindless_index;
 } VD(Texture); 
 
 typedef struct {
@@ -90,6 +96,9 @@ typedef struct {
     VkDeviceAddress     vertex_buffer_address;
     size_t              num_vertices;
     size_t              num_indices;
+
+    /** The bounding sphere in object space (center, radius), set when the mesh is written. */
+    vec4                bounds;
 } VD_R_GPUMesh;
 
 typedef struct {
@@ -161,6 +170,10 @@ typedef struct {
 typedef struct {
     VkDeviceAddress vertex_address;
     mat4            obj;
+
+    /** The material record of the draw in bindless mode, filled in by the renderer. */
+    u32             material_index;
+    u32             pad;
 } VD(DefaultPushConstant);
 
 typedef struct {
@@ -217,22 +230,55 @@ typedef struct {
 
     u32                      num_properties;
     VD(MaterialProperty)     *properties;
+
+    /**
+     * Optional. Replaces the vertex shader in a second pipeline, that draws the batches of GPU
+     * driven mode, @see r.gpu-driven. Without it, the blueprint's objects are drawn one by one.
+     */
+    HandleOf(VD_R_GPUShader) indirect_vertex_shader;
 } MaterialBlueprint;
 
 typedef struct {
     VkPipeline                      pipeline;
+
+    /** Built from MaterialBlueprint.indirect_vertex_shader, with the same layout. */
+    VkPipeline                      indirect_pipeline;
     VkPipelineLayout                layout;
     VkDescriptorSetLayout           property_layout;
+    int                             pass;
     u32                             num_properties;
     VD(MaterialProperty)            properties[VD_(MAX_MATERIAL_PROPERTIES)];
     VD(PushConstantInfo)            push_constant_info;
 } VD(GPUMaterialBlueprint);
 
+/** The property set of a material for one in flight frame slot. */
+typedef struct {
+    VkDescriptorSet                     set;
+
+    /** The material version the set holds, 0 before it was written. */
+    u32                                 version;
+    VD(Buffer)                          buffers[VD_MAX_UNIFORM_BUFFERS_PER_MATERIAL];
+    void                                *mapped[VD_MAX_UNIFORM_BUFFERS_PER_MATERIAL];
+} VD(GPUMaterialFrame);
+
 typedef struct {
     HandleOf(VD(GPUMaterialBlueprint))  blueprint;
     u32                                 num_buffers;
-    VD(Buffer)                          buffers[VD_MAX_UNIFORM_BUFFERS_PER_MATERIAL];
     VD(MaterialProperty)                properties[VD_(MAX_MATERIAL_PROPERTIES)];
+
+    /** Incremented whenever a property changes. Frames with an older version are rewritten. */
+    u32                                 version;
+    VkDescriptorPool                    pool;
+
+    /**
+     * In bindless mode, the material has no sets and only uses frames[].version, for its records in
+     * the bindless material buffer.
+     */
+    VD(GPUMaterialFrame)                frames[VD_MAX_INFLIGHT_FRAMES];
+    u32                                 bindless_index;
+
+    /** Set while the material is in SMat.bindless_pending. */
+    int                                 bindless_queued;
 } VD(GPUMaterial);
 
 typedef struct {
@@ -244,10 +290,38 @@ typedef struct {
 typedef struct {
     HandleOf(GPUMaterial)   material;
     int                     pass;
-    VkDescriptorSet         default_set;
     VkDescriptorSet         property_set;
+
+    /** The value of DefaultPushConstant.material_index in bindless mode. */
+    u32                     material_index;
 } GPUMaterialInstance;
 
+/**
+ * Set 0 of one in flight frame. The buffers stay mapped and the set is written once when it is
+ * created, so updating the scene data every frame is a memcpy.
+ */
+typedef struct {
+    VkDescriptorPool        pool;
+    VkDescriptorSet         set;
+    u32                     num_buffers;
+    VD(Buffer)              buffers[VD_MAX_UNIFORM_BUFFERS_PER_MATERIAL];
+    void                    *mapped[VD_MAX_UNIFORM_BUFFERS_PER_MATERIAL];
+} GPUSceneSet;
+
+/**
+ * What culling writes for one in flight frame of a window in GPU driven mode: the cull header with
+ * the batches, and the staging buffer of the instance upload. Every frame of every window has its
+ * own, so culling never writes memory that a frame of another window may still be reading.
+ */
+typedef struct {
+    VD(Buffer)              cull;
+    void                    *cull_mapped;
+    VkDeviceAddress         cull_address;
+    VD(Buffer)              staging;
+    void                    *staging_mapped;
+    size_t                  staging_size;
+} GPUCullFrame;
+
 typedef struct {
     HandleOf(VD_R_GPUMesh)  mesh;
     HandleOf(GPUMaterial)   material;
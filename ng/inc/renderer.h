@@ -44,6 +44,10 @@ typedef struct {
     VkSemaphore             sem_present_image;
     VD_DescriptorAllocator  descriptor_allocator;
     VD_DeletionQueue        deletion_queue;
+    GPUSceneSet             scene;
+
+    /** Only initialized in GPU driven mode. */
+    GPUCullFrame            cull;
 } VD_RendererFrameData;
 
 struct WindowSurfaceComponent {
@@ -55,11 +59,33 @@ struct WindowSurfaceComponent {
     VkExtent2D                      extent;
     VD_ARRAY VD_RendererFrameData   *frame_data;
     int                             current_frame;
+
+    /** Unique among the windows that exist, and reused once a window is destroyed. */
+    u32                             index;
     VD(Texture)                     color_image;
     VD(Texture)                     depth_image;
     VD_ARRAY VD(RenderObject)       *render_list;
 };
 
+/** What the last frame submitted, summed over every window. */
+typedef struct {
+    u32 draws;
+
+    /** vkCmdDrawIndexedIndirectCount calls in GPU driven mode, one per batch that has instances. */
+    u32 indirect_draws;
+    u32 pipeline_binds;
+    u32 pipeline_binds_skipped;
+    u32 descriptor_set_binds;
+    u32 descriptor_set_binds_skipped;
+    u32 index_buffer_binds;
+    u32 index_buffer_binds_skipped;
+    u32 scissor_sets;
+    u32 scissor_sets_skipped;
+
+    /** Descriptors written into material sets. Only changed materials write any. */
+    u32 descriptor_writes;
+} VD_RendererStats;
+
 VD_Renderer *vd_renderer_create();
 int vd_renderer_init(VD_Renderer *renderer, VD_RendererInitInfo *info);
 int vd_renderer_deinit(VD_Renderer *renderer);
@@ -79,6 +105,8 @@ void vd_renderer_unmap_buffer(VD_Renderer *renderer, VD(Buffer) *buffer);
 
 VkDevice vd_renderer_get_device(VD_Renderer *renderer);
 
+void vd_renderer_get_stats(VD_Renderer *renderer, VD_RendererStats *stats);
+
 Handle vd_renderer_get_default_handle(VD_Renderer *renderer, VD(RendererDefaultHandleSlot) slot);
 
 HandleOf(VD(Texture)) vd_renderer_create_texture(
@@ -107,6 +135,16 @@ HandleOf(GPUMaterial) vd_renderer_create_material(
 
 HandleOf(GPUMaterialBlueprint) vd_renderer_get_default_material(VD_Renderer *renderer);
 
+/**
+ * @brief Change a property of a material, @see MaterialBlueprint.properties for the indices. Only
+ * materials changed this way get their descriptors written again.
+ */
+void vd_renderer_set_material_property(
+    VD_Renderer *renderer,
+    HandleOf(GPUMaterial) material,
+    u32 index,
+    MaterialProperty *value);
+
 void vd_renderer_push_render_object(
     VD_Renderer *renderer,
     WindowSurfaceComponent *ws,
@@ -124,8 +162,10 @@ void vd_renderer_destroy_texture(
 
 // ----OBSERVERS------------------------------------------------------------------------------------
 extern void RendererOnWindowComponentSet(ecs_iter_t *it);
+extern void RendererOnStaticMeshRemove(ecs_iter_t *it);
 
 // ----SYSTEMS--------------------------------------------------------------------------------------
+extern void RendererBeginFrameSystem(ecs_iter_t *it);
 extern void RendererRenderToWindowSurfaceComponents(ecs_iter_t *it);
 extern void RendererCheckWindowComponentSizeChange(ecs_iter_t *it);
 extern void RendererGatherStaticMeshComponentSystem(ecs_iter_t *it);
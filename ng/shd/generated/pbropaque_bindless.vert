@@ -0,0 +1,41 @@
+"#version 450\n"
+"#extension GL_EXT_buffer_reference : require\n"
+"#extension GL_GOOGLE_include_directive : require\n"
+"#include \"vd.glsl\"\n"
+"\n"
+"\n"
+"layout (location = 0) out vec3 outColor;\n"
+"layout (location = 1) out vec2 outUV;\n"
+"layout (location = 2) out vec3 outNormal;\n"
+"layout (location = 3) out vec3 outWorldPos;\n"
+"layout (location = 4) flat out uint outMaterialIndex;\n"
+"\n"
+"layout(buffer_reference, std430) readonly buffer VertexBuffer {\n"
+"	Vertex vertices[];\n"
+"};\n"
+"\n"
+"//push constants block\n"
+"layout( push_constant ) uniform constants\n"
+"{	\n"
+"	VertexBuffer vertexBuffer;\n"
+"    mat4         obj;\n"
+"    uint         materialIndex;\n"
+"} PushConstants;\n"
+"\n"
+"void main() \n"
+"{	\n"
+"	//load vertex data from device adress\n"
+"	Vertex v = PushConstants.vertexBuffer.vertices[gl_VertexIndex];\n"
+"\n"
+"	//output data\n"
+"	gl_Position = object_space_to_ndc(PushConstants.obj, v.position);\n"
+"\n"
+"	// outColor = v.color.xyz;\n"
+"	outColor = vec3(v.uv_x, v.uv_y, 1.0f);\n"
+"	outUV.x = v.uv_x;\n"
+"	outUV.y = v.uv_y;\n"
+"    outNormal = v.normal;\n"
+"    outWorldPos = (PushConstants.obj * vec4(v.position, 1.0)).xyz;\n"
+"    outMaterialIndex = PushConstants.materialIndex;\n"
+"}\n"
+"";
@@ -0,0 +1,37 @@
+"#version 450\n"
+"#extension GL_EXT_buffer_reference : require\n"
+"#extension GL_GOOGLE_include_directive : require\n"
+"#include \"vd.glsl\"\n"
+"#include \"vd.scene.glsl\"\n"
+"\n"
+"\n"
+"layout (location = 0) out vec3 outColor;\n"
+"layout (location = 1) out vec2 outUV;\n"
+"layout (location = 2) out vec3 outNormal;\n"
+"layout (location = 3) out vec3 outWorldPos;\n"
+"layout (location = 4) flat out uint outMaterialIndex;\n"
+"\n"
+"// SSceneDrawPushConstant, in the range of DefaultPushConstant\n"
+"layout( push_constant ) uniform constants\n"
+"{\n"
+"    VD_InstanceBuffer   instances;\n"
+"    VD_CullBuffer       cull;\n"
+"    uint                materialBase;\n"
+"} PushConstants;\n"
+"\n"
+"void main() \n"
+"{\n"
+"    // The cull shader sets the first instance of every command to the index of its instance\n"
+"    VD_Instance instance = PushConstants.instances.instances[gl_InstanceIndex];\n"
+"    Vertex v = PushConstants.cull.batches[instance.batch].vertices.vertices[gl_VertexIndex];\n"
+"\n"
+"    gl_Position = object_space_to_ndc(instance.obj, v.position);\n"
+"\n"
+"    outColor = vec3(v.uv_x, v.uv_y, 1.0f);\n"
+"    outUV.x = v.uv_x;\n"
+"    outUV.y = v.uv_y;\n"
+"    outNormal = v.normal;\n"
+"    outWorldPos = (instance.obj * vec4(v.position, 1.0)).xyz;\n"
+"    outMaterialIndex = PushConstants.materialBase + instance.material_index;\n"
+"}\n"
+"";
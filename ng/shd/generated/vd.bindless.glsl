@@ -0,0 +1,25 @@
+"// Set 1 in bindless mode. Shaders that include this enable GL_EXT_nonuniform_qualifier.\n"
+"\n"
+"layout (set = 1, binding = 0) uniform sampler2D vd_textures[];\n"
+"\n"
+"layout (set = 1, binding = 1, std430) readonly buffer VD_R_Materials {\n"
+"    uint words[];\n"
+"} vd_materials;\n"
+"\n"
+"// SBINDLESS_MATERIAL_STRIDE / 4\n"
+"const uint VD_MATERIAL_STRIDE_WORDS = 64;\n"
+"\n"
+"uint vd_material_word(uint material_index, uint word) {\n"
+"    return vd_materials.words[material_index * VD_MATERIAL_STRIDE_WORDS + word];\n"
+"}\n"
+"\n"
+"float vd_material_float(uint material_index, uint word) {\n"
+"    return uintBitsToFloat(vd_material_word(material_index, word));\n"
+"}\n"
+"\n"
+"// Sample the texture of the sampler2d property at a word of the material record\n"
+"vec4 vd_material_texture(uint material_index, uint word, vec2 uv) {\n"
+"    uint texture_index = vd_material_word(material_index, word);\n"
+"    return texture(vd_textures[nonuniformEXT(texture_index)], uv);\n"
+"}\n"
+"";
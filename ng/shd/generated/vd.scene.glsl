@@ -0,0 +1,58 @@
+"// GPU driven drawing, @see sscene.h. Shaders that include this enable GL_EXT_buffer_reference.\n"
+"\n"
+"layout(buffer_reference, std430) readonly buffer VD_VertexBuffer {\n"
+"    Vertex vertices[];\n"
+"};\n"
+"\n"
+"// SSceneInstance\n"
+"struct VD_Instance {\n"
+"    mat4 obj;\n"
+"    uint batch;\n"
+"    uint material_index;\n"
+"    uint window;\n"
+"    uint pad;\n"
+"};\n"
+"\n"
+"layout(buffer_reference, std430) readonly buffer VD_InstanceBuffer {\n"
+"    VD_Instance instances[];\n"
+"};\n"
+"\n"
+"// SSceneGPUBatch\n"
+"struct VD_Batch {\n"
+"    vec4            bounds;\n"
+"    VD_VertexBuffer vertices;\n"
+"    uint            index_count;\n"
+"    uint            first_index;\n"
+"    uint            first_command;\n"
+"    uint            pad0;\n"
+"    uint            pad1;\n"
+"    uint            pad2;\n"
+"};\n"
+"\n"
+"// SSceneCullHeader, followed by the batches\n"
+"layout(buffer_reference, std430) readonly buffer VD_CullBuffer {\n"
+"    vec4     planes[6];\n"
+"    uint     num_instances;\n"
+"    uint     num_batches;\n"
+"    uint     window;\n"
+"    uint     pad;\n"
+"    VD_Batch batches[];\n"
+"};\n"
+"\n"
+"layout(buffer_reference, std430) buffer VD_CountBuffer {\n"
+"    uint counts[];\n"
+"};\n"
+"\n"
+"// VkDrawIndexedIndirectCommand\n"
+"struct VD_DrawCommand {\n"
+"    uint index_count;\n"
+"    uint instance_count;\n"
+"    uint first_index;\n"
+"    int  vertex_offset;\n"
+"    uint first_instance;\n"
+"};\n"
+"\n"
+"layout(buffer_reference, std430) writeonly buffer VD_CommandBuffer {\n"
+"    VD_DrawCommand commands[];\n"
+"};\n"
+"";
@@ -0,0 +1,36 @@
+#version 450
+#extension GL_EXT_buffer_reference : require
+#extension GL_GOOGLE_include_directive : require
+#include "vd.glsl"
+#include "vd.scene.glsl"
+
+
+layout (location = 0) out vec3 outColor;
+layout (location = 1) out vec2 outUV;
+layout (location = 2) out vec3 outNormal;
+layout (location = 3) out vec3 outWorldPos;
+layout (location = 4) flat out uint outMaterialIndex;
+
+// SSceneDrawPushConstant, in the range of DefaultPushConstant
+layout( push_constant ) uniform constants
+{
+    VD_InstanceBuffer   instances;
+    VD_CullBuffer       cull;
+    uint                materialBase;
+} PushConstants;
+
+void main() 
+{
+    // The cull shader sets the first instance of every command to the index of its instance
+    VD_Instance instance = PushConstants.instances.instances[gl_InstanceIndex];
+    Vertex v = PushConstants.cull.batches[instance.batch].vertices.vertices[gl_VertexIndex];
+
+    gl_Position = object_space_to_ndc(instance.obj, v.position);
+
+    outColor = vec3(v.uv_x, v.uv_y, 1.0f);
+    outUV.x = v.uv_x;
+    outUV.y = v.uv_y;
+    outNormal = v.normal;
+    outWorldPos = (instance.obj * vec4(v.position, 1.0)).xyz;
+    outMaterialIndex = PushConstants.materialBase + instance.material_index;
+}
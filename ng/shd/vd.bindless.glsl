@@ -0,0 +1,24 @@
+// Set 1 in bindless mode. Shaders that include this enable GL_EXT_nonuniform_qualifier.
+
+layout (set = 1, binding = 0) uniform sampler2D vd_textures[];
+
+layout (set = 1, binding = 1, std430) readonly buffer VD_R_Materials {
+    uint words[];
+} vd_materials;
+
+// SBINDLESS_MATERIAL_STRIDE / 4
+const uint VD_MATERIAL_STRIDE_WORDS = 64;
+
+uint vd_material_word(uint material_index, uint word) {
+    return vd_materials.words[material_index * VD_MATERIAL_STRIDE_WORDS + word];
+}
+
+float vd_material_float(uint material_index, uint word) {
+    return uintBitsToFloat(vd_material_word(material_index, word));
+}
+
+// Sample the texture of the sampler2d property at a word of the material record
+vec4 vd_material_texture(uint material_index, uint word, vec2 uv) {
+    uint texture_index = vd_material_word(material_index, word);
+    return texture(vd_textures[nonuniformEXT(texture_index)], uv);
+}
@@ -0,0 +1,57 @@
+// GPU driven drawing, @see sscene.h. Shaders that include this enable GL_EXT_buffer_reference.
+
+layout(buffer_reference, std430) readonly buffer VD_VertexBuffer {
+    Vertex vertices[];
+};
+
+// SSceneInstance
+struct VD_Instance {
+    mat4 obj;
+    uint batch;
+    uint material_index;
+    uint window;
+    uint pad;
+};
+
+layout(buffer_reference, std430) readonly buffer VD_InstanceBuffer {
+    VD_Instance instances[];
+};
+
+// SSceneGPUBatch
+struct VD_Batch {
+    vec4            bounds;
+    VD_VertexBuffer vertices;
+    uint            index_count;
+    uint            first_index;
+    uint            first_command;
+    uint            pad0;
+    uint            pad1;
+    uint            pad2;
+};
+
+// SSceneCullHeader, followed by the batches
+layout(buffer_reference, std430) readonly buffer VD_CullBuffer {
+    vec4     planes[6];
+    uint     num_instances;
+    uint     num_batches;
+    uint     window;
+    uint     pad;
+    VD_Batch batches[];
+};
+
+layout(buffer_reference, std430) buffer VD_CountBuffer {
+    uint counts[];
+};
+
+// VkDrawIndexedIndirectCommand
+struct VD_DrawCommand {
+    uint index_count;
+    uint instance_count;
+    uint first_index;
+    int  vertex_offset;
+    uint first_instance;
+};
+
+layout(buffer_reference, std430) writeonly buffer VD_CommandBuffer {
+    VD_DrawCommand commands[];
+};
@@ -17,9 +17,11 @@ ECS_SYSTEM_DECLARE(GarbageCollectTask);
 ECS_SYSTEM_DECLARE(FreeFrameAllocationSystem);
 
 // ----RENDERER-------------------------------------------------------------------------------------
+ECS_SYSTEM_DECLARE(RendererBeginFrameSystem);                // EcsPreFrame
 ECS_SYSTEM_DECLARE(RendererRenderToWindowSurfaceComponents); // EcsOnStore
 ECS_SYSTEM_DECLARE(RendererCheckWindowComponentSizeChange);  // EcsOnPostLoad
 ECS_SYSTEM_DECLARE(RendererGatherStaticMeshComponentSystem);
+ECS_OBSERVER_DECLARE(RendererOnStaticMeshRemove);
 ECS_COMPONENT_DECLARE(LocationComponent);
 ECS_COMPONENT_DECLARE(RotationComponent);
 ECS_COMPONENT_DECLARE(ScaleComponent);
@@ -53,6 +55,8 @@ void BuiltinImport(ecs_world_t *world)
 	ECS_SYSTEM_DEFINE(world, FreeFrameAllocationSystem, EcsPostFrame, 0);
 
 // ----RENDERER-------------------------------------------------------------------------------------
+	ECS_SYSTEM_DEFINE(world, RendererBeginFrameSystem, EcsPreFrame, 0);
+
 	ECS_SYSTEM_DEFINE(
 		world,
 		RendererRenderToWindowSurfaceComponents,
@@ -66,6 +70,8 @@ void BuiltinImport(ecs_world_t *world)
 		WindowComponent,
 		Size2D);
 
+	ECS_OBSERVER_DEFINE(world, RendererOnStaticMeshRemove, EcsOnRemove, StaticMeshComponent);
+
     ecs_system(world, {
         .entity = ecs_entity(world,
         {
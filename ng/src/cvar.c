@@ -1,15 +1,40 @@
 #define VD_INTERNAL_SOURCE_FILE 1
 #include "cvar.h"
-#include "strmap.h"
+#include "intmap.h"
+#include "array.h"
+#include "vd_atomic.h"
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 struct VD_CVS {
-    strmap VD_CVarValue             *map;
+    /** VD_Symbol -> the head VD_CVar */
+    VD_IntMap                       map;
     VD_HOOK(VD_CVarChangedDelegate) on_cvar_update;
+
+    /** Every head, in the order they were created. */
+    dynarray VD_CVar                **cvars;
+
+    /** Taken by everything but reading a slot and marking it dirty. */
+    volatile i32                    lock;
+
+    /** Heads that were written since the last flush, newest first. */
+    VD_CVar *volatile               dirty;
 };
 
+static void lock_cvs(VD_CVS *cvs)
+{
+    while (vd_atomic_compare_and_swap32(&cvs->lock, 1, 0) != 0);
+}
+
+static void unlock_cvs(VD_CVS *cvs)
+{
+    vd_atomic_fence();
+    cvs->lock = 0;
+}
+
 VD_CVS *vd_cvs_create()
 {
     return calloc(1, sizeof(VD_CVS));
@@ -17,8 +42,9 @@ VD_CVS *vd_cvs_create()
 
 void vd_cvs_init(VD_CVS *cvs)
 {
-    strmap_init(cvs->map, vd_memory_get_system_allocator());
+    vd_intmap_init(&cvs->map, vd_memory_get_system_allocator(), 64, 0);
     VD_HOOK_INIT(cvs->on_cvar_update, vd_memory_get_system_allocator());
+    array_init(cvs->cvars, vd_memory_get_system_allocator());
 }
 
 void vd_cvs_register_hook(VD_CVS *cvs, VD_CALLBACK(VD_CVarChangedDelegate) *callback)
@@ -31,26 +57,479 @@ void vd_cvs_unregister_hook(VD_CVS *cvs, VD_CALLBACK(VD_CVarChangedDelegate) *ca
     VD_HOOK_UNSUBSCRIBE(cvs->on_cvar_update, callback->entry.func);
 }
 
+/* ----SLOTS------------------------------------------------------------------------------------- */
+
+/** Must be called with the lock held. */
+static VD_CVar *find_head(VD_CVS *cvs, VD_Symbol symbol)
+{
+    u64 v;
+    if (!vd_intmap_tryget(&cvs->map, symbol, &v)) {
+        return 0;
+    }
+
+    return (VD_CVar*)(umm)v;
+}
+
+/** Read a slot's value between writes. */
+static VD_CVarData read_data(VD_CVar *cvar)
+{
+    VD_CVarData data;
+    for (;;) {
+        u32 version = cvar->version;
+        vd_atomic_fence();
+        memcpy(&data, (void*)&cvar->v, sizeof(data));
+        vd_atomic_fence();
+        if (!(version & 1) && version == cvar->version) {
+            return data;
+        }
+    }
+}
+
+/** Write the value to every slot of the cvar. Must be called with the lock held. */
+static void write_data(VD_CVar *head, VD_CVarData data)
+{
+    for (VD_CVar *slot = head; slot; slot = slot->alias) {
+        slot->version++;
+        vd_atomic_fence();
+        memcpy((void*)&slot->v, &data, sizeof(data));
+        vd_atomic_fence();
+        slot->version++;
+    }
+}
+
+static void mark_dirty(VD_CVS *cvs, VD_CVar *head)
+{
+    if (vd_atomic_compare_and_swap32(&head->dirty, 1, 0) != 0) {
+        return;
+    }
+
+    for (;;) {
+        VD_CVar *first = cvs->dirty;
+        head->next_dirty = first;
+        if (vd_atomic_compare_and_swap_ptr((void *volatile*)&cvs->dirty, head, first) == first) {
+            return;
+        }
+    }
+}
+
+/** Make slot the head of a new cvar. Must be called with the lock held. */
+static void add_head(VD_CVS *cvs, VD_CVar *slot, VD_CVarData data)
+{
+    slot->head = slot;
+    slot->alias = 0;
+    slot->v = data;
+    vd_atomic_fence();
+    slot->version = 2;
+
+    vd_intmap_set(&cvs->map, slot->symbol, (u64)(umm)slot);
+    array_add(cvs->cvars, slot);
+}
+
+/** Create a slot for a cvar that no code declared yet. Must be called with the lock held. */
+static VD_CVar *add_owned(VD_CVS *cvs, VD_Symbol symbol, VD_CVarValue value)
+{
+    VD_CVar *slot = calloc(1, sizeof(VD_CVar));
+    slot->type = value.type;
+    slot->flags = VD_CVAR_FLAG_OWNED;
+    slot->symbol = symbol;
+    add_head(cvs, slot, value.v);
+    return slot;
+}
+
+VD_CVar *vd_cvs_bind(VD_CVS *cvs, VD_CVar *cvar)
+{
+    lock_cvs(cvs);
+
+    if (cvar->version == 0) {
+        cvar->symbol = vd_symbol_intern(vd_str_from_cstr(cvar->name));
+
+        VD_CVarData def = cvar->def;
+        if (cvar->type == VD_CVS_STR) {
+            def.s = vd_symbol_intern(vd_str_from_cstr(cvar->def_str ? cvar->def_str : ""));
+        }
+
+        VD_CVar *head = find_head(cvs, cvar->symbol);
+        if (head == 0) {
+            add_head(cvs, cvar, def);
+        } else {
+            assert(head->type == cvar->type);
+            cvar->head = head;
+            cvar->v = read_data(head);
+            vd_atomic_fence();
+            cvar->version = 2;
+
+            cvar->alias = head->alias;
+            head->alias = cvar;
+        }
+    }
+
+    unlock_cvs(cvs);
+    return cvar;
+}
+
+void vd_cvs_write(VD_CVS *cvs, VD_CVar *cvar, VD_CVarData value)
+{
+    lock_cvs(cvs);
+    write_data(cvar->head, value);
+    mark_dirty(cvs, cvar->head);
+    unlock_cvs(cvs);
+}
+
+u32 vd_cvs_flush(VD_CVS *cvs)
+{
+    VD_CVar *list;
+    do {
+        list = cvs->dirty;
+        if (list == 0) {
+            return 0;
+        }
+    } while (vd_atomic_compare_and_swap_ptr((void *volatile*)&cvs->dirty, 0, list) != list);
+
+    // Oldest change first
+    VD_CVar *ordered = 0;
+    while (list) {
+        VD_CVar *next = list->next_dirty;
+        list->next_dirty = ordered;
+        ordered = list;
+        list = next;
+    }
+
+    u32 count = 0;
+    while (ordered) {
+        VD_CVar *head = ordered;
+        ordered = head->next_dirty;
+
+        // Cleared first, so that writes from inside the hooks are flushed next time
+        head->dirty = 0;
+        vd_atomic_fence();
+
+        VD_CVarValue value = { .type = head->type, .v = read_data(head) };
+        VD_HOOK_INVOKE(cvs->on_cvar_update, vd_symbol_str(head->symbol), &value);
+        count++;
+    }
+
+    return count;
+}
+
+/* ----BY NAME----------------------------------------------------------------------------------- */
+
 VD_bool vd_cvs_get(VD_CVS *cvs, VD_str name, VD_CVarValue *cvar)
 {
-    return strmap_get(cvs->map, name, cvar);
+    VD_Symbol symbol = vd_interner_find(vd_symbols(), name);
+    if (symbol == 0) {
+        return 0;
+    }
+
+    return vd_cvs_get_symbol(cvs, symbol, cvar);
 }
 
 void vd_cvs_set(VD_CVS *cvs, VD_str name, VD_CVarValue value)
 {
-    VD_CVarValue cvar;
-    if (strmap_get(cvs->map, name, &cvar)) {
-        assert(cvar.type == value.type);
-        memcpy(&cvar, &value, sizeof(value));
-        VD_HOOK_INVOKE(cvs->on_cvar_update, name, &cvar);
+    vd_cvs_set_symbol(cvs, vd_symbol_intern(name), value);
+}
+
+VD_bool vd_cvs_get_symbol(VD_CVS *cvs, VD_Symbol name, VD_CVarValue *cvar)
+{
+    lock_cvs(cvs);
+    VD_CVar *head = find_head(cvs, name);
+    unlock_cvs(cvs);
+
+    if (head == 0) {
+        return 0;
+    }
+
+    cvar->type = head->type;
+    cvar->v = read_data(head);
+    return 1;
+}
+
+void vd_cvs_set_symbol(VD_CVS *cvs, VD_Symbol name, VD_CVarValue value)
+{
+    lock_cvs(cvs);
+
+    VD_CVar *head = find_head(cvs, name);
+    if (head) {
+        assert(head->type == value.type);
+        write_data(head, value.v);
+        mark_dirty(cvs, head);
     } else {
-        memcpy(&cvar, &value, sizeof(value));
-        strmap_set(cvs->map, name, &cvar);
+        add_owned(cvs, name, value);
+    }
+
+    unlock_cvs(cvs);
+}
+
+/* ----FILES------------------------------------------------------------------------------------- */
+
+static VD_str trim(VD_str s)
+{
+    while (s.len > 0 && (s.data[0] == ' ' || s.data[0] == '\t' || s.data[0] == '\r')) {
+        s.data++;
+        s.len--;
     }
+
+    while (s.len > 0 && (s.data[s.len - 1] == ' ' || s.data[s.len - 1] == '\t' || s.data[s.len - 1] == '\r')) {
+        s.len--;
+    }
+
+    return s;
+}
+
+/** Parse a number, and whether it was written as an integer. */
+static VD_bool parse_number(VD_str s, f64 *number, VD_bool *integer)
+{
+    char buf[64];
+    if (s.len == 0 || s.len >= sizeof(buf)) {
+        return 0;
+    }
+
+    memcpy(buf, s.data, s.len);
+    buf[s.len] = 0;
+
+    char *end;
+    *number = strtod(buf, &end);
+    *integer = strpbrk(buf, ".eEnN") == 0;
+    return end == buf + s.len;
+}
+
+/** Parse a value, with the type of the cvar it is for, or with the type it looks like if -1. */
+static VD_bool parse_value(VD_str s, int type, VD_CVarValue *out)
+{
+    if (s.len == 0) {
+        return 0;
+    }
+
+    if (s.data[0] == '"') {
+        if ((type != -1 && type != VD_CVS_STR) || s.len < 2 || s.data[s.len - 1] != '"') {
+            return 0;
+        }
+
+        char buf[1024];
+        u32 len = 0;
+        for (u32 i = 1; i < s.len - 1 && len < sizeof(buf); ++i) {
+            char c = s.data[i];
+            if (c == '\\' && i + 1 < s.len - 1) {
+                c = s.data[++i];
+                c = c == 'n' ? '\n' : c;
+            }
+
+            buf[len++] = c;
+        }
+
+        out->type = VD_CVS_STR;
+        out->v.s = vd_symbol_intern((VD_str) { buf, len });
+        return 1;
+    }
+
+    if (s.data[0] == '(') {
+        if ((type != -1 && type != VD_CVS_VEC4) || s.data[s.len - 1] != ')') {
+            return 0;
+        }
+
+        out->type = VD_CVS_VEC4;
+        memset(out->v.vec, 0, sizeof(out->v.vec));
+
+        VD_str rest = { s.data + 1, s.len - 2 };
+        for (int i = 0; i < 4 && rest.len > 0; ++i) {
+            u32 comma = 0;
+            while (comma < rest.len && rest.data[comma] != ',') {
+                comma++;
+            }
+
+            f64 number;
+            VD_bool integer;
+            if (!parse_number(trim((VD_str) { rest.data, comma }), &number, &integer)) {
+                return 0;
+            }
+
+            out->v.vec[i] = (f32)number;
+            rest = comma < rest.len ? (VD_str) { rest.data + comma + 1, rest.len - comma - 1 } : (VD_str) { 0, 0 };
+        }
+
+        return rest.len == 0;
+    }
+
+    if (vd_str_eq(s, VD_STR_LIT("true")) || vd_str_eq(s, VD_STR_LIT("false"))) {
+        if (type != -1 && type != VD_CVS_BOOL) {
+            return 0;
+        }
+
+        out->type = VD_CVS_BOOL;
+        out->v.b = s.data[0] == 't';
+        return 1;
+    }
+
+    f64 number;
+    VD_bool integer;
+    if (!parse_number(s, &number, &integer)) {
+        return 0;
+    }
+
+    if (type == VD_CVS_F32 || (type == -1 && !integer)) {
+        out->type = VD_CVS_F32;
+        out->v.f = (f32)number;
+        return 1;
+    }
+
+    if ((type == VD_CVS_I32 || type == -1) && integer) {
+        out->type = VD_CVS_I32;
+        out->v.i = (i32)number;
+        return 1;
+    }
+
+    return 0;
+}
+
+u32 vd_cvs_load(VD_CVS *cvs, VD_str text)
+{
+    u32 errors = 0;
+    while (text.len > 0) {
+        u32 end = 0;
+        while (end < text.len && text.data[end] != '\n') {
+            end++;
+        }
+
+        VD_str line = trim((VD_str) { text.data, end });
+        text = end < text.len ? (VD_str) { text.data + end + 1, text.len - end - 1 } : (VD_str) { 0, 0 };
+
+        if (line.len == 0 || line.data[0] == '#') {
+            continue;
+        }
+
+        u32 eq = 0;
+        while (eq < line.len && line.data[eq] != '=') {
+            eq++;
+        }
+
+        VD_str name = trim((VD_str) { line.data, eq });
+        if (eq == line.len || name.len == 0) {
+            errors++;
+            continue;
+        }
+
+        VD_str value_str = trim((VD_str) { line.data + eq + 1, line.len - eq - 1 });
+        VD_Symbol symbol = vd_symbol_intern(name);
+
+        lock_cvs(cvs);
+        VD_CVar *head = find_head(cvs, symbol);
+
+        VD_CVarValue value;
+        if (!parse_value(value_str, head ? (int)head->type : -1, &value)) {
+            errors++;
+        } else if (head) {
+            write_data(head, value.v);
+            mark_dirty(cvs, head);
+        } else {
+            add_owned(cvs, symbol, value);
+        }
+
+        unlock_cvs(cvs);
+    }
+
+    return errors;
+}
+
+int vd_cvs_load_file(VD_CVS *cvs, const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return -1;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char *text = malloc(size > 0 ? (size_t)size : 1);
+    size_t read = fread(text, 1, (size_t)size, f);
+    fclose(f);
+
+    int result = (int)vd_cvs_load(cvs, (VD_str) { text, (u32)read });
+    free(text);
+    return result;
+}
+
+static int compare_names(const void *a, const void *b)
+{
+    VD_str x = vd_symbol_str((*(VD_CVar* const*)a)->symbol);
+    VD_str y = vd_symbol_str((*(VD_CVar* const*)b)->symbol);
+    int c = memcmp(x.data, y.data, x.len < y.len ? x.len : y.len);
+    return c != 0 ? c : (x.len > y.len) - (x.len < y.len);
+}
+
+static void write_value(FILE *f, VD_CVarType type, VD_CVarData data)
+{
+    switch (type) {
+        case VD_CVS_I32:  fprintf(f, "%d", data.i); break;
+        case VD_CVS_F32:  fprintf(f, "%.9g", data.f); break;
+        case VD_CVS_BOOL: fputs(data.b ? "true" : "false", f); break;
+        case VD_CVS_VEC4: {
+            fprintf(f, "(%.9g, %.9g, %.9g, %.9g)", data.vec[0], data.vec[1], data.vec[2], data.vec[3]);
+        } break;
+
+        case VD_CVS_STR: {
+            VD_str s = vd_symbol_str(data.s);
+            fputc('"', f);
+            for (u32 i = 0; i < s.len; ++i) {
+                char c = s.data[i];
+                if (c == '"' || c == '\\') {
+                    fputc('\\', f);
+                } else if (c == '\n') {
+                    fputc('\\', f);
+                    c = 'n';
+                }
+
+                fputc(c, f);
+            }
+            fputc('"', f);
+        } break;
+    }
+}
+
+int vd_cvs_save_file(VD_CVS *cvs, const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        return -1;
+    }
+
+    lock_cvs(cvs);
+
+    size_t len = array_len(cvs->cvars);
+    VD_CVar **sorted = malloc((len > 0 ? len : 1) * sizeof(VD_CVar*));
+    memcpy(sorted, cvs->cvars, len * sizeof(VD_CVar*));
+    qsort(sorted, len, sizeof(VD_CVar*), compare_names);
+
+    for (size_t i = 0; i < len; ++i) {
+        VD_str name = vd_symbol_str(sorted[i]->symbol);
+        fprintf(f, "%.*s = ", (int)name.len, name.data);
+        write_value(f, sorted[i]->type, read_data(sorted[i]));
+        fputc('\n', f);
+    }
+
+    unlock_cvs(cvs);
+    free(sorted);
+
+    return fclose(f) == 0 ? 0 : -1;
 }
 
 void vd_cvs_deinit(VD_CVS *cvs)
 {
-    strmap_deinit(cvs->map);
+    for (size_t i = 0; i < array_len(cvs->cvars); ++i) {
+        VD_CVar *head = cvs->cvars[i];
+
+        // Slots declared in code can outlive the CVS, and are bound again by the next one
+        for (VD_CVar *slot = head, *next; slot; slot = next) {
+            next = slot->alias;
+            if (slot->flags & VD_CVAR_FLAG_OWNED) {
+                free(slot);
+            } else {
+                slot->version = 0;
+            }
+        }
+    }
+
+    array_deinit(cvs->cvars);
+    vd_intmap_deinit(&cvs->map);
     VD_HOOK_DEINIT(cvs->on_cvar_update);
 }
@@ -9,4 +9,20 @@ const char *VD_PBROPAQUE_FRAG =
 #include "shd/generated/pbropaque.frag"
 ;
 
+const char *VD_PBROPAQUE_BINDLESS_VERT =
+#include "shd/generated/pbropaque_bindless.vert"
+;
+
+const char *VD_PBROPAQUE_BINDLESS_FRAG =
+#include "shd/generated/pbropaque_bindless.frag"
+;
+
+const char *VD_PBROPAQUE_INDIRECT_VERT =
+#include "shd/generated/pbropaque_indirect.vert"
+;
+
+const char *VD_SSCENE_CULL_COMP =
+#include "shd/generated/sscene_cull.comp"
+;
+
 #endif // !VD_DEFAULT_SHADERS_H
@@ -13,7 +13,6 @@
 
 #include <stdlib.h>
 
-#define VD_LOG_IMPLEMENTATION
 #include "vd_log.h"
 
 #include "tracy/TracyC.h"
@@ -24,6 +23,7 @@ struct VD_Instance {
     VD_Renderer			    *r;
     VD_SubsytemManager		sm;
     VD_UpdateHook			on_update;
+    VD_HookQueue            end_of_frame;
     ecs_world_t				*world;
     VD_MM					*mm;
     VD_CVS                  *cvs;
@@ -55,7 +55,11 @@ void vd_instance_init(VD_Instance *instance, VD_InstanceInitInfo *info)
     
     Local_Instance = instance;
     instance->mm = vd_mm_create();
-    vd_mm_init(instance->mm);
+    vd_mm_init(instance->mm, &info->mm);
+
+    VD_HOOK_INIT(instance->on_update, vd_memory_get_system_allocator());
+    vd_hook_queue_init(&instance->end_of_frame, vd_memory_get_system_allocator());
+    vd_hook_thread_online();
 
     TracyCZoneEnd(Initialize_MM);
 
@@ -70,11 +74,16 @@ void vd_instance_init(VD_Instance *instance, VD_InstanceInitInfo *info)
                 vd_str_chop_right_last_of(exec_path, '/'));
 
     instance->log.filepath = strdup(log_path.data);
-    instance->log.flags = VD_LOG_WRITE_STDOUT | VD_LOG_WRITE_FILE;
+    instance->log.flags = VD_LOG_WRITE_STDOUT | VD_LOG_WRITE_FILE | VD_LOG_MT | VD_LOG_FLUSH_ON_CRASH;
+    if (info->log.binary) {
+        instance->log.flags |= VD_LOG_BINARY;
+    }
+
     vd_fmt_printf("%{stru32}\n", log_path);
 
     VD_LOG_SET(&instance->log);
     VD_LOG_RESET();
+    vd_log_init(&instance->log);
 
     VD_LOG("Instance", ">>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>> Begin Log");
 
@@ -85,6 +94,15 @@ void vd_instance_init(VD_Instance *instance, VD_InstanceInitInfo *info)
     instance->cvs = vd_cvs_create();
     vd_cvs_init(instance->cvs);
 
+    if (info->cvars.path) {
+        int errors = vd_cvs_load_file(instance->cvs, info->cvars.path);
+        if (errors < 0) {
+            VD_LOG_FMT("Instance", "Could not read config file: %{cstr}", info->cvars.path);
+        } else if (errors > 0) {
+            VD_LOG_FMT("Instance", "Config file %{cstr} has %{i32} invalid lines", info->cvars.path, errors);
+        }
+    }
+
     TracyCZoneEnd(Initialize_CVS);
 // ----FLECS----------------------------------------------------------------------------------------
     TracyCZoneN(Initialize_Flecs, "Initialize::Flecs", 1);
@@ -143,6 +161,10 @@ void vd_instance_main(VD_Instance *instance)
 
     while (!instance->should_close) {
         ecs_progress(instance->world, 0.0f);
+
+        vd_cvs_flush(instance->cvs);
+        vd_hook_queue_flush(&instance->end_of_frame);
+        vd_hook_quiescent();
     }
 
     ecs_quit(instance->world);
@@ -156,10 +178,16 @@ void vd_instance_deinit(VD_Instance *instance)
     ecs_fini(instance->world);
 // ----CVS------------------------------------------------------------------------------------------
     vd_cvs_deinit(instance->cvs);
+// ----HOOKS----------------------------------------------------------------------------------------
+    vd_hook_queue_deinit(&instance->end_of_frame);
+    VD_HOOK_DEINIT(instance->on_update);
+    vd_hook_thread_offline();
+    vd_hook_quiescent();
 // ----MM-------------------------------------------------------------------------------------------
     vd_mm_deinit(instance->mm);
 // ----LOG------------------------------------------------------------------------------------------
     VD_LOG("Instance", "<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<< End Log");
+    vd_log_deinit(&instance->log);
 }
 
 void vd_instance_destroy(VD_Instance *instance)
@@ -177,6 +205,11 @@ VD_UpdateHook *vd_instance_get_update_hook(VD_Instance *instance)
     return &instance->on_update;
 }
 
+VD_HookQueue *vd_instance_get_end_of_frame_queue(VD_Instance *instance)
+{
+    return &instance->end_of_frame;
+}
+
 ecs_world_t *vd_instance_get_world(VD_Instance *instance)
 {
     return instance->world;
@@ -207,11 +240,7 @@ void vd(all_windows)(VD_Instance *instance, VD_ARRAY PtrTo(ecs_entity_t) *result
     ecs_iter_t it = ecs_query_iter(instance->world, instance->cached_window_query);
 
     while (ecs_query_next(&it)) {
-        WindowComponent *w = ecs_field(&it, WindowComponent, 0);
-
-        for (int i = 0; i < it.count; ++i) {
-            array_add(*result, it.entities[i]);
-        }
+        array_append_n(*result, it.entities, it.count);
     }
 }
 
@@ -13,14 +13,75 @@
 
 typedef struct VD_EntityAllocationInfo VD_EntityAllocationInfo;
 
-struct VD_EntityAllocationInfo {
-    /** The size of the allocation (including this header). */
-    size_t 					size;
+#define ENTITY_ALLOCATIONS_PER_INFO 6
+
+/** Set in the low bit of an entity allocation that came from a slab. */
+#define ENTITY_ALLOCATION_FROM_SLAB 1
 
-    /** The next allocation for this entity. */
+/**
+ * A chunk of the list of allocations that belong to an entity. The chunk in the MemoryComponent
+ * fills up first, and is then moved to a new chunk that is linked after it.
+ */
+struct VD_EntityAllocationInfo {
+    /** The next chunk of this entity, or of the next entity in the free list. */
     VD_EntityAllocationInfo *next;
+    u64                     count;
+    umm                     allocations[ENTITY_ALLOCATIONS_PER_INFO];
+};
+
+/** Slabs are carved from buddy blocks of this size, which the buddy allocator aligns to it. */
+#define SLAB_PAGE_SIZE (64 * 1024)
+
+/** The largest size class. Bigger entity allocations get a buddy block of their own. */
+#define SLAB_MAX_OBJECT_SIZE 512
+
+#define SLAB_MAX_OBJECTS (SLAB_PAGE_SIZE / 16)
+
+static const u32 Slab_Class_Sizes[VD_MM_SLAB_CLASS_COUNT] = {
+    16, 32, 48, 64, 96, 128, 160, 192, 256, 320, 384, 512,
 };
 
+typedef struct Slab Slab;
+
+/** The header at the start of a slab page. The objects follow it. */
+struct Slab {
+    /** Neighbours in the partial list of the class, while the slab has free objects. */
+    Slab    *prev;
+    Slab    *next;
+
+    /** The next slab that ran empty during the current batch of frees. */
+    Slab    *next_empty;
+    u16     size_class;
+    u16     capacity;
+    u16     used;
+
+    /** The first occupancy word that may have a free object. */
+    u16     first_free_word;
+    u8      in_partial_list;
+    u8      in_empty_list;
+
+    /** A set bit for every object that is in use. Bits past capacity are always set. */
+    u64     occupancy[SLAB_MAX_OBJECTS / 64];
+};
+
+#define SLAB_HEADER_SIZE ((sizeof(Slab) + 15) & ~(size_t)15)
+
+typedef struct {
+    /** Slabs that have at least one free object. */
+    Slab    *partial;
+    u64     num_slabs;
+    u64     used_objects;
+    u64     total_objects;
+} SlabClass;
+
+typedef struct {
+    Arena           arena;
+    VD_Allocator    allocator;
+
+    /** Used by more than one thread, so every allocation must go through vd_arena_alloc_t. */
+    int             shared;
+} FrameArena;
+
 struct VD_MM {
 
     struct {
@@ -29,44 +90,251 @@ struct VD_MM {
     } global;
 
     struct {
-        Arena 			arena;
-        VD_Allocator 	allocator;
+        FrameArena      arenas[VD_MM_MAX_FRAME_ARENAS];
+        u32             count;
+
+        /** The next index handed out to a thread that allocates frame memory for the first time. */
+        volatile u32    next_stage;
+
+        /** Distinguishes this VD_MM from others in the thread local stage index. */
+        u32             id;
     } frame;
 
     struct {
         VD_BuddyAlloc 			allocator;
-        VD_EntityAllocationInfo free_list;
+        SlabClass               classes[VD_MM_SLAB_CLASS_COUNT];
+
+        /** Chunks of destroyed entities, freed by GarbageCollectTask. */
+        VD_EntityAllocationInfo *volatile free_list;
+
+        /** Guards the buddy allocator and the slabs. */
+        volatile i32            lock;
     } entity;
 };
 
 /**
- * @brief Adds an allocation to @param root.
- * @param root The root of the list.
- * @param info The allocation to add.
- * @return void
- * @note This function does not check if the allocation is already in the list.
- * @note This function makes no assumptions if the allocation and root belong in the same entity.
+ * @brief Add the chunks from first to last to the list at root.
+ * @note This function makes no assumptions if the chunks and root belong in the same entity.
  */
-static void add_entity_allocation(VD_EntityAllocationInfo *root, VD_EntityAllocationInfo *info)
+static void add_entity_allocations(
+    VD_EntityAllocationInfo *volatile *root,
+    VD_EntityAllocationInfo *first,
+    VD_EntityAllocationInfo *last)
 {
     VD_EntityAllocationInfo *prev_next;
     do
     {
-        prev_next = (VD_EntityAllocationInfo*)load_ptr(&root->next);
-        info->next = prev_next;
+        prev_next = (VD_EntityAllocationInfo*)load_ptr((void*)root);
+        last->next = prev_next;
+    } while (compare_and_swap_ptr((void *volatile*)root, first, prev_next) != prev_next);
+}
+
+static VD_BUDDY_ALLOCATION_PROC(buddy_alloc_proc)
+{
+    VD_Allocator *allocator = (VD_Allocator *)usrdata;
+    return (void*)allocator->proc_alloc((umm)ptr, prevsize, newsize, allocator->c);
+}
+
+static void lock_entity_memory(VD_MM *mm)
+{
+    while (compare_and_swap32(&mm->entity.lock, 1, 0) != 0);
+}
 
-        // @note: not sure how this can happen...
-        if (prev_next == info) {
-            break;
+static void unlock_entity_memory(VD_MM *mm)
+{
+    vd_atomic_fence();
+    mm->entity.lock = 0;
+}
+
+/* ----ENTITY SLABS------------------------------------------------------------------------------ */
+static int get_slab_class(size_t size)
+{
+    for (int i = 0; i < VD_MM_SLAB_CLASS_COUNT; ++i) {
+        if (size <= Slab_Class_Sizes[i]) {
+            return i;
         }
+    }
 
-    } while (compare_and_swap_ptr(&root->next, info, prev_next));
+    return -1;
 }
 
-static VD_BUDDY_ALLOCATION_PROC(buddy_alloc_proc)
+static umm get_slab_objects(Slab *slab)
 {
-    VD_Allocator *allocator = (VD_Allocator *)usrdata;
-    return (void*)allocator->proc_alloc((umm)ptr, prevsize, newsize, usrdata);
+    return (umm)slab + SLAB_HEADER_SIZE;
+}
+
+static Slab *get_object_slab(VD_MM *mm, umm object)
+{
+    return (Slab*)((object & ~(umm)(SLAB_PAGE_SIZE - 1)) + mm->entity.allocator.alignment);
+}
+
+static void push_partial_slab(SlabClass *slab_class, Slab *slab)
+{
+    slab->prev = 0;
+    slab->next = slab_class->partial;
+    if (slab->next) {
+        slab->next->prev = slab;
+    }
+
+    slab_class->partial = slab;
+    slab->in_partial_list = 1;
+}
+
+static void remove_partial_slab(SlabClass *slab_class, Slab *slab)
+{
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        slab_class->partial = slab->next;
+    }
+
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+
+    slab->in_partial_list = 0;
+}
+
+static Slab *new_slab(VD_MM *mm, int size_class)
+{
+    Slab *slab = vd_buddy_alloc_realloc(
+        &mm->entity.allocator,
+        0,
+        SLAB_PAGE_SIZE - mm->entity.allocator.alignment);
+
+    if (!slab) {
+        return 0;
+    }
+
+    size_t usable = SLAB_PAGE_SIZE - mm->entity.allocator.alignment - SLAB_HEADER_SIZE;
+    memset(slab, 0, sizeof(Slab));
+    slab->size_class = (u16)size_class;
+    slab->capacity = (u16)(usable / Slab_Class_Sizes[size_class]);
+
+    // Mark the bits past capacity as used, so the search never hands them out
+    for (u32 i = slab->capacity; i < SLAB_MAX_OBJECTS; ++i) {
+        slab->occupancy[i / 64] |= 1ull << (i % 64);
+    }
+
+    SlabClass *slab_class = &mm->entity.classes[size_class];
+    slab_class->num_slabs++;
+    slab_class->total_objects += slab->capacity;
+    push_partial_slab(slab_class, slab);
+    return slab;
+}
+
+static umm slab_alloc(VD_MM *mm, int size_class)
+{
+    SlabClass *slab_class = &mm->entity.classes[size_class];
+    Slab *slab = slab_class->partial;
+    if (!slab) {
+        slab = new_slab(mm, size_class);
+        if (!slab) {
+            return 0;
+        }
+    }
+
+    u32 word = slab->first_free_word;
+    while (slab->occupancy[word] == ~0ull) {
+        word++;
+    }
+
+    u32 index = word * 64 + (u32)vd_ctz64(~slab->occupancy[word]);
+    slab->occupancy[word] |= 1ull << (index % 64);
+    slab->first_free_word = (u16)word;
+    slab->used++;
+    slab_class->used_objects++;
+
+    if (slab->used == slab->capacity) {
+        remove_partial_slab(slab_class, slab);
+    }
+
+    umm object = get_slab_objects(slab) + (umm)index * Slab_Class_Sizes[size_class];
+    memset((void*)object, 0, Slab_Class_Sizes[size_class]);
+    return object;
+}
+
+/**
+ * @brief Free an object. Slabs that run empty are added to empty_list instead of being released, so
+ * that a batch of frees can decide once which of them to give back to the buddy allocator.
+ */
+static void slab_free(VD_MM *mm, umm object, Slab **empty_list)
+{
+    Slab *slab = get_object_slab(mm, object);
+    SlabClass *slab_class = &mm->entity.classes[slab->size_class];
+    u32 index = (u32)((object - get_slab_objects(slab)) / Slab_Class_Sizes[slab->size_class]);
+
+    assert(slab->occupancy[index / 64] & (1ull << (index % 64)));
+    slab->occupancy[index / 64] &= ~(1ull << (index % 64));
+    if (index / 64 < slab->first_free_word) {
+        slab->first_free_word = (u16)(index / 64);
+    }
+
+    slab->used--;
+    slab_class->used_objects--;
+
+    if (!slab->in_partial_list) {
+        push_partial_slab(slab_class, slab);
+    }
+
+    if (slab->used == 0 && !slab->in_empty_list) {
+        slab->in_empty_list = 1;
+        slab->next_empty = *empty_list;
+        *empty_list = slab;
+    }
+}
+
+/**
+ * @brief Give the slabs that are still empty back to the buddy allocator, but keep one partial slab
+ * per class, so that a class that is used again right away does not need a new page.
+ */
+static void release_empty_slabs(VD_MM *mm, Slab *empty_list)
+{
+    while (empty_list) {
+        Slab *slab = empty_list;
+        empty_list = slab->next_empty;
+        slab->in_empty_list = 0;
+
+        SlabClass *slab_class = &mm->entity.classes[slab->size_class];
+        if (slab->used != 0 || (slab_class->partial == slab && slab->next == 0)) {
+            continue;
+        }
+
+        remove_partial_slab(slab_class, slab);
+        slab_class->num_slabs--;
+        slab_class->total_objects -= slab->capacity;
+        vd_buddy_alloc_realloc(&mm->entity.allocator, slab, 0);
+    }
+}
+
+/* ----ENTITY ALLOCATIONS------------------------------------------------------------------------- */
+
+/**
+ * @return The allocation, tagged with ENTITY_ALLOCATION_FROM_SLAB if it came from a slab, or 0.
+ */
+static umm allocate_entity_memory(VD_MM *mm, size_t size)
+{
+    int size_class = get_slab_class(size);
+    if (size_class >= 0) {
+        umm object = slab_alloc(mm, size_class);
+        return object ? (object | ENTITY_ALLOCATION_FROM_SLAB) : 0;
+    }
+
+    return (umm)vd_buddy_alloc_realloc(&mm->entity.allocator, 0, size);
+}
+
+static void free_entity_memory(VD_MM *mm, umm allocation, Slab **empty_list)
+{
+    if (allocation & ENTITY_ALLOCATION_FROM_SLAB) {
+        slab_free(mm, allocation & ~(umm)ENTITY_ALLOCATION_FROM_SLAB, empty_list);
+    } else {
+        vd_buddy_alloc_realloc(&mm->entity.allocator, (void*)allocation, 0);
+    }
+}
+
+static VD_EntityAllocationInfo *new_entity_allocation_info(VD_MM *mm)
+{
+    return (VD_EntityAllocationInfo*)slab_alloc(mm, get_slab_class(sizeof(VD_EntityAllocationInfo)));
 }
 
 static VD_PROC_ALLOC(vd_entity_alloc)
@@ -80,29 +348,92 @@ static VD_PROC_ALLOC(vd_entity_alloc)
         return 0;
     }
 
-    VD_EntityAllocationInfo *info = vd_buddy_alloc_realloc(
-        &mm->entity.allocator,
-        0,
-        sizeof(VD_EntityAllocationInfo) + newsize);
+    const MemoryComponent *memory = ecs_has(world, entity, MemoryComponent)
+        ? ecs_get(world, entity, MemoryComponent)
+        : 0;
 
-    info->next = 0;
-    info->size = sizeof(VD_EntityAllocationInfo) + newsize;
+    lock_entity_memory(mm);
 
-    const MemoryComponent *memory;
-    if (ecs_has(world, entity, MemoryComponent)) {
-        memory = ecs_get(world, entity, MemoryComponent);
-        add_entity_allocation((VD_EntityAllocationInfo*)memory->opaque_info_ptr, info);
-    } else {
+    umm allocation = allocate_entity_memory(mm, newsize);
+    VD_EntityAllocationInfo *info = memory ? (VD_EntityAllocationInfo*)memory->opaque_info_ptr : 0;
+    VD_EntityAllocationInfo *new_info = 0;
+
+    if (allocation != 0) {
+        if (info == 0) {
+            info = new_info = new_entity_allocation_info(mm);
+        } else if (info->count == ENTITY_ALLOCATIONS_PER_INFO) {
+            VD_EntityAllocationInfo *moved = new_entity_allocation_info(mm);
+            *moved = *info;
+            info->next = moved;
+            info->count = 0;
+        }
+
+        info->allocations[info->count++] = allocation;
+    }
+
+    unlock_entity_memory(mm);
+
+    if (allocation == 0) {
+        return 0;
+    }
+
+    if (new_info) {
         ecs_set(world, entity, MemoryComponent,{
-            .opaque_info_ptr = info,
+            .opaque_info_ptr = new_info,
         });
     }
 
+    umm result = allocation & ~(umm)ENTITY_ALLOCATION_FROM_SLAB;
     if (prevsize != 0) {
-        memcpy((char*)info + sizeof(VD_EntityAllocationInfo), (void*)ptr, prevsize);
+        memcpy((void*)result, (void*)ptr, prevsize);
+    }
+
+    return result;
+}
+
+/**
+ * The frame arena index of the calling thread. Only valid if mm_id matches the id of the VD_MM that is
+ * being used.
+ */
+static _Thread_local struct {
+    u32 mm_id;
+    u32 stage;
+} Thread_Frame_Stage;
+
+static volatile u32 Next_MM_Id;
+
+static FrameArena *get_thread_frame_arena(VD_MM *mm)
+{
+    if (Thread_Frame_Stage.mm_id != mm->frame.id) {
+        u32 stage = vd_atomic_inc_and_fetchu32(&mm->frame.next_stage) - 1;
+        if (stage >= mm->frame.count - 1) {
+            stage = mm->frame.count - 1;
+        }
+
+        Thread_Frame_Stage.mm_id = mm->frame.id;
+        Thread_Frame_Stage.stage = stage;
     }
 
-    return (umm)((char *)info + sizeof(VD_EntityAllocationInfo));
+    return &mm->frame.arenas[Thread_Frame_Stage.stage];
+}
+
+static VD_PROC_ALLOC(shared_frame_proc_alloc)
+{
+    VD_Arena *arena = (VD_Arena*)c;
+    if (newsize == 0) {
+        return 0;
+    }
+
+    umm nptr = (umm)vd_arena_alloc_t(arena, newsize, 8);
+    if (nptr == 0) {
+        return 0;
+    }
+
+    if (ptr != 0) {
+        memcpy((void*)nptr, (void*)ptr, prevsize);
+    }
+
+    return nptr;
 }
 
 VD_MM *vd_mm_create()
@@ -110,17 +441,44 @@ VD_MM *vd_mm_create()
     return calloc(1, sizeof(VD_MM));
 }
 
-void vd_mm_init(VD_MM *mm)
+void vd_mm_init(VD_MM *mm, VD_MM_InitInfo *info)
 {
 
-    mm->global.arena = arena_new(VD_MEGABYTES(4), vd_memory_get_system_allocator());
+    mm->global.arena = arena_new_chained(VD_MEGABYTES(4), vd_memory_get_system_allocator());
     mm->global.allocator = (VD_Allocator) { .c = &mm->global.arena, .proc_alloc = vd_arena_proc_alloc };
 
-    mm->frame.arena = arena_new(VD_MEGABYTES(4), vd_memory_get_system_allocator());
-    mm->frame.allocator = (VD_Allocator) { .c = &mm->frame.arena, .proc_alloc = vd_arena_proc_alloc };
+    u32 count = info->frame_arena_count ? info->frame_arena_count : 8;
+    if (count > VD_MM_MAX_FRAME_ARENAS) {
+        count = VD_MM_MAX_FRAME_ARENAS;
+    }
 
-    mm->entity.free_list.next = 0;
-    mm->entity.free_list.size = 0;
+    u64 reserve = info->frame_arena_reserve ? info->frame_arena_reserve : 1024ull * 1024 * 1024;
+    u64 retain  = info->frame_arena_retain  ? info->frame_arena_retain  : VD_MEGABYTES(4);
+
+    mm->frame.count = count;
+    mm->frame.next_stage = 0;
+    mm->frame.id = vd_atomic_inc_and_fetchu32(&Next_MM_Id);
+
+    for (u32 i = 0; i < count; ++i) {
+        FrameArena *frame_arena = &mm->frame.arenas[i];
+
+        if (info->frame_arena_backend == VD_MM_ARENA_BACKEND_VIRTUAL) {
+            frame_arena->arena = arena_new_virtual(reserve, retain);
+        }
+
+        if (frame_arena->arena.data == 0) {
+            frame_arena->arena = arena_new_chained(VD_MEGABYTES(4), vd_memory_get_system_allocator());
+        }
+
+        frame_arena->shared = i == count - 1;
+        frame_arena->allocator = (VD_Allocator) {
+            .c = &frame_arena->arena,
+            .proc_alloc = frame_arena->shared ? shared_frame_proc_alloc : vd_arena_proc_alloc,
+        };
+    }
+
+    mm->entity.free_list = 0;
+    mm->entity.lock = 0;
     vd_buddy_alloc_init(
         &mm->entity.allocator,
         buddy_alloc_proc,
@@ -140,7 +498,12 @@ void *vd_mm_alloc(VD_MM *mm, VD_AllocationInfo *info)
 
         case VD_MM_FRAME:
         {
-            return arena_alloc_t(&mm->frame.arena, info->size);
+            FrameArena *frame_arena = get_thread_frame_arena(mm);
+            if (frame_arena->shared) {
+                return arena_alloc_t(&frame_arena->arena, info->size);
+            }
+
+            return arena_alloc(&frame_arena->arena, info->size);
         } break;
 
         case VD_MM_ENTITY:
@@ -164,12 +527,12 @@ VD_Allocator *vd_mm_get_global_allocator(VD_MM *mm)
 
 VD_Arena *vd_mm_get_frame_arena(VD_MM *mm)
 {
-    return &mm->frame.arena;
+    return &get_thread_frame_arena(mm)->arena;
 }
 
 VD_Allocator *vd_mm_get_frame_allocator(VD_MM *mm)
 {
-    return &mm->frame.allocator;
+    return &get_thread_frame_arena(mm)->allocator;
 }
 
 VD_Allocator vd_mm_make_entity_allocator(VD_MM *mm, u64 entity_id)
@@ -185,12 +548,26 @@ VD_Allocator vd_mm_make_entity_allocator(VD_MM *mm, u64 entity_id)
 
 void vd_mm_end_frame(VD_MM *mm)
 {
-    arena_reset(&mm->frame.arena);
+    for (u32 i = 0; i < mm->frame.count; ++i) {
+        arena_reset(&mm->frame.arenas[i].arena);
+    }
 }
 
 void vd_mm_get_stats(VD_MM *mm, VD_MM_Stats *stats)
 {
-    vd_arena_get_stats(&mm->frame.arena, &stats->frame_used, &stats->frame_total);
+    vd_arena_get_stats(&mm->global.arena, &stats->global_used, &stats->global_total);
+    stats->global_high_water = vd_arena_get_high_water(&mm->global.arena);
+
+    stats->frame_used = 0;
+    stats->frame_total = 0;
+    stats->frame_high_water = 0;
+    for (u32 i = 0; i < mm->frame.count; ++i) {
+        u64 used, total;
+        vd_arena_get_stats(&mm->frame.arenas[i].arena, &used, &total);
+        stats->frame_used += used;
+        stats->frame_total += total;
+        stats->frame_high_water += vd_arena_get_high_water(&mm->frame.arenas[i].arena);
+    }
 
     vd_buddy_alloc_get_stats(
         &mm->entity.allocator,
@@ -198,6 +575,16 @@ void vd_mm_get_stats(VD_MM *mm, VD_MM_Stats *stats)
         &stats->entity_total,
         &stats->num_entity_blocks,
         &stats->num_free_entity_blocks);
+
+    for (int i = 0; i < VD_MM_SLAB_CLASS_COUNT; ++i) {
+        SlabClass *slab_class = &mm->entity.classes[i];
+        stats->slab_classes[i] = (VD_MM_SlabClassStats) {
+            .object_size = Slab_Class_Sizes[i],
+            .num_slabs = slab_class->num_slabs,
+            .used_objects = slab_class->used_objects,
+            .total_objects = slab_class->total_objects,
+        };
+    }
 }
 
 void vd_mm_deinit(VD_MM *mm)
@@ -206,14 +593,33 @@ void vd_mm_deinit(VD_MM *mm)
     vd_mm_get_stats(mm, &stats);
     VD_LOG_FMT(
         "Memory",
-        "Frame Memory: %{u64}/%{u64} bytes",
-        stats.frame_used, stats.frame_total);
+        "Global Memory: %{u64}/%{u64} bytes, %{u64} bytes peak",
+        stats.global_used, stats.global_total, stats.global_high_water);
+
+    VD_LOG_FMT(
+        "Memory",
+        "Frame Memory: %{u64}/%{u64} bytes, %{u64} bytes peak",
+        stats.frame_used, stats.frame_total, stats.frame_high_water);
 
     VD_LOG_FMT(
         "Memory",
         "Entity Memory: %{u64}/%{u64} bytes, %{u64} free blocks %{u64} used blocks",
         stats.entity_used, stats.entity_total,
         stats.num_free_entity_blocks, stats.num_entity_blocks);
+
+    for (int i = 0; i < VD_MM_SLAB_CLASS_COUNT; ++i) {
+        VD_MM_SlabClassStats *slab_class = &stats.slab_classes[i];
+        if (slab_class->num_slabs == 0) {
+            continue;
+        }
+
+        VD_LOG_FMT(
+            "Memory",
+            "Entity Slabs %{u32}: %{u64}/%{u64} objects in %{u64} slabs",
+            slab_class->object_size,
+            slab_class->used_objects, slab_class->total_objects,
+            slab_class->num_slabs);
+    }
 }
 
 VD_DTOR_PROC(MemoryComponentDtor)
@@ -222,21 +628,50 @@ VD_DTOR_PROC(MemoryComponentDtor)
     VD_MM *mm = vd_instance_get_mm(vd_instance_get());
 
     for (int i = 0; i < count; ++i) {
-        VD_EntityAllocationInfo *info = memory->opaque_info_ptr;
-        add_entity_allocation(&mm->entity.free_list, info);
+        VD_EntityAllocationInfo *first = memory[i].opaque_info_ptr;
+        if (first == 0) {
+            continue;
+        }
+
+        VD_EntityAllocationInfo *last = first;
+        while (last->next != 0) {
+            last = last->next;
+        }
+
+        add_entity_allocations(&mm->entity.free_list, first, last);
     }
 }
 
 void GarbageCollectTask(ecs_iter_t *t)
 {
     VD_MM *mm = vd_instance_get_mm(vd_instance_get());
-    VD_EntityAllocationInfo *curr_info = mm->entity.free_list.next;
+
+    VD_EntityAllocationInfo *curr_info;
+    do
+    {
+        curr_info = (VD_EntityAllocationInfo*)load_ptr((void*)&mm->entity.free_list);
+    } while (compare_and_swap_ptr((void *volatile*)&mm->entity.free_list, 0, curr_info) != curr_info);
+
+    if (curr_info == 0) {
+        return;
+    }
+
+    // Free the whole batch under one lock, and only then decide which slabs to give back
+    Slab *empty_slabs = 0;
+    lock_entity_memory(mm);
+
     while (curr_info != 0) {
-        vd_buddy_alloc_realloc(&mm->entity.allocator, curr_info, 0);
-        curr_info = curr_info->next;
+        VD_EntityAllocationInfo *next = curr_info->next;
+        for (u64 i = 0; i < curr_info->count; ++i) {
+            free_entity_memory(mm, curr_info->allocations[i], &empty_slabs);
+        }
+
+        slab_free(mm, (umm)curr_info, &empty_slabs);
+        curr_info = next;
     }
 
-    mm->entity.free_list.next = 0;
+    release_empty_slabs(mm, empty_slabs);
+    unlock_entity_memory(mm);
 }
 
 void FreeFrameAllocationSystem(ecs_iter_t *t)
@@ -79,9 +79,7 @@ void vd_descriptor_allocator_init(
 
     descalloc->sets_per_pool = (u32)((float)info->initial_sets * 1.5f);
     
-    for (u32 i = 0; i < info->num_ratios; ++i) {
-        array_add(descalloc->ratios, info->ratios[i]);
-    }
+    array_append_n(descalloc->ratios, info->ratios, info->num_ratios);
 
     VkDescriptorPool new_pool = create_pool(
         descalloc,
@@ -7,6 +7,7 @@ int vd_r_geo_system_init(VD_R_GeoSystem *s, VD_R_GeoSystemInitInfo *info)
 {
     s->device = info->device;
     s->svma = info->svma;
+    s->generation = 0;
     VD_HANDLEMAP_INIT(s->meshes, {
         .allocator = vd_memory_get_system_allocator(),
         .initial_capacity = 64,
@@ -69,7 +70,7 @@ static void create_buffers(VD_R_GeoSystem *s, VD_R_MeshCreateInfo *info, VD_R_GP
 
 HandleOf(VD_R_GPUMesh) vd_r_geo_system_new(VD_R_GeoSystem *s, VD_R_MeshCreateInfo *info)
 {
-    VD_R_GPUMesh result;
+    VD_R_GPUMesh result = {0};
 
     create_buffers(s, info, &result);
 
@@ -81,6 +82,7 @@ HandleOf(VD_R_GPUMesh) vd_r_geo_system_new(VD_R_GeoSystem *s, VD_R_MeshCreateInf
 int sgeo_resize(VD_R_GeoSystem *s, HandleOf(VD_R_GPUMesh) mesh, VD_R_MeshCreateInfo *info)
 {
    VD_R_GPUMesh *meshptr = USE_HANDLE(mesh, VD_R_GPUMesh); 
+   s->generation++;
    if (meshptr->num_vertices < info->num_vertices || meshptr->num_indices < info->num_indices) {
        free_geo(meshptr, s);
        create_buffers(s, info, meshptr);
@@ -98,6 +100,7 @@ static void free_geo(void *object, void *c)
     VD_R_GeoSystem *s = (VD_R_GeoSystem*)c;
     VD_R_GPUMesh *m = (VD_R_GPUMesh*)object;
 
+    s->generation++;
     svma_free_buffer(s->svma, m->index.buffer, m->index.allocation);
     svma_free_buffer(s->svma, m->vertex.buffer, m->vertex.allocation);
     m->vertex_buffer_address = 0;
@@ -8,6 +8,9 @@ typedef struct {
     VD_HANDLEMAP VD_R_GPUMesh   *meshes;
     VkDevice                    device;
     SVMA                        *svma;
+
+    /** Incremented whenever a mesh is rewritten, @see sgeo_resize, or freed. */
+    u32                         generation;
 } VD_R_GeoSystem;
 
 typedef struct {
@@ -0,0 +1,278 @@
+#define VD_INTERNAL_SOURCE_FILE 1
+#include "r/sbindless.h"
+#include "array.h"
+#include "vulkan_helpers.h"
+#include "mm.h"
+#include "instance.h"
+
+#include <assert.h>
+#include <string.h>
+
+/** Frames after a slot is removed until it can be reused, so that no in flight frame still uses it. */
+#define RETIRE_FRAMES (VD_MAX_INFLIGHT_FRAMES + 1)
+
+// VD_MATERIAL_STRIDE_WORDS in vd.bindless.glsl
+static_assert(SBINDLESS_MATERIAL_STRIDE == 64 * 4, "Material stride must match the shaders");
+
+int sbindless_supported(VkPhysicalDeviceVulkan12Features *features)
+{
+    return features->runtimeDescriptorArray &&
+           features->descriptorBindingPartiallyBound &&
+           features->descriptorBindingSampledImageUpdateAfterBind &&
+           features->descriptorBindingUpdateUnusedWhilePending &&
+           features->shaderSampledImageArrayNonUniformIndexing;
+}
+
+void sbindless_enable_features(VkPhysicalDeviceVulkan12Features *features)
+{
+    features->runtimeDescriptorArray = VK_TRUE;
+    features->descriptorBindingPartiallyBound = VK_TRUE;
+    features->descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    features->descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    features->shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+}
+
+int sbindless_init(SBindless *s, SBindlessInitInfo *info)
+{
+    s->device = info->device;
+    s->svma = info->svma;
+    s->frame = 0;
+
+    array_init(s->free_textures, vd_memory_get_system_allocator());
+    array_init(s->retired_textures, vd_memory_get_system_allocator());
+    array_init(s->free_materials, vd_memory_get_system_allocator());
+    array_init(s->retired_materials, vd_memory_get_system_allocator());
+
+    // Slot 0 is the fallback
+    s->num_textures = 1;
+    s->num_materials = 0;
+
+    VkDescriptorSetLayoutBinding bindings[2] = {
+        {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = SBINDLESS_MAX_TEXTURES,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+        },
+        {
+            .binding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+        },
+    };
+
+    // Textures are added while frames that use the set are in flight
+    VkDescriptorBindingFlags binding_flags[2] = {
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+        VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT,
+        0,
+    };
+
+    VD_VK_CHECK(vkCreateDescriptorSetLayout(
+        s->device,
+        & (VkDescriptorSetLayoutCreateInfo)
+        {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+            .bindingCount = VD_ARRAY_COUNT(bindings),
+            .pBindings = bindings,
+            .pNext = & (VkDescriptorSetLayoutBindingFlagsCreateInfo)
+            {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+                .bindingCount = VD_ARRAY_COUNT(binding_flags),
+                .pBindingFlags = binding_flags,
+            },
+        },
+        0,
+        &s->layout));
+
+    VD_VK_CHECK(vkCreateDescriptorPool(
+        s->device,
+        & (VkDescriptorPoolCreateInfo)
+        {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+            .maxSets = 1,
+            .poolSizeCount = 2,
+            .pPoolSizes = (VkDescriptorPoolSize[])
+            {
+                { .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = SBINDLESS_MAX_TEXTURES },
+                { .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1 },
+            },
+        },
+        0,
+        &s->pool));
+
+    VD_VK_CHECK(vkAllocateDescriptorSets(
+        s->device,
+        & (VkDescriptorSetAllocateInfo)
+        {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = s->pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &s->layout,
+        },
+        &s->set));
+
+    VD_VK_CHECK(vkCreateSampler(
+        s->device,
+        & (VkSamplerCreateInfo)
+        {
+            .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+            .magFilter = VK_FILTER_LINEAR,
+            .minFilter = VK_FILTER_LINEAR,
+        },
+        0,
+        &s->sampler));
+
+    size_t materials_size = (size_t)VD_MAX_INFLIGHT_FRAMES * SBINDLESS_MAX_MATERIALS * SBINDLESS_MATERIAL_STRIDE;
+    svma_create_buffer(
+        s->svma,
+        & (VkBufferCreateInfo)
+        {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size = materials_size,
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        },
+        & (VmaAllocationCreateInfo)
+        {
+            .usage = VMA_MEMORY_USAGE_CPU_TO_GPU,
+            .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        },
+        SVMA_CREATE_TRACKING(),
+        &s->materials.allocation,
+        &s->materials.buffer);
+
+    s->materials_mapped = svma_map(s->svma, s->materials.allocation);
+    memset(s->materials_mapped, 0, materials_size);
+
+    vkUpdateDescriptorSets(
+        s->device,
+        1,
+        & (VkWriteDescriptorSet)
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = s->set,
+            .dstBinding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .pBufferInfo = & (VkDescriptorBufferInfo)
+            {
+                .buffer = s->materials.buffer,
+                .offset = 0,
+                .range = VK_WHOLE_SIZE,
+            },
+        },
+        0,
+        0);
+
+    return 0;
+}
+
+/** Move the slots that no in flight frame can use anymore to the free list. */
+static void release_retired(SBindless *s, dynarray SBindlessRetired **retired, dynarray u32 **free_list)
+{
+    for (u32 i = array_len(*retired); i > 0; --i) {
+        if (s->frame - (*retired)[i - 1].frame >= RETIRE_FRAMES) {
+            array_add(*free_list, (*retired)[i - 1].index);
+            array_delswap(*retired, i - 1);
+        }
+    }
+}
+
+void sbindless_begin_frame(SBindless *s)
+{
+    s->frame++;
+    release_retired(s, &s->retired_textures, &s->free_textures);
+    release_retired(s, &s->retired_materials, &s->free_materials);
+}
+
+static void write_texture(SBindless *s, u32 index, VkImageView view)
+{
+    vkUpdateDescriptorSets(
+        s->device,
+        1,
+        & (VkWriteDescriptorSet)
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = s->set,
+            .dstBinding = 0,
+            .dstArrayElement = index,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .pImageInfo = & (VkDescriptorImageInfo)
+            {
+                .imageView = view,
+                .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                .sampler = s->sampler,
+            },
+        },
+        0,
+        0);
+}
+
+void sbindless_set_fallback_texture(SBindless *s, VkImageView view)
+{
+    write_texture(s, 0, view);
+}
+
+u32 sbindless_add_texture(SBindless *s, VkImageView view)
+{
+    u32 index;
+    if (array_len(s->free_textures) > 0) {
+        index = array_pop(s->free_textures);
+    } else {
+        if (s->num_textures == SBINDLESS_MAX_TEXTURES) {
+            VD_LOG("SBindless", "Out of texture slots, using the fallback texture");
+            return 0;
+        }
+
+        index = s->num_textures++;
+    }
+
+    write_texture(s, index, view);
+    return index;
+}
+
+void sbindless_remove_texture(SBindless *s, u32 index)
+{
+    if (index == 0) {
+        return;
+    }
+
+    assert(index < s->num_textures);
+    array_add(s->retired_textures, ((SBindlessRetired) { .index = index, .frame = s->frame }));
+}
+
+u32 sbindless_add_material(SBindless *s)
+{
+    if (array_len(s->free_materials) > 0) {
+        return array_pop(s->free_materials);
+    }
+
+    // Materials have nothing to fall back to, unlike textures
+    assert(s->num_materials < SBINDLESS_MAX_MATERIALS);
+    return s->num_materials++;
+}
+
+void sbindless_remove_material(SBindless *s, u32 index)
+{
+    assert(index < s->num_materials);
+    array_add(s->retired_materials, ((SBindlessRetired) { .index = index, .frame = s->frame }));
+}
+
+void sbindless_deinit(SBindless *s)
+{
+    svma_unmap(s->svma, s->materials.allocation);
+    svma_free_buffer(s->svma, s->materials.buffer, s->materials.allocation);
+    vkDestroySampler(s->device, s->sampler, 0);
+    vkDestroyDescriptorPool(s->device, s->pool, 0);
+    vkDestroyDescriptorSetLayout(s->device, s->layout, 0);
+
+    array_deinit(s->free_textures);
+    array_deinit(s->retired_textures);
+    array_deinit(s->free_materials);
+    array_deinit(s->retired_materials);
+}
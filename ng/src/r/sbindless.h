@@ -0,0 +1,95 @@
+#ifndef VD_R_SBINDLESS_H
+#define VD_R_SBINDLESS_H
+#include "r/types.h"
+#include "r/svma.h"
+
+/*
+ * Bindless mode (r.bindless). Every pipeline has the same set 1: an array of every sampled texture,
+ * and a storage buffer with a record for every material. Draws pass the index of their material
+ * record in DefaultPushConstant.material_index, and materials refer to textures by index, so set 1 is
+ * bound once per command buffer and materials never bind anything.
+ *
+ * The material buffer holds a copy of every record for each in flight frame slot, so that changing a
+ * material never writes a record the GPU may be reading. A record packs the material's properties in
+ * order: structs aligned to 16 bytes, and sampler2d properties as the u32 index of the texture.
+ */
+
+enum {
+    SBINDLESS_MAX_TEXTURES      = 4096,
+    SBINDLESS_MAX_MATERIALS     = 4096,
+
+    /** Bytes per material record. */
+    SBINDLESS_MATERIAL_STRIDE   = 256,
+};
+
+typedef struct {
+    u32 index;
+    u64 frame;
+} SBindlessRetired;
+
+typedef struct {
+    VkDevice                        device;
+    SVMA                            *svma;
+    VkDescriptorSetLayout           layout;
+    VkDescriptorPool                pool;
+    VkDescriptorSet                 set;
+    VkSampler                       sampler;
+
+    VD(Buffer)                      materials;
+    u8                              *materials_mapped;
+
+    /** Texture slot 0 is the fallback for textures that are not registered. */
+    u32                             num_textures;
+    dynarray u32                    *free_textures;
+    dynarray SBindlessRetired       *retired_textures;
+
+    u32                             num_materials;
+    dynarray u32                    *free_materials;
+    dynarray SBindlessRetired       *retired_materials;
+
+    u64                             frame;
+} SBindless;
+
+typedef struct {
+    VkDevice                        device;
+    SVMA                            *svma;
+} SBindlessInitInfo;
+
+/** The device features that bindless mode needs, @see sbindless_enable_features. */
+int sbindless_supported(VkPhysicalDeviceVulkan12Features *features);
+void sbindless_enable_features(VkPhysicalDeviceVulkan12Features *features);
+
+int sbindless_init(SBindless *s, SBindlessInitInfo *info);
+
+/**
+ * @brief Advance to the next frame. Slots that were removed are reused once every frame that could
+ * still use them has finished. Called once per frame, before any window is rendered.
+ */
+void sbindless_begin_frame(SBindless *s);
+
+/** Write the texture that slot 0 shows. */
+void sbindless_set_fallback_texture(SBindless *s, VkImageView view);
+
+/** @return The index of the texture in the texture array. */
+u32 sbindless_add_texture(SBindless *s, VkImageView view);
+void sbindless_remove_texture(SBindless *s, u32 index);
+
+/** @return The index of a new material record. */
+u32 sbindless_add_material(SBindless *s);
+void sbindless_remove_material(SBindless *s, u32 index);
+
+/** The record of a material for an in flight frame slot. */
+static VD_INLINE u8 *sbindless_material_record(SBindless *s, u32 index, u32 frame)
+{
+    return s->materials_mapped + ((size_t)frame * SBINDLESS_MAX_MATERIALS + index) * SBINDLESS_MATERIAL_STRIDE;
+}
+
+/** The value of DefaultPushConstant.material_index for a material record. */
+static VD_INLINE u32 sbindless_material_shader_index(u32 index, u32 frame)
+{
+    return frame * SBINDLESS_MAX_MATERIALS + index;
+}
+
+void sbindless_deinit(SBindless *s);
+
+#endif // !VD_R_SBINDLESS_H
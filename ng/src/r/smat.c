@@ -7,6 +7,8 @@
 #include "instance.h"
 #include "vd_vk.h"
 
+#include <assert.h>
+
 static void free_material(void *object, void *c);
 static void free_material_blueprint(void *object, void *c);
 
@@ -18,12 +20,21 @@ int smat_init(SMat *s, SMatInitInfo *info)
     s->svma = info->svma;
     s->color_format = info->color_format;
     s->depth_format = info->depth_format;
+    s->bindless = info->bindless;
+    s->timeline = info->timeline;
+    s->serial = 0;
+    s->generation = 0;
+    s->bindless_pending = 0;
+    if (s->bindless) {
+        array_init(s->bindless_pending, vd_memory_get_system_allocator());
+    }
 
     dynarray VkDescriptorSetLayoutBinding *bindings = 0;
     array_init(bindings, VD_MM_FRAME_ALLOCATOR());
 
     for (u32 i = 0 ; i < info->num_set0_bindings; ++i) {
         VkDescriptorSetLayoutBinding new_binding = {
+            .binding = i,
             .descriptorType = binding_type_to_vk_descriptor_type(info->set0_bindings[i].type),
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
@@ -53,32 +64,10 @@ int smat_init(SMat *s, SMatInitInfo *info)
         0,
         &s->samplers.linear));
 
-    // Create Uniform Buffers
-    int buffer_index = 0;
-    for (int i = 0; i < info->num_set0_bindings; ++i) {
-        if (info->set0_bindings[i].type != BINDING_TYPE_STRUCT) {
-            continue;
-        }
-
-        svma_create_buffer(
-            s->svma,
-            & (VkBufferCreateInfo)
-            {
-                .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-                .size = info->set0_bindings[i].struct_size,
-                .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            },
-            & (VmaAllocationCreateInfo)
-            {
-                .usage = VMA_MEMORY_USAGE_CPU_TO_GPU,
-                .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
-            },
-            SVMA_CREATE_TRACKING(),
-            &s->set0_buffers[buffer_index].allocation,
-            &s->set0_buffers[buffer_index].buffer);
-
-    }
-    s->num_set0_buffers = buffer_index + 1;
+    // Buffers for set 0 are created per frame, @see smat_scene_set_init
+    assert(info->num_set0_bindings <= VD_ARRAY_COUNT(s->set0_bindings));
+    memcpy(s->set0_bindings, info->set0_bindings, info->num_set0_bindings * sizeof(BindingInfo));
+    s->num_set0_bindings = info->num_set0_bindings;
 
     s->default_push_constant = info->default_push_constant;
 
@@ -111,7 +100,7 @@ static void alloc_copy_or_zero_properties(
                 VD_MM_GLOBAL_ALLOCATOR(),
                 src[i].binding.struct_size);
 
-            if (src[i].pstruct == 0) {
+            if (src[i].pstruct != 0) {
                 memcpy(
                     dst[i].pstruct,
                     src[i].pstruct,
@@ -123,43 +112,149 @@ static void alloc_copy_or_zero_properties(
     }
 }
 
+/**
+ * Pack properties into a bindless material record: structs aligned to 16 bytes, and sampler2d
+ * properties as the u32 index of the texture. Without dst, only the size is computed.
+ * @return The size of the record.
+ */
+static size_t pack_record(MaterialProperty *properties, u32 num_properties, u8 *dst)
+{
+    size_t offset = 0;
+    for (u32 i = 0; i < num_properties; ++i) {
+        MaterialProperty *p = &properties[i];
+
+        switch (p->binding.type) {
+            case BINDING_TYPE_STRUCT: {
+                offset = (offset + 15) & ~(size_t)15;
+                if (dst) {
+                    memcpy(dst + offset, p->pstruct, p->binding.struct_size);
+                }
+
+                offset += p->binding.struct_size;
+            } break;
+            case BINDING_TYPE_SAMPLER2D: {
+                offset = (offset + 3) & ~(size_t)3;
+                if (dst) {
+                    u32 index = USE_HANDLE(p->sampler2d, Texture)->bindless_index;
+                    memcpy(dst + offset, &index, sizeof(index));
+                }
+
+                offset += sizeof(u32);
+            } break;
+            default: break;
+        }
+    }
+
+    return offset;
+}
+
 HandleOf(GPUMaterial) smat_new_from_blueprint(SMat *s, HandleOf(GPUMaterialBlueprint) b)
 {
     GPUMaterial result = {0};
     GPUMaterialBlueprint *blueprint = USE_HANDLE(b, GPUMaterialBlueprint);
 
     result.blueprint = COPY_HANDLE(b);
+    result.version = 1;
 
     alloc_copy_or_zero_properties(
         blueprint->properties,
         blueprint->num_properties,
         result.properties);
 
-    // Create Uniform Buffers
-    int buffer_index = 0;
-    for (int i = 0; i < blueprint->num_properties; ++i) {
-        if (blueprint->properties[i].binding.type != BINDING_TYPE_STRUCT) {
-            continue;
+    if (s->bindless) {
+        result.bindless_index = sbindless_add_material(s->bindless);
+        result.bindless_queued = 1;
+
+        HandleOf(GPUMaterial) handle = VD_HANDLEMAP_REGISTER(s->materials, &result, {
+            .ref_mode = VD_HANDLEMAP_REF_MODE_COUNT,
+        });
+
+        array_add(s->bindless_pending, handle);
+        return handle;
+    }
+
+    u32 num_samplers = 0;
+    for (u32 i = 0; i < blueprint->num_properties; ++i) {
+        if (blueprint->properties[i].binding.type == BINDING_TYPE_STRUCT) {
+            result.num_buffers++;
+        } else {
+            num_samplers++;
         }
+    }
 
-        svma_create_buffer(
-            s->svma,
-            & (VkBufferCreateInfo)
-            {
-                .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-                .size = blueprint->properties[i].binding.struct_size,
-                .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            },
-            & (VmaAllocationCreateInfo)
+    assert(result.num_buffers <= VD_MAX_UNIFORM_BUFFERS_PER_MATERIAL);
+
+    // One set per frame slot, so that a changed material never writes a set the GPU may be reading
+    VkDescriptorPoolSize pool_sizes[2];
+    u32 num_pool_sizes = 0;
+    if (result.num_buffers > 0) {
+        pool_sizes[num_pool_sizes++] = (VkDescriptorPoolSize) {
+            .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorCount = result.num_buffers * VD_MAX_INFLIGHT_FRAMES,
+        };
+    }
+
+    if (num_samplers > 0) {
+        pool_sizes[num_pool_sizes++] = (VkDescriptorPoolSize) {
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = num_samplers * VD_MAX_INFLIGHT_FRAMES,
+        };
+    }
+
+    VD_VK_CHECK(vkCreateDescriptorPool(
+        s->device,
+        & (VkDescriptorPoolCreateInfo)
+        {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .maxSets = VD_MAX_INFLIGHT_FRAMES,
+            .poolSizeCount = num_pool_sizes,
+            .pPoolSizes = pool_sizes,
+        },
+        0,
+        &result.pool));
+
+    for (int f = 0; f < VD_MAX_INFLIGHT_FRAMES; ++f) {
+        GPUMaterialFrame *frame = &result.frames[f];
+
+        VD_VK_CHECK(vkAllocateDescriptorSets(
+            s->device,
+            & (VkDescriptorSetAllocateInfo)
             {
-                .usage = VMA_MEMORY_USAGE_CPU_TO_GPU,
-                .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+                .descriptorPool = result.pool,
+                .descriptorSetCount = 1,
+                .pSetLayouts = &blueprint->property_layout,
             },
-            SVMA_CREATE_TRACKING(),
-            &result.buffers[buffer_index].allocation,
-            &result.buffers[buffer_index].buffer);
+            &frame->set));
 
+        u32 buffer_index = 0;
+        for (u32 i = 0; i < blueprint->num_properties; ++i) {
+            if (blueprint->properties[i].binding.type != BINDING_TYPE_STRUCT) {
+                continue;
+            }
+
+            svma_create_buffer(
+                s->svma,
+                & (VkBufferCreateInfo)
+                {
+                    .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                    .size = blueprint->properties[i].binding.struct_size,
+                    .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                },
+                & (VmaAllocationCreateInfo)
+                {
+                    .usage = VMA_MEMORY_USAGE_CPU_TO_GPU,
+                    .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+                },
+                SVMA_CREATE_TRACKING(),
+                &frame->buffers[buffer_index].allocation,
+                &frame->buffers[buffer_index].buffer);
+
+            frame->mapped[buffer_index] = svma_map(s->svma, frame->buffers[buffer_index].allocation);
+            buffer_index++;
+        }
     }
+
     return VD_HANDLEMAP_REGISTER(s->materials, &result, {
         .ref_mode = VD_HANDLEMAP_REF_MODE_COUNT,
     });
@@ -169,47 +264,56 @@ HandleOf(GPUMaterialBlueprint) smat_new_blueprint(SMat *s, MaterialBlueprint *b)
 {
     GPUMaterialBlueprint result;
 
+    result.pass = b->pass;
+    result.indirect_pipeline = VK_NULL_HANDLE;
     result.push_constant_info = b->push_constant.info;
     if (!b->push_constant.custom) {
         result.push_constant_info = s->default_push_constant;
     }
 
-    dynarray VkDescriptorSetLayoutBinding *bindings = 0;
-    array_init(bindings, VD_MM_FRAME_ALLOCATOR());
-    array_addn(bindings, b->num_properties);
-
     alloc_copy_or_zero_properties(b->properties, b->num_properties, result.properties);
     result.num_properties = b->num_properties;
 
-    for (u32 bb = 0; bb < b->num_properties; ++bb) {
-        BindingInfo *binfo = &b->properties[bb].binding;
+    VkDescriptorSetLayout set_layouts[2] = {
+        s->set0_layout,
+        VK_NULL_HANDLE,
+    };
 
-        bindings[bb] = (VkDescriptorSetLayoutBinding)
-        {
-            .binding = 0,
-            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-            .descriptorCount = 1,
-            .descriptorType = binding_type_to_vk_descriptor_type(binfo->type),
-        };
-    }
+    if (s->bindless) {
+        assert(pack_record(result.properties, result.num_properties, 0) <= SBINDLESS_MATERIAL_STRIDE);
+        result.property_layout = VK_NULL_HANDLE;
+        set_layouts[1] = s->bindless->layout;
+    } else {
+        dynarray VkDescriptorSetLayoutBinding *bindings = 0;
+        array_init(bindings, VD_MM_FRAME_ALLOCATOR());
+        array_addn(bindings, b->num_properties);
 
-    VkDescriptorSetLayoutCreateInfo create_info = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-        .bindingCount = array_len(bindings),
-        .pBindings = bindings,
-    };
+        for (u32 bb = 0; bb < b->num_properties; ++bb) {
+            BindingInfo *binfo = &b->properties[bb].binding;
 
-    VD_VK_CHECK(vkCreateDescriptorSetLayout(
-        s->device,
-        &create_info,
-        0,
-        &result.property_layout));
+            bindings[bb] = (VkDescriptorSetLayoutBinding)
+            {
+                .binding = bb,
+                .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                .descriptorCount = 1,
+                .descriptorType = binding_type_to_vk_descriptor_type(binfo->type),
+            };
+        }
 
-    VkDescriptorSetLayout set_layouts[2] = {
-        s->set0_layout,
-        result.property_layout,
-    };
+        VkDescriptorSetLayoutCreateInfo create_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = array_len(bindings),
+            .pBindings = bindings,
+        };
 
+        VD_VK_CHECK(vkCreateDescriptorSetLayout(
+            s->device,
+            &create_info,
+            0,
+            &result.property_layout));
+
+        set_layouts[1] = result.property_layout;
+    }
 
     VkPushConstantRange push_constant_range = {
         .offset = 0,
@@ -249,67 +353,66 @@ HandleOf(GPUMaterialBlueprint) smat_new_blueprint(SMat *s, MaterialBlueprint *b)
         };
     }
 
-    VD_VK_CHECK(vd_vk_build_pipeline(
-        s->device,
-        & (VD_VK_PipelineBuildInfo)
-        {
-            .layout = result.layout,
-            .blend = {
-                .on = b->blend.on,
-            },
-            .num_stages = array_len(shader_stages),
-            .stages = shader_stages,
-            .topology = b->topology,
-            .cull_mode = b->cull_mode,
-            .front_face = b->cull_face,
-            .depth_test = {
-                .on = b->depth_test.on,
-                .write = b->depth_test.write,
-                .cmp_op = b->depth_test.cmp_op,
-            },
-            .multisample.on = b->multisample.on,
-            .polygon_mode = b->polygon_mode,
-            .color_format = s->color_format,
-            .depth_format = s->depth_format,
+    VD_VK_PipelineBuildInfo build_info = {
+        .layout = result.layout,
+        .blend = {
+            .on = b->blend.on,
+        },
+        .num_stages = array_len(shader_stages),
+        .stages = shader_stages,
+        .topology = b->topology,
+        .cull_mode = b->cull_mode,
+        .front_face = b->cull_face,
+        .depth_test = {
+            .on = b->depth_test.on,
+            .write = b->depth_test.write,
+            .cmp_op = b->depth_test.cmp_op,
         },
-        &result.pipeline));
+        .multisample.on = b->multisample.on,
+        .polygon_mode = b->polygon_mode,
+        .color_format = s->color_format,
+        .depth_format = s->depth_format,
+    };
+
+    VD_VK_CHECK(vd_vk_build_pipeline(s->device, &build_info, &result.pipeline));
+
+    if (b->indirect_vertex_shader.id != 0) {
+        for (int i = 0; i < b->num_shaders; ++i) {
+            if (shader_stages[i].stage == VK_SHADER_STAGE_VERTEX_BIT) {
+                shader_stages[i].module = USE_HANDLE(b->indirect_vertex_shader, GPUShader)->module;
+            }
+        }
 
+        VD_VK_CHECK(vd_vk_build_pipeline(s->device, &build_info, &result.indirect_pipeline));
+    }
 
     return VD_HANDLEMAP_REGISTER(s->blueprints, &result, {
         .ref_mode = VD_HANDLEMAP_REF_MODE_COUNT,
     });
 }
 
-static VkDescriptorSet write_set(
-    SMat *s,
-    int n,
-    u32 num_buffers,
-    VD(Buffer) *buffers,
-    VkDescriptorSetLayout set_layout,
-    MaterialWriteInfo *info)
+/**
+ * Bring a frame's set up to the material's version. Structs are copied into the mapped buffers, which
+ * the set points at from the start, so only the first write and sampler changes write descriptors.
+ */
+static void write_material_frame(SMat *s, GPUMaterial *material, GPUMaterialFrame *frame)
 {
-    int buffer_index = 0;
-    VkDescriptorSet return_set = vd_descriptor_allocator_allocate(
-        s->desc_allocator,
-        set_layout,
-        0);
-
-    dynarray VkWriteDescriptorSet *writes = 0;
-    array_init(writes, VD_MM_FRAME_ALLOCATOR());
-    array_addn(writes, info->num_properties);
-
-    dynarray VkDescriptorBufferInfo *buffer_infos = 0;
-    array_init(buffer_infos, VD_MM_FRAME_ALLOCATOR());
+    GPUMaterialBlueprint *blueprint = USE_HANDLE(material->blueprint, GPUMaterialBlueprint);
+    int first_write = frame->version == 0;
 
-    dynarray VkDescriptorImageInfo *image_infos = 0;
-    array_init(image_infos, VD_MM_FRAME_ALLOCATOR());
+    VkWriteDescriptorSet writes[VD_(MAX_MATERIAL_PROPERTIES)];
+    VkDescriptorBufferInfo buffer_infos[VD_(MAX_MATERIAL_PROPERTIES)];
+    VkDescriptorImageInfo image_infos[VD_(MAX_MATERIAL_PROPERTIES)];
+    u32 num_writes = 0;
 
-    for (int i = 0; i < info->num_properties; ++i) {
-        MaterialProperty *p = &info->properties[i];
+    u32 buffer_index = 0;
+    for (u32 i = 0; i < blueprint->num_properties; ++i) {
+        MaterialProperty *p = &material->properties[i];
+        VkWriteDescriptorSet *write = &writes[num_writes];
 
-        writes[i] = (VkWriteDescriptorSet) {
+        *write = (VkWriteDescriptorSet) {
             .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .dstSet = return_set,
+            .dstSet = frame->set,
             .dstBinding = i,
             .descriptorType = binding_type_to_vk_descriptor_type(p->binding.type),
             .descriptorCount = 1,
@@ -317,99 +420,286 @@ static VkDescriptorSet write_set(
 
         switch (p->binding.type) {
             case BINDING_TYPE_STRUCT: {
-                VD(Buffer) *buffer = &buffers[buffer_index++];
-                void *data = svma_map(s->svma, buffer->allocation);
-                memcpy(data, p->pstruct, p->binding.struct_size);
-
-                svma_unmap(s->svma, buffer->allocation);
-
-                VkDescriptorBufferInfo *binfo = array_addp(buffer_infos);
-                binfo->buffer = buffer->buffer;
-                binfo->offset = 0;
-                binfo->range = p->binding.struct_size;
-
-                writes[i].pBufferInfo = binfo;
+                memcpy(frame->mapped[buffer_index], p->pstruct, p->binding.struct_size);
+
+                if (first_write) {
+                    buffer_infos[i] = (VkDescriptorBufferInfo) {
+                        .buffer = frame->buffers[buffer_index].buffer,
+                        .offset = 0,
+                        .range = p->binding.struct_size,
+                    };
+                    write->pBufferInfo = &buffer_infos[i];
+                    num_writes++;
+                }
+
+                buffer_index++;
             } break;
             case BINDING_TYPE_SAMPLER2D: {
                 Texture *img = USE_HANDLE(p->sampler2d, Texture);
-                VkDescriptorImageInfo *iinfo = array_addp(image_infos);
-                iinfo->imageView = img->view;
-                iinfo->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                iinfo->sampler = s->samplers.linear;
-
-                writes[i].pImageInfo = iinfo;
+                image_infos[i] = (VkDescriptorImageInfo) {
+                    .imageView = img->view,
+                    .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    .sampler = s->samplers.linear,
+                };
+                write->pImageInfo = &image_infos[i];
+                num_writes++;
             } break;
             default: break;
         }
     }
 
-    vkUpdateDescriptorSets(
+    if (num_writes > 0) {
+        vkUpdateDescriptorSets(s->device, num_writes, writes, 0, 0);
+        s->descriptor_writes += num_writes;
+    }
+
+    frame->version = material->version;
+}
+
+/**
+ * Wait until the GPU is done with the submissions that used the frame slot before. The last one is
+ * VD_MAX_INFLIGHT_FRAMES serials back, and may belong to another window than the one that is
+ * recorded, which only waited for its own frames. Only needed before a slot is written. The wait
+ * has no timeout, since VD_VK_CHECK would abort on VK_TIMEOUT while another window is still busy.
+ */
+static void retire_frame_slot(SMat *s)
+{
+    if (s->slot_retired) {
+        return;
+    }
+
+    u64 value = s->serial - VD_MAX_INFLIGHT_FRAMES;
+    VD_VK_CHECK(vkWaitSemaphores(
         s->device,
-        array_len(writes),
-        writes,
-        0,
-        0);
+        & (VkSemaphoreWaitInfo)
+        {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .semaphoreCount = 1,
+            .pSemaphores = &s->timeline,
+            .pValues = &value,
+        },
+        UINT64_MAX));
 
-    return return_set;
+    s->slot_retired = 1;
 }
 
-void smat_begin_frame(SMat *s, VD_DescriptorAllocator *descriptor_allocator)
+void smat_begin_frame(SMat *s, VD_DescriptorAllocator *descriptor_allocator, u64 serial)
 {
+    assert(serial > s->serial);
     s->desc_allocator = descriptor_allocator;
+    s->descriptor_writes = 0;
+    s->serial = serial;
+    s->frame_slot = (u32)(serial % VD_MAX_INFLIGHT_FRAMES);
+    s->slot_retired = serial <= VD_MAX_INFLIGHT_FRAMES;
     vd_descriptor_allocator_clear(s->desc_allocator);
 }
 
-GPUMaterialInstance smat_prep(SMat *s, MaterialWriteInfo *set0_info)
+GPUMaterialInstance smat_prep(SMat *s, HandleOf(GPUMaterial) material)
 {
-    VkDescriptorSet set0 = write_set(
-        s,
-        0,
-        s->num_set0_buffers,
-        s->set0_buffers,
-        s->set0_layout,
-        set0_info);
+    GPUMaterial *materialptr = USE_HANDLE(material, GPUMaterial);
+    GPUMaterialBlueprint *blueprint = USE_HANDLE(materialptr->blueprint, GPUMaterialBlueprint);
+
+    GPUMaterialFrame *f = &materialptr->frames[s->frame_slot];
+    if (s->bindless) {
+        if (f->version != materialptr->version) {
+            retire_frame_slot(s);
+            pack_record(
+                materialptr->properties,
+                blueprint->num_properties,
+                sbindless_material_record(s->bindless, materialptr->bindless_index, s->frame_slot));
+            f->version = materialptr->version;
+        }
+
+        return (GPUMaterialInstance) {
+            .pass = blueprint->pass,
+            .material = material,
+            .material_index = sbindless_material_shader_index(
+                materialptr->bindless_index,
+                s->frame_slot),
+        };
+    }
+
+    if (f->version != materialptr->version) {
+        retire_frame_slot(s);
+        write_material_frame(s, materialptr, f);
+    }
 
-    GPUMaterial *material = USE_HANDLE(set0_info->material, GPUMaterial);
-    GPUMaterialBlueprint *blueprint = USE_HANDLE(material->blueprint, GPUMaterialBlueprint);
-    int buffer_index = 0;
-    VkDescriptorSet property_set = write_set(
-        s,
-        1,
-        material->num_buffers,
-        material->buffers,
-        blueprint->property_layout,
-        & (MaterialWriteInfo)
-        {
-            .material = set0_info->material,
-            .num_properties = blueprint->num_properties,
-            .properties = material->properties,
-        });
     return (GPUMaterialInstance) {
-        .default_set = set0,
-        .property_set = property_set,
-        .pass = 0,
-        .material = set0_info->material,
+        .property_set = f->set,
+        .pass = blueprint->pass,
+        .material = material,
     };
 }
 
-void smat_end_frame(SMat *s)
+void smat_prep_bindless(SMat *s)
 {
-    s->desc_allocator = 0;
+    assert(s->bindless);
+
+    for (u32 i = array_len(s->bindless_pending); i > 0; --i) {
+        GPUMaterial *materialptr = USE_HANDLE(s->bindless_pending[i - 1], GPUMaterial);
+        if (materialptr == 0) {
+            array_delswap(s->bindless_pending, i - 1);
+            continue;
+        }
+
+        // Writes the record of the slot if it's out of date
+        smat_prep(s, s->bindless_pending[i - 1]);
+
+        int up_to_date = 1;
+        for (u32 f = 0; f < VD_MAX_INFLIGHT_FRAMES; ++f) {
+            if (materialptr->frames[f].version != materialptr->version) {
+                up_to_date = 0;
+                break;
+            }
+        }
+
+        if (up_to_date) {
+            materialptr->bindless_queued = 0;
+            array_delswap(s->bindless_pending, i - 1);
+        }
+    }
 }
 
-void smat_deinit(SMat *s)
+void smat_set_property(SMat *s, HandleOf(GPUMaterial) material, u32 index, MaterialProperty *value)
 {
-    for (int i = 0; i < s->num_set0_buffers; ++i) {
-        svma_free_buffer(
+    GPUMaterial *materialptr = USE_HANDLE(material, GPUMaterial);
+    GPUMaterialBlueprint *blueprint = USE_HANDLE(materialptr->blueprint, GPUMaterialBlueprint);
+    assert(index < blueprint->num_properties);
+
+    MaterialProperty *p = &materialptr->properties[index];
+    assert(p->binding.type == value->binding.type);
+
+    switch (p->binding.type) {
+        case BINDING_TYPE_STRUCT: {
+            memcpy(p->pstruct, value->pstruct, p->binding.struct_size);
+        } break;
+        case BINDING_TYPE_SAMPLER2D: {
+            p->sampler2d = value->sampler2d;
+        } break;
+        default: break;
+    }
+
+    // 0 means never written, so skip it on wrap around
+    materialptr->version++;
+    if (materialptr->version == 0) {
+        materialptr->version = 1;
+    }
+
+    if (s->bindless && !materialptr->bindless_queued) {
+        materialptr->bindless_queued = 1;
+        array_add(s->bindless_pending, material);
+    }
+}
+
+void smat_scene_set_init(SMat *s, GPUSceneSet *set)
+{
+    VD_VK_CHECK(vkCreateDescriptorPool(
+        s->device,
+        & (VkDescriptorPoolCreateInfo)
+        {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .maxSets = 1,
+            .poolSizeCount = 1,
+            .pPoolSizes = & (VkDescriptorPoolSize)
+            {
+                .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .descriptorCount = s->num_set0_bindings,
+            },
+        },
+        0,
+        &set->pool));
+
+    VD_VK_CHECK(vkAllocateDescriptorSets(
+        s->device,
+        & (VkDescriptorSetAllocateInfo)
+        {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = set->pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &s->set0_layout,
+        },
+        &set->set));
+
+    VkDescriptorBufferInfo buffer_infos[VD_MAX_UNIFORM_BUFFERS_PER_MATERIAL];
+    VkWriteDescriptorSet writes[VD_MAX_UNIFORM_BUFFERS_PER_MATERIAL];
+
+    set->num_buffers = s->num_set0_bindings;
+    for (u32 i = 0; i < s->num_set0_bindings; ++i) {
+        assert(s->set0_bindings[i].type == BINDING_TYPE_STRUCT);
+
+        svma_create_buffer(
             s->svma,
-            s->set0_buffers[i].buffer,
-            s->set0_buffers[i].allocation);
+            & (VkBufferCreateInfo)
+            {
+                .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                .size = s->set0_bindings[i].struct_size,
+                .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            },
+            & (VmaAllocationCreateInfo)
+            {
+                .usage = VMA_MEMORY_USAGE_CPU_TO_GPU,
+                .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+            },
+            SVMA_CREATE_TRACKING(),
+            &set->buffers[i].allocation,
+            &set->buffers[i].buffer);
+
+        set->mapped[i] = svma_map(s->svma, set->buffers[i].allocation);
+        memset(set->mapped[i], 0, s->set0_bindings[i].struct_size);
+
+        buffer_infos[i] = (VkDescriptorBufferInfo)
+        {
+            .buffer = set->buffers[i].buffer,
+            .offset = 0,
+            .range = s->set0_bindings[i].struct_size,
+        };
+
+        writes[i] = (VkWriteDescriptorSet)
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set->set,
+            .dstBinding = i,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorCount = 1,
+            .pBufferInfo = &buffer_infos[i],
+        };
     }
 
+    vkUpdateDescriptorSets(s->device, s->num_set0_bindings, writes, 0, 0);
+}
+
+void smat_scene_set_write(SMat *s, GPUSceneSet *set, u32 binding, const void *data, size_t size)
+{
+    assert(binding < set->num_buffers);
+    assert(size <= s->set0_bindings[binding].struct_size);
+    memcpy(set->mapped[binding], data, size);
+}
+
+void smat_scene_set_deinit(SMat *s, GPUSceneSet *set)
+{
+    for (u32 i = 0; i < set->num_buffers; ++i) {
+        svma_unmap(s->svma, set->buffers[i].allocation);
+        svma_free_buffer(s->svma, set->buffers[i].buffer, set->buffers[i].allocation);
+    }
+
+    vkDestroyDescriptorPool(s->device, set->pool, 0);
+    set->num_buffers = 0;
+}
+
+void smat_end_frame(SMat *s)
+{
+    s->desc_allocator = 0;
+}
+
+void smat_deinit(SMat *s)
+{
     vkDestroyDescriptorSetLayout(s->device, s->set0_layout, 0);
     vkDestroySampler(s->device, s->samplers.linear, 0);
     VD_HANDLEMAP_DEINIT(s->materials);
     VD_HANDLEMAP_DEINIT(s->blueprints);
+    if (s->bindless) {
+        array_deinit(s->bindless_pending);
+    }
 }
 
 static void free_material_blueprint(void *object, void *c)
@@ -417,8 +707,10 @@ static void free_material_blueprint(void *object, void *c)
     SMat *s = (SMat*)c;
     GPUMaterialBlueprint *blueprint = (GPUMaterialBlueprint*)object;
 
+    s->generation++;
     vkDestroyDescriptorSetLayout(s->device, blueprint->property_layout, 0);
     vkDestroyPipeline(s->device, blueprint->pipeline, 0);
+    vkDestroyPipeline(s->device, blueprint->indirect_pipeline, 0);
     vkDestroyPipelineLayout(s->device, blueprint->layout, 0);
 }
 
@@ -427,13 +719,22 @@ static void free_material(void *object, void *c)
     SMat *s = (SMat*)c;
     GPUMaterial *material = (GPUMaterial*)object;
 
-    for (int i = 0; i < material->num_buffers; ++i) {
-        svma_free_buffer(
-            s->svma,
-            material->buffers[i].buffer,
-            material->buffers[i].allocation);
+    s->generation++;
+    for (int f = 0; f < VD_MAX_INFLIGHT_FRAMES; ++f) {
+        for (u32 i = 0; i < material->num_buffers; ++i) {
+            svma_unmap(s->svma, material->frames[f].buffers[i].allocation);
+            svma_free_buffer(
+                s->svma,
+                material->frames[f].buffers[i].buffer,
+                material->frames[f].buffers[i].allocation);
+        }
+    }
+
+    if (s->bindless) {
+        sbindless_remove_material(s->bindless, material->bindless_index);
     }
 
+    vkDestroyDescriptorPool(s->device, material->pool, 0);
     DROP_HANDLE(material->blueprint);
 }
 
@@ -3,6 +3,7 @@
 #include "r/types.h"
 #include "r/descriptor_allocator.h"
 #include "r/svma.h"
+#include "r/sbindless.h"
 
 typedef struct {
     VD_HANDLEMAP GPUMaterial            *materials;
@@ -11,8 +12,23 @@ typedef struct {
     SVMA                     *svma;
     VkDescriptorSetLayout    set0_layout;
     VD_DescriptorAllocator   *desc_allocator;
-    VD(Buffer)               set0_buffers[VD_MAX_UNIFORM_BUFFERS_PER_MATERIAL];
-    u32                      num_set0_buffers;
+    BindingInfo              set0_bindings[VD_MAX_UNIFORM_BUFFERS_PER_MATERIAL];
+    u32                      num_set0_bindings;
+
+    /** Descriptors written since smat_begin_frame. */
+    u32                      descriptor_writes;
+
+    /**
+     * Every submission signals the timeline with its serial, whichever window it renders. A frame uses
+     * the slot of its serial, so a slot is only rewritten once every earlier submission that could
+     * read it is done, @see smat_begin_frame.
+     */
+    VkSemaphore              timeline;
+    u64                      serial;
+
+    /** The frame slot of the frame that is recorded. */
+    u32                      frame_slot;
+    int                      slot_retired;
     struct {
         VkSampler linear;
     } samplers;
@@ -20,6 +36,24 @@ typedef struct {
     VkFormat                color_format;
     VkFormat                depth_format;
     VD(PushConstantInfo)    default_push_constant;
+
+    /**
+     * Set in bindless mode. Pipelines then use the bindless set as set 1, and materials write their
+     * properties to records in the bindless material buffer instead of owning sets.
+     */
+    SBindless               *bindless;
+
+    /**
+     * Materials whose records may be out of date in some frame slot, in bindless mode. Only GPU
+     * driven drawing uses it, since it draws materials without preparing them, @see smat_prep_bindless.
+     */
+    dynarray HandleOf(GPUMaterial) *bindless_pending;
+
+    /**
+     * Incremented whenever a material or blueprint is freed. Their slots are then reused, so anything
+     * that kept what it read from a handle has to read it again.
+     */
+    u32                      generation;
 } SMat;
 
 typedef struct {
@@ -32,6 +66,10 @@ typedef struct {
 
     VkFormat                color_format;
     VkFormat                depth_format;
+    SBindless               *bindless;
+
+    /** A timeline semaphore that every submission that draws materials signals with its serial. */
+    VkSemaphore             timeline;
 } SMatInitInfo;
 
 int smat_init(SMat *s, SMatInitInfo *info);
@@ -39,9 +77,42 @@ int smat_init(SMat *s, SMatInitInfo *info);
 HandleOf(GPUMaterialBlueprint) smat_new_blueprint(SMat *s, MaterialBlueprint *b);
 HandleOf(GPUMaterial) smat_new_from_blueprint(SMat *s, HandleOf(GPUMaterialBlueprint) b);
 
-void smat_begin_frame(SMat *s, VD_DescriptorAllocator *descriptor_allocator);
+/**
+ * @brief Begin recording a frame.
+ * @param serial    The value the frame's submission signals SMat.timeline with. Serials start at 1
+ * and increase by 1 with every submission.
+ */
+void smat_begin_frame(SMat *s, VD_DescriptorAllocator *descriptor_allocator, u64 serial);
+
+/**
+ * @brief Create the set 0 of one in flight frame, with a buffer for every struct binding of set 0.
+ * Set 0 only holds structs.
+ */
+void smat_scene_set_init(SMat *s, GPUSceneSet *set);
+
+/** Copy the data of a set 0 binding. The GPU must be done with the frame. */
+void smat_scene_set_write(SMat *s, GPUSceneSet *set, u32 binding, const void *data, size_t size);
+void smat_scene_set_deinit(SMat *s, GPUSceneSet *set);
+
+/**
+ * @brief Get the property set (set 1) of a material for the frame slot of the frame that is
+ * recorded. The set is only written if a property changed since the slot was last used. In bindless
+ * mode, there is no set, and the material's record for the slot is written instead,
+ * @see GPUMaterialInstance.material_index.
+ */
+GPUMaterialInstance smat_prep(SMat *s, HandleOf(GPUMaterial) material);
+
+/**
+ * @brief Write the bindless records of the frame slot for every material that changed, in bindless
+ * mode. Materials leave the pending list once every slot is up to date.
+ */
+void smat_prep_bindless(SMat *s);
 
-GPUMaterialInstance smat_prep(SMat *s, MaterialWriteInfo *set0_info);
+/**
+ * @brief Change a property of a material. Structs are copied. Every frame slot picks the change up
+ * the next time it prepares the material.
+ */
+void smat_set_property(SMat *s, HandleOf(GPUMaterial) material, u32 index, MaterialProperty *value);
 void smat_end_frame(SMat *s);
 void smat_deinit(SMat *s);
 
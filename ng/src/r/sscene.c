@@ -0,0 +1,492 @@
+#define VD_INTERNAL_SOURCE_FILE 1
+#include "r/sscene.h"
+#include "array.h"
+#include "vulkan_helpers.h"
+#include "vd_vk.h"
+#include "mm.h"
+#include "instance.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+/** The instances the GPU buffers start out with. */
+#define INITIAL_CAPACITY 1024
+
+/** The push constants of sscene_cull.comp. */
+typedef struct {
+    VkDeviceAddress instances;
+    VkDeviceAddress cull;
+    VkDeviceAddress counts;
+    VkDeviceAddress commands;
+} CullPushConstant;
+
+// The std430 layouts of vd.scene.glsl
+static_assert(sizeof(SSceneInstance) == 80, "SSceneInstance must match VD_Instance");
+static_assert(sizeof(SSceneGPUBatch) == 48, "SSceneGPUBatch must match VD_Batch");
+static_assert(offsetof(SSceneGPUBatch, vertex_address) == 16, "SSceneGPUBatch must match VD_Batch");
+static_assert(sizeof(SSceneCullHeader) == 112, "SSceneCullHeader must match VD_CullBuffer");
+static_assert(sizeof(VkDrawIndexedIndirectCommand) == 20, "VD_DrawCommand must match");
+
+static VkDeviceAddress buffer_address(SScene *s, VkBuffer buffer)
+{
+    return vkGetBufferDeviceAddress(
+        s->device,
+        & (VkBufferDeviceAddressInfo)
+        {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+            .buffer = buffer,
+        });
+}
+
+static void create_buffer(
+    SScene *s,
+    size_t size,
+    VkBufferUsageFlags usage,
+    VmaMemoryUsage memory_usage,
+    VD(Buffer) *result)
+{
+    svma_create_buffer(
+        s->svma,
+        & (VkBufferCreateInfo)
+        {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size = size,
+            .usage = usage,
+        },
+        & (VmaAllocationCreateInfo)
+        {
+            .usage = memory_usage,
+            .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        },
+        SVMA_CREATE_TRACKING(),
+        &result->allocation,
+        &result->buffer);
+}
+
+static void create_instance_buffers(SScene *s, u32 capacity)
+{
+    s->capacity = capacity;
+
+    create_buffer(
+        s,
+        (size_t)capacity * sizeof(SSceneInstance),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY,
+        &s->gpu_instances);
+    s->gpu_instances_address = buffer_address(s, s->gpu_instances.buffer);
+
+    // Every instance gets a command, so a batch can never overflow its range
+    create_buffer(
+        s,
+        (size_t)capacity * sizeof(VkDrawIndexedIndirectCommand),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY,
+        &s->commands);
+    s->commands_address = buffer_address(s, s->commands.buffer);
+}
+
+int sscene_init(SScene *s, SSceneInitInfo *info)
+{
+    s->device = info->device;
+    s->svma = info->svma;
+
+    array_init(s->instances, vd_memory_get_system_allocator());
+    array_init(s->entities, vd_memory_get_system_allocator());
+    array_init(s->dirty, vd_memory_get_system_allocator());
+    array_init(s->queued, vd_memory_get_system_allocator());
+    array_init(s->batches, vd_memory_get_system_allocator());
+    vd_intmap_init(&s->entity_to_instance, vd_memory_get_system_allocator(), INITIAL_CAPACITY, 0);
+    vd_intmap_init(&s->batch_map, vd_memory_get_system_allocator(), 64, 0);
+
+    create_instance_buffers(s, INITIAL_CAPACITY);
+
+    create_buffer(
+        s,
+        SSCENE_MAX_BATCHES * sizeof(u32),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY,
+        &s->counts);
+    s->counts_address = buffer_address(s, s->counts.buffer);
+
+    VD_VK_CHECK(vkCreatePipelineLayout(
+        s->device,
+        & (VkPipelineLayoutCreateInfo)
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = & (VkPushConstantRange)
+            {
+                .offset = 0,
+                .size = sizeof(CullPushConstant),
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            },
+        },
+        0,
+        &s->cull_layout));
+
+    VD_VK_CHECK(vkCreateComputePipelines(
+        s->device,
+        VK_NULL_HANDLE,
+        1,
+        & (VkComputePipelineCreateInfo)
+        {
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .layout = s->cull_layout,
+            .stage = (VkPipelineShaderStageCreateInfo)
+            {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = info->cull_shader,
+                .pName = "main",
+            },
+        },
+        0,
+        &s->cull_pipeline));
+
+    return 0;
+}
+
+void sscene_frame_init(SScene *s, GPUCullFrame *frame)
+{
+    create_buffer(
+        s,
+        sizeof(SSceneCullHeader) + SSCENE_MAX_BATCHES * sizeof(SSceneGPUBatch),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VMA_MEMORY_USAGE_CPU_TO_GPU,
+        &frame->cull);
+    frame->cull_mapped = svma_map(s->svma, frame->cull.allocation);
+    frame->cull_address = buffer_address(s, frame->cull.buffer);
+
+    // Staging buffers are created by the first upload that needs one
+    frame->staging = (VD(Buffer)) {0};
+    frame->staging_mapped = 0;
+    frame->staging_size = 0;
+}
+
+void sscene_frame_deinit(SScene *s, GPUCullFrame *frame)
+{
+    svma_unmap(s->svma, frame->cull.allocation);
+    svma_free_buffer(s->svma, frame->cull.buffer, frame->cull.allocation);
+
+    if (frame->staging_size > 0) {
+        svma_unmap(s->svma, frame->staging.allocation);
+        svma_free_buffer(s->svma, frame->staging.buffer, frame->staging.allocation);
+    }
+}
+
+static void mark_dirty(SScene *s, u32 index)
+{
+    if (!s->queued[index]) {
+        s->queued[index] = 1;
+        array_add(s->dirty, index);
+    }
+}
+
+/** @return The batch of a blueprint and a mesh, or -1 if a new one would be one too many. */
+static int find_or_add_batch(SScene *s, HandleOf(GPUMaterialBlueprint) blueprint, HandleOf(VD_R_GPUMesh) mesh)
+{
+    u64 key = ((u64)VD_HANDLE_SLOT(blueprint) << 32) | VD_HANDLE_SLOT(mesh);
+
+    u64 index;
+    if (vd_intmap_tryget(&s->batch_map, key, &index)) {
+        SSceneBatch *batch = &s->batches[index];
+
+        // The slots were reused. Handles are counted, so nothing draws the old pair anymore
+        if (batch->blueprint.id != blueprint.id || batch->mesh.id != mesh.id) {
+            assert(batch->num_instances == 0);
+            batch->blueprint = blueprint;
+            batch->mesh = mesh;
+        }
+
+        return (int)index;
+    }
+
+    if (array_len(s->batches) == SSCENE_MAX_BATCHES) {
+        return -1;
+    }
+
+    index = array_len(s->batches);
+    array_add(s->batches, ((SSceneBatch) {
+        .blueprint = blueprint,
+        .mesh = mesh,
+    }));
+    vd_intmap_set(&s->batch_map, key, index);
+    return (int)index;
+}
+
+int sscene_set_instance(SScene *s, u64 entity, mat4 obj, SSceneInstanceInfo *info)
+{
+    int batch = find_or_add_batch(s, info->blueprint, info->mesh);
+    if (batch < 0) {
+        sscene_remove_instance(s, entity);
+        return -1;
+    }
+
+    u64 index;
+    if (vd_intmap_tryget(&s->entity_to_instance, entity, &index)) {
+        s->batches[s->instances[index].batch].num_instances--;
+    } else {
+        index = array_len(s->instances);
+        array_add(s->instances, (SSceneInstance) {0});
+        array_add(s->entities, entity);
+        array_add(s->queued, 0);
+        vd_intmap_set(&s->entity_to_instance, entity, index);
+    }
+
+    SSceneInstance *instance = &s->instances[index];
+    memcpy(instance->obj, obj, sizeof(instance->obj));
+    instance->batch = (u32)batch;
+    instance->material_index = info->material_index;
+    instance->window = info->window;
+    s->batches[batch].num_instances++;
+
+    mark_dirty(s, (u32)index);
+    return 0;
+}
+
+void sscene_remove_instance(SScene *s, u64 entity)
+{
+    u64 index;
+    if (!vd_intmap_tryget(&s->entity_to_instance, entity, &index)) {
+        return;
+    }
+
+    vd_intmap_del(&s->entity_to_instance, entity);
+    s->batches[s->instances[index].batch].num_instances--;
+
+    // Move the last instance into the hole. Dirty indices past the end are skipped by the upload
+    u32 last = array_len(s->instances) - 1;
+    if (index != last) {
+        s->instances[index] = s->instances[last];
+        s->entities[index] = s->entities[last];
+        vd_intmap_set(&s->entity_to_instance, s->entities[index], index);
+        mark_dirty(s, (u32)index);
+    }
+
+    array_pop(s->instances);
+    array_pop(s->entities);
+    array_pop(s->queued);
+}
+
+/** Make room for every instance, replacing the instance buffers if they're too small. */
+static void grow(SScene *s, VD_DeletionQueue *dq)
+{
+    u32 len = array_len(s->instances);
+    if (len <= s->capacity) {
+        return;
+    }
+
+    u32 capacity = s->capacity;
+    while (capacity < len) {
+        capacity *= 2;
+    }
+
+    vd_deletion_queue_push_buffer(dq, &s->gpu_instances);
+    vd_deletion_queue_push_buffer(dq, &s->commands);
+    create_instance_buffers(s, capacity);
+
+    // The new buffer starts out empty
+    array_clear(s->dirty);
+    for (u32 i = 0; i < len; ++i) {
+        s->queued[i] = 1;
+        array_add(s->dirty, i);
+    }
+}
+
+/** Copy the dirty instances to the staging buffer of the frame, and record copying them over. */
+static void upload(SScene *s, GPUCullFrame *frame, VkCommandBuffer cmd, VD_DeletionQueue *dq)
+{
+    u32 len = array_len(s->instances);
+    u32 num_dirty = array_len(s->dirty);
+    if (num_dirty == 0) {
+        return;
+    }
+
+    size_t size = (size_t)num_dirty * sizeof(SSceneInstance);
+    if (frame->staging_size < size) {
+        if (frame->staging_size > 0) {
+            svma_unmap(s->svma, frame->staging.allocation);
+            vd_deletion_queue_push_buffer(dq, &frame->staging);
+        }
+
+        create_buffer(
+            s,
+            size,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VMA_MEMORY_USAGE_CPU_TO_GPU,
+            &frame->staging);
+        frame->staging_mapped = svma_map(s->svma, frame->staging.allocation);
+        frame->staging_size = size;
+    }
+
+    dynarray VkBufferCopy *regions = 0;
+    array_init(regions, VD_MM_FRAME_ALLOCATOR());
+
+    SSceneInstance *staging = (SSceneInstance*)frame->staging_mapped;
+    u32 num_staged = 0;
+    for (u32 i = 0; i < num_dirty; ++i) {
+        u32 index = s->dirty[i];
+        if (index >= len || !s->queued[index]) {
+            continue;
+        }
+
+        s->queued[index] = 0;
+        staging[num_staged] = s->instances[index];
+        array_add(regions, ((VkBufferCopy) {
+            .srcOffset = (VkDeviceSize)num_staged * sizeof(SSceneInstance),
+            .dstOffset = (VkDeviceSize)index * sizeof(SSceneInstance),
+            .size = sizeof(SSceneInstance),
+        }));
+        num_staged++;
+    }
+
+    array_clear(s->dirty);
+
+    if (num_staged > 0) {
+        vkCmdCopyBuffer(
+            cmd,
+            frame->staging.buffer,
+            s->gpu_instances.buffer,
+            num_staged,
+            regions);
+    }
+}
+
+static void barrier(
+    VkCommandBuffer cmd,
+    VkPipelineStageFlags2 src_stage,
+    VkAccessFlags2 src_access,
+    VkPipelineStageFlags2 dst_stage,
+    VkAccessFlags2 dst_access)
+{
+    vkCmdPipelineBarrier2(
+        cmd,
+        & (VkDependencyInfo)
+        {
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .memoryBarrierCount = 1,
+            .pMemoryBarriers = & (VkMemoryBarrier2)
+            {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                .srcStageMask = src_stage,
+                .srcAccessMask = src_access,
+                .dstStageMask = dst_stage,
+                .dstAccessMask = dst_access,
+            },
+        });
+}
+
+void sscene_cull(
+    SScene *s,
+    GPUCullFrame *frame,
+    VkCommandBuffer cmd,
+    VD_DeletionQueue *dq,
+    u32 window,
+    mat4 viewproj)
+{
+    SSceneCullHeader *header = (SSceneCullHeader*)frame->cull_mapped;
+    SSceneGPUBatch *gpu_batches = (SSceneGPUBatch*)(header + 1);
+
+    glm_frustum_planes(viewproj, (vec4*)header->planes);
+    header->num_instances = array_len(s->instances);
+    header->num_batches = array_len(s->batches);
+    header->window = window;
+
+    // Meshes can be rewritten and move, so batches are written every frame
+    u32 first_command = 0;
+    for (u32 b = 0; b < array_len(s->batches); ++b) {
+        SSceneBatch *batch = &s->batches[b];
+        batch->first_command = first_command;
+        first_command += batch->num_instances;
+
+        if (batch->num_instances == 0) {
+            continue;
+        }
+
+        VD_R_GPUMesh *mesh = USE_HANDLE(batch->mesh, VD_R_GPUMesh);
+        memcpy(gpu_batches[b].bounds, mesh->bounds, sizeof(gpu_batches[b].bounds));
+        gpu_batches[b].vertex_address = mesh->vertex_buffer_address;
+        gpu_batches[b].index_count = (u32)mesh->num_indices;
+        gpu_batches[b].first_index = 0;
+        gpu_batches[b].first_command = batch->first_command;
+    }
+
+    grow(s, dq);
+
+    // Earlier frames may still be reading the instances, commands and counts
+    barrier(
+        cmd,
+        VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT |
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
+        VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+        0,
+        VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+        VK_ACCESS_2_TRANSFER_WRITE_BIT);
+
+    upload(s, frame, cmd, dq);
+    vkCmdFillBuffer(cmd, s->counts.buffer, 0, VK_WHOLE_SIZE, 0);
+
+    barrier(
+        cmd,
+        VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+        VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT,
+        VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+
+    u32 num_instances = array_len(s->instances);
+    if (num_instances > 0) {
+        CullPushConstant pc = {
+            .instances = s->gpu_instances_address,
+            .cull = frame->cull_address,
+            .counts = s->counts_address,
+            .commands = s->commands_address,
+        };
+
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, s->cull_pipeline);
+        vkCmdPushConstants(cmd, s->cull_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pc), &pc);
+        vkCmdDispatch(cmd, (num_instances + SSCENE_CULL_GROUP_SIZE - 1) / SSCENE_CULL_GROUP_SIZE, 1, 1);
+    }
+
+    barrier(
+        cmd,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT,
+        VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+}
+
+SSceneDrawPushConstant sscene_draw_push_constant(SScene *s, GPUCullFrame *frame, u32 material_base)
+{
+    return (SSceneDrawPushConstant) {
+        .instances = s->gpu_instances_address,
+        .cull = frame->cull_address,
+        .material_base = material_base,
+    };
+}
+
+void sscene_deinit(SScene *s)
+{
+    vkDestroyPipeline(s->device, s->cull_pipeline, 0);
+    vkDestroyPipelineLayout(s->device, s->cull_layout, 0);
+
+    svma_free_buffer(s->svma, s->counts.buffer, s->counts.allocation);
+    svma_free_buffer(s->svma, s->commands.buffer, s->commands.allocation);
+    svma_free_buffer(s->svma, s->gpu_instances.buffer, s->gpu_instances.allocation);
+
+    vd_intmap_deinit(&s->batch_map);
+    vd_intmap_deinit(&s->entity_to_instance);
+    array_deinit(s->batches);
+    array_deinit(s->queued);
+    array_deinit(s->dirty);
+    array_deinit(s->entities);
+    array_deinit(s->instances);
+}
@@ -0,0 +1,165 @@
+#ifndef VD_R_SSCENE_H
+#define VD_R_SSCENE_H
+#include "r/types.h"
+#include "r/svma.h"
+#include "r/deletion_queue.h"
+#include "intmap.h"
+
+/*
+ * GPU driven drawing (r.gpu-driven). Static meshes are instances in a persistent buffer, and only
+ * the instances that changed are uploaded. Every frame, a compute shader culls the instances of a
+ * window against the view frustum, and writes a VkDrawIndexedIndirectCommand for every visible one
+ * into the range of its batch. The renderer then records one vkCmdDrawIndexedIndirectCount per
+ * batch, so the CPU cost of a frame doesn't depend on the number of instances.
+ *
+ * A batch is a blueprint and a mesh. Meshes own their index buffers, so the instances of different
+ * meshes can't be drawn by the same call.
+ *
+ * Materials are referred to by their bindless record, so GPU driven drawing needs bindless mode.
+ */
+
+enum {
+    SSCENE_MAX_BATCHES      = 1024,
+
+    /** Instances culled by one compute invocation group. Must match sscene_cull.comp. */
+    SSCENE_CULL_GROUP_SIZE  = 64,
+};
+
+/** An instance, as the shaders see it, @see vd.scene.glsl. */
+typedef struct {
+    f32             obj[16];
+    u32             batch;
+
+    /** The index of the material record in frame slot 0. */
+    u32             material_index;
+
+    /**
+     * Only instances of the window that is drawn are culled in,
+     * @see WindowSurfaceComponent.index.
+     */
+    u32             window;
+    u32             pad;
+} SSceneInstance;
+
+/** A batch, as the shaders see it. Written every frame, so that meshes can be rewritten. */
+typedef struct {
+    /** The bounding sphere of the mesh in object space: center, radius. */
+    f32             bounds[4];
+    VkDeviceAddress vertex_address;
+    u32             index_count;
+    u32             first_index;
+    u32             first_command;
+    u32             pad[3];
+} SSceneGPUBatch;
+
+/** The data a frame culls with, followed by the batches. */
+typedef struct {
+    f32             planes[6][4];
+    u32             num_instances;
+    u32             num_batches;
+    u32             window;
+    u32             pad;
+} SSceneCullHeader;
+
+typedef struct {
+    HandleOf(GPUMaterialBlueprint)  blueprint;
+    HandleOf(VD_R_GPUMesh)          mesh;
+    u32                             num_instances;
+
+    /** Where the commands of the batch start, set by sscene_cull. */
+    u32                             first_command;
+} SSceneBatch;
+
+/**
+ * The push constants of the pipelines that draw batches. They replace the start of
+ * DefaultPushConstant, @see pbropaque_indirect.vert.
+ */
+typedef struct {
+    VkDeviceAddress                 instances;
+    VkDeviceAddress                 cull;
+
+    /** Added to the material index of every instance, to get the record of the frame slot. */
+    u32                             material_base;
+    u32                             pad;
+} SSceneDrawPushConstant;
+
+typedef struct {
+    VkDevice                        device;
+    SVMA                            *svma;
+    VkPipelineLayout                cull_layout;
+    VkPipeline                      cull_pipeline;
+
+    /** Instances on the CPU, with the entity each one belongs to. */
+    dynarray SSceneInstance         *instances;
+    dynarray u64                    *entities;
+    VD_IntMap                       entity_to_instance;
+
+    /** Instances that have to be uploaded, and whether an instance is in the list. */
+    dynarray u32                    *dirty;
+    dynarray u8                     *queued;
+
+    dynarray SSceneBatch            *batches;
+
+    /** Batch index by the slots of the blueprint and the mesh. */
+    VD_IntMap                       batch_map;
+
+    /** The number of instances the GPU buffers can hold. */
+    u32                             capacity;
+    VD(Buffer)                      gpu_instances;
+    VkDeviceAddress                 gpu_instances_address;
+    VD(Buffer)                      commands;
+    VkDeviceAddress                 commands_address;
+    VD(Buffer)                      counts;
+    VkDeviceAddress                 counts_address;
+} SScene;
+
+typedef struct {
+    VkDevice                        device;
+    SVMA                            *svma;
+
+    /** The compute shader that culls, @see sscene_cull.comp. */
+    VkShaderModule                  cull_shader;
+} SSceneInitInfo;
+
+typedef struct {
+    HandleOf(GPUMaterialBlueprint)  blueprint;
+    HandleOf(VD_R_GPUMesh)          mesh;
+    u32                             material_index;
+    u32                             window;
+} SSceneInstanceInfo;
+
+int sscene_init(SScene *s, SSceneInitInfo *info);
+
+/** Create the cull buffer of an in flight frame of a window. */
+void sscene_frame_init(SScene *s, GPUCullFrame *frame);
+void sscene_frame_deinit(SScene *s, GPUCullFrame *frame);
+
+/**
+ * @brief Add the instance of an entity, or update it. The instance is uploaded by the next cull.
+ * @return 0 on success, -1 if there are already SSCENE_MAX_BATCHES batches and the instance needs
+ * a new one. The entity then has no instance.
+ */
+int sscene_set_instance(SScene *s, u64 entity, mat4 obj, SSceneInstanceInfo *info);
+void sscene_remove_instance(SScene *s, u64 entity);
+
+/**
+ * @brief Upload the instances that changed, and record the culling of the instances of window
+ * into cmd, outside of rendering. Afterwards, the commands and counts of every batch are ready for
+ * vkCmdDrawIndexedIndirectCount, @see SSceneBatch.first_command.
+ * @param frame The frame of the window that cmd belongs to. The GPU must be done with it.
+ * @param dq    Buffers that are replaced are freed with it.
+ */
+void sscene_cull(
+    SScene *s,
+    GPUCullFrame *frame,
+    VkCommandBuffer cmd,
+    VD_DeletionQueue *dq,
+    u32 window,
+    mat4 viewproj);
+
+/** The push constants for drawing the batches of a frame that sscene_cull culled. */
+SSceneDrawPushConstant sscene_draw_push_constant(SScene *s, GPUCullFrame *frame, u32 material_base);
+
+void sscene_deinit(SScene *s);
+
+#endif // !VD_R_SSCENE_H
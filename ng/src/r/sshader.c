@@ -14,6 +14,14 @@ const char *GLSL_VD_STRUCTS =
 #include "shd/generated/vd.structs.glsl"
 ;
 
+const char *GLSL_VD_BINDLESS = 
+#include "shd/generated/vd.bindless.glsl"
+;
+
+const char *GLSL_VD_SCENE = 
+#include "shd/generated/vd.scene.glsl"
+;
+
 static void free_shader(void *object, void *c);
 static void vd_shdc_log_error(const char *what, const char *msg, const char *extmsg);
 
@@ -30,10 +38,12 @@ int vd_r_sshader_init(SShader *s, SShaderInitInfo *info)
     s->compiler = vd_shdc_create();
     vd_shdc_init(s->compiler, &(VD_SHDC_InitInfo) {
         .cb_error = vd_shdc_log_error,
-        .num_include_mappings = 2,
+        .num_include_mappings = 4,
         .include_mappings = (VD_SHDC_IncludeMapping[]) {
             (VD_SHDC_IncludeMapping) { .file = "vd.glsl", .code = GLSL_PREINCLUDE },
             (VD_SHDC_IncludeMapping) { .file = "vd.structs.glsl", .code = GLSL_VD_STRUCTS },
+            (VD_SHDC_IncludeMapping) { .file = "vd.bindless.glsl", .code = GLSL_VD_BINDLESS },
+            (VD_SHDC_IncludeMapping) { .file = "vd.scene.glsl", .code = GLSL_VD_SCENE },
         },
     });
     return 0;
@@ -53,6 +63,7 @@ HandleOf(GPUShader) vd_r_sshader_new(SShader *s, GPUShaderCreateInfo *info)
             case VK_SHADER_STAGE_VERTEX_BIT:   shader_stage = VD_SHDC_SHADER_STAGE_VERTEX;   break;
             case VK_SHADER_STAGE_GEOMETRY_BIT: shader_stage = VD_SHDC_SHADER_STAGE_GEOMETRY; break;
             case VK_SHADER_STAGE_FRAGMENT_BIT: shader_stage = VD_SHDC_SHADER_STAGE_FRAGMENT; break;
+            case VK_SHADER_STAGE_COMPUTE_BIT:  shader_stage = VD_SHDC_SHADER_STAGE_COMPUTE;  break;
             default: exit(1);
         }
 
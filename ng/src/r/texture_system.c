@@ -14,6 +14,7 @@ int vd_texture_system_init(VD_R_TextureSystem *s, VD_R_TextureSystemInitInfo *in
     });
     s->device = info->device;
     s->svma = info->svma;
+    s->bindless = info->bindless;
     return 0;
 }
 
@@ -77,6 +78,10 @@ Handle vd_texture_system_new(VD_R_TextureSystem *s, VD_R_TextureCreateInfo *info
         0,
         &result.view));
 
+    if (s->bindless && (info->usage & VK_IMAGE_USAGE_SAMPLED_BIT)) {
+        result.bindless_index = sbindless_add_texture(s->bindless, result.view);
+    }
+
     Handle result_handle = VD_HANDLEMAP_REGISTER(s->image_handles, &result, {
         .ref_mode = VD_HANDLEMAP_REF_MODE_COUNT,
     });
@@ -93,6 +98,10 @@ static void free_texture(void *object, void *c)
 {
     VD_R_TextureSystem *s = (VD_R_TextureSystem*)c;
     Texture *image = (Texture*)object;
+    if (s->bindless && image->bindless_index != 0) {
+        sbindless_remove_texture(s->bindless, image->bindless_index);
+    }
+
     vkDestroyImageView(s->device, image->view, 0);
     svma_free_texture(s->svma, image->image, image->allocation);
 }
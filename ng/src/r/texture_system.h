@@ -5,16 +5,21 @@
 #include "volk.h"
 #include "vk_mem_alloc.h"
 #include "r/svma.h"
+#include "r/sbindless.h"
 
 typedef struct {
     VD_HANDLEMAP Texture    *image_handles;
     VkDevice                device;
     SVMA                    *svma;
+
+    /** Sampled textures are added to the bindless texture array, if bindless mode is on. */
+    SBindless               *bindless;
 } VD_R_TextureSystem;
 
 typedef struct {
     VkDevice        device;
     SVMA            *svma;
+    SBindless       *bindless;
 } VD_R_TextureSystemInitInfo;
 
 int vd_texture_system_init(VD_R_TextureSystem *s, VD_R_TextureSystemInitInfo *info);
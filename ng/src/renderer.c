@@ -8,6 +8,7 @@
 #include "r/geo_system.h"
 #include "r/texture_system.h"
 #include "r/smat.h"
+#include "r/sscene.h"
 #include "r/svma.h"
 #include "vd_common.h"
 #include "renderer.h"
@@ -32,6 +33,7 @@
 #include "mm.h"
 #include "vulkan_helpers.h"
 #include "cvar.h"
+#include "sort.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -43,6 +45,13 @@
 
 static void vd_shdc_log_error(const char *what, const char *msg, const char *extmsg);
 
+/** A static mesh that is drawn one by one in GPU driven mode. */
+typedef struct {
+    u64                                 entity;
+    u32                                 window;
+    RenderObject                        ro;
+} CPUDrawnStaticMesh;
+
 struct VD_Renderer {
     ecs_world_t                         *world;
     VD_Instance                         *app_instance;
@@ -55,12 +64,46 @@ struct VD_Renderer {
     SMat                                smat;
     SVMA                                *svma;
 
+    /** Only initialized in bindless mode, @see r.bindless. */
+    SBindless                           bindless;
+    int                                 use_bindless;
+
+    /** Only initialized in GPU driven mode, @see r.gpu-driven. Needs bindless mode. */
+    SScene                              scene;
+    int                                 use_gpu_driven;
+
+    /**
+     * Static meshes that are drawn one by one in GPU driven mode, and their index by entity. Their
+     * render objects are kept, so that tables that didn't change are never visited.
+     */
+    dynarray CPUDrawnStaticMesh         *cpu_drawn;
+    VD_IntMap                           cpu_drawn_index;
+
+    /** Incremented whenever a window gets or gives back its index. */
+    u32                                 window_generation;
+
+    /** The sum of the generations the gather of gather_frame saw, @see begin_gather. */
+    u64                                 gathered_generation;
+    i64                                 gather_frame;
+    int                                 regather;
+
 // ----RENDERING DEVICES----------------------------------------------------------------------------
     VkPhysicalDevice                    physical_device;
     VkDevice                            device;
 
     VD_DeletionQueue                    deletion_queue;
 
+    /**
+     * Signaled by every window submission with its serial, so that state shared by windows knows
+     * when the GPU is done with a frame of any window, @see SMat.timeline.
+     */
+    VkSemaphore                         timeline;
+    u64                                 submit_serial;
+
+    /** Indices of destroyed windows, @see WindowSurfaceComponent.index. */
+    dynarray u32                        *free_window_indices;
+    u32                                 num_window_indices;
+
     struct {
         u32                             queue_family_index;
         VkQueue                         queue;
@@ -98,6 +141,8 @@ struct VD_Renderer {
         HandleOf(GPUMaterialBlueprint)   pbropaque;
     } materials;
 
+    VD_RendererStats                    stats;
+
 #if VD_VALIDATION_LAYERS
     VkDebugUtilsMessengerEXT            debug_messenger;
     PFN_vkCreateDebugUtilsMessengerEXT  vkCreateDebugUtilsMessengerEXT;
@@ -336,6 +381,8 @@ int vd_renderer_init(VD_Renderer *renderer, VD_RendererInitInfo *info)
     u32 best_device_graphics_queue_family = 0;
     u32 best_device_present_queue_family = 0;
     int best_device_is_gpu = 0;
+    int best_device_supports_bindless = 0;
+    int best_device_supports_gpu_driven = 0;
     int min_major_version = 1;
     int min_minor_version = 3;
 
@@ -513,6 +560,16 @@ int vd_renderer_init(VD_Renderer *renderer, VD_RendererInitInfo *info)
             "\tDescriptor Indexing (1.2): %{u32}",
             features12.descriptorIndexing);
 
+        VD_DBG_FMT(
+            "Renderer",
+            "\tBindless Descriptors (1.2): %{u32}",
+            sbindless_supported(&features12));
+
+        VD_DBG_FMT(
+            "Renderer",
+            "\tDraw Indirect Count (1.2): %{u32}",
+            features12.drawIndirectCount);
+
         VD_DBG_FMT(
             "Renderer",
             "\tSynchronization 2 (1.3): %{u32}",
@@ -540,11 +597,17 @@ int vd_renderer_init(VD_Renderer *renderer, VD_RendererInitInfo *info)
             best_device_graphics_queue_family   = q_device_graphics_queue_family;
             best_device_present_queue_family    = q_device_present_queue_family;
             best_device_is_gpu                  = q_device_is_gpu;
+            best_device_supports_bindless       = sbindless_supported(&features12);
+            best_device_supports_gpu_driven     = features12.drawIndirectCount &&
+                                                  features.features.drawIndirectFirstInstance;
         } else if (q_device_is_gpu && physical_device_satisfies_requirements) {
             best_device                         = i;
             best_device_graphics_queue_family   = q_device_graphics_queue_family;
             best_device_present_queue_family    = q_device_present_queue_family;
             best_device_is_gpu                  = q_device_is_gpu;
+            best_device_supports_bindless       = sbindless_supported(&features12);
+            best_device_supports_gpu_driven     = features12.drawIndirectCount &&
+                                                  features.features.drawIndirectFirstInstance;
         }
 
     }
@@ -560,6 +623,45 @@ int vd_renderer_init(VD_Renderer *renderer, VD_RendererInitInfo *info)
 // ----CREATE LOGICAL DEVICE------------------------------------------------------------------------
     TracyCZoneN(Create_Logical_Device, "Create Logical Device", 1);
 
+    VD_CVAR_BOOL(bindless, "r.bindless", 0);
+    renderer->use_bindless = vd_cvar_get_bool(bindless);
+    if (renderer->use_bindless && !best_device_supports_bindless) {
+        VD_LOG("Renderer", "r.bindless is set, but the device does not support bindless descriptors");
+        renderer->use_bindless = 0;
+    }
+
+    VD_CVAR_BOOL(gpu_driven, "r.gpu-driven", 0);
+    renderer->use_gpu_driven = vd_cvar_get_bool(gpu_driven);
+    if (renderer->use_gpu_driven && !renderer->use_bindless) {
+        VD_LOG("Renderer", "r.gpu-driven is set, but it needs r.bindless");
+        renderer->use_gpu_driven = 0;
+    } else if (renderer->use_gpu_driven && !best_device_supports_gpu_driven) {
+        VD_LOG("Renderer", "r.gpu-driven is set, but the device does not support draw indirect count");
+        renderer->use_gpu_driven = 0;
+    }
+
+    VkPhysicalDeviceVulkan13Features enabled_features13 = {
+        .sType              = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+        .synchronization2   = VK_TRUE,
+        .dynamicRendering   = VK_TRUE,
+    };
+
+    VkPhysicalDeviceVulkan12Features enabled_features12 = {
+        .sType                  = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .bufferDeviceAddress    = VK_TRUE,
+        .descriptorIndexing     = VK_TRUE,
+        .timelineSemaphore      = VK_TRUE,
+        .pNext                  = &enabled_features13,
+    };
+
+    if (renderer->use_bindless) {
+        sbindless_enable_features(&enabled_features12);
+    }
+
+    if (renderer->use_gpu_driven) {
+        enabled_features12.drawIndirectCount = VK_TRUE;
+    }
+
     static const char *create_logical_device_extensions[] = {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME,
 #if VD_PLATFORM_MACOS
@@ -594,19 +696,9 @@ int vd_renderer_init(VD_Renderer *renderer, VD_RendererInitInfo *info)
                 .features = (VkPhysicalDeviceFeatures) 
                 {
                     .multiDrawIndirect      = VK_TRUE,
+                    .drawIndirectFirstInstance = renderer->use_gpu_driven,
                 },
-                .pNext = & (VkPhysicalDeviceVulkan12Features) 
-                {
-                    .sType                  = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
-                    .bufferDeviceAddress    = VK_TRUE,
-                    .descriptorIndexing     = VK_TRUE,
-                    .pNext = & (VkPhysicalDeviceVulkan13Features) 
-                    {
-                        .sType              = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
-                        .synchronization2   = VK_TRUE,
-                        .dynamicRendering   = VK_TRUE,
-                    },
-                },
+                .pNext = &enabled_features12,
             },
             .enabledExtensionCount          = VD_ARRAY_COUNT(create_logical_device_extensions),
             .ppEnabledExtensionNames        = create_logical_device_extensions,
@@ -657,9 +749,18 @@ int vd_renderer_init(VD_Renderer *renderer, VD_RendererInitInfo *info)
     renderer->depth_image_format = VK_FORMAT_D32_SFLOAT;
 
 // ----SYSTEMS--------------------------------------------------------------------------------------
+    if (renderer->use_bindless) {
+        VD_LOG("Renderer", "Using bindless descriptors");
+        sbindless_init(&renderer->bindless, & (SBindlessInitInfo) {
+            .svma = renderer->svma,
+            .device = renderer->device,
+        });
+    }
+
     vd_texture_system_init(&renderer->textures, & (VD_R_TextureSystemInitInfo) {
         .svma = renderer->svma,
         .device = renderer->device,
+        .bindless = renderer->use_bindless ? &renderer->bindless : 0,
     });
 
     vd_r_geo_system_init(&renderer->geos, & (VD_R_GeoSystemInitInfo) {
@@ -671,6 +772,26 @@ int vd_renderer_init(VD_Renderer *renderer, VD_RendererInitInfo *info)
         .device = renderer->device,
     });
 
+    VD_VK_CHECK(vkCreateSemaphore(
+        renderer->device,
+        & (VkSemaphoreCreateInfo)
+        {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = & (VkSemaphoreTypeCreateInfo)
+            {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+                .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+                .initialValue = 0,
+            },
+        },
+        0,
+        &renderer->timeline));
+    renderer->submit_serial = 0;
+
+    array_init(renderer->free_window_indices, vd_memory_get_system_allocator());
+    renderer->num_window_indices = 0;
+    renderer->window_generation = 0;
+
     smat_init(&renderer->smat, & (SMatInitInfo) {
         .device = renderer->device,
         .svma = renderer->svma,
@@ -684,6 +805,8 @@ int vd_renderer_init(VD_Renderer *renderer, VD_RendererInitInfo *info)
         },
         .color_format = renderer->color_image_format,
         .depth_format = renderer->depth_image_format,
+        .bindless = renderer->use_bindless ? &renderer->bindless : 0,
+        .timeline = renderer->timeline,
         .default_push_constant = {
             .type = PUSH_CONSTANT_TYPE_DEFAULT,
             .size = sizeof(DefaultPushConstant),
@@ -691,6 +814,28 @@ int vd_renderer_init(VD_Renderer *renderer, VD_RendererInitInfo *info)
         },
     });
 
+    if (renderer->use_gpu_driven) {
+        VD_LOG("Renderer", "Using GPU driven drawing");
+        HandleOf(GPUShader) cull = vd_renderer_create_shader(renderer, & (GPUShaderCreateInfo) {
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .sourcecode = VD_SSCENE_CULL_COMP,
+            .sourcecode_len = strlen(VD_SSCENE_CULL_COMP),
+        });
+
+        sscene_init(&renderer->scene, & (SSceneInitInfo) {
+            .device = renderer->device,
+            .svma = renderer->svma,
+            .cull_shader = USE_HANDLE(cull, GPUShader)->module,
+        });
+
+        array_init(renderer->cpu_drawn, vd_memory_get_system_allocator());
+        vd_intmap_init(&renderer->cpu_drawn_index, vd_memory_get_system_allocator(), 16, 0);
+        renderer->gathered_generation = 0;
+        renderer->gather_frame = -1;
+        renderer->regather = 0;
+        DROP_HANDLE(cull);
+    }
+
 // ----IMMEDIATE QUEUE------------------------------------------------------------------------------
 
     VD_VK_CHECK(vkCreateCommandPool(
@@ -907,6 +1052,12 @@ int vd_renderer_init(VD_Renderer *renderer, VD_RendererInitInfo *info)
             checkers,
             checkers_size);
 
+        if (renderer->use_bindless) {
+            sbindless_set_fallback_texture(
+                &renderer->bindless,
+                USE_HANDLE(renderer->images.checker_magenta, Texture)->view);
+        }
+
     }
 
 // ----DEFAULT PASSES-------------------------------------------------------------------------------
@@ -987,22 +1138,31 @@ int vd_renderer_init(VD_Renderer *renderer, VD_RendererInitInfo *info)
     {
         TracyCZoneN(Create_Pipeline_Opaque, "Create Pipeline Opaque", 1);
 
-        HandleOf(GPUShader) vertex, fragment;
+        HandleOf(GPUShader) vertex, fragment, indirect_vertex = INVALID_HANDLE();
+        const char *vertex_source = renderer->use_bindless ? VD_PBROPAQUE_BINDLESS_VERT : VD_PBROPAQUE_VERT;
+        const char *fragment_source = renderer->use_bindless ? VD_PBROPAQUE_BINDLESS_FRAG : VD_PBROPAQUE_FRAG;
 
         TracyCZoneN(Compile_Shaders, "Compile Shaders", 1);
         {
             vertex = vd_renderer_create_shader(renderer, & (GPUShaderCreateInfo) {
                 .stage = VK_SHADER_STAGE_VERTEX_BIT,
-                .sourcecode = VD_PBROPAQUE_VERT,
-                .sourcecode_len = strlen(VD_PBROPAQUE_VERT),
+                .sourcecode = vertex_source,
+                .sourcecode_len = strlen(vertex_source),
             });
         }
 
         {
             fragment = vd_renderer_create_shader(renderer, & (GPUShaderCreateInfo) {
                 .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-                .sourcecode = VD_PBROPAQUE_FRAG,
-                .sourcecode_len = strlen(VD_PBROPAQUE_FRAG),
+                .sourcecode = fragment_source,
+                .sourcecode_len = strlen(fragment_source),
+            });
+        }
+        if (renderer->use_gpu_driven) {
+            indirect_vertex = vd_renderer_create_shader(renderer, & (GPUShaderCreateInfo) {
+                .stage = VK_SHADER_STAGE_VERTEX_BIT,
+                .sourcecode = VD_PBROPAQUE_INDIRECT_VERT,
+                .sourcecode_len = strlen(VD_PBROPAQUE_INDIRECT_VERT),
             });
         }
         TracyCZoneEnd(Compile_Shaders);
@@ -1035,17 +1195,18 @@ int vd_renderer_init(VD_Renderer *renderer, VD_RendererInitInfo *info)
                     .sampler2d = renderer->images.checker_magenta,
                 },
             },
+            .indirect_vertex_shader = indirect_vertex,
         });
 
         DROP_HANDLE(vertex);
         DROP_HANDLE(fragment);
+        if (renderer->use_gpu_driven) {
+            DROP_HANDLE(indirect_vertex);
+        }
 
         TracyCZoneEnd(Create_Pipeline_Opaque);
     }
 
-// ----CVARS----------------------------------------------------------------------------------------
-    VD_CVS_SET_INT("r.inflight-frame-count", 2);
-
     return 0;
 }
 
@@ -1056,8 +1217,18 @@ static void rebuild_frame_data(
     dynarray VD_RendererFrameData **out_frame_data)
 {
     VD_RendererFrameData *frame_data = *out_frame_data;
-    i32 num_inflight_frames;
-    VD_CVS_GET_INT("r.inflight-frame-count", &num_inflight_frames);
+    VD_CVAR_I32(inflight_frame_count, "r.inflight-frame-count", 2);
+    i32 num_inflight_frames = vd_cvar_get_i32(inflight_frame_count);
+
+    // Every window keeps at most VD_MAX_INFLIGHT_FRAMES frames in flight
+    if (num_inflight_frames < 1 || num_inflight_frames > VD_MAX_INFLIGHT_FRAMES) {
+        VD_LOG_FMT(
+            "Renderer",
+            "r.inflight-frame-count must be between 1 and %{i32}, was %{i32}",
+            (i32)VD_MAX_INFLIGHT_FRAMES,
+            num_inflight_frames);
+        num_inflight_frames = num_inflight_frames < 1 ? 1 : VD_MAX_INFLIGHT_FRAMES;
+    }
 
     array_clear(frame_data);
     array_addn(frame_data, num_inflight_frames);
@@ -1141,6 +1312,11 @@ static void rebuild_frame_data(
                 .allocator = VD_MM_GLOBAL_ALLOCATOR(),
                 .renderer = renderer,
             });
+
+        smat_scene_set_init(&renderer->smat, &frame_data[i].scene);
+        if (renderer->use_gpu_driven) {
+            sscene_frame_init(&renderer->scene, &frame_data[i].cull);
+        }
     }
     *out_frame_data = frame_data;
 }
@@ -1511,6 +1687,16 @@ static void create_swapchain_image_views_and_framebuffers(
 
 void on_window_component_immediate_destroy(ecs_entity_t entity, void *usrdata);
 
+static u32 new_window_index(VD_Renderer *renderer)
+{
+    renderer->window_generation++;
+    if (array_len(renderer->free_window_indices) > 0) {
+        return array_pop(renderer->free_window_indices);
+    }
+
+    return renderer->num_window_indices++;
+}
+
 void RendererOnWindowComponentSet(ecs_iter_t *it)
 {
     const Application *app = ecs_singleton_get(it->world, Application);
@@ -1566,6 +1752,7 @@ void RendererOnWindowComponentSet(ecs_iter_t *it)
             .extent = { window_size->x, window_size->y },
             .frame_data = frame_data,
             .current_frame = 0,
+            .index = new_window_index(renderer),
             .color_image = color_image,
             .depth_image = depth_image,
             .render_list = render_list,
@@ -1584,6 +1771,8 @@ void on_window_component_immediate_destroy(ecs_entity_t entity, void *usrdata)
 
     vkDeviceWaitIdle(renderer->device);
     array_deinit(ws->render_list);
+    array_add(renderer->free_window_indices, ws->index);
+    renderer->window_generation++;
 
     vkDestroyImageView(renderer->device, ws->color_image.view, 0);
     vkDestroyImageView(renderer->device, ws->depth_image.view, 0);
@@ -1597,6 +1786,10 @@ void on_window_component_immediate_destroy(ecs_entity_t entity, void *usrdata)
         vkDestroySemaphore(renderer->device, ws->frame_data[i].sem_present_image, 0);
         vkDestroyCommandPool(renderer->device, ws->frame_data[i].command_pool, 0);
         vd_descriptor_allocator_deinit(&ws->frame_data[i].descriptor_allocator);
+        smat_scene_set_deinit(&renderer->smat, &ws->frame_data[i].scene);
+        if (renderer->use_gpu_driven) {
+            sscene_frame_deinit(&renderer->scene, &ws->frame_data[i].cull);
+        }
     }
 
     for (int i = 0; i < array_len(ws->image_views); ++i) {
@@ -1610,12 +1803,25 @@ void on_window_component_immediate_destroy(ecs_entity_t entity, void *usrdata)
 int vd_renderer_deinit(VD_Renderer *renderer)
 {
     vkDeviceWaitIdle(renderer->device);
+    if (renderer->use_gpu_driven) {
+        sscene_deinit(&renderer->scene);
+        array_deinit(renderer->cpu_drawn);
+        vd_intmap_deinit(&renderer->cpu_drawn_index);
+
+        // Static meshes removed when the world is destroyed have nothing to remove anymore
+        renderer->use_gpu_driven = 0;
+    }
     smat_deinit(&renderer->smat);
     vd_texture_system_deinit(&renderer->textures);
     vd_r_geo_system_deinit(&renderer->geos);
     vd_r_sshader_deinit(&renderer->sshader);
+    if (renderer->use_bindless) {
+        sbindless_deinit(&renderer->bindless);
+    }
     vkDestroyCommandPool(renderer->device, renderer->imm.command_pool, 0);
     vkDestroyFence(renderer->device, renderer->imm.fence, 0);
+    vkDestroySemaphore(renderer->device, renderer->timeline, 0);
+    array_deinit(renderer->free_window_indices);
 
     vd_deletion_queue_flush(&renderer->deletion_queue);
     svma_deinit(renderer->svma);
@@ -1627,12 +1833,66 @@ int vd_renderer_deinit(VD_Renderer *renderer)
     return 0;
 }
 
+/*
+ * Draw sort keys, from the most significant bit:
+ * - pass       17 bits (VD_PASS_* go up to VD_PASS_MAX)
+ * - blueprint  15 bits (slot of the blueprint handle)
+ * - material   16 bits (slot of the material handle)
+ * - mesh       16 bits (slot of the mesh handle)
+ * Slots that don't fit only make the grouping worse; submission compares the real state.
+ */
+#define DRAW_KEY_FIELD(v, bits, shift) (((u64)(v) & ((1ull << (bits)) - 1)) << (shift))
+
+/** The pass, blueprint and material bits of the key. */
+static u64 make_material_key(HandleOf(GPUMaterial) material)
+{
+    GPUMaterial *materialptr = USE_HANDLE(material, GPUMaterial);
+    GPUMaterialBlueprint *blueprintptr = USE_HANDLE(materialptr->blueprint, GPUMaterialBlueprint);
+
+    return DRAW_KEY_FIELD(blueprintptr->pass,                      17, 47) |
+           DRAW_KEY_FIELD(VD_HANDLE_SLOT(materialptr->blueprint),  15, 32) |
+           DRAW_KEY_FIELD(VD_HANDLE_SLOT(material),                16, 16);
+}
+
+/** The order to draw the render list in, on the frame allocator. */
+static VD_SortItem *sort_render_list(dynarray RenderObject *ro)
+{
+    TracyCZoneN(Sort_Render_List, "Render::Sort", 1);
+
+    size_t len = array_len(ro);
+    dynarray VD_SortItem *items = 0;
+    array_init(items, VD_MM_FRAME_ALLOCATOR());
+    array_resize_uninit(items, len);
+
+    dynarray VD_SortItem *scratch = 0;
+    array_init(scratch, VD_MM_FRAME_ALLOCATOR());
+    array_resize_uninit(scratch, len);
+
+    // Consecutive objects usually share a material, so its key is only built once
+    u64 last_material = 0;
+    u64 material_key = 0;
+    for (size_t i = 0; i < len; ++i) {
+        if (i == 0 || ro[i].material.id != last_material) {
+            material_key = make_material_key(ro[i].material);
+            last_material = ro[i].material.id;
+        }
+
+        items[i].key = material_key | DRAW_KEY_FIELD(VD_HANDLE_SLOT(ro[i].mesh), 16, 0);
+        items[i].index = (u32)i;
+    }
+
+    vd_radix_sort_u64(items, scratch, len);
+
+    TracyCZoneEnd(Sort_Render_List);
+    return items;
+}
+
 static void render_window_surface(
     VD_Renderer *renderer,
     WindowSurfaceComponent *ws)
 {
-    VD_RendererFrameData *frame_data = 
-        &ws->frame_data[ws->current_frame % array_len(ws->frame_data)];
+    u32 frame_index = ws->current_frame % array_len(ws->frame_data);
+    VD_RendererFrameData *frame_data = &ws->frame_data[frame_index];
     ws->current_frame++;
 
     VD_VK_CHECK(vkWaitForFences(
@@ -1647,7 +1907,8 @@ static void render_window_surface(
         1,
         &frame_data->fnc_render_complete));
 
-    smat_begin_frame(&renderer->smat, &frame_data->descriptor_allocator);
+    u64 serial = ++renderer->submit_serial;
+    smat_begin_frame(&renderer->smat, &frame_data->descriptor_allocator, serial);
     vd_deletion_queue_flush(&frame_data->deletion_queue);
 
     u32 swapchain_image_idx;
@@ -1671,6 +1932,46 @@ static void render_window_surface(
             .pNext = 0,
         }));
 
+    float aspect_ratio = (float)ws->extent.width / (float)ws->extent.height;
+    mat4 projmatrix;
+    vd_r_perspective(projmatrix, glm_rad(40.0f), aspect_ratio, 0.01f, 100.0f);
+
+    static float dt = 0.0f;
+    dt += 0.01f;
+    vec3 up = {0, 1, 0};
+
+
+    mat4 viewmatrix = GLM_MAT4_IDENTITY_INIT;
+    float radius = 5.0f;
+    vec3 eye = {sinf(glm_rad(dt) * 2) * radius, sinf(glm_rad(dt) * 1.5) * radius, cosf(glm_rad(dt) * 2) * radius};
+    glm_lookat(eye, GLM_VEC3_ZERO, up, viewmatrix);
+
+    VD_R_SceneData scene_data;
+    glm_mat4_copy(projmatrix, scene_data.proj);
+    glm_mat4_copy(viewmatrix, scene_data.view);
+
+    vec3 sun_direction = {0.0f, 0.0f, -1.0f};
+    glm_vec3_copy(sun_direction, scene_data.sun_direction);
+    glm_normalize(scene_data.sun_direction);
+
+    // The fence above means the GPU is done with this frame's copy
+    smat_scene_set_write(&renderer->smat, &frame_data->scene, 0, &scene_data, sizeof(scene_data));
+
+    // Culling writes the draws, so it has to be recorded outside of rendering
+    if (renderer->use_gpu_driven) {
+        mat4 viewproj;
+        glm_mat4_mul(projmatrix, viewmatrix, viewproj);
+
+        smat_prep_bindless(&renderer->smat);
+        sscene_cull(
+            &renderer->scene,
+            &frame_data->cull,
+            cmd,
+            &frame_data->deletion_queue,
+            ws->index,
+            viewproj);
+    }
+
     vd_vk_image_transition(
         cmd,
         ws->color_image.image,
@@ -1740,79 +2041,112 @@ static void render_window_surface(
         });
 
 
-    float aspect_ratio = (float)ws->extent.width / (float)ws->extent.height;
-    mat4 projmatrix;
-    vd_r_perspective(projmatrix, glm_rad(40.0f), aspect_ratio, 0.01f, 100.0f);
+    dynarray RenderObject *ro = ws->render_list;
+    VD_SortItem *order = sort_render_list(ro);
+    VD_RendererStats *stats = &renderer->stats;
+
+    GPUMaterialBlueprint    *blueprintptr = 0;
+    VD(PushConstantInfo)    *scene_bound_with = 0;
+    VkPipeline              bound_pipeline = VK_NULL_HANDLE;
+    u64                     bound_material = 0;
+    VkBuffer                bound_index_buffer = VK_NULL_HANDLE;
+    VkRect2D                bound_scissor = { .extent = { 0, 0 } };
+    int                     scissor_set = 0;
+    u32                     material_index = 0;
+
+    // In bindless mode, set 1 is the same for every material, so it is bound along with set 0
+    VkDescriptorSet         frame_sets[2] = { frame_data->scene.set, VK_NULL_HANDLE };
+    u32                     num_frame_sets = 1;
+    if (renderer->use_bindless) {
+        frame_sets[1] = renderer->bindless.set;
+        num_frame_sets = 2;
+    }
 
-    static float dt = 0.0f;
-    dt += 0.01f;
-    vec3 up = {0, 1, 0};
+    for (int o = 0; o < array_len(ro); ++o) {
+        RenderObject *obj = &ro[order[o].index];
 
+        // Objects are sorted by material, so a material's sets are prepared once per frame
+        if (obj->material.id != bound_material || blueprintptr == 0) {
+            GPUMaterial *materialptr = USE_HANDLE(obj->material, GPUMaterial);
+            blueprintptr = USE_HANDLE(materialptr->blueprint, GPUMaterialBlueprint);
 
-    mat4 viewmatrix = GLM_MAT4_IDENTITY_INIT;
-    float radius = 5.0f;
-    vec3 eye = {sinf(glm_rad(dt) * 2) * radius, sinf(glm_rad(dt) * 1.5) * radius, cosf(glm_rad(dt) * 2) * radius};
-    glm_lookat(eye, GLM_VEC3_ZERO, up, viewmatrix);
+            if (blueprintptr->pipeline != bound_pipeline) {
+                vkCmdBindPipeline(
+                    cmd,
+                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    blueprintptr->pipeline);
 
-    VD_R_SceneData scene_data;
-    glm_mat4_copy(projmatrix, scene_data.proj);
-    glm_mat4_copy(viewmatrix, scene_data.view);
+                bound_pipeline = blueprintptr->pipeline;
+                stats->pipeline_binds++;
+            } else {
+                stats->pipeline_binds_skipped++;
+            }
 
-    vec3 sun_direction = {0.0f, 0.0f, -1.0f};
-    glm_vec3_copy(sun_direction, scene_data.sun_direction);
-    glm_normalize(scene_data.sun_direction);
+            // Set 0 stays bound across layouts with the same push constant range, so in practice
+            // it is bound once per command buffer
+            if (scene_bound_with == 0 ||
+                scene_bound_with->size != blueprintptr->push_constant_info.size ||
+                scene_bound_with->stage != blueprintptr->push_constant_info.stage)
+            {
+                vkCmdBindDescriptorSets(
+                    cmd,
+                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    blueprintptr->layout,
+                    0,
+                    num_frame_sets,
+                    frame_sets,
+                    0,
+                    0);
+
+                scene_bound_with = &blueprintptr->push_constant_info;
+                stats->descriptor_set_binds++;
+            }
 
-    dynarray RenderObject *ro = ws->render_list;
-    for (int i = 0; i < array_len(ro); ++i) {
-        HandleOf(GPUMaterial) material = ro[i].material;
-        GPUMaterial *materialptr = USE_HANDLE(material, GPUMaterial);
-        HandleOf(GPUMaterialBlueprint) blueprint = materialptr->blueprint;
-        GPUMaterialBlueprint *blueprintptr = USE_HANDLE(materialptr->blueprint, GPUMaterialBlueprint);
+            GPUMaterialInstance instance = smat_prep(&renderer->smat, obj->material);
+            material_index = instance.material_index;
+
+            if (renderer->use_bindless) {
+                stats->descriptor_set_binds_skipped++;
+            } else {
+                vkCmdBindDescriptorSets(
+                    cmd,
+                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    blueprintptr->layout,
+                    1,
+                    1,
+                    &instance.property_set,
+                    0,
+                    0);
+
+                stats->descriptor_set_binds++;
+            }
 
-        vkCmdBindPipeline(
-            cmd,
-            VK_PIPELINE_BIND_POINT_GRAPHICS,
-            blueprintptr->pipeline);
+            bound_material = obj->material.id;
+        } else {
+            stats->pipeline_binds_skipped++;
+            stats->descriptor_set_binds_skipped++;
+        }
 
-        GPUMaterialInstance instance = smat_prep(
-            &renderer->smat,
-            & (MaterialWriteInfo)
+        VkRect2D scissor = { .offset = { 0, 0 }, .extent = ws->extent };
+        if (obj->scissor.use_custom) {
+            scissor = (VkRect2D)
             {
-                .material = material,
-                .num_properties = 1,
-                .properties = (MaterialProperty[])
-                {
-                    (MaterialProperty)
-                    {
-                        .binding.type = BINDING_TYPE_STRUCT,
-                        .binding.struct_size = sizeof(scene_data),
-                        .pstruct = &scene_data,
-                    },
-                },
-            });
-
-        VD_R_GPUMesh *mesh_to_draw = USE_HANDLE(ro[i].mesh, VD_R_GPUMesh);
+                .offset = { obj->scissor.custom[0], obj->scissor.custom[1] },
+                .extent = { obj->scissor.custom[2], obj->scissor.custom[3] },
+            };
+        }
 
-        if (ro[i].scissor.use_custom) {
-            vkCmdSetScissor(
-                cmd,
-                0,
-                1,
-                & (VkRect2D)
-                {
-                    .offset = { ro[i].scissor.custom[0], ro[i].scissor.custom[1] },
-                    .extent = { ro[i].scissor.custom[2], ro[i].scissor.custom[3] },
-                });
+        if (!scissor_set || memcmp(&scissor, &bound_scissor, sizeof(scissor)) != 0) {
+            vkCmdSetScissor(cmd, 0, 1, &scissor);
+            bound_scissor = scissor;
+            scissor_set = 1;
+            stats->scissor_sets++;
         } else {
-            vkCmdSetScissor(
-                cmd,
-                0,
-                1,
-                & (VkRect2D)
-                {
-                    .offset = { 0, 0 },
-                    .extent = ws->extent,
-                });
+            stats->scissor_sets_skipped++;
+        }
+
+        if (renderer->use_bindless && obj->push_constant.info.type == PUSH_CONSTANT_TYPE_DEFAULT) {
+            obj->push_constant.def.material_index = material_index;
         }
 
         vkCmdPushConstants(
@@ -1820,35 +2154,114 @@ static void render_window_surface(
             blueprintptr->layout,
             vd_shader_stage_to_vk_shader_stage(blueprintptr->push_constant_info.stage),
             0,
-            ro[i].push_constant.info.size,
-            get_push_constant_ptr(&ro[i].push_constant));
-
-        vkCmdBindDescriptorSets(
-            cmd,
-            VK_PIPELINE_BIND_POINT_GRAPHICS,
-            blueprintptr->layout,
-            0,
-            2,
-            (VkDescriptorSet[])
-            {
-                instance.default_set,
-                instance.property_set,
-            },
-            0,
-            0);
-
-        vkCmdBindIndexBuffer(cmd, mesh_to_draw->index.buffer, 0, VK_INDEX_TYPE_UINT32);
+            obj->push_constant.info.size,
+            get_push_constant_ptr(&obj->push_constant));
+
+        VD_R_GPUMesh *mesh_to_draw = USE_HANDLE(obj->mesh, VD_R_GPUMesh);
+        if (mesh_to_draw->index.buffer != bound_index_buffer) {
+            vkCmdBindIndexBuffer(cmd, mesh_to_draw->index.buffer, 0, VK_INDEX_TYPE_UINT32);
+            bound_index_buffer = mesh_to_draw->index.buffer;
+            stats->index_buffer_binds++;
+        } else {
+            stats->index_buffer_binds_skipped++;
+        }
 
         vkCmdDrawIndexed(
             cmd,
-            ro[i].index_count,
+            obj->index_count,
             1,
-            ro[i].first_index,
+            obj->first_index,
             0,
             0);
+
+        stats->draws++;
+    }
+
+    if (renderer->use_gpu_driven) {
+        SScene *scene = &renderer->scene;
+        SSceneDrawPushConstant pc = sscene_draw_push_constant(
+            scene,
+            &frame_data->cull,
+            renderer->smat.frame_slot * SBINDLESS_MAX_MATERIALS);
+
+        // Batches are drawn without a custom scissor
+        VkRect2D scissor = { .offset = { 0, 0 }, .extent = ws->extent };
+        if (!scissor_set || memcmp(&scissor, &bound_scissor, sizeof(scissor)) != 0) {
+            vkCmdSetScissor(cmd, 0, 1, &scissor);
+            stats->scissor_sets++;
+        } else {
+            stats->scissor_sets_skipped++;
+        }
+
+        for (u32 b = 0; b < array_len(scene->batches); ++b) {
+            SSceneBatch *batch = &scene->batches[b];
+            if (batch->num_instances == 0) {
+                continue;
+            }
+
+            blueprintptr = USE_HANDLE(batch->blueprint, GPUMaterialBlueprint);
+            if (blueprintptr->indirect_pipeline != bound_pipeline) {
+                vkCmdBindPipeline(
+                    cmd,
+                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    blueprintptr->indirect_pipeline);
+
+                bound_pipeline = blueprintptr->indirect_pipeline;
+                stats->pipeline_binds++;
+            } else {
+                stats->pipeline_binds_skipped++;
+            }
+
+            if (scene_bound_with == 0 ||
+                scene_bound_with->size != blueprintptr->push_constant_info.size ||
+                scene_bound_with->stage != blueprintptr->push_constant_info.stage)
+            {
+                vkCmdBindDescriptorSets(
+                    cmd,
+                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    blueprintptr->layout,
+                    0,
+                    num_frame_sets,
+                    frame_sets,
+                    0,
+                    0);
+
+                scene_bound_with = &blueprintptr->push_constant_info;
+                stats->descriptor_set_binds++;
+            }
+
+            vkCmdPushConstants(
+                cmd,
+                blueprintptr->layout,
+                vd_shader_stage_to_vk_shader_stage(blueprintptr->push_constant_info.stage),
+                0,
+                sizeof(pc),
+                &pc);
+
+            VD_R_GPUMesh *mesh = USE_HANDLE(batch->mesh, VD_R_GPUMesh);
+            if (mesh->index.buffer != bound_index_buffer) {
+                vkCmdBindIndexBuffer(cmd, mesh->index.buffer, 0, VK_INDEX_TYPE_UINT32);
+                bound_index_buffer = mesh->index.buffer;
+                stats->index_buffer_binds++;
+            } else {
+                stats->index_buffer_binds_skipped++;
+            }
+
+            vkCmdDrawIndexedIndirectCount(
+                cmd,
+                scene->commands.buffer,
+                batch->first_command * sizeof(VkDrawIndexedIndirectCommand),
+                scene->counts.buffer,
+                b * sizeof(u32),
+                batch->num_instances,
+                sizeof(VkDrawIndexedIndirectCommand));
+
+            stats->indirect_draws++;
+        }
     }
     vkCmdEndRendering(cmd);
 
+    stats->descriptor_writes += renderer->smat.descriptor_writes;
     smat_end_frame(&renderer->smat);
 
     vd_vk_image_transition(
@@ -1891,13 +2304,21 @@ static void render_window_surface(
                 .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
                 .value = 1,
             },
-            .signalSemaphoreInfoCount = 1,
-            .pSignalSemaphoreInfos = & (VkSemaphoreSubmitInfoKHR)
+            .signalSemaphoreInfoCount = 2,
+            .pSignalSemaphoreInfos = (VkSemaphoreSubmitInfoKHR[])
             {
-                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR,
-                .semaphore = frame_data->sem_present_image,
-                .stageMask = VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT,
-                .value = 1,
+                {
+                    .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR,
+                    .semaphore = frame_data->sem_present_image,
+                    .stageMask = VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT,
+                    .value = 1,
+                },
+                {
+                    .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR,
+                    .semaphore = renderer->timeline,
+                    .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                    .value = serial,
+                },
             },
             .commandBufferInfoCount = 1,
             .pCommandBufferInfos = & (VkCommandBufferSubmitInfo)
@@ -2048,6 +2469,33 @@ void vd_renderer_destroy_texture(
     svma_free_texture(renderer->svma, image->image, image->allocation);
 }
 
+/** The bounding sphere of vertices: the center of their box, and the distance to the farthest. */
+static void compute_mesh_bounds(VD_R_Vertex *vertices, size_t num_vertices, vec4 bounds)
+{
+    glm_vec4_zero(bounds);
+    if (num_vertices == 0) {
+        return;
+    }
+
+    vec3 box[2];
+    glm_vec3_copy(vertices[0].position, box[0]);
+    glm_vec3_copy(vertices[0].position, box[1]);
+    for (size_t i = 1; i < num_vertices; ++i) {
+        glm_vec3_minv(box[0], vertices[i].position, box[0]);
+        glm_vec3_maxv(box[1], vertices[i].position, box[1]);
+    }
+
+    vec3 center;
+    glm_vec3_center(box[0], box[1], center);
+
+    float radius2 = 0.0f;
+    for (size_t i = 0; i < num_vertices; ++i) {
+        radius2 = glm_max(radius2, glm_vec3_distance2(center, vertices[i].position));
+    }
+
+    glm_vec4(center, sqrtf(radius2), bounds);
+}
+
 VD_R_GPUMesh vd_renderer_upload_mesh(
     VD_Renderer *renderer,
     u32 *indices,
@@ -2059,6 +2507,7 @@ VD_R_GPUMesh vd_renderer_upload_mesh(
     size_t bytes_vertices = sizeof(*vertices) * num_vertices;
 
     VD_R_GPUMesh result;
+    compute_mesh_bounds(vertices, num_vertices, result.bounds);
 
     result.index = vd_renderer_create_buffer(
         renderer,
@@ -2194,6 +2643,7 @@ void vd_renderer_write_mesh(
 
     mesh->num_indices = info->num_indices;
     mesh->num_vertices = info->num_vertices;
+    compute_mesh_bounds(info->vertices, info->num_vertices, mesh->bounds);
 
     VkCommandBuffer cmd = vd_renderer_imm_begin(renderer);
 
@@ -2237,6 +2687,20 @@ HandleOf(GPUMaterial) vd_renderer_create_material(
     return smat_new_from_blueprint(&renderer->smat, blueprint);
 }
 
+void vd_renderer_set_material_property(
+    VD_Renderer *renderer,
+    HandleOf(GPUMaterial) material,
+    u32 index,
+    MaterialProperty *value)
+{
+    smat_set_property(&renderer->smat, material, index, value);
+}
+
+void vd_renderer_get_stats(VD_Renderer *renderer, VD_RendererStats *stats)
+{
+    *stats = renderer->stats;
+}
+
 HandleOf(GPUMaterialBlueprint) vd_renderer_get_default_material(VD_Renderer *renderer)
 {
     return renderer->materials.pbropaque;
@@ -2256,6 +2720,17 @@ static void vd_shdc_log_error(const char *what, const char *msg, const char *ext
 }
 
 
+void RendererBeginFrameSystem(ecs_iter_t *it)
+{
+    const Application *app = ecs_singleton_get(it->world, Application);
+    VD_Renderer *renderer = vd_instance_get_renderer(app->instance);
+
+    renderer->stats = (VD_RendererStats) {0};
+    if (renderer->use_bindless) {
+        sbindless_begin_frame(&renderer->bindless);
+    }
+}
+
 void RendererRenderToWindowSurfaceComponents(ecs_iter_t *it)
 {
     const Application *app = ecs_singleton_get(it->world, Application);
@@ -2263,6 +2738,15 @@ void RendererRenderToWindowSurfaceComponents(ecs_iter_t *it)
     WindowSurfaceComponent *ws = ecs_field(it, WindowSurfaceComponent, 0);
 
     for (int i = 0; i < it->count; ++i) {
+        // The static meshes of the window that aren't instances
+        if (renderer->use_gpu_driven) {
+            for (u32 j = 0; j < array_len(renderer->cpu_drawn); ++j) {
+                if (renderer->cpu_drawn[j].window == ws[i].index) {
+                    vd_renderer_push_render_object(renderer, &ws[i], &renderer->cpu_drawn[j].ro);
+                }
+            }
+        }
+
         render_window_surface(renderer, &ws[i]);
         array_clear(ws[i].render_list);
     }
@@ -2331,6 +2815,7 @@ void RendererCheckWindowComponentSizeChange(ecs_iter_t *it)
             .extent = { sizes[i].x, sizes[i].y },
             .frame_data = frame_data,
             .current_frame = 0,
+            .index = ws->index,
             .color_image = color_image,
             .depth_image = depth_image,
             .render_list = ws->render_list,
@@ -2338,6 +2823,133 @@ void RendererCheckWindowComponentSizeChange(ecs_iter_t *it)
     }
 }
 
+static RenderObject static_mesh_render_object(
+    StaticMeshComponent *static_mesh,
+    WorldTransformComponent *world_transform)
+{
+    DefaultPushConstant pc = {0};
+    pc.vertex_address = USE_HANDLE(static_mesh->mesh, VD_R_GPUMesh)->vertex_buffer_address;
+
+    glm_mat4_copy(world_transform->world, pc.obj);
+
+    return (RenderObject) {
+        .mesh = static_mesh->mesh,
+        .material = static_mesh->material,
+        .push_constant = {
+            .info = {
+                .stage = SHADER_STAGE_VERT_BIT,
+                .type = PUSH_CONSTANT_TYPE_DEFAULT,
+                .size = sizeof(DefaultPushConstant),
+            },
+            .def = pc,
+        },
+        .first_index = 0,
+        .index_count = USE_HANDLE(static_mesh->mesh, VD_R_GPUMesh)->num_indices,
+    };
+}
+
+static void set_cpu_drawn(VD_Renderer *renderer, u64 entity, u32 window, RenderObject *ro)
+{
+    u64 index;
+    if (!vd_intmap_tryget(&renderer->cpu_drawn_index, entity, &index)) {
+        index = array_len(renderer->cpu_drawn);
+        array_add(renderer->cpu_drawn, (CPUDrawnStaticMesh) {0});
+        vd_intmap_set(&renderer->cpu_drawn_index, entity, index);
+    }
+
+    renderer->cpu_drawn[index] = (CPUDrawnStaticMesh) {
+        .entity = entity,
+        .window = window,
+        .ro = *ro,
+    };
+}
+
+static void remove_cpu_drawn(VD_Renderer *renderer, u64 entity)
+{
+    u64 index;
+    if (!vd_intmap_tryget(&renderer->cpu_drawn_index, entity, &index)) {
+        return;
+    }
+
+    vd_intmap_del(&renderer->cpu_drawn_index, entity);
+    array_delswap(renderer->cpu_drawn, index);
+    if (index < array_len(renderer->cpu_drawn)) {
+        vd_intmap_set(&renderer->cpu_drawn_index, renderer->cpu_drawn[index].entity, index);
+    }
+}
+
+/**
+ * Instances and CPU drawn meshes keep what they read from their material, blueprint, mesh and
+ * window, which can change without a write to their table. Once per frame, check whether any of
+ * them did, and if so gather every table again.
+ */
+static void begin_gather(VD_Renderer *renderer, ecs_world_t *world)
+{
+    i64 frame = ecs_get_world_info(world)->frame_count_total;
+    if (frame == renderer->gather_frame) {
+        return;
+    }
+
+    u64 generation =
+        (u64)renderer->smat.generation +
+        (u64)renderer->geos.generation +
+        (u64)renderer->window_generation;
+
+    renderer->gather_frame = frame;
+    renderer->regather = generation != renderer->gathered_generation;
+    renderer->gathered_generation = generation;
+}
+
+/**
+ * In GPU driven mode, static meshes are instances that are only updated when their table changed.
+ * Meshes whose blueprint has no indirect pipeline, or that don't fit in a batch, are kept in the
+ * CPU drawn list instead, and pushed to their window's render list every frame.
+ */
+static void gather_static_meshes_gpu_driven(
+    VD_Renderer *renderer,
+    ecs_iter_t *it,
+    StaticMeshComponent *static_mesh_components,
+    WorldTransformComponent *world_transforms,
+    WindowSurfaceComponent *ws)
+{
+    begin_gather(renderer, it->world);
+
+    // Always asked, so that the query keeps track of which tables it saw
+    int changed = ecs_iter_changed(it);
+    if (!changed && !renderer->regather) {
+        return;
+    }
+
+    for (int i = 0; i < it->count; ++i) {
+        GPUMaterial *material = USE_HANDLE(static_mesh_components[i].material, GPUMaterial);
+        GPUMaterialBlueprint *blueprint = USE_HANDLE(material->blueprint, GPUMaterialBlueprint);
+
+        if (blueprint->indirect_pipeline != VK_NULL_HANDLE) {
+            int result = sscene_set_instance(
+                &renderer->scene,
+                it->entities[i],
+                world_transforms[i].world,
+                & (SSceneInstanceInfo)
+                {
+                    .blueprint = material->blueprint,
+                    .mesh = static_mesh_components[i].mesh,
+                    .material_index = material->bindless_index,
+                    .window = ws->index,
+                });
+
+            if (result == 0) {
+                remove_cpu_drawn(renderer, it->entities[i]);
+                continue;
+            }
+        } else {
+            sscene_remove_instance(&renderer->scene, it->entities[i]);
+        }
+
+        RenderObject ro = static_mesh_render_object(&static_mesh_components[i], &world_transforms[i]);
+        set_cpu_drawn(renderer, it->entities[i], ws->index, &ro);
+    }
+}
+
 void RendererGatherStaticMeshComponentSystem(ecs_iter_t *it)
 {
     const Application *app = ecs_singleton_get(it->world, Application);
@@ -2346,31 +2958,32 @@ void RendererGatherStaticMeshComponentSystem(ecs_iter_t *it)
     WorldTransformComponent *world_transforms = ecs_field(it, WorldTransformComponent, 1);
     WindowSurfaceComponent *ws = ecs_field(it, WindowSurfaceComponent, 2);
 
+    if (renderer->use_gpu_driven) {
+        gather_static_meshes_gpu_driven(renderer, it, static_mesh_components, world_transforms, ws);
+        return;
+    }
+
     for (int i = 0; i < it->count; ++i) {
+        RenderObject ro = static_mesh_render_object(&static_mesh_components[i], &world_transforms[i]);
+        vd_renderer_push_render_object(renderer, ws, &ro);
+    }
+}
 
-        DefaultPushConstant pc;
-        pc.vertex_address = USE_HANDLE(
-            static_mesh_components[i].mesh,
-            VD_R_GPUMesh)->vertex_buffer_address;
-
-        glm_mat4_copy(world_transforms[i].world, pc.obj);
-
-        RenderObject ro = {
-            .mesh = static_mesh_components[i].mesh,
-            .material = static_mesh_components[i].material,
-            .push_constant = {
-                .info = {
-                    .stage = SHADER_STAGE_VERT_BIT,
-                    .type = PUSH_CONSTANT_TYPE_DEFAULT,
-                    .size = sizeof(DefaultPushConstant),
-                },
-                .def = pc,
-            },
-            .first_index = 0,
-            .index_count = USE_HANDLE(static_mesh_components[i].mesh, VD_R_GPUMesh)->num_indices,
-        };
+void RendererOnStaticMeshRemove(ecs_iter_t *it)
+{
+    const Application *app = ecs_singleton_get(it->world, Application);
+    if (app == 0) {
+        return;
+    }
 
-        vd_renderer_push_render_object(renderer, ws, &ro);
+    VD_Renderer *renderer = vd_instance_get_renderer(app->instance);
+    if (!renderer->use_gpu_driven) {
+        return;
+    }
+
+    for (int i = 0; i < it->count; ++i) {
+        sscene_remove_instance(&renderer->scene, it->entities[i]);
+        remove_cpu_drawn(renderer, it->entities[i]);
     }
 }
 
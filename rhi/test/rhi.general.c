@@ -1,4 +1,3 @@
-#define VD_LOG_IMPLEMENTATION
 #define VD_ABBREVIATIONS 1
 #include "vd_log.h"
 #include "utest.h"
@@ -0,0 +1,58 @@
+// bench.h
+//
+// Helpers for the benchmarks. Benchmarks are plain utest cases that get built into vdbenchrunner,
+// and report their own throughput to stdout.
+#ifndef VD_BENCH_H
+#define VD_BENCH_H
+#include "utest.h"
+#include "vd_common.h"
+
+#include <stdio.h>
+
+/** Write results here so that the compiler cannot throw away the benchmarked work. */
+static volatile u64 vd_bench_sink;
+
+static inline i64 vd_bench_now(void)
+{
+    return (i64)utest_ns();
+}
+
+/**
+ * @brief Print the throughput of a benchmark.
+ * @param name The name of the measurement.
+ * @param ops The number of operations performed.
+ * @param ns The time it took, in nanoseconds.
+ */
+static inline void vd_bench_report(const char *name, u64 ops, i64 ns)
+{
+    double seconds = (double)ns / 1e9;
+    printf("    %-48s %14.0f ops/sec %10.2f ns/op\n",
+        name,
+        (double)ops / seconds,
+        (double)ns / (double)ops);
+}
+
+/**
+ * @brief Print the throughput of a benchmark that processes a stream of bytes.
+ * @param name The name of the measurement.
+ * @param bytes The number of bytes processed.
+ * @param ns The time it took, in nanoseconds.
+ */
+static inline void vd_bench_report_bytes(const char *name, u64 bytes, i64 ns)
+{
+    double seconds = (double)ns / 1e9;
+    printf("    %-48s %14.1f MB/s\n",
+        name,
+        (double)bytes / (1024.0 * 1024.0) / seconds);
+}
+
+/** splitmix64, used to generate benchmark keys. */
+static inline u64 vd_bench_rand(u64 *state)
+{
+    u64 z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+#endif // !VD_BENCH_H
@@ -0,0 +1,2 @@
+#include "utest.h"
+UTEST_MAIN()
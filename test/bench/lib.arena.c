@@ -0,0 +1,147 @@
+#define VD_ABBREVIATIONS 1
+#include "bench.h"
+#include "arena.h"
+#include "vd_sysutil.h"
+
+#define FRAME_COUNT      200
+#define SPIKE_EVERY      50
+#define SMALL_FRAME_SIZE (2 * 1024 * 1024)
+#define SPIKE_FRAME_SIZE (256 * 1024 * 1024)
+
+/**
+ * Simulates a frame arena: most frames allocate a few MB, and every SPIKE_EVERY frames one
+ * allocates a few hundred MB.
+ */
+static void bench_frames(const char *name, Arena *a)
+{
+    u64 seed = 0xA11CE;
+    u64 allocations = 0;
+    u64 sum = 0;
+
+    i64 start = vd_bench_now();
+    for (int frame = 0; frame < FRAME_COUNT; ++frame) {
+        u64 budget = (frame % SPIKE_EVERY) == SPIKE_EVERY - 1 ? SPIKE_FRAME_SIZE : SMALL_FRAME_SIZE;
+        u64 used = 0;
+        while (used < budget) {
+            u64 size = 16 + (vd_bench_rand(&seed) & 1023);
+            u8 *p = arena_alloc(a, size);
+            if (!p) {
+                break;
+            }
+
+            sum += p[0];
+            used += size;
+            allocations++;
+        }
+
+        arena_reset(a);
+    }
+    vd_bench_report(name, allocations, vd_bench_now() - start);
+
+    u64 used, total;
+    vd_arena_get_stats(a, &used, &total);
+    printf("    %-48s %14llu bytes committed after reset, %llu peak\n",
+        "",
+        (unsigned long long)total,
+        (unsigned long long)vd_arena_get_high_water(a));
+
+    vd_bench_sink = sum;
+}
+
+UTEST(arena, frame_fixed_malloc)
+{
+    Arena a = arena_new(SPIKE_FRAME_SIZE + VD_MEGABYTES(1), vd_memory_get_system_allocator());
+    bench_frames("arena alloc, fixed malloc block", &a);
+    arena_free(&a);
+}
+
+UTEST(arena, frame_chained_malloc)
+{
+    Arena a = arena_new_chained(VD_MEGABYTES(4), vd_memory_get_system_allocator());
+    bench_frames("arena alloc, chained malloc blocks", &a);
+    arena_free(&a);
+}
+
+UTEST(arena, frame_virtual)
+{
+    Arena a = arena_new_virtual(1024ull * 1024 * 1024, VD_MEGABYTES(4));
+    bench_frames("arena alloc, virtual reserve/commit", &a);
+    arena_free(&a);
+}
+
+#define THREAD_ALLOCATIONS 2000000
+#define MAX_THREADS        8
+
+typedef struct {
+    Arena   *arena;
+    int     shared;
+    u64     sum;
+} FrameWorker;
+
+static int frame_worker_proc(void *arg)
+{
+    FrameWorker *worker = (FrameWorker*)arg;
+    u64 sum = 0;
+    for (int i = 0; i < THREAD_ALLOCATIONS; ++i) {
+        u64 *p = worker->shared
+            ? (u64*)arena_alloc_t(worker->arena, 32)
+            : (u64*)arena_alloc(worker->arena, 32);
+        *p = (u64)i;
+        sum += *p;
+    }
+
+    worker->sum = sum;
+    return 0;
+}
+
+/**
+ * Every thread allocates THREAD_ALLOCATIONS times, either from one arena through vd_arena_alloc_t, or
+ * from an arena of its own, the way VD_MM hands out a frame arena per thread.
+ */
+static void bench_threads(int thread_count, int shared)
+{
+    char name[64];
+    Arena arenas[MAX_THREADS];
+    FrameWorker workers[MAX_THREADS];
+    VD_SysUtilThread threads[MAX_THREADS];
+
+    for (int i = 0; i < thread_count; ++i) {
+        arenas[i] = arena_new_chained(VD_MEGABYTES(4), vd_memory_get_system_allocator());
+        workers[i].arena = shared ? &arenas[0] : &arenas[i];
+        workers[i].shared = shared;
+    }
+
+    i64 start = vd_bench_now();
+    for (int i = 0; i < thread_count; ++i) {
+        vd_sysutil_thread_create(&threads[i], frame_worker_proc, &workers[i]);
+    }
+
+    for (int i = 0; i < thread_count; ++i) {
+        vd_sysutil_thread_join(&threads[i]);
+    }
+    i64 elapsed = vd_bench_now() - start;
+
+    snprintf(name, sizeof(name), "frame alloc, %s (%d threads)",
+        shared ? "shared arena" : "arena per thread",
+        thread_count);
+    vd_bench_report(name, (u64)THREAD_ALLOCATIONS * thread_count, elapsed);
+
+    for (int i = 0; i < thread_count; ++i) {
+        vd_bench_sink += workers[i].sum;
+        arena_free(&arenas[i]);
+    }
+}
+
+UTEST(arena, threads_shared)
+{
+    for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+        bench_threads(threads, 1);
+    }
+}
+
+UTEST(arena, threads_per_thread)
+{
+    for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+        bench_threads(threads, 0);
+    }
+}
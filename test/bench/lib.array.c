@@ -0,0 +1,63 @@
+#define VD_ABBREVIATIONS 1
+#include "bench.h"
+#include "array.h"
+#include "arena.h"
+
+#define FRAME_COUNT   2000
+#define FRAME_ITEMS   4096
+
+typedef struct {
+    float    transform[16];
+    u64      material;
+    u32      mesh;
+    u32      flags;
+} Item;
+
+static Item Source[FRAME_ITEMS];
+
+/**
+ * Simulates a per-frame list like the renderer's render_list: a few thousand items are pushed
+ * into a frame arena every frame, and the arena is reset after.
+ */
+static void bench_frames(const char *name, int bulk, int reserve)
+{
+    Arena a = arena_new_chained(VD_MEGABYTES(1), vd_memory_get_system_allocator());
+    VD_Allocator alc = { .proc_alloc = vd_arena_proc_alloc, .c = &a };
+    u64 sum = 0;
+
+    i64 start = vd_bench_now();
+    for (int frame = 0; frame < FRAME_COUNT; ++frame) {
+        Item *items = 0;
+        array_init(items, &alc);
+        if (reserve) {
+            array_reserve(items, FRAME_ITEMS);
+        }
+
+        if (bulk) {
+            array_append_n(items, Source, FRAME_ITEMS);
+        } else {
+            for (int i = 0; i < FRAME_ITEMS; ++i) {
+                array_add(items, Source[i]);
+            }
+        }
+
+        sum += items[frame % FRAME_ITEMS].mesh;
+        arena_reset(&a);
+    }
+    vd_bench_report_bytes(name, (u64)FRAME_COUNT * FRAME_ITEMS * sizeof(Item), vd_bench_now() - start);
+
+    printf("    %-48s %14llu bytes peak\n", "", (unsigned long long)vd_arena_get_high_water(&a));
+    vd_bench_sink = sum;
+    arena_free(&a);
+}
+
+UTEST(array, frame_list)
+{
+    for (int i = 0; i < FRAME_ITEMS; ++i) {
+        Source[i].mesh = (u32)i;
+    }
+
+    bench_frames("array_add one by one", 0, 0);
+    bench_frames("array_reserve + array_add", 0, 1);
+    bench_frames("array_append_n", 1, 0);
+}
@@ -0,0 +1,61 @@
+#define VD_BUDDY_ALLOC_IMPLEMENTATION
+#include "vd_buddy_alloc.h"
+#include "bench.h"
+
+#include <stdlib.h>
+
+/**
+ * Keeps live_count allocations of 16 to 1024 bytes alive, and replaces a random one op_count times,
+ * the way entities come and go. Reports throughput, and how much of the heap is in use at the end.
+ */
+static void bench_churn(u64 live_count, u64 op_count)
+{
+    char name[64];
+    VD_BuddyAlloc allocator;
+    vd_buddy_alloc_init(&allocator, vd_buddy_alloc_default_palloc, 0, VD_MEGABYTES(4), 8);
+
+    void **live = (void**)malloc(sizeof(void*) * live_count);
+    u64 seed = 0xB0DD1;
+
+    i64 start = vd_bench_now();
+    for (u64 i = 0; i < live_count; ++i) {
+        live[i] = vd_buddy_alloc_realloc(&allocator, 0, 16 + (vd_bench_rand(&seed) & 1007));
+    }
+    snprintf(name, sizeof(name), "buddy alloc (%llu live)", (unsigned long long)live_count);
+    vd_bench_report(name, live_count, vd_bench_now() - start);
+
+    start = vd_bench_now();
+    for (u64 i = 0; i < op_count; ++i) {
+        u64 r = vd_bench_rand(&seed);
+        u64 index = r % live_count;
+        vd_buddy_alloc_realloc(&allocator, live[index], 0);
+        live[index] = vd_buddy_alloc_realloc(&allocator, 0, 16 + ((r >> 32) & 1007));
+    }
+    snprintf(name, sizeof(name), "buddy free+alloc (%llu live)", (unsigned long long)live_count);
+    vd_bench_report(name, op_count, vd_bench_now() - start);
+
+    size_t used, total, num_blocks, num_free_blocks;
+    vd_buddy_alloc_get_stats(&allocator, &used, &total, &num_blocks, &num_free_blocks);
+    printf("    %-48s %13.1f%% used, %llu blocks, %llu free\n",
+        "",
+        100.0 * (double)used / (double)total,
+        (unsigned long long)num_blocks,
+        (unsigned long long)num_free_blocks);
+
+    for (u64 i = 0; i < live_count; ++i) {
+        vd_buddy_alloc_realloc(&allocator, live[i], 0);
+    }
+
+    vd_buddy_alloc_deinit(&allocator);
+    free(live);
+}
+
+UTEST(buddy_alloc, churn_1k)
+{
+    bench_churn(1000, 1000000);
+}
+
+UTEST(buddy_alloc, churn_100k)
+{
+    bench_churn(100000, 1000000);
+}
@@ -0,0 +1,105 @@
+#include "bench.h"
+#include "fmt.h"
+
+static const char *Asset_Names[] = {
+    "textures/terrain/grass_albedo.png",
+    "shaders/pbr.vert",
+    "meshes/sponza.glb",
+    "fonts/inter.ttf",
+};
+
+/** A mix of the kinds of lines the engine logs. */
+static size_t format_log_line(char *out, size_t n, u64 i)
+{
+    switch (i & 3) {
+        case 0: return vd_fmt_snfmt(
+            out, n,
+            "[Renderer/LOG]: Window %{u64} resized to %{u32}x%{u32}\n",
+            i, (u32)(1280 + (i & 255)), (u32)(720 + (i & 127)));
+
+        case 1: return vd_fmt_snfmt(
+            out, n,
+            "[Flecs/LOG]: %{i32} %{cstr}::%{i32}: %{cstr}\n",
+            (i32)(i & 3) - 1, "src/addons/pipeline/pipeline.c", (i32)(i & 1023), "system is not registered");
+
+        case 2: return vd_fmt_snfmt(
+            out, n,
+            "[MM/DBG]: Frame %{u64} used %{u64} of %{u64} bytes, %{f32} ms\n",
+            i, (u64)(i * 4096) & 0xFFFFFF, (u64)16 * 1024 * 1024, (float)(i & 255) * 0.0625f);
+
+        default: {
+            VD_str name = vd_str_from_cstr(Asset_Names[i & 3]);
+            return vd_fmt_snfmt(
+                out, n,
+                "[Asset/LOG]: Loaded %{stru32} (%{u64} bytes) in %{f64} ms\n",
+                name, (u64)i * 977, (double)(i & 4095) * 0.001);
+        }
+    }
+}
+
+UTEST(fmt, log_line_mix)
+{
+    const u64 count = 2000000;
+    char out[512];
+    u64 sum = 0;
+
+    i64 start = vd_bench_now();
+    for (u64 i = 0; i < count; ++i) {
+        sum += format_log_line(out, sizeof(out), i);
+    }
+    vd_bench_report("fmt log line mix", count, vd_bench_now() - start);
+
+    vd_bench_sink = sum;
+}
+
+UTEST(fmt, integers)
+{
+    const u64 count = 4000000;
+    char out[128];
+    u64 sum = 0;
+    u64 seed = 0x1234;
+
+    i64 start = vd_bench_now();
+    for (u64 i = 0; i < count; ++i) {
+        u64 r = vd_bench_rand(&seed);
+        sum += vd_fmt_snfmt(out, sizeof(out), "%{u64} %{i32} %{u16}", r, (i32)r, (u16)(r >> 16));
+    }
+    vd_bench_report("fmt u64 + i32 + u16", count, vd_bench_now() - start);
+
+    vd_bench_sink = sum;
+}
+
+UTEST(fmt, floats)
+{
+    const u64 count = 4000000;
+    char out[128];
+    u64 sum = 0;
+    u64 seed = 0x1234;
+
+    i64 start = vd_bench_now();
+    for (u64 i = 0; i < count; ++i) {
+        u64 r = vd_bench_rand(&seed);
+        sum += vd_fmt_snfmt(out, sizeof(out), "%{f64} %{f32}", (double)(r & 0xFFFFFF) / 1024.0, (float)(r >> 40) * 0.01f);
+    }
+    vd_bench_report("fmt f64 + f32", count, vd_bench_now() - start);
+
+    vd_bench_sink = sum;
+}
+
+UTEST(fmt, literal_text)
+{
+    const u64 count = 4000000;
+    char out[256];
+    u64 sum = 0;
+
+    i64 start = vd_bench_now();
+    for (u64 i = 0; i < count; ++i) {
+        sum += vd_fmt_snfmt(
+            out, sizeof(out),
+            "[Instance/LOG]: >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>> %{cstr}\n",
+            "Begin Log");
+    }
+    vd_bench_report("fmt 100 byte literal + cstr", count, vd_bench_now() - start);
+
+    vd_bench_sink = sum;
+}
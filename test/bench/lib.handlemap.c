@@ -0,0 +1,81 @@
+#include "bench.h"
+#include "handlemap.h"
+#include "intmap.h"
+
+#define HANDLE_COUNT 1000000
+#define USE_COUNT    10000000
+
+typedef struct {
+    u64 payload[4];
+} BenchObject;
+
+/**
+ * The lookup path handlemaps used before generational handles: a hash lookup from id to slot, then
+ * an index into the slot array.
+ */
+typedef struct {
+    VD_IntMap   idmap;
+    BenchObject *arr;
+} LegacyHandleMap;
+
+static BenchObject *legacy_use(LegacyHandleMap *map, u64 id)
+{
+    u64 slot;
+    if (!vd_intmap_tryget(&map->idmap, id, &slot)) {
+        return 0;
+    }
+
+    return &map->arr[slot];
+}
+
+UTEST(handlemap, use_1m_handles)
+{
+    u64 seed = 0xBEEF;
+    u32 *order = (u32*)malloc(sizeof(u32) * USE_COUNT);
+    for (u64 i = 0; i < USE_COUNT; ++i) {
+        order[i] = (u32)(vd_bench_rand(&seed) % HANDLE_COUNT);
+    }
+
+    LegacyHandleMap legacy;
+    legacy.arr = (BenchObject*)calloc(HANDLE_COUNT, sizeof(BenchObject));
+    vd_intmap_init(&legacy.idmap, vd_memory_get_system_allocator(), HANDLE_COUNT, 0);
+    for (u64 i = 0; i < HANDLE_COUNT; ++i) {
+        legacy.arr[i].payload[0] = i;
+        vd_intmap_set(&legacy.idmap, i + 1, i);
+    }
+
+    VD_HANDLEMAP BenchObject *map;
+    VD_HANDLEMAP_INIT(map, {
+        .allocator = vd_memory_get_system_allocator(),
+        .initial_capacity = HANDLE_COUNT,
+    });
+
+    VD_Handle *handles = (VD_Handle*)malloc(sizeof(VD_Handle) * HANDLE_COUNT);
+    for (u64 i = 0; i < HANDLE_COUNT; ++i) {
+        BenchObject object = { .payload = { i } };
+        handles[i] = VD_HANDLEMAP_REGISTER(map, &object, {
+            .ref_mode = VD_HANDLEMAP_REF_MODE_COUNT,
+        });
+    }
+
+    u64 sum = 0;
+    i64 start = vd_bench_now();
+    for (u64 i = 0; i < USE_COUNT; ++i) {
+        sum += legacy_use(&legacy, order[i] + 1)->payload[0];
+    }
+    vd_bench_report("handle use, id hash lookup (1M handles)", USE_COUNT, vd_bench_now() - start);
+
+    start = vd_bench_now();
+    for (u64 i = 0; i < USE_COUNT; ++i) {
+        sum += USE_HANDLE(handles[order[i]], BenchObject)->payload[0];
+    }
+    vd_bench_report("handle use, generational slot (1M handles)", USE_COUNT, vd_bench_now() - start);
+
+    vd_bench_sink = sum;
+
+    VD_HANDLEMAP_DEINIT(map);
+    vd_intmap_deinit(&legacy.idmap);
+    free(legacy.arr);
+    free(handles);
+    free(order);
+}
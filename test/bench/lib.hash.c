@@ -0,0 +1,152 @@
+#include "bench.h"
+#include "hash.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/** The vd_hash that hash.h used to have (MurmurHash2 with 4 byte steps), to compare against. */
+static u64 murmur2_hash(const void *data, u64 len, u32 seed)
+{
+    const u64 m = 0x5bd1e995;
+    const u64 r = 24;
+
+    u64 h = seed ^ len;
+    const u8 *bytes = (const u8*)data;
+
+    while (len >= 4) {
+        u32 k;
+        memcpy(&k, bytes, sizeof(k));
+
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+
+        h *= m;
+        h ^= k;
+
+        bytes += 4;
+        len -= 4;
+    }
+
+    switch (len) {
+        case 3: h ^= bytes[2] << 16; /* fallthrough */
+        case 2: h ^= bytes[1] << 8;  /* fallthrough */
+        case 1: h ^= bytes[0];
+                h *= m;
+    }
+
+    h ^= h >> 13;
+    h *= m;
+    h ^= h >> 15;
+
+    return h;
+}
+
+/** The finalizer intmap used to hash its keys with. */
+static u64 fmix64(u64 k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ull;
+    k ^= k >> 33;
+    return k;
+}
+
+static void bench_hash_size(u64 size, u64 total)
+{
+    char name[64];
+    u8 *data = (u8*)malloc(size + 64);
+    u64 seed = 0x4A54;
+    for (u64 i = 0; i < size + 64; ++i) {
+        data[i] = (u8)vd_bench_rand(&seed);
+    }
+
+    u64 count = total / size;
+    u64 sum = 0;
+
+    // Vary the start a little so that every key differs
+    i64 start = vd_bench_now();
+    for (u64 i = 0; i < count; ++i) {
+        sum += vd_hash(data + (i & 63), size, VD_HASH_DEFAULT_SEED);
+    }
+    snprintf(name, sizeof(name), "vd_hash %llu bytes", (unsigned long long)size);
+    vd_bench_report_bytes(name, count * size, vd_bench_now() - start);
+
+    start = vd_bench_now();
+    for (u64 i = 0; i < count; ++i) {
+        sum += murmur2_hash(data + (i & 63), size, VD_HASH_DEFAULT_SEED);
+    }
+    snprintf(name, sizeof(name), "murmur2 (old vd_hash) %llu bytes", (unsigned long long)size);
+    vd_bench_report_bytes(name, count * size, vd_bench_now() - start);
+
+    vd_bench_sink = sum;
+    free(data);
+}
+
+UTEST(hash, short_keys)
+{
+    bench_hash_size(8, 256ull << 20);
+    bench_hash_size(16, 256ull << 20);
+    bench_hash_size(32, 512ull << 20);
+    bench_hash_size(64, 512ull << 20);
+}
+
+UTEST(hash, long_keys)
+{
+    bench_hash_size(256, 1ull << 30);
+    bench_hash_size(4096, 2ull << 30);
+    bench_hash_size(1 << 20, 2ull << 30);
+}
+
+UTEST(hash, streaming)
+{
+    const u64 size = 64 << 20;
+    const u64 chunk = 64 * 1024 + 7;
+    u8 *data = (u8*)malloc(size);
+    u64 seed = 0x57AE;
+    for (u64 i = 0; i < size; ++i) {
+        data[i] = (u8)vd_bench_rand(&seed);
+    }
+
+    i64 start = vd_bench_now();
+    VD_HashState state;
+    vd_hash_begin(&state, 0);
+    for (u64 at = 0; at < size; at += chunk) {
+        vd_hash_update(&state, data + at, at + chunk > size ? size - at : chunk);
+    }
+    vd_bench_sink = vd_hash_end(&state);
+    vd_bench_report_bytes("vd_hash streaming (64MB in 64KB + 7 pieces)", size, vd_bench_now() - start);
+
+    start = vd_bench_now();
+    vd_bench_sink = vd_hash(data, size, 0);
+    vd_bench_report_bytes("vd_hash one shot (64MB)", size, vd_bench_now() - start);
+
+    free(data);
+}
+
+UTEST(hash, u64_keys)
+{
+    const u64 count = 200000000;
+    u64 sum = 0;
+
+    i64 start = vd_bench_now();
+    for (u64 i = 0; i < count; ++i) {
+        sum += vd_hash_u64(i, 0);
+    }
+    vd_bench_report("vd_hash_u64", count, vd_bench_now() - start);
+
+    start = vd_bench_now();
+    for (u64 i = 0; i < count; ++i) {
+        sum += fmix64(i);
+    }
+    vd_bench_report("fmix64 (old intmap hash)", count, vd_bench_now() - start);
+
+    start = vd_bench_now();
+    for (u64 i = 0; i < count; ++i) {
+        sum += murmur2_hash(&i, 8, VD_HASH_DEFAULT_SEED);
+    }
+    vd_bench_report("murmur2 (old vd_hash) of a u64", count, vd_bench_now() - start);
+
+    vd_bench_sink = sum;
+}
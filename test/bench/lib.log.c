@@ -0,0 +1,155 @@
+#include "bench.h"
+#include "vd_log.h"
+#include "vd_sysutil.h"
+#include <stdio.h>
+
+#define BENCH_LOG_PATH "vd_bench_log.txt"
+
+static void log_lines(u64 count)
+{
+    for (u64 i = 0; i < count; ++i) {
+        VD_LOG_FMT("Bench", "Window resized to %{u32}x%{u32} on frame %{u64}", 1280u, 720u, i);
+    }
+}
+
+UTEST(log, fopen_per_line)
+{
+    const u64 count = 20000;
+    remove(BENCH_LOG_PATH);
+
+    VD_Log log = { .filepath = BENCH_LOG_PATH, .flags = VD_LOG_WRITE_FILE };
+
+    VD_Log *prev = VD_LOG_GET();
+    VD_LOG_SET(&log);
+
+    i64 start = vd_bench_now();
+    log_lines(count);
+    vd_bench_report("log, fopen/fclose per line", count, vd_bench_now() - start);
+
+    VD_LOG_SET(prev);
+    remove(BENCH_LOG_PATH);
+}
+
+UTEST(log, sync_fd)
+{
+    const u64 count = 200000;
+    remove(BENCH_LOG_PATH);
+
+    VD_Log log = { .filepath = BENCH_LOG_PATH, .flags = VD_LOG_WRITE_FILE };
+    vd_log_init(&log);
+
+    VD_Log *prev = VD_LOG_GET();
+    VD_LOG_SET(&log);
+
+    i64 start = vd_bench_now();
+    log_lines(count);
+    vd_bench_report("log, write per line (vd_log_init)", count, vd_bench_now() - start);
+
+    vd_log_deinit(&log);
+    VD_LOG_SET(prev);
+    remove(BENCH_LOG_PATH);
+}
+
+UTEST(log, async)
+{
+    const u64 count = 1000000;
+    remove(BENCH_LOG_PATH);
+
+    // Big enough that the burst never drops, so this measures the cost of each line
+    VD_Log log = {
+        .filepath = BENCH_LOG_PATH,
+        .flags = VD_LOG_WRITE_FILE | VD_LOG_MT,
+        .ring_size = 128 * 1024 * 1024,
+        .ring_count = 2,
+    };
+    vd_log_init(&log);
+
+    VD_Log *prev = VD_LOG_GET();
+    VD_LOG_SET(&log);
+
+    i64 start = vd_bench_now();
+    log_lines(count);
+    vd_bench_report("log, async (enqueue)", count, vd_bench_now() - start);
+
+    vd_log_flush(&log);
+    vd_bench_report("log, async (enqueue + flush)", count, vd_bench_now() - start);
+    printf("    dropped %llu of %llu lines\n", (unsigned long long)vd_log_get_dropped(&log), (unsigned long long)count);
+
+    vd_log_deinit(&log);
+    VD_LOG_SET(prev);
+    remove(BENCH_LOG_PATH);
+}
+
+UTEST(log, binary)
+{
+    const u64 count = 1000000;
+    remove(BENCH_LOG_PATH);
+
+    VD_Log log = {
+        .filepath = BENCH_LOG_PATH,
+        .flags = VD_LOG_WRITE_FILE | VD_LOG_BINARY,
+        .ring_size = 128 * 1024 * 1024,
+        .ring_count = 2,
+    };
+    vd_log_init(&log);
+
+    VD_Log *prev = VD_LOG_GET();
+    VD_LOG_SET(&log);
+
+    i64 start = vd_bench_now();
+    log_lines(count);
+    vd_bench_report("log, binary (enqueue)", count, vd_bench_now() - start);
+
+    vd_log_flush(&log);
+    vd_bench_report("log, binary (enqueue + flush)", count, vd_bench_now() - start);
+    printf("    dropped %llu of %llu lines\n", (unsigned long long)vd_log_get_dropped(&log), (unsigned long long)count);
+
+    vd_log_deinit(&log);
+    VD_LOG_SET(prev);
+    remove(BENCH_LOG_PATH);
+}
+
+typedef struct {
+    u64     count;
+} LogThread;
+
+static int log_thread_proc(void *arg)
+{
+    LogThread *thread = (LogThread*)arg;
+    log_lines(thread->count);
+    return 0;
+}
+
+UTEST(log, async_threads)
+{
+    const u64 count_per_thread = 250000;
+    const int thread_count = 4;
+    remove(BENCH_LOG_PATH);
+
+    // Default rings, so a burst this size drops lines
+    VD_Log log = { .filepath = BENCH_LOG_PATH, .flags = VD_LOG_WRITE_FILE | VD_LOG_MT };
+    vd_log_init(&log);
+
+    VD_SysUtilThread threads[4];
+    LogThread thread_info = { count_per_thread };
+
+    VD_Log *prev = VD_LOG_GET();
+    VD_LOG_SET(&log);
+
+    i64 start = vd_bench_now();
+    for (int i = 0; i < thread_count; ++i) {
+        vd_sysutil_thread_create(&threads[i], log_thread_proc, &thread_info);
+    }
+
+    for (int i = 0; i < thread_count; ++i) {
+        vd_sysutil_thread_join(&threads[i]);
+    }
+
+    vd_log_flush(&log);
+    vd_bench_report("log, async 4 threads (enqueue + flush)", count_per_thread * thread_count, vd_bench_now() - start);
+    printf("    dropped %llu of %llu lines\n", (unsigned long long)vd_log_get_dropped(&log), (unsigned long long)(count_per_thread * thread_count));
+
+    vd_log_deinit(&log);
+    VD_LOG_SET(prev);
+    remove(BENCH_LOG_PATH);
+}
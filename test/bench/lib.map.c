@@ -0,0 +1,180 @@
+#include "bench.h"
+#include "intmap.h"
+#include "strmap.h"
+#include "intern.h"
+
+static void bench_intmap_lookups(u64 key_count, u64 lookup_count)
+{
+    char name[64];
+    u64 *keys = (u64*)malloc(sizeof(u64) * key_count);
+    u64 seed = 0xC0FFEE;
+    for (u64 i = 0; i < key_count; ++i) {
+        keys[i] = vd_bench_rand(&seed);
+    }
+
+    VD_IntMap map;
+    vd_intmap_init(&map, vd_memory_get_system_allocator(), 16, 0);
+
+    i64 start = vd_bench_now();
+    for (u64 i = 0; i < key_count; ++i) {
+        vd_intmap_set(&map, keys[i], i);
+    }
+    snprintf(name, sizeof(name), "intmap insert (%llu keys)", (unsigned long long)key_count);
+    vd_bench_report(name, key_count, vd_bench_now() - start);
+
+    u64 sum = 0;
+    u64 index = 0x1234;
+    start = vd_bench_now();
+    for (u64 i = 0; i < lookup_count; ++i) {
+        u64 v;
+        index = index * 6364136223846793005ull + 1442695040888963407ull;
+        vd_intmap_tryget(&map, keys[(index >> 11) % key_count], &v);
+        sum += v;
+    }
+    snprintf(name, sizeof(name), "intmap lookup hit (%llu keys)", (unsigned long long)key_count);
+    vd_bench_report(name, lookup_count, vd_bench_now() - start);
+
+    start = vd_bench_now();
+    for (u64 i = 0; i < lookup_count; ++i) {
+        u64 v;
+        sum += vd_intmap_tryget(&map, vd_bench_rand(&seed), &v);
+    }
+    snprintf(name, sizeof(name), "intmap lookup miss (%llu keys)", (unsigned long long)key_count);
+    vd_bench_report(name, lookup_count, vd_bench_now() - start);
+
+    vd_bench_sink = sum;
+    vd_intmap_deinit(&map);
+    free(keys);
+}
+
+UTEST(intmap, lookups_1k)
+{
+    bench_intmap_lookups(1000, 10000000);
+}
+
+UTEST(intmap, lookups_100k)
+{
+    bench_intmap_lookups(100000, 10000000);
+}
+
+UTEST(intmap, lookups_10m)
+{
+    bench_intmap_lookups(10000000, 10000000);
+}
+
+/**
+ * Keys of 4 to 100 bytes, so that both short keys and keys longer than a cache line are measured.
+ */
+static VD_str *make_string_keys(u64 count, char **storage)
+{
+    VD_str *keys = (VD_str*)malloc(sizeof(VD_str) * count);
+    char *buf = (char*)malloc(count * 128);
+    u64 seed = 0x57121;
+
+    for (u64 i = 0; i < count; ++i) {
+        char *key = buf + i * 128;
+        u32 len = (u32)snprintf(key, 128, "%llx/", (unsigned long long)i);
+        u32 pad = (u32)(vd_bench_rand(&seed) % 96);
+        for (u32 j = 0; j < pad; ++j) {
+            key[len++] = 'a' + (char)(j % 26);
+        }
+
+        keys[i] = (VD_str) { .data = key, .len = len };
+    }
+
+    *storage = buf;
+    return keys;
+}
+
+UTEST(strmap, lookups_1m)
+{
+    const u64 key_count = 1000000;
+    const u64 lookup_count = 10000000;
+
+    char *storage;
+    VD_str *keys = make_string_keys(key_count, &storage);
+
+    u64 *map = 0;
+    VD_STRMAP_INIT(map, vd_memory_get_system_allocator());
+
+    i64 start = vd_bench_now();
+    for (u64 i = 0; i < key_count; ++i) {
+        VD_STRMAP_SET(map, keys[i], &i);
+    }
+    vd_bench_report("strmap insert (1M mixed length keys)", key_count, vd_bench_now() - start);
+
+    u64 sum = 0;
+    u64 seed = 0x1234;
+    start = vd_bench_now();
+    for (u64 i = 0; i < lookup_count; ++i) {
+        u64 v = 0;
+        VD_STRMAP_GET(map, keys[vd_bench_rand(&seed) % key_count], &v);
+        sum += v;
+    }
+    vd_bench_report("strmap lookup hit (1M mixed length keys)", lookup_count, vd_bench_now() - start);
+
+    // Same lengths, but the first character can never match
+    start = vd_bench_now();
+    for (u64 i = 0; i < lookup_count; ++i) {
+        u64 v = 0;
+        VD_str key = keys[vd_bench_rand(&seed) % key_count];
+        char miss[128];
+        memcpy(miss, key.data, key.len);
+        miss[0] = 'z';
+        sum += VD_STRMAP_GET(map, ((VD_str) { .data = miss, .len = key.len }), &v);
+    }
+    vd_bench_report("strmap lookup miss (1M mixed length keys)", lookup_count, vd_bench_now() - start);
+
+    vd_bench_sink = sum;
+    VD_STRMAP_DEINIT(map);
+    free(keys);
+    free(storage);
+}
+
+UTEST(intern, lookups_1m)
+{
+    const u64 key_count = 1000000;
+    const u64 lookup_count = 10000000;
+
+    char *storage;
+    VD_str *keys = make_string_keys(key_count, &storage);
+    u64 *hashes = (u64*)malloc(sizeof(u64) * key_count);
+    VD_Symbol *symbols = (VD_Symbol*)malloc(sizeof(VD_Symbol) * key_count);
+
+    VD_Interner *interner = vd_interner_create(vd_memory_get_system_allocator());
+
+    i64 start = vd_bench_now();
+    for (u64 i = 0; i < key_count; ++i) {
+        hashes[i] = vd_interner_hash(keys[i]);
+        symbols[i] = vd_interner_intern_hashed(interner, keys[i], hashes[i]);
+    }
+    vd_bench_report("intern insert (1M mixed length keys)", key_count, vd_bench_now() - start);
+
+    u64 sum = 0;
+    u64 seed = 0x1234;
+    start = vd_bench_now();
+    for (u64 i = 0; i < lookup_count; ++i) {
+        sum += vd_interner_find(interner, keys[vd_bench_rand(&seed) % key_count]);
+    }
+    vd_bench_report("intern find (1M mixed length keys)", lookup_count, vd_bench_now() - start);
+
+    start = vd_bench_now();
+    for (u64 i = 0; i < lookup_count; ++i) {
+        u64 k = vd_bench_rand(&seed) % key_count;
+        sum += vd_interner_find_hashed(interner, keys[k], hashes[k]);
+    }
+    vd_bench_report("intern find, precomputed hash (1M mixed length keys)", lookup_count, vd_bench_now() - start);
+
+    start = vd_bench_now();
+    for (u64 i = 0; i < lookup_count; ++i) {
+        sum += vd_interner_get_str(interner, symbols[vd_bench_rand(&seed) % key_count]).len;
+    }
+    vd_bench_report("intern get_str (1M symbols)", lookup_count, vd_bench_now() - start);
+
+    vd_bench_sink = sum;
+    vd_interner_destroy(interner);
+    free(symbols);
+    free(hashes);
+    free(keys);
+    free(storage);
+}
@@ -0,0 +1,450 @@
+#define VD_META_IMPLEMENTATION
+#include "vd_meta.h"
+#include "bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    float x;
+    float y;
+    float z;
+} BenchVec3;
+
+typedef struct {
+    const char  *name;
+    uint32_t    mesh;
+    int32_t     layer;
+    BenchVec3   position;
+    BenchVec3   scale;
+    float       rotation[4];
+} BenchEntity;
+
+typedef struct {
+    const char  *name;
+    BenchEntity *entities;
+} BenchScene;
+
+VD_META_DECL_TYPE(BenchVec3);
+VD_META_DECL_TYPE(BenchEntity);
+VD_META_DECL_TYPE(BenchScene);
+
+/** A bump allocator, so that every parse starts from the same empty memory. */
+typedef struct {
+    char    *base;
+    size_t  used;
+    size_t  cap;
+} BenchBump;
+
+static VD_META_ALLOC_PROC(bench_bump_alloc)
+{
+    BenchBump *bump = (BenchBump*)c;
+    if (newsize == 0) {
+        return 0;
+    }
+
+    size_t at = (bump->used + 15) & ~(size_t)15;
+    if (at + newsize > bump->cap) {
+        return 0;
+    }
+
+    bump->used = at + newsize;
+    void *result = bump->base + at;
+    if (ptr) {
+        memcpy(result, ptr, prevsize < newsize ? prevsize : newsize);
+    }
+
+    return result;
+}
+
+static VD_META_INTRUSIVE_ARRAY_ADD_PROC(bench_array_add)
+{
+    BenchBump *bump = (BenchBump*)c;
+    u32 *header = *array ? (u32*)*array - 2 : 0;
+    u32 len = header ? header[0] : 0;
+    u32 cap = header ? header[1] : 0;
+
+    if (len + 1 > cap) {
+        u32 new_cap = cap ? cap * 2 : 64;
+        u32 *grown = (u32*)bench_bump_alloc(header, cap * size + 8, new_cap * size + 8, bump);
+        grown[1] = new_cap;
+        if (!header) {
+            grown[0] = 0;
+        }
+
+        header = grown;
+        *array = header + 2;
+    }
+
+    if (element) {
+        memcpy((char*)*array + len * size, element, size);
+    }
+
+    header[0]++;
+}
+
+static VD_META_INTRUSIVE_ARRAY_LEN_PROC(bench_array_len)
+{
+    return array ? ((u32*)array - 2)[0] : 0;
+}
+
+static void bench_define_types(VD_Meta_Registry *registry)
+{
+    VD_META_DEFN_TYPE(registry, BenchVec3, {
+        .name = "BenchVec3",
+        .type_class = VD_META_TYPE_OBJECT,
+        .size = sizeof(BenchVec3),
+        .object = {
+            .len = 3,
+            .fields = (VD_Meta_Field[]) {
+                { .name = "x", .offset = offsetof(BenchVec3, x), .type = VD_META_ID(float) },
+                { .name = "y", .offset = offsetof(BenchVec3, y), .type = VD_META_ID(float) },
+                { .name = "z", .offset = offsetof(BenchVec3, z), .type = VD_META_ID(float) },
+            },
+        },
+    });
+
+    VD_META_DEFN_TYPE(registry, BenchEntity, {
+        .name = "BenchEntity",
+        .type_class = VD_META_TYPE_OBJECT,
+        .size = sizeof(BenchEntity),
+        .object = {
+            .len = 6,
+            .fields = (VD_Meta_Field[]) {
+                { .name = "name",     .offset = offsetof(BenchEntity, name),     .type = VD_META_ID(CString) },
+                { .name = "mesh",     .offset = offsetof(BenchEntity, mesh),     .type = VD_META_ID(uint32_t) },
+                { .name = "layer",    .offset = offsetof(BenchEntity, layer),    .type = VD_META_ID(int32_t) },
+                { .name = "position", .offset = offsetof(BenchEntity, position), .type = VD_META_ID(BenchVec3) },
+                { .name = "scale",    .offset = offsetof(BenchEntity, scale),    .type = VD_META_ID(BenchVec3) },
+                {
+                    .name = "rotation",
+                    .offset = offsetof(BenchEntity, rotation),
+                    .type = VD_META_ID(float),
+                    .flags = VD_META_FIELD_FLAG_FIXED_ARRAY,
+                    .fixed_array = { .len = 4 },
+                },
+            },
+        },
+    });
+
+    VD_META_DEFN_TYPE(registry, BenchScene, {
+        .name = "BenchScene",
+        .type_class = VD_META_TYPE_OBJECT,
+        .size = sizeof(BenchScene),
+        .object = {
+            .len = 2,
+            .fields = (VD_Meta_Field[]) {
+                { .name = "name", .offset = offsetof(BenchScene, name), .type = VD_META_ID(CString) },
+                {
+                    .name = "entities",
+                    .offset = offsetof(BenchScene, entities),
+                    .type = VD_META_ID(BenchEntity),
+                    .flags = VD_META_FIELD_FLAG_INTRUSIVE_ARRAY,
+                },
+            },
+        },
+    });
+}
+
+/**
+ * Builds a scene file like the ones the editor saves: pretty printed, with editor-only fields the
+ * runtime types don't know about.
+ */
+static char *bench_make_scene_json(u64 entity_count, size_t *out_len)
+{
+    size_t cap = entity_count * 640 + 1024;
+    char *json = (char*)malloc(cap);
+    size_t len = 0;
+    u64 seed = 0x5CE4E;
+
+    len += snprintf(json + len, cap - len,
+        "{\n    \"--vd-meta-type-name--\": \"BenchScene\",\n    \"name\": \"sponza\",\n    \"entities\": [\n");
+
+    for (u64 i = 0; i < entity_count; ++i) {
+        u64 r = vd_bench_rand(&seed);
+        float px = (float)(r & 0xFFFF) * 0.01f - 300.0f;
+        float py = (float)((r >> 16) & 0xFFFF) * 0.001f;
+        float pz = (float)((r >> 32) & 0xFFFF) * -0.01f;
+
+        len += snprintf(json + len, cap - len,
+            "        {\n"
+            "            \"--vd-meta-type-name--\": \"BenchEntity\",\n"
+            "            \"name\": \"entity_%llu/mesh_%u\",\n"
+            "            \"mesh\": %u,\n"
+            "            \"layer\": %d,\n"
+            "            \"position\": {\"--vd-meta-type-name--\": \"BenchVec3\", \"x\": %f, \"y\": %f, \"z\": %f},\n"
+            "            \"scale\": {\"--vd-meta-type-name--\": \"BenchVec3\", \"x\": 1.000000, \"y\": 1.000000, \"z\": 1.000000},\n"
+            "            \"rotation\": [0.000000, 0.707107, 0.000000, 0.707107],\n"
+            "            \"editor\": {\"selected\": false, \"color\": [1, 0.5, 0], \"note\": \"placed by {tool}, \\\"moved\\\"\"}\n"
+            "        }%s\n",
+            (unsigned long long)i, (unsigned)(r >> 48) & 255,
+            (unsigned)(r >> 48) & 255,
+            (int)((r >> 56) & 7) - 4,
+            px, py, pz,
+            i + 1 < entity_count ? "," : "");
+    }
+
+    len += snprintf(json + len, cap - len, "    ]\n}\n");
+    *out_len = len;
+    return json;
+}
+
+typedef struct {
+    const char  *data;
+    size_t      len;
+    size_t      pos;
+} BenchReader;
+
+static VD_META_READ_PROC(bench_read)
+{
+    BenchReader *reader = (BenchReader*)c;
+    size_t n = reader->len - reader->pos;
+    if (n > cap) {
+        n = cap;
+    }
+
+    memcpy(dst, reader->data + reader->pos, n);
+    reader->pos += n;
+    return n;
+}
+
+static void bench_parse_scene(int streamed)
+{
+    const u64 entity_count = 20000;
+    const int iterations = 5;
+
+    size_t json_len;
+    char *json = bench_make_scene_json(entity_count, &json_len);
+
+    BenchBump bump = { (char*)malloc(64 * 1024 * 1024), 0, 64 * 1024 * 1024 };
+
+    VD_Meta_Registry registry = {0};
+    registry.intrusive_array_props = (VD_Meta_IntrusiveArrayProperties) {
+        bench_array_add,
+        bench_array_len,
+        &bump,
+    };
+    vd_meta_init(&registry);
+    bench_define_types(&registry);
+
+    u64 sum = 0;
+    i64 start = vd_bench_now();
+    for (int i = 0; i < iterations; ++i) {
+        bump.used = 0;
+
+        VD_Meta_ParseOptions options = { .alloc = bench_bump_alloc, .alloc_ctx = &bump };
+        void *out_object = 0;
+        int result;
+        if (streamed) {
+            BenchReader reader = { json, json_len, 0 };
+            result = vd_meta_parse_json_stream(&registry, &options, bench_read, &reader, &out_object);
+        } else {
+            result = vd_meta_parse_json(&registry, &options, json, json_len, &out_object);
+        }
+
+        BenchScene *scene = (BenchScene*)out_object;
+        if (result != 0 || bench_array_len(scene->entities, 0) != entity_count) {
+            printf("    parse failed (%d)\n", result);
+            break;
+        }
+
+        sum += scene->entities[entity_count - 1].mesh;
+    }
+
+    vd_bench_report_bytes(
+        streamed ? "meta parse json (scene, 64KB chunks)" : "meta parse json (scene, whole buffer)",
+        (u64)json_len * iterations,
+        vd_bench_now() - start);
+
+    vd_bench_sink = sum;
+    vd_meta_deinit(&registry);
+    free(bump.base);
+    free(json);
+}
+
+UTEST(meta, parse_json_scene)
+{
+    bench_parse_scene(0);
+}
+
+UTEST(meta, parse_json_scene_streamed)
+{
+    bench_parse_scene(1);
+}
+
+UTEST(meta, binary_scene)
+{
+    const u64 entity_count = 20000;
+    const int iterations = 5;
+
+    size_t json_len;
+    char *json = bench_make_scene_json(entity_count, &json_len);
+
+    BenchBump bump = { (char*)malloc(64 * 1024 * 1024), 0, 64 * 1024 * 1024 };
+
+    VD_Meta_Registry registry = {0};
+    registry.intrusive_array_props = (VD_Meta_IntrusiveArrayProperties) {
+        bench_array_add,
+        bench_array_len,
+        &bump,
+    };
+    vd_meta_init(&registry);
+    bench_define_types(&registry);
+
+    // The scene every format starts from
+    void *scene = 0;
+    VD_Meta_ParseOptions parse_options = { .alloc = bench_bump_alloc, .alloc_ctx = &bump };
+    if (vd_meta_parse_json(&registry, &parse_options, json, json_len, &scene) != 0) {
+        printf("    parse failed\n");
+        return;
+    }
+    size_t scene_used = bump.used;
+
+    char *out_json = 0;
+    size_t out_json_len = 0;
+    i64 start = vd_bench_now();
+    for (int i = 0; i < iterations; ++i) {
+        free(out_json);
+        vd_meta_write_json(&registry, scene, VD_META_ID(BenchScene), &(VD_Meta_WriteOptions) { .pretty = -1 }, &out_json, &out_json_len);
+    }
+    vd_bench_report("meta write json (entities)", iterations * entity_count, vd_bench_now() - start);
+
+    void *compact = 0;
+    size_t compact_len = 0;
+    start = vd_bench_now();
+    for (int i = 0; i < iterations; ++i) {
+        free(compact);
+        vd_meta_write_binary(&registry, scene, VD_META_ID(BenchScene), &(VD_Meta_WriteOptions) {0}, &compact, &compact_len);
+    }
+    vd_bench_report("meta write binary (entities)", iterations * entity_count, vd_bench_now() - start);
+
+    u64 sum = 0;
+    start = vd_bench_now();
+    for (int i = 0; i < iterations; ++i) {
+        bump.used = scene_used;
+        void *out_object = 0;
+        parse_options = (VD_Meta_ParseOptions) { .alloc = bench_bump_alloc, .alloc_ctx = &bump };
+        vd_meta_parse_binary(&registry, &parse_options, compact, compact_len, &out_object);
+        sum += ((BenchScene*)out_object)->entities[entity_count - 1].mesh;
+    }
+    vd_bench_report("meta parse binary (entities)", iterations * entity_count, vd_bench_now() - start);
+
+    start = vd_bench_now();
+    for (int i = 0; i < iterations; ++i) {
+        bump.used = scene_used;
+        void *out_object = 0;
+        parse_options = (VD_Meta_ParseOptions) { .alloc = bench_bump_alloc, .alloc_ctx = &bump };
+        vd_meta_parse_json(&registry, &parse_options, out_json, out_json_len, &out_object);
+        sum += ((BenchScene*)out_object)->entities[entity_count - 1].mesh;
+    }
+    vd_bench_report("meta parse json (entities, minified)", iterations * entity_count, vd_bench_now() - start);
+
+    void *in_place = 0;
+    size_t in_place_len = 0;
+    start = vd_bench_now();
+    for (int i = 0; i < iterations; ++i) {
+        free(in_place);
+        vd_meta_write_binary(
+            &registry,
+            scene,
+            VD_META_ID(BenchScene),
+            &(VD_Meta_WriteOptions) { .binary_flags = VD_META_BINARY_FLAG_IN_PLACE },
+            &in_place,
+            &in_place_len);
+    }
+    vd_bench_report("meta write binary in place (entities)", iterations * entity_count, vd_bench_now() - start);
+
+    // Relocating patches the data, so every iteration works on a fresh copy, which is timed too
+    void *copy = malloc(in_place_len);
+    start = vd_bench_now();
+    for (int i = 0; i < iterations; ++i) {
+        memcpy(copy, in_place, in_place_len);
+        void *out_object = 0;
+        vd_meta_binary_relocate(&registry, copy, in_place_len, VD_META_ID(BenchScene), &out_object);
+        sum += ((BenchScene*)out_object)->entities[entity_count - 1].mesh;
+    }
+    vd_bench_report("meta relocate binary in place (entities)", iterations * entity_count, vd_bench_now() - start);
+
+    start = vd_bench_now();
+    for (int i = 0; i < iterations; ++i) {
+        const void *root = 0;
+        vd_meta_binary_get_root(&registry, in_place, in_place_len, VD_META_ID(BenchScene), &root);
+        const BenchEntity *entities = VD_META_REL_PTR(const BenchEntity, ((const BenchScene*)root)->entities);
+        sum += entities[entity_count - 1].mesh;
+    }
+    vd_bench_report("meta get root binary in place (scene)", iterations, vd_bench_now() - start);
+
+    printf(
+        "    json %zu bytes, binary %zu bytes, in place %zu bytes\n",
+        out_json_len,
+        compact_len,
+        in_place_len);
+
+    vd_bench_sink = sum;
+    free(copy);
+    free(in_place);
+    free(compact);
+    free(out_json);
+    vd_meta_deinit(&registry);
+    free(bump.base);
+    free(json);
+}
+
+UTEST(meta, write_entities_one_by_one)
+{
+    const u64 entity_count = 20000;
+    const int iterations = 5;
+
+    size_t json_len;
+    char *json = bench_make_scene_json(entity_count, &json_len);
+
+    BenchBump bump = { (char*)malloc(64 * 1024 * 1024), 0, 64 * 1024 * 1024 };
+
+    VD_Meta_Registry registry = {0};
+    registry.intrusive_array_props = (VD_Meta_IntrusiveArrayProperties) {
+        bench_array_add,
+        bench_array_len,
+        &bump,
+    };
+    vd_meta_init(&registry);
+    bench_define_types(&registry);
+
+    void *out_object = 0;
+    VD_Meta_ParseOptions parse_options = { .alloc = bench_bump_alloc, .alloc_ctx = &bump };
+    if (vd_meta_parse_json(&registry, &parse_options, json, json_len, &out_object) != 0) {
+        printf("    parse failed\n");
+        return;
+    }
+    BenchScene *scene = (BenchScene*)out_object;
+
+    // Saving entities separately, where the cost of each call matters more than that of each byte
+    u64 sum = 0;
+    i64 start = vd_bench_now();
+    for (int i = 0; i < iterations; ++i) {
+        for (u64 e = 0; e < entity_count; ++e) {
+            char *out_json;
+            size_t out_len;
+            vd_meta_write_json(&registry, &scene->entities[e], VD_META_ID(BenchEntity), &(VD_Meta_WriteOptions) { .pretty = -1 }, &out_json, &out_len);
+            sum += out_len;
+            free(out_json);
+        }
+    }
+    vd_bench_report("meta write json (one entity at a time)", iterations * entity_count, vd_bench_now() - start);
+
+    start = vd_bench_now();
+    for (int i = 0; i < iterations; ++i) {
+        for (u64 e = 0; e < entity_count; ++e) {
+            void *out_data;
+            size_t out_len;
+            vd_meta_write_binary(&registry, &scene->entities[e], VD_META_ID(BenchEntity), &(VD_Meta_WriteOptions) {0}, &out_data, &out_len);
+            sum += out_len;
+            free(out_data);
+        }
+    }
+    vd_bench_report("meta write binary (one entity at a time)", iterations * entity_count, vd_bench_now() - start);
+
+    vd_bench_sink = sum;
+    vd_meta_deinit(&registry);
+    free(bump.base);
+    free(json);
+}
@@ -0,0 +1,73 @@
+#include "bench.h"
+#include "sort.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ITEMS   10000
+#define ROUNDS  500
+
+static VD_SortItem Source[ITEMS];
+static VD_SortItem Items[ITEMS];
+static VD_SortItem Scratch[ITEMS];
+
+static int compare_items(const void *a, const void *b)
+{
+    const VD_SortItem *x = (const VD_SortItem*)a;
+    const VD_SortItem *y = (const VD_SortItem*)b;
+    if (x->key != y->key) {
+        return x->key < y->key ? -1 : 1;
+    }
+
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+static void bench_sorts(const char *radix_name, const char *qsort_name)
+{
+    u64 sum = 0;
+
+    i64 start = vd_bench_now();
+    for (int r = 0; r < ROUNDS; ++r) {
+        memcpy(Items, Source, sizeof(Items));
+        vd_radix_sort_u64(Items, Scratch, ITEMS);
+        sum += Items[r % ITEMS].index;
+    }
+    vd_bench_report(radix_name, (u64)ROUNDS * ITEMS, vd_bench_now() - start);
+
+    start = vd_bench_now();
+    for (int r = 0; r < ROUNDS; ++r) {
+        memcpy(Items, Source, sizeof(Items));
+        qsort(Items, ITEMS, sizeof(VD_SortItem), compare_items);
+        sum += Items[r % ITEMS].index;
+    }
+    vd_bench_report(qsort_name, (u64)ROUNDS * ITEMS, vd_bench_now() - start);
+
+    vd_bench_sink = sum;
+}
+
+/** Keys shaped like the renderer's draw keys: a few blueprints, more materials and meshes. */
+UTEST(sort, draw_keys)
+{
+    u64 seed = 0xD4A3;
+    for (u32 i = 0; i < ITEMS; ++i) {
+        u64 r = vd_bench_rand(&seed);
+        u64 blueprint = r & 7;
+        u64 material = (r >> 8) & 63;
+        u64 mesh = (r >> 16) & 255;
+        Source[i].key = (blueprint << 40) | (material << 20) | mesh;
+        Source[i].index = i;
+    }
+
+    bench_sorts("radix sort, draw keys", "qsort, draw keys");
+}
+
+UTEST(sort, random_keys)
+{
+    u64 seed = 0xD4A4;
+    for (u32 i = 0; i < ITEMS; ++i) {
+        Source[i].key = vd_bench_rand(&seed);
+        Source[i].index = i;
+    }
+
+    bench_sorts("radix sort, random keys", "qsort, random keys");
+}
@@ -0,0 +1,197 @@
+#define VD_ABBREVIATIONS 1
+#include "utest.h"
+#include "arena.h"
+
+UTEST(arena, fixed_returns_null_when_full)
+{
+    Arena a = arena_new(64, vd_memory_get_system_allocator());
+
+    ASSERT_NE(arena_alloc(&a, 48), (void*)0);
+    ASSERT_EQ(arena_alloc(&a, 48), (void*)0);
+    ASSERT_EQ(arena_alloc_t(&a, 48), (void*)0);
+
+    // A failed allocation must not consume the remaining space
+    ASSERT_NE(arena_alloc_t(&a, 16), (void*)0);
+
+    arena_free(&a);
+}
+
+UTEST(arena, chained_grows)
+{
+    Arena a = arena_new_chained(64, vd_memory_get_system_allocator());
+
+    char *first = arena_alloc(&a, 48);
+    char *second = arena_alloc(&a, 48);
+    char *big = arena_alloc(&a, 1000);
+
+    ASSERT_NE(first, (char*)0);
+    ASSERT_NE(second, (char*)0);
+    ASSERT_NE(big, (char*)0);
+
+    memset(first, 1, 48);
+    memset(second, 2, 48);
+    memset(big, 3, 1000);
+    ASSERT_EQ(first[47], 1);
+    ASSERT_EQ(second[0], 2);
+
+    u64 used, total;
+    vd_arena_get_stats(&a, &used, &total);
+    ASSERT_EQ(used, 48 + 48 + 1000);
+    ASSERT_GE(total, used);
+
+    arena_free(&a);
+}
+
+UTEST(arena, rewind_frees_scratch_blocks)
+{
+    Arena a = arena_new_chained(64, vd_memory_get_system_allocator());
+
+    void *persistent = arena_alloc(&a, 32);
+    ArenaMark mark = arena_mark(&a);
+
+    arena_alloc(&a, 500);
+    arena_alloc(&a, 500);
+    ASSERT_EQ(vd_arena_get_used(&a), 1032);
+
+    arena_rewind(&a, mark);
+    ASSERT_EQ(vd_arena_get_used(&a), 32);
+    ASSERT_EQ(a.block->prev, (VD_ArenaBlock*)0);
+    ASSERT_EQ(vd_arena_get_high_water(&a), 1032);
+
+    // The next allocation reuses the space after the mark
+    void *after = arena_alloc(&a, 8);
+    ASSERT_EQ((umm)after, (umm)persistent + 32);
+
+    arena_free(&a);
+}
+
+UTEST(arena, scope_rewinds)
+{
+    Arena a = arena_new_chained(64, vd_memory_get_system_allocator());
+    arena_alloc(&a, 16);
+
+    arena_scope(&a) {
+        arena_alloc(&a, 256);
+        ASSERT_EQ(vd_arena_get_used(&a), 272);
+    }
+
+    ASSERT_EQ(vd_arena_get_used(&a), 16);
+    arena_free(&a);
+}
+
+UTEST(arena, reset_keeps_one_block_that_fits_the_frame)
+{
+    Arena a = arena_new_chained(64, vd_memory_get_system_allocator());
+
+    for (int i = 0; i < 10; ++i) {
+        arena_alloc(&a, 40);
+    }
+
+    ASSERT_NE(a.block->prev, (VD_ArenaBlock*)0);
+    arena_reset(&a);
+    ASSERT_EQ(a.block->prev, (VD_ArenaBlock*)0);
+
+    // The same frame again fits in a single block
+    VD_ArenaBlock *block = a.block;
+    for (int i = 0; i < 10; ++i) {
+        arena_alloc(&a, 40);
+    }
+
+    ASSERT_EQ(a.block, block);
+    ASSERT_EQ(vd_arena_get_high_water(&a), 400);
+
+    arena_free(&a);
+}
+
+static int fail_allocations;
+
+static VD_PROC_ALLOC(failing_alloc)
+{
+    if (newsize && fail_allocations) {
+        return 0;
+    }
+
+    return vd_memory_get_system_allocator()->proc_alloc(ptr, prevsize, newsize, c);
+}
+
+UTEST(arena, reset_leaves_the_arena_empty_when_out_of_memory)
+{
+    VD_Allocator alc = { .proc_alloc = failing_alloc };
+    Arena a = arena_new_chained(64, &alc);
+
+    for (int i = 0; i < 10; ++i) {
+        arena_alloc(&a, 40);
+    }
+
+    fail_allocations = 1;
+    arena_reset(&a);
+    ASSERT_EQ(a.block, (VD_ArenaBlock*)0);
+    ASSERT_EQ(a.committed, 0);
+    ASSERT_EQ(arena_alloc(&a, 40), (void*)0);
+
+    // Once memory is back, the arena grows again
+    fail_allocations = 0;
+    ASSERT_NE(arena_alloc(&a, 40), (void*)0);
+
+    arena_free(&a);
+}
+
+UTEST(arena, virtual_commits_on_demand)
+{
+    Arena a = arena_new_virtual(64ull * 1024 * 1024, 128 * 1024);
+    ASSERT_NE(a.data, (umm)0);
+    ASSERT_EQ(a.committed, 0);
+
+    char *first = arena_alloc(&a, 100);
+    ASSERT_NE(first, (char*)0);
+    ASSERT_EQ(a.committed, 128 * 1024);
+
+    // Pointers stay stable while the arena commits more pages
+    char *big = arena_alloc(&a, 8 * 1024 * 1024);
+    ASSERT_NE(big, (char*)0);
+    ASSERT_EQ((umm)first, a.data);
+    big[8 * 1024 * 1024 - 1] = 1;
+    ASSERT_GE(a.committed, 8 * 1024 * 1024);
+
+    // Past the reserved range
+    ASSERT_EQ(arena_alloc(&a, 64 * 1024 * 1024), (void*)0);
+
+    arena_reset(&a);
+    ASSERT_EQ(a.committed, 128 * 1024);
+    ASSERT_GE(vd_arena_get_high_water(&a), 8 * 1024 * 1024 + 100);
+
+    char *again = arena_alloc(&a, 100);
+    ASSERT_EQ((umm)again, a.data);
+    ASSERT_EQ(again[0], 0);
+
+    arena_free(&a);
+}
+
+UTEST(arena, proc_alloc_resizes_the_last_allocation_in_place)
+{
+    Arena a = arena_new(1024, vd_memory_get_system_allocator());
+    VD_Allocator alc = { .proc_alloc = vd_arena_proc_alloc, .c = &a };
+
+    char *p = (char*)vd_realloc(&alc, 0, 0, 64);
+    memset(p, 1, 64);
+
+    char *grown = (char*)vd_realloc(&alc, (umm)p, 64, 256);
+    ASSERT_EQ(grown, p);
+    ASSERT_EQ(grown[63], 1);
+    ASSERT_EQ(grown[64], 0);
+    ASSERT_EQ(vd_arena_get_used(&a), 256);
+
+    char *shrunk = (char*)vd_realloc(&alc, (umm)grown, 256, 32);
+    ASSERT_EQ(shrunk, p);
+    ASSERT_EQ(vd_arena_get_used(&a), 32);
+    ASSERT_EQ(vd_arena_get_high_water(&a), 256);
+
+    // Anything but the last allocation still moves
+    char *other = (char*)vd_realloc(&alc, 0, 0, 8);
+    char *moved = (char*)vd_realloc(&alc, (umm)shrunk, 32, 64);
+    ASSERT_NE(moved, p);
+    ASSERT_EQ(moved[0], 1);
+    ASSERT_NE(other, (char*)0);
+
+    arena_free(&a);
+}
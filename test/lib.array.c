@@ -1,6 +1,8 @@
 #define VD_ABBREVIATIONS 1
+#define VD_ARRAY_DEBUG 1
 #include "utest.h"
 #include "array.h"
+#include "arena.h"
 
 UTEST(array, test_add_basic)
 {
@@ -30,4 +32,177 @@ UTEST(array, test_add_grow)
     {
         EXPECT_EQ(arr[i], i);
     }
-}
\ No newline at end of file
+}
+static int compare_int(const void *a, const void *b)
+{
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    int key;
+    int order;
+} KeyedInt;
+
+static int compare_keyed(const void *a, const void *b)
+{
+    return compare_int(&((const KeyedInt*)a)->key, &((const KeyedInt*)b)->key);
+}
+
+UTEST(array, reserve_is_exact)
+{
+    int *arr = 0;
+    array_init(arr, vd_memory_get_system_allocator());
+
+    array_reserve(arr, 37);
+    EXPECT_EQ(array_cap(arr), 37);
+    EXPECT_EQ(array_len(arr), 0);
+
+    // Never shrinks
+    array_reserve(arr, 10);
+    EXPECT_EQ(array_cap(arr), 37);
+
+    array_deinit(arr);
+}
+
+UTEST(array, append_n_and_resize_uninit)
+{
+    int *arr = 0;
+    array_init(arr, vd_memory_get_system_allocator());
+
+    int src[100];
+    for (int i = 0; i < 100; ++i) {
+        src[i] = i;
+    }
+
+    array_add(arr, -1);
+    array_append_n(arr, src, 100);
+    ASSERT_EQ(array_len(arr), 101);
+    EXPECT_EQ(arr[0], -1);
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(arr[i + 1], i);
+    }
+
+    array_resize_uninit(arr, 500);
+    EXPECT_EQ(array_len(arr), 500);
+    EXPECT_GE(array_cap(arr), 500);
+    EXPECT_EQ(arr[100], 99);
+
+    array_resize_uninit(arr, 3);
+    EXPECT_EQ(array_len(arr), 3);
+
+    array_deinit(arr);
+}
+
+UTEST(array, insert_and_delete_ranges)
+{
+    int *arr = 0;
+    array_init(arr, vd_memory_get_system_allocator());
+
+    int head[] = { 0, 1, 5, 6 };
+    int mid[] = { 2, 3, 4 };
+    array_append_n(arr, head, 4);
+    array_insertn(arr, 2, mid, 3);
+    array_insert(arr, 7, 7);
+    array_insert(arr, 0, -1);
+
+    ASSERT_EQ(array_len(arr), 9);
+    for (int i = 0; i < 9; ++i) {
+        EXPECT_EQ(arr[i], i - 1);
+    }
+
+    array_deln(arr, 1, 3);
+    ASSERT_EQ(array_len(arr), 6);
+    EXPECT_EQ(arr[0], -1);
+    EXPECT_EQ(arr[1], 3);
+
+    // From the end
+    array_deln(arr, 4, 2);
+    ASSERT_EQ(array_len(arr), 4);
+    EXPECT_EQ(arr[3], 5);
+
+    array_deinit(arr);
+}
+
+UTEST(array, insert_sorted_is_stable)
+{
+    KeyedInt *arr = 0;
+    array_init(arr, vd_memory_get_system_allocator());
+
+    int keys[] = { 5, 1, 3, 5, 1, 9, 3, 5, 0, 7 };
+    for (int i = 0; i < (int)VD_ARRAY_COUNT(keys); ++i) {
+        KeyedInt v = { keys[i], i };
+        array_insert_sorted(arr, v, compare_keyed);
+    }
+
+    ASSERT_EQ(array_len(arr), VD_ARRAY_COUNT(keys));
+    for (size_t i = 1; i < array_len(arr); ++i) {
+        EXPECT_LE(arr[i - 1].key, arr[i].key);
+        if (arr[i - 1].key == arr[i].key) {
+            EXPECT_LT(arr[i - 1].order, arr[i].order);
+        }
+    }
+
+    KeyedInt five = { 5, 0 };
+    EXPECT_EQ(array_lower_bound(arr, &five, compare_keyed), 5);
+    EXPECT_EQ(array_upper_bound(arr, &five, compare_keyed), 8);
+
+    array_deinit(arr);
+}
+
+UTEST(array, shrink_gives_space_back_to_the_arena)
+{
+    Arena a = arena_new(4096, vd_memory_get_system_allocator());
+    VD_Allocator alc = { .proc_alloc = vd_arena_proc_alloc, .c = &a };
+
+    int *arr = 0;
+    array_init(arr, &alc);
+    for (int i = 0; i < 100; ++i) {
+        array_add(arr, i);
+    }
+
+    // Growing the last allocation of an arena happens in place, without leaving copies behind
+    EXPECT_EQ(vd_arena_get_used(&a), sizeof(VD_ArrayHeader) + array_cap(arr) * sizeof(int));
+
+    array_deln(arr, 10, 90);
+    array_shrink(arr);
+    EXPECT_EQ(array_cap(arr), 10);
+    EXPECT_EQ(vd_arena_get_used(&a), sizeof(VD_ArrayHeader) + 10 * sizeof(int));
+    EXPECT_EQ(arr[9], 9);
+
+    arena_free(&a);
+}
+
+UTEST(array, debug_records_peak_capacity_per_call_site)
+{
+    vd_array_debug_reset_sites();
+
+    for (int round = 0; round < 3; ++round) {
+        int *arr = 0;
+        array_init(arr, vd_memory_get_system_allocator()); int line = __LINE__;
+        for (int i = 0; i < 10 * (round + 1); ++i) {
+            array_add(arr, i);
+        }
+
+        array_clear(arr);
+        array_deinit(arr);
+
+        if (round == 2) {
+            VD_ArraySite sites[VD_ARRAY_DEBUG_MAX_SITES];
+            size_t len = vd_array_debug_get_sites(sites, VD_ARRAY_COUNT(sites));
+
+            VD_ArraySite *site = 0;
+            for (size_t i = 0; i < len; ++i) {
+                if (sites[i].line == line && strcmp(sites[i].file, __FILE__) == 0) {
+                    site = &sites[i];
+                }
+            }
+
+            ASSERT_NE(site, (VD_ArraySite*)0);
+            EXPECT_EQ(site->arrays, 3);
+            EXPECT_EQ(site->tsize, sizeof(int));
+            EXPECT_EQ(site->peak_len, 30);
+            EXPECT_EQ(site->peak_cap, 32);
+        }
+    }
+}
@@ -2,6 +2,8 @@
 #include "vd_buddy_alloc.h"
 #include "utest.h"
 
+#include <string.h>
+
 UTEST(buddy_alloc, test_basic_invocation)
 {
 	VD_BuddyAlloc allocator;
@@ -12,4 +14,93 @@ UTEST(buddy_alloc, test_basic_invocation)
 	EXPECT_NE(p, 0);
 
 	vd_buddy_alloc_deinit(&allocator);
-}
\ No newline at end of file
+}
+
+UTEST(buddy_alloc, frees_coalesce_into_one_block)
+{
+	VD_BuddyAlloc allocator;
+	vd_buddy_alloc_init(&allocator, vd_buddy_alloc_default_palloc, 0, 4096, 16);
+
+	void *ptrs[128];
+	for (int i = 0; i < 128; ++i) {
+		ptrs[i] = vd_buddy_alloc_realloc(&allocator, 0, 16);
+		ASSERT_NE(ptrs[i], (void*)0);
+		ASSERT_EQ(((size_t)ptrs[i]) & 15, (size_t)0);
+	}
+
+	size_t used, total, num_blocks, num_free_blocks;
+	vd_buddy_alloc_get_stats(&allocator, &used, &total, &num_blocks, &num_free_blocks);
+	EXPECT_EQ(used, (size_t)4096);
+	EXPECT_EQ(total, (size_t)4096);
+	EXPECT_EQ(num_free_blocks, (size_t)0);
+
+	// Free in an order that leaves no buddies together until the end
+	for (int i = 0; i < 128; i += 2) {
+		vd_buddy_alloc_realloc(&allocator, ptrs[i], 0);
+	}
+
+	for (int i = 1; i < 128; i += 2) {
+		vd_buddy_alloc_realloc(&allocator, ptrs[i], 0);
+	}
+
+	vd_buddy_alloc_get_stats(&allocator, &used, &total, &num_blocks, &num_free_blocks);
+	EXPECT_EQ(used, (size_t)0);
+	EXPECT_EQ(num_blocks, (size_t)1);
+	EXPECT_EQ(num_free_blocks, (size_t)1);
+
+	vd_buddy_alloc_deinit(&allocator);
+}
+
+UTEST(buddy_alloc, grows_new_regions)
+{
+	VD_BuddyAlloc allocator;
+	vd_buddy_alloc_init(&allocator, vd_buddy_alloc_default_palloc, 0, 1024, 16);
+
+	void *small = vd_buddy_alloc_realloc(&allocator, 0, 900);
+	void *more = vd_buddy_alloc_realloc(&allocator, 0, 900);
+	void *big = vd_buddy_alloc_realloc(&allocator, 0, 10000);
+	ASSERT_NE(small, (void*)0);
+	ASSERT_NE(more, (void*)0);
+	ASSERT_NE(big, (void*)0);
+	memset(big, 0xAB, 10000);
+
+	size_t total;
+	vd_buddy_alloc_get_stats(&allocator, 0, &total, 0, 0);
+	EXPECT_EQ(total, (size_t)(1024 + 1024 + 16384));
+
+	vd_buddy_alloc_deinit(&allocator);
+}
+
+UTEST(buddy_alloc, realloc_in_place_when_buddy_is_free)
+{
+	VD_BuddyAlloc allocator;
+	vd_buddy_alloc_init(&allocator, vd_buddy_alloc_default_palloc, 0, 4096, 16);
+
+	char *p = vd_buddy_alloc_realloc(&allocator, 0, 100);
+	memset(p, 7, 100);
+
+	char *grown = vd_buddy_alloc_realloc(&allocator, p, 1000);
+	ASSERT_EQ(grown, p);
+	EXPECT_EQ(grown[99], 7);
+
+	// The upper buddy is taken, so growing again has to move
+	char *blocker = vd_buddy_alloc_realloc(&allocator, 0, 1000);
+	ASSERT_NE(blocker, (char*)0);
+	char *moved = vd_buddy_alloc_realloc(&allocator, grown, 2000);
+	ASSERT_NE(moved, grown);
+	EXPECT_EQ(moved[0], 7);
+	EXPECT_EQ(moved[99], 7);
+
+	char *shrunk = vd_buddy_alloc_realloc(&allocator, moved, 10);
+	EXPECT_EQ(shrunk, moved);
+
+	vd_buddy_alloc_realloc(&allocator, shrunk, 0);
+	vd_buddy_alloc_realloc(&allocator, blocker, 0);
+
+	size_t used, num_free_blocks;
+	vd_buddy_alloc_get_stats(&allocator, &used, 0, 0, &num_free_blocks);
+	EXPECT_EQ(used, (size_t)0);
+	EXPECT_EQ(num_free_blocks, (size_t)1);
+
+	vd_buddy_alloc_deinit(&allocator);
+}
@@ -1,6 +1,8 @@
 #define VD_ABBREVIATIONS 1
 #include "utest.h"
 #include "delegate.h"
+#include "vd_atomic.h"
+#include "vd_sysutil.h"
 
 VD_DELEGATE_DECLARE_PARAMS1_VOID(SimpleDelegate, int, a)
 
@@ -86,4 +88,174 @@ UTEST(delegate, test_return_callback_invocation)
 	EXPECT_EQ(ret, 2);
 }
 
-VD_DELEGATE_DECLARE_PARAMS2_VOID(Simple2Delegate, int, a, float, b)
\ No newline at end of file
+VD_DELEGATE_DECLARE_PARAMS2_VOID(Simple2Delegate, int, a, float, b)
+
+static void record_func1(int a, void *usrdata)
+{
+	int *log = (int *)usrdata;
+	log[log[0]++ + 1] = a;
+}
+
+static void record_func2(int a, void *usrdata)
+{
+	int *log = (int *)usrdata;
+	log[log[0]++ + 1] = a * 10;
+}
+
+static void record_func3(int a, void *usrdata)
+{
+	int *log = (int *)usrdata;
+	log[log[0]++ + 1] = a * 100;
+}
+
+UTEST(delegate, unsubscribe_first_keeps_order)
+{
+	int log[16] = { 0 };
+
+	VD_HOOK(SimpleDelegate) hook = { 0 };
+	VD_HOOK_INIT(hook, vd_memory_get_system_allocator());
+
+	VD_HOOK_SUBSCRIBE(hook, record_func1, log);
+	VD_HOOK_SUBSCRIBE(hook, record_func2, log);
+	VD_HOOK_SUBSCRIBE(hook, record_func3, log);
+
+	VD_HOOK_UNSUBSCRIBE(hook, record_func1);
+	ASSERT_EQ(VD_HOOK_LEN(hook), 2);
+
+	VD_HOOK_INVOKE(hook, 1);
+	ASSERT_EQ(log[0], 2);
+	EXPECT_EQ(log[1], 10);
+	EXPECT_EQ(log[2], 100);
+
+	VD_HOOK_UNSUBSCRIBE(hook, record_func2);
+	VD_HOOK_UNSUBSCRIBE(hook, record_func3);
+	EXPECT_EQ(VD_HOOK_LEN(hook), 0);
+
+	VD_HOOK_DEINIT(hook);
+	vd_hook_quiescent();
+}
+
+static SimpleDelegateHook Self_Removing_Hook;
+
+static void remove_self(int a, void *usrdata)
+{
+	VD_HOOK_UNSUBSCRIBE(Self_Removing_Hook, remove_self);
+	*(int *)usrdata += a;
+}
+
+UTEST(delegate, unsubscribe_during_invoke)
+{
+	int calls = 0;
+	VD_HOOK_INIT(Self_Removing_Hook, vd_memory_get_system_allocator());
+	VD_HOOK_SUBSCRIBE(Self_Removing_Hook, remove_self, &calls);
+	VD_HOOK_SUBSCRIBE(Self_Removing_Hook, simple_func1, &calls);
+
+	// The invocation keeps going over the subscribers it started with
+	VD_HOOK_INVOKE(Self_Removing_Hook, 1);
+	EXPECT_EQ(calls, 1);
+	EXPECT_EQ(VD_HOOK_LEN(Self_Removing_Hook), 1);
+
+	VD_HOOK_INVOKE(Self_Removing_Hook, 5);
+	EXPECT_EQ(calls, 1);
+
+	VD_HOOK_DEINIT(Self_Removing_Hook);
+	vd_hook_quiescent();
+}
+
+static void record_sum(int a, float b, void *usrdata)
+{
+	float *log = (float *)usrdata;
+	log[(int)log[0]++ + 1] = (float)a + b;
+}
+
+UTEST(delegate, deferred_invocations_run_in_order_on_flush)
+{
+	float log[16] = { 0 };
+
+	VD_HOOK(Simple2Delegate) hook = { 0 };
+	VD_HOOK_INIT(hook, vd_memory_get_system_allocator());
+
+	VD_HookQueue queue;
+	vd_hook_queue_init(&queue, vd_memory_get_system_allocator());
+
+	VD_HOOK_DEFER(Simple2Delegate, &queue, hook, 1, 0.5f);
+	VD_HOOK_DEFER(Simple2Delegate, &queue, hook, 2, 0.25f);
+
+	// Subscribers are the ones the hook has when flushing
+	VD_HOOK_SUBSCRIBE(hook, record_sum, log);
+	EXPECT_EQ(log[0], 0.0f);
+
+	EXPECT_EQ(vd_hook_queue_flush(&queue), 2);
+	ASSERT_EQ(log[0], 2.0f);
+	EXPECT_EQ(log[1], 1.5f);
+	EXPECT_EQ(log[2], 2.25f);
+
+	EXPECT_EQ(vd_hook_queue_flush(&queue), 0);
+
+	vd_hook_queue_deinit(&queue);
+	VD_HOOK_DEINIT(hook);
+	vd_hook_quiescent();
+}
+
+#define STRESS_THREAD_COUNT 4
+#define STRESS_ROUNDS 2000
+
+typedef struct {
+	SimpleDelegateHook hook;
+	VD_HookQueue       queue;
+	volatile int32_t   calls;
+	volatile int32_t   deferred;
+} StressState;
+
+static void count_call(int a, void *usrdata)
+{
+	StressState *state = (StressState *)usrdata;
+	if (a == 0) {
+		vd_atomic_inc_and_fetch32(&state->calls);
+	} else {
+		vd_atomic_inc_and_fetch32(&state->deferred);
+	}
+}
+
+static int stress_thread_proc(void *arg)
+{
+	StressState *state = (StressState *)arg;
+	vd_hook_thread_online();
+
+	for (int i = 0; i < STRESS_ROUNDS; ++i) {
+		VD_HOOK_SUBSCRIBE(state->hook, count_call, state);
+		VD_HOOK_INVOKE(state->hook, 0);
+		VD_HOOK_DEFER(SimpleDelegate, &state->queue, state->hook, 1);
+		VD_HOOK_UNSUBSCRIBE(state->hook, count_call);
+		vd_hook_quiescent();
+	}
+
+	vd_hook_thread_offline();
+	return 0;
+}
+
+UTEST(delegate, concurrent_subscribe_invoke_and_defer)
+{
+	static StressState state;
+	VD_HOOK_INIT(state.hook, vd_memory_get_system_allocator());
+	vd_hook_queue_init(&state.queue, vd_memory_get_system_allocator());
+
+	VD_SysUtilThread threads[STRESS_THREAD_COUNT];
+	for (int i = 0; i < STRESS_THREAD_COUNT; ++i) {
+		ASSERT_EQ(vd_sysutil_thread_create(&threads[i], stress_thread_proc, &state), 0);
+	}
+
+	for (int i = 0; i < STRESS_THREAD_COUNT; ++i) {
+		vd_sysutil_thread_join(&threads[i]);
+	}
+
+	// Every thread subscribed before invoking, so it saw at least its own subscription
+	EXPECT_GE(state.calls, STRESS_THREAD_COUNT * STRESS_ROUNDS);
+	EXPECT_EQ(VD_HOOK_LEN(state.hook), 0);
+	EXPECT_EQ(vd_hook_queue_flush(&state.queue), STRESS_THREAD_COUNT * STRESS_ROUNDS);
+	EXPECT_EQ(state.deferred, 0);
+
+	vd_hook_queue_deinit(&state.queue);
+	VD_HOOK_DEINIT(state.hook);
+	vd_hook_quiescent();
+}
@@ -41,4 +41,32 @@ UTEST(FMT, MultipleStringSlices)
     str s = vd_snfmt(&a, "%{stru32} %{stru32}", str_lit("Hello"), str_lit("World"));
     EXPECT_TRUE(vd_str_eq(s, str_lit("Hello World")));
     arena_free(&a);
-}
\ No newline at end of file
+}
+UTEST(FMT, FloatTypes)
+{
+    Arena a = arena_new(1024, vd_memory_get_system_allocator());
+    char expected[512];
+
+    const double values[] = { 0.0, -0.0, 0.5, -2.25, 1.0 / 3.0, 0.0000005, 123456.789, 9.5e12, -1e20 };
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+        arena_reset(&a);
+        str s = vd_snfmt(&a, "%{f64}|%{f32}", values[i], (float)values[i]);
+        snprintf(expected, sizeof(expected), "%f|%f", values[i], (float)values[i]);
+        EXPECT_TRUE(vd_str_eq(s, vd_str_from_cstr(expected)));
+    }
+
+    arena_free(&a);
+}
+
+UTEST(FMT, MeasuringKeepsArgumentsInOrder)
+{
+    // Every argument is consumed even when it doesn't fit, so the length is exact
+    char out[4];
+    size_t len = vd_fmt_snfmt(out, sizeof(out), "%{i32} %{u64} %{cstr} 100%", -12345, (u64)1 << 40, "end");
+    EXPECT_EQ(len, sizeof("-12345 1099511627776 end 100%") - 1);
+
+    Arena a = arena_new(1024, vd_memory_get_system_allocator());
+    str s = vd_snfmt(&a, "%{i32} %{u64} %{cstr} 100%", -12345, (u64)1 << 40, "end");
+    EXPECT_TRUE(vd_str_eq(s, str_lit("-12345 1099511627776 end 100%")));
+    arena_free(&a);
+}
@@ -0,0 +1,209 @@
+#define VD_ABBREVIATIONS 1
+#include "utest.h"
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** splitmix64 */
+static u64 test_rand(u64 *state)
+{
+    u64 z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static void fill_random(u8 *data, u64 len, u64 *state)
+{
+    for (u64 i = 0; i < len; ++i) {
+        data[i] = (u8)test_rand(state);
+    }
+}
+
+UTEST(hash, streaming_matches_one_shot)
+{
+    u8 data[400];
+    u64 seed = 0x5EED;
+    fill_random(data, sizeof(data), &seed);
+
+    for (u64 len = 0; len <= sizeof(data); ++len) {
+        u64 expected = vd_hash(data, len, 42);
+
+        // Whole, then in random pieces that straddle the block boundaries
+        VD_HashState state;
+        vd_hash_begin(&state, 42);
+        vd_hash_update(&state, data, len);
+        ASSERT_EQ(vd_hash_end(&state), expected);
+
+        vd_hash_begin(&state, 42);
+        for (u64 at = 0; at < len;) {
+            u64 n = test_rand(&seed) % 60;
+            n = n > len - at ? len - at : n;
+            vd_hash_update(&state, data + at, n);
+            at += n;
+        }
+        ASSERT_EQ(vd_hash_end(&state), expected);
+    }
+
+    // Seeds give unrelated hashes
+    EXPECT_NE(vd_hash(data, 100, 1), vd_hash(data, 100, 2));
+}
+
+UTEST(hash, u64_path_matches_bytes)
+{
+    u64 seed = 0xABC;
+    u16 probe = 1;
+    if (*(u8*)&probe != 1) {
+        UTEST_SKIP("big endian host");
+    }
+
+    for (int i = 0; i < 1000; ++i) {
+        u64 key = test_rand(&seed);
+        ASSERT_EQ(vd_hash_u64(key, 0), vd_hash(&key, 8, 0));
+        ASSERT_EQ(vd_hash_u64(key, key >> 7), vd_hash(&key, 8, key >> 7));
+    }
+}
+
+/**
+ * Flip each input bit (64 of them, spread over the key) of random keys and count how often each
+ * output bit flips. Every pair should flip half of the time.
+ */
+static double worst_avalanche_bias(u64 len, int use_u64)
+{
+    enum { SAMPLES = 4000, OUT_BITS = 64 };
+    u64 in_bits = len * 8 < 64 ? len * 8 : 64;
+
+    u32 *flips = (u32*)calloc(in_bits * OUT_BITS, sizeof(u32));
+    u8 key[256];
+    u64 seed = 0xA7A1 + len;
+
+    for (int s = 0; s < SAMPLES; ++s) {
+        fill_random(key, len, &seed);
+        u64 h0;
+        if (use_u64) {
+            u64 k;
+            memcpy(&k, key, 8);
+            h0 = vd_hash_u64(k, 0);
+        } else {
+            h0 = vd_hash(key, len, 0);
+        }
+
+        for (u64 b = 0; b < in_bits; ++b) {
+            u64 bit = b * (len * 8) / in_bits;
+            key[bit / 8] ^= (u8)(1 << (bit % 8));
+
+            u64 h1;
+            if (use_u64) {
+                u64 k;
+                memcpy(&k, key, 8);
+                h1 = vd_hash_u64(k, 0);
+            } else {
+                h1 = vd_hash(key, len, 0);
+            }
+
+            key[bit / 8] ^= (u8)(1 << (bit % 8));
+
+            u64 diff = h0 ^ h1;
+            for (int o = 0; o < OUT_BITS; ++o) {
+                flips[b * OUT_BITS + o] += (u32)((diff >> o) & 1);
+            }
+        }
+    }
+
+    double worst = 0;
+    for (u64 i = 0; i < in_bits * OUT_BITS; ++i) {
+        double bias = (double)flips[i] / SAMPLES - 0.5;
+        bias = bias < 0 ? -bias : bias;
+        worst = bias > worst ? bias : worst;
+    }
+
+    free(flips);
+    return worst;
+}
+
+UTEST(hash, avalanche)
+{
+    // 6 standard deviations for 4000 samples, so random noise doesn't trip it. Shorter keys have
+    // too few distinct values to sample.
+    const double max_bias = 0.05;
+    const u64 lens[] = { 3, 4, 8, 12, 16, 17, 33, 48, 64, 100, 200 };
+
+    for (size_t i = 0; i < sizeof(lens) / sizeof(lens[0]); ++i) {
+        double bias = worst_avalanche_bias(lens[i], 0);
+        if (bias >= max_bias) {
+            printf("len %llu: worst bias %f\n", (unsigned long long)lens[i], bias);
+        }
+        EXPECT_LT(bias, max_bias);
+    }
+
+    EXPECT_LT(worst_avalanche_bias(8, 1), max_bias);
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    u32 x = *(const u32*)a, y = *(const u32*)b;
+    return (x > y) - (x < y);
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    u64 x = *(const u64*)a, y = *(const u64*)b;
+    return (x > y) - (x < y);
+}
+
+/** Count the colliding pairs (equal neighbours after sorting) of all 64 bits, and of each half. */
+static void count_collisions(u64 *hashes, u64 count, u64 *full, u64 *low, u64 *high)
+{
+    u32 *halves = (u32*)malloc(count * sizeof(u32));
+    *full = *low = *high = 0;
+
+    for (int part = 0; part < 2; ++part) {
+        for (u64 i = 0; i < count; ++i) {
+            halves[i] = (u32)(part ? hashes[i] >> 32 : hashes[i]);
+        }
+
+        qsort(halves, count, sizeof(u32), compare_u32);
+        for (u64 i = 1; i < count; ++i) {
+            *(part ? high : low) += halves[i] == halves[i - 1];
+        }
+    }
+
+    qsort(hashes, count, sizeof(u64), compare_u64);
+    for (u64 i = 1; i < count; ++i) {
+        *full += hashes[i] == hashes[i - 1];
+    }
+
+    free(halves);
+}
+
+UTEST(hash, collisions)
+{
+    // Sequential integers and near identical strings, the keys maps actually see
+    const u64 count = 1 << 20;
+    // n^2 / 2^33 expected for 32 bits
+    const u64 expected = (count * count) >> 33;
+
+    u64 *hashes = (u64*)malloc(count * sizeof(u64));
+    u64 full, low, high;
+
+    for (u64 i = 0; i < count; ++i) {
+        hashes[i] = vd_hash_u64(i, 0);
+    }
+    count_collisions(hashes, count, &full, &low, &high);
+    EXPECT_EQ(full, 0u);
+    EXPECT_LT(low, expected * 2);
+    EXPECT_LT(high, expected * 2);
+
+    for (u64 i = 0; i < count; ++i) {
+        char key[32];
+        int len = snprintf(key, sizeof(key), "entity_%llu", (unsigned long long)i);
+        hashes[i] = vd_hash(key, (u64)len, VD_HASH_DEFAULT_SEED);
+    }
+    count_collisions(hashes, count, &full, &low, &high);
+    EXPECT_EQ(full, 0u);
+    EXPECT_LT(low, expected * 2);
+    EXPECT_LT(high, expected * 2);
+
+    free(hashes);
+}
@@ -0,0 +1,139 @@
+#define VD_ABBREVIATIONS 1
+#include "utest.h"
+#include "intern.h"
+#include "vd_atomic.h"
+#include "vd_sysutil.h"
+#include <stdio.h>
+#include <string.h>
+
+UTEST(intern, same_string_same_symbol)
+{
+    VD_Interner *interner = vd_interner_create(vd_memory_get_system_allocator());
+
+    char buf[] = "hello";
+    Symbol a = vd_interner_intern(interner, str_lit("hello"));
+    Symbol b = vd_interner_intern(interner, (VD_str) { buf, 5 });
+    Symbol c = vd_interner_intern(interner, str_lit("world"));
+
+    ASSERT_NE(a, 0u);
+    ASSERT_EQ(a, b);
+    ASSERT_NE(a, c);
+    ASSERT_EQ(vd_interner_get_count(interner), 2u);
+
+    VD_str s = vd_interner_get_str(interner, c);
+    ASSERT_EQ(s.len, 5u);
+    ASSERT_STREQ(s.data, "world");
+
+    vd_interner_destroy(interner);
+}
+
+UTEST(intern, find_does_not_intern)
+{
+    VD_Interner *interner = vd_interner_create(vd_memory_get_system_allocator());
+
+    ASSERT_EQ(vd_interner_find(interner, str_lit("missing")), 0u);
+    ASSERT_EQ(vd_interner_get_count(interner), 0u);
+
+    Symbol a = vd_interner_intern(interner, str_lit("present"));
+    u64 hash = vd_interner_hash(str_lit("present"));
+    ASSERT_EQ(vd_interner_find_hashed(interner, str_lit("present"), hash), a);
+
+    ASSERT_EQ(vd_interner_get_str(interner, 0).len, 0u);
+    ASSERT_EQ(vd_interner_get_str(interner, a + 1).len, 0u);
+
+    vd_interner_destroy(interner);
+}
+
+UTEST(intern, grows_past_first_page)
+{
+    VD_Interner *interner = vd_interner_create(vd_memory_get_system_allocator());
+
+    char buf[32];
+    for (int i = 0; i < 10000; ++i) {
+        int len = snprintf(buf, sizeof(buf), "symbol-%d", i);
+        ASSERT_EQ(vd_interner_intern(interner, (VD_str) { buf, len }), (Symbol)(i + 1));
+    }
+
+    for (int i = 0; i < 10000; ++i) {
+        int len = snprintf(buf, sizeof(buf), "symbol-%d", i);
+        ASSERT_EQ(vd_interner_find(interner, (VD_str) { buf, len }), (Symbol)(i + 1));
+        ASSERT_STREQ(vd_interner_get_str(interner, (Symbol)(i + 1)).data, buf);
+    }
+
+    vd_interner_destroy(interner);
+}
+
+static Symbol get_cached_symbol(void)
+{
+    VD_SYMBOL_LIT(sym, "intern.cached-literal");
+    return sym;
+}
+
+UTEST(intern, symbol_lit_is_cached)
+{
+    Symbol a = get_cached_symbol();
+    Symbol b = get_cached_symbol();
+
+    ASSERT_EQ(a, b);
+    ASSERT_EQ(a, vd_symbol_intern(str_lit("intern.cached-literal")));
+    ASSERT_STREQ(vd_symbol_str(a).data, "intern.cached-literal");
+}
+
+#define STRESS_THREAD_COUNT 4
+#define STRESS_STRING_COUNT 4096
+
+typedef struct {
+    VD_Interner     *interner;
+    Symbol          symbols[STRESS_THREAD_COUNT][STRESS_STRING_COUNT];
+} StressState;
+
+typedef struct {
+    StressState     *state;
+    u32             index;
+} StressThread;
+
+static int stress_thread_proc(void *arg)
+{
+    StressThread *thread = (StressThread*)arg;
+    char buf[32];
+
+    // Every thread interns the same strings, in a different order
+    for (u32 i = 0; i < STRESS_STRING_COUNT; ++i) {
+        u32 n = (i * 7 + thread->index * 1031) % STRESS_STRING_COUNT;
+        int len = snprintf(buf, sizeof(buf), "stress-%u", n);
+        thread->state->symbols[thread->index][n] = vd_interner_intern(thread->state->interner, (VD_str) { buf, len });
+    }
+
+    return 0;
+}
+
+UTEST(intern, concurrent_intern)
+{
+    static StressState state;
+    state.interner = vd_interner_create(vd_memory_get_system_allocator());
+
+    VD_SysUtilThread threads[STRESS_THREAD_COUNT];
+    StressThread thread_info[STRESS_THREAD_COUNT];
+    for (u32 i = 0; i < STRESS_THREAD_COUNT; ++i) {
+        thread_info[i] = (StressThread) { &state, i };
+        ASSERT_EQ(vd_sysutil_thread_create(&threads[i], stress_thread_proc, &thread_info[i]), 0);
+    }
+
+    for (u32 i = 0; i < STRESS_THREAD_COUNT; ++i) {
+        vd_sysutil_thread_join(&threads[i]);
+    }
+
+    ASSERT_EQ(vd_interner_get_count(state.interner), (u32)STRESS_STRING_COUNT);
+
+    char buf[32];
+    for (u32 n = 0; n < STRESS_STRING_COUNT; ++n) {
+        for (u32 t = 1; t < STRESS_THREAD_COUNT; ++t) {
+            ASSERT_EQ(state.symbols[t][n], state.symbols[0][n]);
+        }
+
+        snprintf(buf, sizeof(buf), "stress-%u", n);
+        ASSERT_STREQ(vd_interner_get_str(state.interner, state.symbols[0][n]).data, buf);
+    }
+
+    vd_interner_destroy(state.interner);
+}
@@ -0,0 +1,198 @@
+#define VD_ABBREVIATIONS 1
+#include "utest.h"
+#include "vd_common.h"
+#include "str.h"
+#include "vd_log.h"
+#include "vd_sysutil.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_THREAD_COUNT 4
+#define LOG_LINES_PER_THREAD 20000
+
+typedef struct {
+    VD_Log  *log;
+    int     index;
+} LogThread;
+
+static int log_thread_proc(void *arg)
+{
+    LogThread *thread = (LogThread*)arg;
+    for (int i = 0; i < LOG_LINES_PER_THREAD; ++i) {
+        vd_log_write(thread->log, "[Test/LOG]: thread %{i32} line %{i32}\n", thread->index, i);
+    }
+
+    return 0;
+}
+
+static char *read_file(const char *path, long *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return 0;
+    }
+
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char *data = (char*)malloc(*size + 1);
+    fread(data, 1, *size, f);
+    data[*size] = 0;
+    fclose(f);
+    return data;
+}
+
+UTEST(log, mt_lines_are_written_whole_and_in_order)
+{
+    const char *path = "vd_test_log_mt.txt";
+    remove(path);
+
+    VD_Log log = {
+        .filepath = path,
+        .flags = VD_LOG_WRITE_FILE | VD_LOG_MT,
+        .ring_size = 4096,
+        .ring_count = 3,
+    };
+    ASSERT_EQ(vd_log_init(&log), 0);
+
+    VD_SysUtilThread threads[LOG_THREAD_COUNT];
+    LogThread thread_info[LOG_THREAD_COUNT];
+    for (int i = 0; i < LOG_THREAD_COUNT; ++i) {
+        thread_info[i] = (LogThread) { &log, i };
+        ASSERT_EQ(vd_sysutil_thread_create(&threads[i], log_thread_proc, &thread_info[i]), 0);
+    }
+
+    for (int i = 0; i < LOG_THREAD_COUNT; ++i) {
+        vd_sysutil_thread_join(&threads[i]);
+    }
+
+    vd_log_flush(&log);
+    u64 dropped = vd_log_get_dropped(&log);
+    vd_log_deinit(&log);
+
+    long size;
+    char *data = read_file(path, &size);
+    ASSERT_NE(data, (char*)0);
+
+    // Every line is whole, and the lines of each thread come in the order they were logged
+    int last_line[LOG_THREAD_COUNT];
+    for (int i = 0; i < LOG_THREAD_COUNT; ++i) {
+        last_line[i] = -1;
+    }
+
+    u64 line_count = 0;
+    char *cursor = data;
+    char *end;
+    while ((end = strchr(cursor, '\n')) != 0) {
+        int thread_index, line_index;
+        if (sscanf(cursor, "[Test/LOG]: thread %d line %d", &thread_index, &line_index) == 2) {
+            ASSERT_TRUE(thread_index >= 0 && thread_index < LOG_THREAD_COUNT);
+            ASSERT_GT(line_index, last_line[thread_index]);
+            last_line[thread_index] = line_index;
+            line_count++;
+        } else {
+            // Only the dropped line count may follow
+            ASSERT_EQ(strncmp(cursor, "[Log/WRN]: Dropped", 18), 0);
+        }
+
+        cursor = end + 1;
+    }
+
+    ASSERT_EQ(line_count + dropped, (u64)LOG_THREAD_COUNT * LOG_LINES_PER_THREAD);
+
+    free(data);
+    remove(path);
+}
+
+UTEST(log, sync_backend_keeps_file_open)
+{
+    const char *path = "vd_test_log_sync.txt";
+    remove(path);
+
+    VD_Log log = {
+        .filepath = path,
+        .flags = VD_LOG_WRITE_FILE,
+    };
+    ASSERT_EQ(vd_log_init(&log), 0);
+
+    VD_Log *prev = VD_LOG_GET();
+    VD_LOG_SET(&log);
+    VD_LOG_FMT("Test", "value %{i32}", 42);
+    VD_LOG("Test", "done");
+    VD_LOG_SET(prev);
+
+    vd_log_deinit(&log);
+
+    long size;
+    char *data = read_file(path, &size);
+    ASSERT_NE(data, (char*)0);
+    ASSERT_STREQ(data, "[Test/LOG]: value 42\n[Test/LOG]: done\n");
+
+    free(data);
+    remove(path);
+}
+
+static VD_LOG_DECODE_PROC(append_decoded)
+{
+    VD_str *out = (VD_str*)c;
+    memcpy((char*)out->data + out->len, text, len);
+    out->len += (u32)len;
+}
+
+UTEST(log, binary_decodes_to_the_same_text)
+{
+    const char *path = "vd_test_log_binary.txt";
+    remove(path);
+
+    VD_Log log = {
+        .filepath = path,
+        .flags = VD_LOG_WRITE_FILE | VD_LOG_BINARY,
+    };
+    ASSERT_EQ(vd_log_init(&log), 0);
+
+    VD_Log *prev = VD_LOG_GET();
+    VD_LOG_SET(&log);
+    for (int i = 0; i < 3; ++i) {
+        VD_LOG_FMT("Test", "%{i32} %{u32} %{i64} %{u64}", -i, 7u, -((i64)1 << 40), (u64)1 << 63);
+        VD_WRN_FMT("Test", "%{f32} %{f64}", 0.5f, 2.25);
+        VD_ERR_FMT("Test", "%{stru32}|%{pathu32}", str_lit("slice"), str_lit("a\\b"));
+        VD_LOG("Test", "done");
+    }
+    vd_log_write(&log, "[Test/LOG]: unregistered %{i32}\n", 9);
+    VD_LOG_SET(prev);
+
+    vd_log_deinit(&log);
+
+    long size;
+    char *data = read_file(path, &size);
+    ASSERT_NE(data, (char*)0);
+
+    char decoded[4096];
+    VD_str out = { decoded, 0 };
+    ASSERT_EQ(vd_log_decode(data, size, append_decoded, &out), 0);
+    decoded[out.len] = 0;
+
+    const char *expected_block =
+        "[Test/LOG]: %d 7 -1099511627776 9223372036854775808\n"
+        "[Test/WRN]: 0.500000 2.250000\n"
+        "[Test/ERR]: slice|a/b\n"
+        "[Test/LOG]: done\n";
+
+    char expected[4096];
+    int expected_len = 0;
+    for (int i = 0; i < 3; ++i) {
+        expected_len += snprintf(expected + expected_len, sizeof(expected) - expected_len, expected_block, -i);
+    }
+    snprintf(expected + expected_len, sizeof(expected) - expected_len, "[Test/LOG]: unregistered 9\n");
+
+    ASSERT_STREQ(decoded, expected);
+
+    // A truncated file decodes up to the last whole record
+    out.len = 0;
+    ASSERT_LT(vd_log_decode(data, size - 3, append_decoded, &out), 0);
+
+    free(data);
+    remove(path);
+}
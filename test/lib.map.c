@@ -3,6 +3,8 @@
 #include "strmap.h"
 #include "intmap.h"
 #include "handlemap.h"
+#include "vd_atomic.h"
+#include "vd_sysutil.h"
 #include "string.h"
 
 UTEST(strmap, basic)
@@ -16,6 +18,8 @@ UTEST(strmap, basic)
     int result;
     ASSERT_TRUE(strmap_get(map, str_lit("hello"), &result));
     ASSERT_EQ(result, 1);
+
+    strmap_deinit(map);
 }
 
 UTEST(strmap, update)
@@ -35,6 +39,8 @@ UTEST(strmap, update)
 
     ASSERT_TRUE(strmap_get(map, str_lit("hello"), &result));
     ASSERT_EQ(result, 1);
+
+    strmap_deinit(map);
 }
 
 UTEST(strmap, delete)
@@ -52,6 +58,59 @@ UTEST(strmap, delete)
     strmap_del(map, str_lit("hello"));
 
     ASSERT_FALSE(strmap_get(map, str_lit("hello"), &result));
+
+    strmap_deinit(map);
+}
+
+UTEST(strmap, grows_past_initial_capacity)
+{
+    strmap u32 *map = 0;
+    strmap_init(map, vd_memory_get_system_allocator());
+
+    char buf[128];
+    for (u32 i = 0; i < 10000; ++i) {
+        // Mix short keys with ones longer than any inline prefix
+        int len = snprintf(buf, sizeof(buf), i % 3 ? "key_%u" : "a_much_longer_key_that_does_not_fit_inline_%u", i);
+        ASSERT_TRUE(strmap_set(map, ((VD_str) { .data = buf, .len = (u32)len }), &i));
+    }
+
+    ASSERT_GE(VD_STRMAP_HEADER(map)->cap_total, 10000u);
+
+    for (u32 i = 0; i < 10000; ++i) {
+        int len = snprintf(buf, sizeof(buf), i % 3 ? "key_%u" : "a_much_longer_key_that_does_not_fit_inline_%u", i);
+        u32 result = 0;
+        ASSERT_TRUE(strmap_get(map, ((VD_str) { .data = buf, .len = (u32)len }), &result));
+        ASSERT_EQ(result, i);
+    }
+
+    strmap_deinit(map);
+}
+
+UTEST(strmap, delete_keeps_other_keys_reachable)
+{
+    strmap u32 *map = 0;
+    strmap_init(map, vd_memory_get_system_allocator());
+
+    char buf[32];
+    for (u32 i = 0; i < 1000; ++i) {
+        int len = snprintf(buf, sizeof(buf), "%u", i);
+        strmap_set(map, ((VD_str) { .data = buf, .len = (u32)len }), &i);
+    }
+
+    for (u32 i = 0; i < 1000; i += 2) {
+        int len = snprintf(buf, sizeof(buf), "%u", i);
+        ASSERT_TRUE(strmap_del(map, ((VD_str) { .data = buf, .len = (u32)len })));
+    }
+
+    ASSERT_EQ(VD_STRMAP_HEADER(map)->count, 500u);
+
+    for (u32 i = 0; i < 1000; ++i) {
+        int len = snprintf(buf, sizeof(buf), "%u", i);
+        u32 result;
+        ASSERT_EQ(strmap_get(map, ((VD_str) { .data = buf, .len = (u32)len }), &result), (i % 2) == 1);
+    }
+
+    strmap_deinit(map);
 }
 
 UTEST(intmap, basic)
@@ -96,6 +155,68 @@ UTEST(intmap, grow)
     vd_intmap_deinit(&map);
 }
 
+UTEST(intmap, update)
+{
+    VD_IntMap map;
+    vd_intmap_init(&map, vd_memory_get_system_allocator(), 10, 0);
+
+    u64 v;
+    ASSERT_TRUE(vd_intmap_set(&map, 7, 1));
+    ASSERT_TRUE(vd_intmap_set(&map, 7, 2));
+    ASSERT_TRUE(vd_intmap_tryget(&map, 7, &v));
+    ASSERT_EQ(v, 2);
+    ASSERT_EQ(map.usecount, 1);
+
+    vd_intmap_deinit(&map);
+}
+
+UTEST(intmap, full_no_autogrow)
+{
+    VD_IntMap map;
+    vd_intmap_init(&map, vd_memory_get_system_allocator(), 10, VD_INTMAP_FLAG_NO_AUTOGROW);
+
+    u64 i = 0;
+    while (vd_intmap_set(&map, i, i)) {
+        i++;
+    }
+
+    ASSERT_EQ(i, map.cap);
+
+    u64 v;
+    ASSERT_FALSE(vd_intmap_tryget(&map, i + 1000, &v));
+
+    vd_intmap_deinit(&map);
+}
+
+UTEST(intmap, delete_keeps_cluster_reachable)
+{
+    VD_IntMap map;
+    vd_intmap_init(&map, vd_memory_get_system_allocator(), 16, 0);
+
+    const u64 count = 2000;
+    for (u64 i = 0; i < count; ++i) {
+        ASSERT_TRUE(vd_intmap_set(&map, i * 7919, i));
+    }
+
+    for (u64 i = 0; i < count; i += 2) {
+        vd_intmap_del(&map, i * 7919);
+    }
+
+    ASSERT_EQ(map.usecount, count / 2);
+
+    for (u64 i = 0; i < count; ++i) {
+        u64 v;
+        if (i % 2 == 0) {
+            ASSERT_FALSE(vd_intmap_tryget(&map, i * 7919, &v));
+        } else {
+            ASSERT_TRUE(vd_intmap_tryget(&map, i * 7919, &v));
+            ASSERT_EQ(v, i);
+        }
+    }
+
+    vd_intmap_deinit(&map);
+}
+
 static void string_free(void *object, void *c) {
     free(object);
 }
@@ -115,9 +236,187 @@ UTEST(handlemap, basic)
     });
 
     ASSERT_NE(handle.id, 0);
-    ASSERT_NE(handle.map, (void*)0);
+    ASSERT_NE((void*)handle.map, (void*)0);
 
     const char *use_value = *(const char**)vd_handle_use(&handle, 0);
 
     ASSERT_STREQ(use_value, "value");
 }
+
+UTEST(handlemap, stale_handle_after_free)
+{
+    VD_HANDLEMAP int *map;
+    VD_HANDLEMAP_INIT(map, {
+        .allocator = vd_memory_get_system_allocator(),
+        .initial_capacity = 1,
+    });
+
+    int value = 1;
+    VD_Handle first = VD_HANDLEMAP_REGISTER(map, &value, {
+        .ref_mode = VD_HANDLEMAP_REF_MODE_COUNT
+    });
+    VD_Handle first_copy = first;
+
+    DROP_HANDLE(first);
+    ASSERT_EQ(USE_HANDLE(first_copy, int), (int*)0);
+
+    value = 2;
+    VD_Handle second = VD_HANDLEMAP_REGISTER(map, &value, {
+        .ref_mode = VD_HANDLEMAP_REF_MODE_COUNT
+    });
+
+    // The slot is reused, but the old handle must not resolve to the new object
+    ASSERT_EQ(VD_HANDLE_SLOT(second), VD_HANDLE_SLOT(first_copy));
+    ASSERT_NE(second.id, first_copy.id);
+    ASSERT_EQ(USE_HANDLE(first_copy, int), (int*)0);
+    ASSERT_EQ(*USE_HANDLE(second, int), 2);
+
+    VD_HANDLEMAP_DEINIT(map);
+}
+
+UTEST(handlemap, refcount)
+{
+    VD_HANDLEMAP int *map;
+    VD_HANDLEMAP_INIT(map, {
+        .allocator = vd_memory_get_system_allocator(),
+        .initial_capacity = 4,
+    });
+
+    int value = 3;
+    VD_Handle handle = VD_HANDLEMAP_REGISTER(map, &value, {
+        .ref_mode = VD_HANDLEMAP_REF_MODE_COUNT
+    });
+
+    VD_Handle copy = COPY_HANDLE(handle);
+    VD_Handle observer = handle;
+
+    DROP_HANDLE(handle);
+    ASSERT_EQ(*USE_HANDLE(observer, int), 3);
+
+    DROP_HANDLE(copy);
+    ASSERT_EQ(USE_HANDLE(observer, int), (int*)0);
+
+    VD_HANDLEMAP_DEINIT(map);
+}
+
+#define STRESS_THREAD_COUNT 8
+#define STRESS_ITERATIONS   20000
+#define STRESS_LIVE_HANDLES 64
+
+typedef struct {
+    u32 owner;
+    u32 seq;
+} StressObject;
+
+typedef struct {
+    VD_HANDLEMAP StressObject   *map;
+    VD_Handle                   shared;
+    volatile i32                freed;
+    volatile i32                registered;
+    volatile i32                errors;
+} StressState;
+
+typedef struct {
+    StressState *state;
+    u32         owner;
+} StressThread;
+
+static void stress_free_object(void *object, void *c)
+{
+    StressState *state = (StressState*)c;
+    vd_atomic_inc_and_fetch32(&state->freed);
+}
+
+static int stress_thread_proc(void *arg)
+{
+    StressThread *thread = (StressThread*)arg;
+    StressState *state = thread->state;
+
+    VD_Handle live[STRESS_LIVE_HANDLES];
+    u32 live_seq[STRESS_LIVE_HANDLES];
+    u32 live_count = 0;
+    u32 rng = thread->owner * 2654435761u + 1;
+
+    for (u32 i = 0; i < STRESS_ITERATIONS; ++i) {
+        rng = rng * 1664525u + 1013904223u;
+        u32 op = rng >> 28;
+
+        VD_Handle shared_copy = COPY_HANDLE(state->shared);
+
+        if (op < 6 && live_count < STRESS_LIVE_HANDLES) {
+            StressObject object = { thread->owner, i };
+            live[live_count] = VD_HANDLEMAP_REGISTER(state->map, &object, {
+                .ref_mode = VD_HANDLEMAP_REF_MODE_COUNT,
+            });
+            live_seq[live_count] = i;
+            live_count++;
+            vd_atomic_inc_and_fetch32(&state->registered);
+        } else if (op < 9 && live_count > 0 && live_count < STRESS_LIVE_HANDLES) {
+            u32 index = (rng >> 8) % live_count;
+            live[live_count] = COPY_HANDLE(live[index]);
+            live_seq[live_count] = live_seq[index];
+            live_count++;
+        } else if (live_count > 0) {
+            u32 index = (rng >> 8) % live_count;
+            DROP_HANDLE(live[index]);
+            live[index] = live[live_count - 1];
+            live_seq[index] = live_seq[live_count - 1];
+            live_count--;
+        }
+
+        for (u32 j = 0; j < live_count; j += 7) {
+            StressObject *object = USE_HANDLE(live[j], StressObject);
+            if (!object || object->owner != thread->owner || object->seq != live_seq[j]) {
+                vd_atomic_inc_and_fetch32(&state->errors);
+            }
+        }
+
+        DROP_HANDLE(shared_copy);
+    }
+
+    while (live_count > 0) {
+        DROP_HANDLE(live[--live_count]);
+    }
+
+    return 0;
+}
+
+UTEST(handlemap, concurrent_stress)
+{
+    StressState state = {0};
+    VD_HANDLEMAP_INIT(state.map, {
+        .allocator = vd_memory_get_system_allocator(),
+        .on_free_object = stress_free_object,
+        .c = &state,
+        .initial_capacity = 16,
+        .flags = VD_HANDLEMAP_FLAG_CONCURRENT,
+    });
+
+    StressObject shared_object = { VD_U32_MAX, 0 };
+    state.shared = VD_HANDLEMAP_REGISTER(state.map, &shared_object, {
+        .ref_mode = VD_HANDLEMAP_REF_MODE_COUNT,
+    });
+    VD_Handle shared_observer = state.shared;
+
+    VD_SysUtilThread threads[STRESS_THREAD_COUNT];
+    StressThread thread_info[STRESS_THREAD_COUNT];
+    for (u32 i = 0; i < STRESS_THREAD_COUNT; ++i) {
+        thread_info[i] = (StressThread) { &state, i };
+        ASSERT_EQ(vd_sysutil_thread_create(&threads[i], stress_thread_proc, &thread_info[i]), 0);
+    }
+
+    for (u32 i = 0; i < STRESS_THREAD_COUNT; ++i) {
+        vd_sysutil_thread_join(&threads[i]);
+    }
+
+    ASSERT_EQ(state.errors, 0);
+    ASSERT_EQ(state.freed, state.registered);
+
+    // Every thread returned its copy of the shared handle
+    ASSERT_NE(USE_HANDLE(shared_observer, StressObject), (StressObject*)0);
+    DROP_HANDLE(state.shared);
+    ASSERT_EQ(USE_HANDLE(shared_observer, StressObject), (StressObject*)0);
+    ASSERT_EQ(state.freed, state.registered + 1);
+
+    VD_HANDLEMAP_DEINIT(state.map);
+}
@@ -43,6 +43,13 @@ typedef struct {
 
 VD_META_DECL_TYPE(Contacts);
 
+typedef struct {
+    const char  *owner;
+    Contact     *contacts;
+} AddressBook;
+
+VD_META_DECL_TYPE(AddressBook);
+
 static void define_types(VD_Meta_Registry *registry)
 {
     VD_META_DEFN_TYPE(registry, Vector3, {
@@ -179,6 +186,28 @@ static void define_types(VD_Meta_Registry *registry)
             }
         }
     });
+
+    VD_META_DEFN_TYPE(registry, AddressBook, {
+        .name = "AddressBook",
+        .type_class = VD_META_TYPE_OBJECT,
+        .size = sizeof(AddressBook),
+        .object = {
+            .len = 2,
+            .fields = (VD_Meta_Field[]) {
+                {
+                    .name = "owner",
+                    .offset = offsetof(AddressBook, owner),
+                    .type = VD_META_ID(CString),
+                },
+                {
+                    .name = "contacts",
+                    .offset = offsetof(AddressBook, contacts),
+                    .type = VD_META_ID(Contact),
+                    .flags = VD_META_FIELD_FLAG_INTRUSIVE_ARRAY,
+                }
+            }
+        }
+    });
 }
 
 UTEST(vd_meta, when_registering_descriptor_then_can_retrieve_it)
@@ -214,6 +243,26 @@ UTEST(vd_meta, when_registering_descriptor_then_can_retrieve_it)
     vd_meta_deinit(&registry);
 }
 
+UTEST(vd_meta, when_get_id_by_symbol_then_matches_get_id)
+{
+    VD_Meta_Registry registry = {0};
+    vd_meta_init(&registry);
+
+    // Not registered yet, so it must not be cached
+    EXPECT_EQ(vd_meta_get_id_by_symbol(&registry, 300, "Vector3").value, 0);
+
+    define_types(&registry);
+
+    VD_Meta_ID vec3id = vd_meta_get_id_by_symbol(&registry, 300, "Vector3");
+    EXPECT_EQ(vec3id.value, VD_META_ID(Vector3).value);
+
+    // Cached by symbol, so the name is not looked at anymore
+    EXPECT_EQ(vd_meta_get_id_by_symbol(&registry, 300, "").value, VD_META_ID(Vector3).value);
+    EXPECT_EQ(vd_meta_get_id_by_symbol(&registry, 1, "Matrix3x3").value, VD_META_ID(Matrix3x3).value);
+
+    vd_meta_deinit(&registry);
+}
+
 UTEST(vd_meta, when_write_vec3_json_then_is_valid)
 {
     VD_Meta_Registry registry = {0};
@@ -272,6 +321,53 @@ UTEST(vd_meta, when_write_object_with_intrusive_array_containing_fixed_array_the
     vd_meta_deinit(&registry);
 }
 
+UTEST(vd_meta, when_set_array_field_items_then_can_read_them_back)
+{
+    VD_Meta_Registry registry = {0};
+    vd_meta_init(&registry);
+    define_types(&registry);
+
+    // Fixed array
+    {
+        PhoneBookAddress addr = {0};
+        VD_Meta_Descriptor *desc = vd_meta_get_descriptor(&registry, VD_META_ID(PhoneBookAddress));
+        VD_Meta_Field *field = &desc->object.fields[0];
+        VD_Meta_Descriptor *item_desc = vd_meta_get_descriptor(&registry, field->type);
+
+        int32_t value = 42;
+        vd_meta_field_array_set(&registry, item_desc, field, 3, &addr, &value);
+
+        EXPECT_EQ(vd_meta_field_array_len(&registry, item_desc, field, &addr), 10);
+        EXPECT_EQ(addr.number[3], 42);
+        EXPECT_EQ(*(int32_t*)vd_meta_field_array_get(&registry, item_desc, field, 3, &addr), 42);
+        EXPECT_EQ(addr.number[2], 0);
+    }
+
+    // Intrusive array
+    {
+        PhoneBook pb = {0};
+        VD_Meta_Descriptor *desc = vd_meta_get_descriptor(&registry, VD_META_ID(PhoneBook));
+        VD_Meta_Field *field = &desc->object.fields[0];
+        VD_Meta_Descriptor *item_desc = vd_meta_get_descriptor(&registry, field->type);
+
+        ASSERT_NE(vd_meta_field_array_add(&registry, item_desc, field, &pb), NULL);
+        ASSERT_NE(vd_meta_field_array_add(&registry, item_desc, field, &pb), NULL);
+
+        PhoneBookAddress first = { .number = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10} };
+        PhoneBookAddress second = { .number = {11, 12, 13, 14, 15, 16, 17, 18, 19, 20} };
+        vd_meta_field_array_set(&registry, item_desc, field, 0, &pb, &first);
+        vd_meta_field_array_set(&registry, item_desc, field, 1, &pb, &second);
+
+        EXPECT_EQ(vd_meta_field_array_len(&registry, item_desc, field, &pb), 2);
+        EXPECT_EQ(pb.addresses[0].number[0], 1);
+        EXPECT_EQ(pb.addresses[0].number[9], 10);
+        EXPECT_EQ(pb.addresses[1].number[0], 11);
+        EXPECT_EQ(pb.addresses[1].number[9], 20);
+    }
+
+    vd_meta_deinit(&registry);
+}
+
 UTEST(vd_meta, when_write_object_with_intrusive_array_of_strings_then_is_valid)
 {
     VD_Meta_Registry registry = {0};
@@ -408,4 +504,275 @@ UTEST(vd_meta, when_parse_type_hinted_object_with_intrusive_array_of_fixed_array
     }
 
     vd_meta_deinit(&registry);
-}
\ No newline at end of file
+}
+static const char *Address_Book_Json =
+    "{\n"
+    "    \"--vd-meta-type-name--\": \"AddressBook\",\n"
+    "    \"owner\": \"Ren\\u00e9e \\\"R\\\" \\ud83d\\ude00\\n\",\n"
+    "    \"contacts\": [\n"
+    "        { \"first_name\": \"John\", \"country_code\": [\"U\", \"S\"], \"last_name\": \"Smith\" },\n"
+    "        { \"middle_name\": null, \"first_name\": \"Jane\", \"notes\": { \"text\": \"a } b, \\\"c]\", \"tags\": [1, [2], {}] } }\n"
+    "    ],\n"
+    "    \"version\": 3\n"
+    "}";
+
+static void expect_address_book(int *utest_result, AddressBook *book)
+{
+    EXPECT_STREQ(book->owner, "Ren\xc3\xa9" "e \"R\" \xf0\x9f\x98\x80\n");
+    EXPECT_EQ(VD_META_ARRAY_LEN(book->contacts), 2);
+
+    EXPECT_STREQ(book->contacts[0].first_name, "John");
+    EXPECT_STREQ(book->contacts[0].last_name, "Smith");
+    EXPECT_EQ(book->contacts[0].middle_name, NULL);
+    EXPECT_EQ(book->contacts[0].country_code[0], 'U');
+    EXPECT_EQ(book->contacts[0].country_code[1], 'S');
+
+    EXPECT_STREQ(book->contacts[1].first_name, "Jane");
+    EXPECT_EQ(book->contacts[1].middle_name, NULL);
+    EXPECT_EQ(book->contacts[1].last_name, NULL);
+}
+
+UTEST(vd_meta, when_parse_json_with_escapes_and_unknown_fields_then_is_valid)
+{
+    VD_Meta_Registry registry = {0};
+    vd_meta_init(&registry);
+    define_types(&registry);
+
+    void *out_object = 0;
+    VD_Meta_ID out_type;
+    EXPECT_EQ(vd_meta_parse_json(
+        &registry,
+        &(VD_Meta_ParseOptions) { .out_type = &out_type },
+        Address_Book_Json,
+        strlen(Address_Book_Json),
+        &out_object), 0);
+
+    EXPECT_EQ(out_type.value, VD_META_ID(AddressBook).value);
+    expect_address_book(utest_result, (AddressBook*)out_object);
+
+    vd_meta_deinit(&registry);
+}
+
+typedef struct {
+    const char  *data;
+    size_t      len;
+    size_t      pos;
+} TestReader;
+
+static VD_META_READ_PROC(test_read_3_bytes)
+{
+    TestReader *reader = (TestReader*)c;
+    size_t n = reader->len - reader->pos;
+    if (n > 3) n = 3;
+    if (n > cap) n = cap;
+
+    memcpy(dst, reader->data + reader->pos, n);
+    reader->pos += n;
+    return n;
+}
+
+UTEST(vd_meta, when_parse_json_stream_in_small_chunks_then_is_valid)
+{
+    VD_Meta_Registry registry = {0};
+    vd_meta_init(&registry);
+    define_types(&registry);
+
+    // A window smaller than most strings, so that it has to grow and tokens get split across reads
+    TestReader reader = { Address_Book_Json, strlen(Address_Book_Json), 0 };
+    void *out_object = 0;
+    VD_Meta_ID out_type;
+    EXPECT_EQ(vd_meta_parse_json_stream(
+        &registry,
+        &(VD_Meta_ParseOptions) { .out_type = &out_type, .chunk_size = 4 },
+        test_read_3_bytes,
+        &reader,
+        &out_object), 0);
+
+    EXPECT_EQ(out_type.value, VD_META_ID(AddressBook).value);
+    expect_address_book(utest_result, (AddressBook*)out_object);
+
+    // Truncated input fails instead of reading past the end
+    reader = (TestReader) { Address_Book_Json, strlen(Address_Book_Json) - 4, 0 };
+    EXPECT_EQ(vd_meta_parse_json_stream(
+        &registry,
+        &(VD_Meta_ParseOptions) { .out_type = &out_type, .chunk_size = 4 },
+        test_read_3_bytes,
+        &reader,
+        &out_object), VD_META_INVALID_JSON);
+
+    vd_meta_deinit(&registry);
+}
+
+UTEST(vd_meta, when_write_binary_then_parse_binary_is_same)
+{
+    VD_Meta_Registry registry = {0};
+    vd_meta_init(&registry);
+    define_types(&registry);
+
+    void *book = 0;
+    ASSERT_EQ(vd_meta_parse_json(
+        &registry,
+        &(VD_Meta_ParseOptions) {0},
+        Address_Book_Json,
+        strlen(Address_Book_Json),
+        &book), 0);
+
+    void *data = 0;
+    size_t len = 0;
+    ASSERT_EQ(vd_meta_write_binary(
+        &registry,
+        book,
+        VD_META_ID(AddressBook),
+        &(VD_Meta_WriteOptions) {0},
+        &data,
+        &len), 0);
+
+    void *out_object = 0;
+    VD_Meta_ID out_type;
+    EXPECT_EQ(vd_meta_parse_binary(
+        &registry,
+        &(VD_Meta_ParseOptions) { .out_type = &out_type },
+        data,
+        len,
+        &out_object), 0);
+
+    EXPECT_EQ(out_type.value, VD_META_ID(AddressBook).value);
+    expect_address_book(utest_result, (AddressBook*)out_object);
+
+    // Data for one type can't be read as another, and truncated data fails instead of reading past the end
+    EXPECT_EQ(vd_meta_parse_binary(
+        &registry,
+        &(VD_Meta_ParseOptions) { .type = VD_META_ID(PhoneBook) },
+        data,
+        len,
+        &out_object), VD_META_SCHEMA_MISMATCH);
+
+    EXPECT_EQ(vd_meta_parse_binary(
+        &registry,
+        &(VD_Meta_ParseOptions) {0},
+        data,
+        len - 3,
+        &out_object), VD_META_INVALID_BINARY);
+
+    // Intrusive arrays of fixed arrays are copied as blocks
+    PhoneBook pb = {0};
+    for (int i = 0; i < 3; ++i) {
+        PhoneBookAddress addr;
+        for (int j = 0; j < 10; ++j) {
+            addr.number[j] = i * 10 + j;
+        }
+        VD_META_ARRAY_ADD(pb.addresses, addr, registry.alloc, registry.alloc_ctx);
+    }
+
+    ASSERT_EQ(vd_meta_write_binary(
+        &registry,
+        &pb,
+        VD_META_ID(PhoneBook),
+        &(VD_Meta_WriteOptions) {0},
+        &data,
+        &len), 0);
+
+    ASSERT_EQ(vd_meta_parse_binary(
+        &registry,
+        &(VD_Meta_ParseOptions) {0},
+        data,
+        len,
+        &out_object), 0);
+
+    PhoneBook *out_pb = (PhoneBook*)out_object;
+    ASSERT_EQ(VD_META_ARRAY_LEN(out_pb->addresses), 3);
+    EXPECT_EQ(memcmp(out_pb->addresses, pb.addresses, 3 * sizeof(PhoneBookAddress)), 0);
+
+    vd_meta_deinit(&registry);
+}
+
+UTEST(vd_meta, when_write_binary_in_place_then_can_read_without_parsing)
+{
+    VD_Meta_Registry registry = {0};
+    vd_meta_init(&registry);
+    define_types(&registry);
+
+    void *book = 0;
+    ASSERT_EQ(vd_meta_parse_json(
+        &registry,
+        &(VD_Meta_ParseOptions) {0},
+        Address_Book_Json,
+        strlen(Address_Book_Json),
+        &book), 0);
+
+    void *data = 0;
+    size_t len = 0;
+    ASSERT_EQ(vd_meta_write_binary(
+        &registry,
+        book,
+        VD_META_ID(AddressBook),
+        &(VD_Meta_WriteOptions) { .binary_flags = VD_META_BINARY_FLAG_IN_PLACE },
+        &data,
+        &len), 0);
+
+    // Read through the relative offsets, as if the data was mmapped
+    const void *root = 0;
+    ASSERT_EQ(vd_meta_binary_get_root(&registry, data, len, VD_META_ID(AddressBook), &root), 0);
+
+    const AddressBook *in_place = (const AddressBook*)root;
+    EXPECT_STREQ(VD_META_REL_PTR(const char, in_place->owner), ((AddressBook*)book)->owner);
+
+    const Contact *contacts = VD_META_REL_PTR(const Contact, in_place->contacts);
+    EXPECT_EQ(VD_META_ARRAY_LEN(contacts), 2);
+    EXPECT_STREQ(VD_META_REL_PTR(const char, contacts[0].first_name), "John");
+    EXPECT_EQ(VD_META_REL_PTR(const char, contacts[0].middle_name), NULL);
+    EXPECT_EQ(contacts[0].country_code[1], 'S');
+    EXPECT_STREQ(VD_META_REL_PTR(const char, contacts[1].first_name), "Jane");
+
+    // In place data is not the compact format
+    void *out_object = 0;
+    EXPECT_EQ(vd_meta_parse_binary(&registry, &(VD_Meta_ParseOptions) {0}, data, len, &out_object), VD_META_INVALID_BINARY);
+
+    // Relocating turns the offsets into pointers, after which it's a regular object
+    EXPECT_EQ(vd_meta_binary_relocate(&registry, data, len, VD_META_ID(AddressBook), &out_object), 0);
+    EXPECT_EQ(out_object, (void*)root);
+    expect_address_book(utest_result, (AddressBook*)out_object);
+
+    vd_meta_deinit(&registry);
+}
+
+UTEST(vd_meta, when_get_plan_then_primitive_runs_are_merged)
+{
+    VD_Meta_Registry registry = {0};
+    vd_meta_init(&registry);
+    define_types(&registry);
+
+    // Three rows of three floats are one copy
+    VD_Meta_Plan *matrix = vd_meta_get_plan(&registry, VD_META_ID(Matrix3x3));
+    ASSERT_NE(matrix, (VD_Meta_Plan*)0);
+    EXPECT_EQ(matrix->fields_len, 1);
+    EXPECT_EQ(matrix->ops_len, 1);
+    EXPECT_EQ(matrix->ops[0].kind, VD_META_PLAN_OP_COPY);
+    EXPECT_EQ(matrix->ops[0].size, sizeof(Matrix3x3));
+    EXPECT_TRUE(matrix->is_flat);
+    EXPECT_FALSE(matrix->has_pointers);
+
+    // Plans are compiled once
+    EXPECT_EQ(vd_meta_get_plan(&registry, VD_META_ID(Matrix3x3)), matrix);
+
+    VD_Meta_Plan *contact = vd_meta_get_plan(&registry, VD_META_ID(Contact));
+    ASSERT_NE(contact, (VD_Meta_Plan*)0);
+    EXPECT_EQ(contact->fields_len, 4);
+    ASSERT_EQ(contact->ops_len, 4);
+    EXPECT_EQ(contact->ops[0].kind, VD_META_PLAN_OP_CSTRING);
+    EXPECT_EQ(contact->ops[3].kind, VD_META_PLAN_OP_COPY);
+    EXPECT_EQ(contact->ops[3].offset, offsetof(Contact, country_code));
+    EXPECT_EQ(contact->ops[3].size, 2);
+    EXPECT_FALSE(contact->is_flat);
+    EXPECT_TRUE(contact->has_pointers);
+
+    // The element plan of an intrusive array is shared
+    VD_Meta_Plan *book = vd_meta_get_plan(&registry, VD_META_ID(AddressBook));
+    ASSERT_NE(book, (VD_Meta_Plan*)0);
+    EXPECT_EQ(book->fields[1].flags, VD_META_FIELD_FLAG_INTRUSIVE_ARRAY);
+    EXPECT_EQ(book->fields[1].plan, contact);
+
+    EXPECT_EQ(vd_meta_get_plan(&registry, (VD_Meta_ID) { 9999 }), (VD_Meta_Plan*)0);
+
+    vd_meta_deinit(&registry);
+}
@@ -0,0 +1,94 @@
+#define VD_ABBREVIATIONS 1
+#include "utest.h"
+#include "sort.h"
+
+#include <stdlib.h>
+
+/** splitmix64 */
+static u64 test_rand(u64 *state)
+{
+    u64 z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static int is_sorted_stable(SortItem *items, size_t len)
+{
+    for (size_t i = 1; i < len; ++i) {
+        if (items[i - 1].key > items[i].key) {
+            return 0;
+        }
+
+        if (items[i - 1].key == items[i].key && items[i - 1].index > items[i].index) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+UTEST(sort, radix_random_keys)
+{
+    enum { N = 5000 };
+    static SortItem items[N], scratch[N];
+    u64 seed = 0x5EED;
+    u64 sum = 0;
+
+    for (u32 i = 0; i < N; ++i) {
+        items[i].key = test_rand(&seed);
+        items[i].index = i;
+        sum += items[i].key;
+    }
+
+    radix_sort_u64(items, scratch, N);
+    EXPECT_TRUE(is_sorted_stable(items, N));
+
+    for (u32 i = 0; i < N; ++i) {
+        sum -= items[i].key;
+    }
+    EXPECT_EQ(sum, 0ull);
+}
+
+UTEST(sort, radix_is_stable)
+{
+    enum { N = 1000 };
+    static SortItem items[N], scratch[N];
+    u64 seed = 0xABCD;
+
+    // Few distinct keys, spread over the high and low bytes
+    for (u32 i = 0; i < N; ++i) {
+        u64 r = test_rand(&seed);
+        items[i].key = ((r & 3) << 60) | ((r >> 8) & 3);
+        items[i].index = i;
+    }
+
+    radix_sort_u64(items, scratch, N);
+    EXPECT_TRUE(is_sorted_stable(items, N));
+}
+
+UTEST(sort, radix_small_and_uniform)
+{
+    SortItem items[4] = {
+        { .key = 7, .index = 0 },
+        { .key = 7, .index = 1 },
+        { .key = 7, .index = 2 },
+        { .key = 7, .index = 3 },
+    };
+    SortItem scratch[4];
+
+    radix_sort_u64(items, scratch, 0);
+    radix_sort_u64(items, scratch, 1);
+    radix_sort_u64(items, scratch, 4);
+    for (u32 i = 0; i < 4; ++i) {
+        EXPECT_EQ(items[i].index, i);
+    }
+
+    items[0].key = 1ull << 40;
+    items[3].key = 0;
+    radix_sort_u64(items, scratch, 4);
+    EXPECT_EQ(items[0].index, 3u);
+    EXPECT_EQ(items[1].index, 1u);
+    EXPECT_EQ(items[2].index, 2u);
+    EXPECT_EQ(items[3].index, 0u);
+}